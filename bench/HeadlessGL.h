@@ -0,0 +1,39 @@
+// A GL context for the benchmarks that need one, without a window or even a
+// display: Mesa's surfaceless EGL platform where there is one, and EGL's
+// default display otherwise.
+
+#ifndef _BENCH_HEADLESS_GL_H_
+#define _BENCH_HEADLESS_GL_H_ 1
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stddef.h>
+
+/* a GL context with nothing to draw to, made current on this thread */
+static bool makeHeadlessContext() {
+    EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay
+        = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+            "eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(
+            EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)
+        || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    EGLContext context
+        = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, NULL);
+    if (context == EGL_NO_CONTEXT)
+        return false;
+    return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+#endif
@@ -0,0 +1,446 @@
+// Loads the game's assets over and over, without a window, and reports what
+// each one costs as JSON.
+//
+//      bench_assets [--iterations N] [--cached] [--baseline FILE]
+//                   [--threshold PERCENT] [--save] [--verbose]
+//
+// Run it from the top of the repository.  Each iteration goes through the
+// phases below in turn, on a surfaceless EGL context standing in for GLUT's:
+//      hyrulefeild  Hyrule Field, its .mtl and every texture it names
+//      boat         the King of Red Lions
+//      toonlink     Link
+//      md5mesh      FDL.md5mesh (ReadMD5Model(), textures included)
+//      md5anim      FDL.md5anim (ReadMD5Anim())
+// and for each reports the median and best wall time, the peak resident set
+// while it ran and the allocations it made (malloc(), calloc() and
+// realloc(), so new and the driver's too).  One untimed iteration goes
+// first, so texture caches are built and every later load reads them, as
+// the game does after its first run.  --cached also loads the models through
+// their mesh caches, and the md5 files through their compiled copies (see
+// md5binary.h), as the game does, rather than parsing them.
+//
+// The report is compared with FILE (bench/bench_assets.json by default), and
+// bench_assets fails if any phase's best time, peak RSS or allocations grew
+// by more than PERCENT (20 by default).  The best time is steadier than the
+// median, and a phase has to get slower by a millisecond or more besides.
+// --save writes the report there instead.  The numbers only mean anything on
+// the machine that saved them.
+
+#include <GL/glew.h>
+
+#include "HeadlessGL.h"
+
+#include "GLTaskQueue.h"
+#include "MD5/md5model.h"
+#include "Object.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace paone;
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+/* changes in time smaller than this are noise, whatever the percentage */
+static const double MIN_REGRESSION_MS = 1.0;
+
+// Every allocation in the process, counted on its way to glibc's own
+// allocator.  Defining these here puts them in front of libc for the
+// libraries too.
+static atomic<unsigned long> allocations(0);
+static atomic<unsigned long> allocatedBytes(0);
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(count * size, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) { __libc_free(pointer); }
+}
+static const bool COUNTS_ALLOCATIONS = true;
+#else
+static const bool COUNTS_ALLOCATIONS = false;
+#endif
+
+/* start the resident set's high water mark again from here.  false if the
+ * kernel can't, leaving peakRSS() the peak of the whole run */
+static bool resetPeakRSS() {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0)
+        return false;
+    bool reset = write(fd, "5", 1) == 1;
+    close(fd);
+    return reset;
+}
+
+/* the resident set's high water mark, in KiB */
+static long peakRSS() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return atol(line.c_str() + 6);
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/* the loaders talk on stdout; keep that out of the report */
+class QuietStdout {
+public:
+    QuietStdout(bool quiet) : _saved(-1) {
+        if (!quiet)
+            return;
+        fflush(stdout);
+        int null = open("/dev/null", O_WRONLY);
+        if (null < 0)
+            return;
+        _saved = dup(STDOUT_FILENO);
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+    ~QuietStdout() {
+        if (_saved < 0)
+            return;
+        fflush(stdout);
+        dup2(_saved, STDOUT_FILENO);
+        close(_saved);
+    }
+
+private:
+    int _saved;
+};
+
+struct Phase {
+    const char *name;
+    /* the timed load, false if it failed, and the untimed cleanup after */
+    function<bool()> load;
+    function<void()> unload;
+
+    vector<double> ms;
+    vector<unsigned long> allocations, allocatedBytes;
+    long peakRSS;
+};
+
+struct Result {
+    double medianMs, minMs;
+    long peakRSS;
+    unsigned long allocations, allocatedBytes;
+};
+
+template <typename T>
+static T median(vector<T> values) {
+    sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+static Result summarize(const Phase &phase) {
+    Result result;
+    result.medianMs       = median(phase.ms);
+    result.minMs          = *min_element(phase.ms.begin(), phase.ms.end());
+    result.peakRSS        = phase.peakRSS;
+    result.allocations    = median(phase.allocations);
+    result.allocatedBytes = median(phase.allocatedBytes);
+    return result;
+}
+
+static string toJSON(const vector<Phase> &phases, int iterations,
+                     bool cached) {
+    ostringstream out;
+    out << "{\n";
+    out << "  \"iterations\": " << iterations << ",\n";
+    out << "  \"cached\": " << (cached ? "true" : "false") << ",\n";
+    out << "  \"phases\": {\n";
+    for (size_t i = 0; i < phases.size(); i++) {
+        Result result = summarize(phases[i]);
+        char line[512];
+        snprintf(line,
+                 sizeof(line),
+                 "    \"%s\": {\"median_ms\": %.3f, \"min_ms\": %.3f, "
+                 "\"peak_rss_kb\": %ld, \"allocations\": %lu, "
+                 "\"allocated_bytes\": %lu}%s\n",
+                 phases[i].name,
+                 result.medianMs,
+                 result.minMs,
+                 result.peakRSS,
+                 result.allocations,
+                 result.allocatedBytes,
+                 i + 1 < phases.size() ? "," : "");
+        out << line;
+    }
+    out << "  }\n";
+    out << "}\n";
+    return out.str();
+}
+
+/* the number after "key": in the object for phase in a saved report.  only
+ * reads what toJSON() writes, give or take whitespace */
+static bool baselineValue(const string &json, const char *phase,
+                          const char *key, double &value) {
+    size_t start = json.find(string("\"") + phase + "\"");
+    if (start == string::npos)
+        return false;
+    size_t end = json.find('}', start);
+    size_t at  = json.find(string("\"") + key + "\"", start);
+    if (at == string::npos || at > end)
+        return false;
+    at = json.find(':', at);
+    if (at == string::npos || at > end)
+        return false;
+    value = strtod(json.c_str() + at + 1, NULL);
+    return true;
+}
+
+/* how each phase compares with the baseline.  false if any got worse by
+ * more than threshold percent */
+static bool compare(const vector<Phase> &phases, const string &baseline,
+                    double threshold) {
+    bool passed = true;
+    for (size_t i = 0; i < phases.size(); i++) {
+        Result result = summarize(phases[i]);
+        struct {
+            const char *key;
+            double value;
+            bool counted;
+            double slack;
+        } metrics[] = {
+            {"min_ms", result.minMs, true, MIN_REGRESSION_MS},
+            {"peak_rss_kb", (double)result.peakRSS, true, 0},
+            {"allocations",
+             (double)result.allocations,
+             COUNTS_ALLOCATIONS,
+             0},
+        };
+        for (size_t m = 0; m < sizeof(metrics) / sizeof(metrics[0]); m++) {
+            double before;
+            if (!metrics[m].counted
+                || !baselineValue(
+                       baseline, phases[i].name, metrics[m].key, before)
+                || before <= 0)
+                continue;
+
+            double change  = (metrics[m].value - before) / before * 100.0;
+            bool regressed = change > threshold
+                             && metrics[m].value - before > metrics[m].slack;
+            fprintf(stderr,
+                    "%-12s %-12s %12.3f -> %12.3f  %+7.1f%%%s\n",
+                    phases[i].name,
+                    metrics[m].key,
+                    before,
+                    metrics[m].value,
+                    change,
+                    regressed ? "  REGRESSED" : "");
+            passed = passed && !regressed;
+        }
+    }
+    return passed;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: bench_assets [--iterations N] [--cached] "
+            "[--baseline FILE]\n"
+            "                    [--threshold PERCENT] [--save] "
+            "[--verbose]\n");
+}
+
+int main(int argc, char **argv) {
+    int iterations      = 5;
+    bool cached         = false;
+    string baselineFile = "bench/bench_assets.json";
+    double threshold    = 20.0;
+    bool save           = false;
+    bool verbose        = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = max(1, atoi(argv[++i]));
+        } else if (arg == "--cached") {
+            cached = true;
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselineFile = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (arg == "--save") {
+            save = true;
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    if (!makeHeadlessContext()) {
+        fprintf(stderr, "couldn't make a headless GL context\n");
+        return 1;
+    }
+    GLTaskQueue::shared().makeGLThread();
+    glewInit();
+
+    Object *model = NULL;
+    auto objPhase = [&](const char *name, string file) {
+        Phase phase;
+        phase.name = name;
+        phase.load = [&, file]() {
+            model = new Object();
+            return cached ? model->loadCachedObjectFile(
+                                file, file + ".meshcache", false, true)
+                          : model->loadObjectFile(file, false, true);
+        };
+        phase.unload = [&]() {
+            delete model;
+            model = NULL;
+        };
+        return phase;
+    };
+
+    struct md5_model_t md5Model;
+    struct md5_anim_t md5Anim;
+    Phase md5MeshPhase;
+    md5MeshPhase.name = "md5mesh";
+    md5MeshPhase.load = [&]() {
+        memset(&md5Model, 0, sizeof(md5Model));
+        return (cached ? ReadMD5ModelCached("assets/FDL/FDL.md5mesh",
+                                            "assets/FDL/FDL.md5mesh.md5cache",
+                                            &md5Model)
+                       : ReadMD5Model("assets/FDL/FDL.md5mesh", &md5Model))
+               != 0;
+    };
+    md5MeshPhase.unload = [&]() { FreeModel(&md5Model); };
+
+    Phase md5AnimPhase;
+    md5AnimPhase.name = "md5anim";
+    md5AnimPhase.load = [&]() {
+        memset(&md5Anim, 0, sizeof(md5Anim));
+        return (cached ? ReadMD5AnimCached("assets/FDL/FDL.md5anim",
+                                           "assets/FDL/FDL.md5anim.md5cache",
+                                           &md5Anim)
+                       : ReadMD5Anim("assets/FDL/FDL.md5anim", &md5Anim))
+               != 0;
+    };
+    md5AnimPhase.unload = [&]() { FreeAnim(&md5Anim); };
+
+    vector<Phase> phases;
+    phases.push_back(
+        objPhase("hyrulefeild", "assets/Env/HyruleField/hyrulefeild.obj"));
+    phases.push_back(objPhase("boat", "assets/KingOfRedLions/boat.obj"));
+    phases.push_back(objPhase("toonlink", "assets/ToonLink/toonlink.obj"));
+    phases.push_back(md5MeshPhase);
+    phases.push_back(md5AnimPhase);
+
+    for (size_t p = 0; p < phases.size(); p++)
+        phases[p].peakRSS = 0;
+
+    // the first time around only builds the caches.
+    for (int iteration = -1; iteration < iterations; iteration++) {
+        for (size_t p = 0; p < phases.size(); p++) {
+            Phase &phase = phases[p];
+            bool resetRSS = resetPeakRSS();
+            unsigned long allocationsBefore    = allocations.load();
+            unsigned long allocatedBytesBefore = allocatedBytes.load();
+
+            bench_clock::time_point start = bench_clock::now();
+            bool loaded;
+            {
+                QuietStdout quiet(!verbose);
+                loaded = phase.load();
+                glFinish();
+            }
+            double ms = chrono::duration<double, milli>(bench_clock::now()
+                                                        - start)
+                            .count();
+
+            unsigned long phaseAllocations
+                = allocations.load() - allocationsBefore;
+            unsigned long phaseAllocatedBytes
+                = allocatedBytes.load() - allocatedBytesBefore;
+            long phasePeakRSS = peakRSS();
+            phase.unload();
+
+            if (!loaded) {
+                fprintf(stderr, "%s didn't load\n", phase.name);
+                return 1;
+            }
+            if (iteration < 0)
+                continue;
+
+            phase.ms.push_back(ms);
+            phase.allocations.push_back(phaseAllocations);
+            phase.allocatedBytes.push_back(phaseAllocatedBytes);
+            // without a reset, every phase sees the peak so far.
+            phase.peakRSS = resetRSS ? max(phase.peakRSS, phasePeakRSS)
+                                     : phasePeakRSS;
+        }
+    }
+
+    string report = toJSON(phases, iterations, cached);
+    fputs(report.c_str(), stdout);
+
+    if (save) {
+        ofstream out(baselineFile.c_str());
+        out << report;
+        if (!out) {
+            fprintf(stderr, "couldn't write %s\n", baselineFile.c_str());
+            return 1;
+        }
+        fprintf(stderr, "saved as the baseline in %s\n", baselineFile.c_str());
+        return 0;
+    }
+
+    ifstream in(baselineFile.c_str());
+    if (!in) {
+        fprintf(stderr,
+                "no baseline in %s; --save to make one\n",
+                baselineFile.c_str());
+        return 0;
+    }
+    stringstream baseline;
+    baseline << in.rdbuf();
+
+    if (!compare(phases, baseline.str(), threshold)) {
+        fprintf(stderr,
+                "\nregressed by more than %.1f%% against %s\n",
+                threshold,
+                baselineFile.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,337 @@
+// Times the modelLoader's image kernels against the per-pixel loops they
+// replaced, on the diffuse/alpha BMP pairs Hyrule Field is textured with.
+//
+//      bench_image_kernels [directory] [iterations]
+//
+// directory defaults to assets/Env/HyruleField, so run it from the top of the
+// repository (or point it at a copy of the assets).  For every level the CPU
+// supports it reports the best of iterations runs of:
+//      swap       BGR -> RGB over every *_c.bmp
+//      interleave every *_c.bmp with its *_a.bmp into RGBA
+//      load       loadBMP() both halves of each pair, then
+//                 createTransparentTexture()
+// and checks every level produced the same bytes as the old loops.
+
+#include "ImageKernels.h"
+#include "ImageLoader.h"
+#include "MappedFile.h"
+
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace paone;
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+struct Image {
+    string file;
+    int width, height, channels;
+    /* the pixels as they sit in the file (BGR), and decoded (RGB) */
+    vector<unsigned char> bgr, rgb;
+};
+
+struct Pair {
+    Image color, alpha;
+};
+
+/* what the decoders did before: fread, then swap in place a byte at a time */
+static unsigned char *legacyLoadBMP(const string &file, int &width,
+                                    int &height) {
+    FILE *fp = fopen(file.c_str(), "rb");
+    if (!fp)
+        return NULL;
+    fseek(fp, 18, SEEK_CUR);
+    fread(&width, 4, 1, fp);
+    fread(&height, 4, 1, fp);
+    fseek(fp, 28, SEEK_CUR);
+
+    size_t size         = (size_t)width * height * 3;
+    unsigned char *data = (unsigned char *)malloc(size);
+    if (fread(data, size, 1, fp) != 1) {
+        free(data);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+
+    for (size_t i = 0; i < size; i += 3) {
+        char temp   = data[i];
+        data[i]     = data[i + 2];
+        data[i + 2] = temp;
+    }
+    return data;
+}
+
+static void legacySwap(const unsigned char *src, unsigned char *dst,
+                       size_t numPixels) {
+    memcpy(dst, src, numPixels * 3);
+    for (size_t i = 0; i < numPixels * 3; i += 3) {
+        char temp  = dst[i];
+        dst[i]     = dst[i + 2];
+        dst[i + 2] = temp;
+    }
+}
+
+static void legacyInterleave(const unsigned char *imageData,
+                             const unsigned char *imageMask, int texWidth,
+                             int texHeight, int texChannels, int maskChannels,
+                             unsigned char *fullData) {
+    for (int j = 0; j < texHeight; j++) {
+        for (int i = 0; i < texWidth; i++) {
+            fullData[(j * texWidth + i) * 4 + 0]
+                = imageData[(j * texWidth + i) * texChannels + 0];
+            fullData[(j * texWidth + i) * 4 + 1]
+                = imageData[(j * texWidth + i) * texChannels + 1];
+            fullData[(j * texWidth + i) * 4 + 2]
+                = imageData[(j * texWidth + i) * texChannels + 2];
+            fullData[(j * texWidth + i) * 4 + 3]
+                = imageMask[(j * texWidth + i) * maskChannels + 0];
+        }
+    }
+}
+
+static bool readImage(const string &file, Image &image) {
+    image.file = file;
+
+    bool success = false;
+    unsigned char *pixels = loadBMP((char *)file.c_str(),
+                                    image.width,
+                                    image.height,
+                                    image.channels,
+                                    success,
+                                    true,
+                                    "");
+    if (!success)
+        return false;
+    size_t size = (size_t)image.width * image.height * image.channels;
+    image.rgb.assign(pixels, pixels + size);
+    free(pixels);
+
+    image.bgr.resize(size);
+    swapRedBlue3(image.rgb.data(), image.bgr.data(), size / 3);
+    return true;
+}
+
+/* the best time, in milliseconds, of iterations runs of run */
+template <typename F>
+static double best(int iterations, F run) {
+    double fastest = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        bench_clock::time_point start = bench_clock::now();
+        run();
+        double ms = chrono::duration<double, milli>(bench_clock::now() - start)
+                        .count();
+        fastest = min(fastest, ms);
+    }
+    return fastest;
+}
+
+static const char *levelName(ImageKernelLevel level) {
+    switch (level) {
+    case IMAGE_KERNELS_AVX2:
+        return "avx2";
+    case IMAGE_KERNELS_SSSE3:
+        return "ssse3";
+    default:
+        return "scalar";
+    }
+}
+
+static void report(const char *name, const char *level, double ms,
+                   double bytes, double baseline) {
+    printf("%-10s  %-7s  %9.3f ms  %9.1f MB/s  %6.2fx\n",
+           name,
+           level,
+           ms,
+           bytes / (ms * 1e3),
+           baseline / ms);
+}
+
+int main(int argc, char **argv) {
+    string directory = argc > 1 ? argv[1] : "assets/Env/HyruleField";
+    int iterations   = argc > 2 ? atoi(argv[2]) : 20;
+    if (iterations < 1)
+        iterations = 1;
+
+    // every diffuse map with an alpha map to go with it.
+    vector<Pair> pairs;
+    glob_t found;
+    if (glob((directory + "/*_a.bmp").c_str(), 0, NULL, &found) == 0) {
+        for (size_t i = 0; i < found.gl_pathc; i++) {
+            string alphaFile = found.gl_pathv[i];
+            string colorFile
+                = alphaFile.substr(0, alphaFile.size() - 6) + "_c.bmp";
+
+            Pair pair;
+            if (!readImage(alphaFile, pair.alpha)
+                || !readImage(colorFile, pair.color))
+                continue;
+            if (pair.alpha.width != pair.color.width
+                || pair.alpha.height != pair.color.height)
+                continue;
+            pairs.push_back(pair);
+        }
+        globfree(&found);
+    }
+    if (pairs.empty()) {
+        fprintf(stderr, "no *_a.bmp/*_c.bmp pairs in %s\n", directory.c_str());
+        return 1;
+    }
+
+    size_t pixels = 0;
+    for (size_t i = 0; i < pairs.size(); i++)
+        pixels += (size_t)pairs[i].color.width * pairs[i].color.height;
+    printf("%lu pairs, %.2f Mpixels, best of %d\n\n",
+           (unsigned long)pairs.size(),
+           pixels / 1e6,
+           iterations);
+
+    vector<vector<unsigned char> > rgb(pairs.size()), rgba(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        rgb[i].resize(pairs[i].color.rgb.size());
+        rgba[i].resize((size_t)pairs[i].color.width * pairs[i].color.height
+                       * 4);
+    }
+
+    // what the old loops made, to hold every level to.
+    vector<vector<unsigned char> > expected(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        const Pair &pair = pairs[i];
+        expected[i].resize(rgba[i].size());
+        legacyInterleave(pair.color.rgb.data(),
+                         pair.alpha.rgb.data(),
+                         pair.color.width,
+                         pair.color.height,
+                         3,
+                         pair.alpha.channels,
+                         expected[i].data());
+    }
+
+    double swapBytes       = pixels * 3.0;
+    double interleaveBytes = pixels * 4.0;
+
+    double legacySwapMs = best(iterations, [&]() {
+        for (size_t i = 0; i < pairs.size(); i++)
+            legacySwap(pairs[i].color.bgr.data(),
+                       rgb[i].data(),
+                       rgb[i].size() / 3);
+    });
+    double legacyInterleaveMs = best(iterations, [&]() {
+        for (size_t i = 0; i < pairs.size(); i++)
+            legacyInterleave(pairs[i].color.rgb.data(),
+                             pairs[i].alpha.rgb.data(),
+                             pairs[i].color.width,
+                             pairs[i].color.height,
+                             3,
+                             pairs[i].alpha.channels,
+                             rgba[i].data());
+    });
+    double legacyLoadMs = best(iterations, [&]() {
+        for (size_t i = 0; i < pairs.size(); i++) {
+            int w, h;
+            unsigned char *color = legacyLoadBMP(pairs[i].color.file, w, h);
+            unsigned char *alpha = legacyLoadBMP(pairs[i].alpha.file, w, h);
+            unsigned char *full = (unsigned char *)malloc((size_t)w * h * 4);
+            legacyInterleave(color, alpha, w, h, 3, 3, full);
+            free(full);
+            free(alpha);
+            free(color);
+        }
+    });
+
+    printf("%-10s  %-7s  %12s  %14s  %7s\n",
+           "kernel",
+           "level",
+           "time",
+           "throughput",
+           "speedup");
+    report("swap", "legacy", legacySwapMs, swapBytes, legacySwapMs);
+    report("interleave",
+           "legacy",
+           legacyInterleaveMs,
+           interleaveBytes,
+           legacyInterleaveMs);
+    report("load", "legacy", legacyLoadMs, interleaveBytes, legacyLoadMs);
+
+    bool identical = true;
+    for (int level = IMAGE_KERNELS_SCALAR; level <= supportedImageKernels();
+         level++) {
+        limitImageKernels((ImageKernelLevel)level);
+        const char *name = levelName((ImageKernelLevel)level);
+
+        double swapMs = best(iterations, [&]() {
+            for (size_t i = 0; i < pairs.size(); i++)
+                swapRedBlue3(pairs[i].color.bgr.data(),
+                             rgb[i].data(),
+                             rgb[i].size() / 3);
+        });
+        for (size_t i = 0; i < pairs.size(); i++)
+            identical = identical && rgb[i] == pairs[i].color.rgb;
+
+        double interleaveMs = best(iterations, [&]() {
+            for (size_t i = 0; i < pairs.size(); i++)
+                interleaveRGBA(pairs[i].color.rgb.data(),
+                               3,
+                               pairs[i].alpha.rgb.data(),
+                               pairs[i].alpha.channels,
+                               rgba[i].data(),
+                               rgba[i].size() / 4);
+        });
+        for (size_t i = 0; i < pairs.size(); i++)
+            identical = identical && rgba[i] == expected[i];
+
+        double loadMs = best(iterations, [&]() {
+            for (size_t i = 0; i < pairs.size(); i++) {
+                int w, h, colorChannels, alphaChannels;
+                bool success;
+                unsigned char *color
+                    = loadBMP((char *)pairs[i].color.file.c_str(),
+                              w,
+                              h,
+                              colorChannels,
+                              success,
+                              true,
+                              "");
+                unsigned char *alpha
+                    = loadBMP((char *)pairs[i].alpha.file.c_str(),
+                              w,
+                              h,
+                              alphaChannels,
+                              success,
+                              true,
+                              "");
+                unsigned char *full = createTransparentTexture(
+                    color, alpha, w, h, colorChannels, alphaChannels);
+                identical
+                    = identical
+                      && memcmp(full, expected[i].data(), expected[i].size())
+                             == 0;
+                free(full);
+                free(alpha);
+                free(color);
+            }
+        });
+
+        report("swap", name, swapMs, swapBytes, legacySwapMs);
+        report("interleave",
+               name,
+               interleaveMs,
+               interleaveBytes,
+               legacyInterleaveMs);
+        report("load", name, loadMs, interleaveBytes, legacyLoadMs);
+    }
+
+    if (!identical) {
+        fprintf(stderr, "\nthe kernels do not match the old loops!\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,422 @@
+// Compresses an md5 animation into clips (CompressAnim()) at a few error
+// bounds, and reports what each takes in memory, how fast SampleClip() poses
+// it, with and without a cursor, against InterpolateSkeletons() on the whole
+// frames, and how far off the poses are.
+//
+//      bench_md5_clip [mesh] [animation] [iterations]
+//
+// mesh and animation default to assets/FDL/FDL.md5mesh and FDL.md5anim, so
+// run it from the top of the repository.  Poses are sampled SAMPLES times
+// between every frame and the next, the last on to the first as Animate()
+// does.  Each row gives the frames kept, the bytes and the best of
+// iterations runs posing every sample in order, without a cursor and with
+// one, then the worst any joint strays (position and angle) and the worst
+// any skinned vertex does.  It fails if a frame strays from the file by more
+// than the bound the clip was made under, give or take packing the
+// orientations, or if the cursor poses differently.  Last, it poses a crowd
+// of CROWD instances, each from its own copy and a quarter frame on from the
+// last time, once each.
+
+#include <GL/glew.h>
+
+#include "HeadlessGL.h"
+
+#include "GLTaskQueue.h"
+#include "MD5/md5clip.h"
+#include "MD5/md5skin.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+/* poses sampled from each frame on to the next */
+static const int SAMPLES = 4;
+
+/* how far, in radians, packing alone may turn an orientation */
+static const float PACKING_ANGLE = 2e-4f;
+
+/* instances in the crowd, each with its own copy of the animation */
+static const int CROWD = 1024;
+
+/* the bounds to compress at: a position in model units, an angle in radians */
+struct Bound
+{
+    const char *name;
+    float position;
+    float angle;
+};
+static const Bound BOUNDS[] = {{"packed", 0.0f, 0.0f},
+                               {"0.001", 0.001f, 0.0005f},
+                               {"0.01", 0.01f, 0.002f},
+                               {"0.03", 0.03f, 0.006f},
+                               {"0.05", 0.05f, 0.01f}};
+
+/* the one the crowd's clips are compressed at: Md5Object's */
+static const int CROWD_BOUND = 3;
+
+/* the best time, in milliseconds, of iterations runs of run */
+template <typename F>
+static double best(int iterations, F run) {
+    double fastest = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        bench_clock::time_point start = bench_clock::now();
+        run();
+        double ms = chrono::duration<double, milli>(bench_clock::now() - start)
+                        .count();
+        fastest = min(fastest, ms);
+    }
+    return fastest;
+}
+
+/* the angle, in radians, between two orientations.  In double, as acos()
+ * near 1 is too coarse in float to tell turns this small apart */
+static float angleBetween(const quat4_t a, const quat4_t b) {
+    double dot = 0.0, lengthA = 0.0, lengthB = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        dot += (double)a[i] * b[i];
+        lengthA += (double)a[i] * a[i];
+        lengthB += (double)b[i] * b[i];
+    }
+    double cosHalf = fabs(dot) / sqrt(lengthA * lengthB);
+    return cosHalf >= 1.0 ? 0.0f : (float)(2.0 * acos(cosHalf));
+}
+
+/* how far apart two skeletons' joints are, at worst */
+static void compareSkeletons(const struct md5_joint_t *a,
+                             const struct md5_joint_t *b, int num_joints,
+                             float *position, float *angle) {
+    for (int j = 0; j < num_joints; ++j) {
+        float dx = a[j].pos[0] - b[j].pos[0], dy = a[j].pos[1] - b[j].pos[1],
+              dz = a[j].pos[2] - b[j].pos[2];
+        *position = max(*position, sqrtf(dx * dx + dy * dy + dz * dz));
+        *angle    = max(*angle, angleBetween(a[j].orient, b[j].orient));
+    }
+}
+
+int main(int argc, char **argv) {
+    string meshFile      = argc > 1 ? argv[1] : "assets/FDL/FDL.md5mesh";
+    string animationFile = argc > 2 ? argv[2] : "assets/FDL/FDL.md5anim";
+    int iterations       = argc > 3 ? atoi(argv[3]) : 200;
+    if (iterations < 1)
+        iterations = 1;
+
+    // the loader wants somewhere to put the textures.
+    if (!makeHeadlessContext()) {
+        fprintf(stderr, "couldn't make a headless GL context\n");
+        return 1;
+    }
+    paone::GLTaskQueue::shared().makeGLThread();
+    glewInit();
+
+    struct md5_model_t model;
+    struct md5_anim_t animation;
+    memset(&model, 0, sizeof(model));
+    memset(&animation, 0, sizeof(animation));
+
+    // the loaders talk on stdout.
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    bool loaded = ReadMD5Model(meshFile.c_str(), &model)
+                  && ReadMD5Anim(animationFile.c_str(), &animation)
+                  && animation.num_joints == model.num_joints
+                  && animation.num_frames > 0;
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(null);
+    close(saved);
+    if (!loaded) {
+        fprintf(stderr,
+                "couldn't load %s with %s\n",
+                meshFile.c_str(),
+                animationFile.c_str());
+        return 1;
+    }
+
+    int num_joints = animation.num_joints;
+    int num_frames = animation.num_frames;
+    int samples    = num_frames * SAMPLES;
+
+    // what md5_anim_t keeps of the skeletons: every joint of every frame.
+    unsigned long animBytes
+        = sizeof(struct md5_anim_t)
+          + num_frames
+                * (sizeof(struct md5_joint_t *)
+                   + sizeof(struct md5_joint_t) * num_joints);
+
+    // every sample posed from the whole frames, and skinned.
+    vector<struct md5_joint_t> skeleton(num_joints);
+    vector<struct md5_matrix_t> palette(num_joints);
+    vector<vector<struct md5_joint_t> > expected(samples);
+    vector<vector<float> > expectedVerts(samples * model.num_meshes);
+    float size = 0.0f;
+    for (int s = 0; s < samples; ++s) {
+        int f = s / SAMPLES;
+        expected[s].resize(num_joints);
+        InterpolateSkeletons(animation.skelFrames[f],
+                             animation.skelFrames[(f + 1) % num_frames],
+                             num_joints,
+                             (float)(s % SAMPLES) / SAMPLES,
+                             expected[s].data());
+        BuildPalette(
+            expected[s].data(), model.inverseBind, num_joints, palette.data());
+        for (unsigned int m = 0; m < model.num_meshes; ++m) {
+            vector<float> &verts = expectedVerts[s * model.num_meshes + m];
+            verts.resize(model.meshes[m].num_verts * 3);
+            SkinVertices(
+                model.meshes[m].skin, palette.data(), (vec3_t *)verts.data());
+            for (size_t i = 0; i < verts.size(); ++i)
+                size = max(size, fabsf(verts[i]));
+        }
+    }
+
+    double wholeMs = best(iterations, [&]() {
+        for (int s = 0; s < samples; ++s) {
+            int f = s / SAMPLES;
+            InterpolateSkeletons(animation.skelFrames[f],
+                                 animation.skelFrames[(f + 1) % num_frames],
+                                 num_joints,
+                                 (float)(s % SAMPLES) / SAMPLES,
+                                 skeleton.data());
+        }
+    });
+
+    printf("%d frames of %d joints, %d poses, best of %d\n\n",
+           num_frames,
+           num_joints,
+           samples,
+           iterations);
+    printf("%-7s  %6s  %8s  %6s  %9s  %9s  %10s  %10s  %10s\n",
+           "bound",
+           "frames",
+           "bytes",
+           "ratio",
+           "us/pose",
+           "cursor",
+           "joint",
+           "radians",
+           "vertex");
+    printf("%-7s  %6d  %8lu  %5.2fx  %9.3f  %9.3f  %10.3g  %10.3g  %10.3g\n",
+           "whole",
+           num_frames,
+           animBytes,
+           1.0,
+           wholeMs * 1e3 / samples,
+           wholeMs * 1e3 / samples,
+           0.0,
+           0.0,
+           0.0);
+
+    bool strayed = false, differed = false;
+    vector<float> verts;
+    vector<struct md5_joint_t> uncursored(num_joints);
+    for (const Bound &bound : BOUNDS) {
+        struct md5_clip_t clip;
+        CompressAnim(&animation, bound.position, bound.angle, &clip);
+
+        double ms = best(iterations, [&]() {
+            for (int s = 0; s < samples; ++s) {
+                int f = s / SAMPLES;
+                SampleClip(&clip,
+                           NULL,
+                           f,
+                           (f + 1) % num_frames,
+                           (float)(s % SAMPLES) / SAMPLES,
+                           skeleton.data());
+            }
+        });
+
+        struct md5_clip_cursor_t cursor;
+        InitClipCursor(&clip, &cursor);
+        double cursorMs = best(iterations, [&]() {
+            for (int s = 0; s < samples; ++s) {
+                int f = s / SAMPLES;
+                SampleClip(&clip,
+                           &cursor,
+                           f,
+                           (f + 1) % num_frames,
+                           (float)(s % SAMPLES) / SAMPLES,
+                           skeleton.data());
+            }
+        });
+
+        // how far off every sample is, and every frame the file has.
+        float position = 0.0f, angle = 0.0f, vertex = 0.0f;
+        float framePosition = 0.0f, frameAngle = 0.0f;
+        for (int s = 0; s < samples; ++s) {
+            int f = s / SAMPLES;
+            float interp = (float)(s % SAMPLES) / SAMPLES;
+            SampleClip(&clip,
+                       &cursor,
+                       f,
+                       (f + 1) % num_frames,
+                       interp,
+                       skeleton.data());
+            SampleClip(&clip,
+                       NULL,
+                       f,
+                       (f + 1) % num_frames,
+                       interp,
+                       uncursored.data());
+            for (int j = 0; j < num_joints; ++j)
+                differed |= skeleton[j].parent != uncursored[j].parent
+                            || memcmp(skeleton[j].pos,
+                                      uncursored[j].pos,
+                                      sizeof(vec3_t))
+                            || memcmp(skeleton[j].orient,
+                                      uncursored[j].orient,
+                                      sizeof(quat4_t));
+            compareSkeletons(skeleton.data(),
+                             expected[s].data(),
+                             num_joints,
+                             &position,
+                             &angle);
+            if (s % SAMPLES == 0)
+                compareSkeletons(skeleton.data(),
+                                 animation.skelFrames[f],
+                                 num_joints,
+                                 &framePosition,
+                                 &frameAngle);
+
+            BuildPalette(
+                skeleton.data(), model.inverseBind, num_joints, palette.data());
+            for (unsigned int m = 0; m < model.num_meshes; ++m) {
+                const vector<float> &want
+                    = expectedVerts[s * model.num_meshes + m];
+                verts.resize(want.size());
+                SkinVertices(model.meshes[m].skin,
+                             palette.data(),
+                             (vec3_t *)verts.data());
+                for (size_t i = 0; i < verts.size(); i += 3) {
+                    float dx = verts[i] - want[i], dy = verts[i + 1] - want[i + 1],
+                          dz = verts[i + 2] - want[i + 2];
+                    vertex = max(vertex, sqrtf(dx * dx + dy * dy + dz * dz));
+                }
+            }
+        }
+
+        unsigned long bytes = ClipBytes(&clip);
+        printf("%-7s  %6u  %8lu  %5.2fx  %9.3f  %9.3f  %10.3g  %10.3g  "
+               "%10.3g\n",
+               bound.name,
+               clip.num_keys,
+               bytes,
+               (double)animBytes / bytes,
+               ms * 1e3 / samples,
+               cursorMs * 1e3 / samples,
+               position,
+               angle,
+               vertex);
+
+        if (framePosition > bound.position * 1.0001f
+            || frameAngle > bound.angle + PACKING_ANGLE) {
+            fprintf(stderr,
+                    "  a frame strayed by %g, %g radians\n",
+                    framePosition,
+                    frameAngle);
+            strayed = true;
+        }
+        FreeClipCursor(&cursor);
+        FreeClip(&clip);
+    }
+    printf("\nerrors are in model units; no vertex is more than %g from the "
+           "origin\n",
+           size);
+
+    // a crowd, each with its own copy, so the frames come from memory
+    // rather than a cache the one animation sits in.
+    const Bound &crowdBound = BOUNDS[CROWD_BOUND];
+    vector<vector<struct md5_joint_t> > crowdFrames(CROWD);
+    vector<struct md5_clip_t> crowdClips(CROWD);
+    vector<struct md5_clip_cursor_t> crowdCursors(CROWD);
+    for (int c = 0; c < CROWD; ++c) {
+        crowdFrames[c].resize(num_frames * num_joints);
+        for (int f = 0; f < num_frames; ++f)
+            memcpy(&crowdFrames[c][f * num_joints],
+                   animation.skelFrames[f],
+                   sizeof(struct md5_joint_t) * num_joints);
+        CompressAnim(&animation,
+                     crowdBound.position,
+                     crowdBound.angle,
+                     &crowdClips[c]);
+        InitClipCursor(&crowdClips[c], &crowdCursors[c]);
+    }
+
+    // each a quarter frame on from the last round, as a game drawing faster
+    // than the animation's frame rate moves them.
+    int round         = 0;
+    double crowdWhole = best(iterations, [&]() {
+        ++round;
+        for (int c = 0; c < CROWD; ++c) {
+            int s = (c + round) % samples, f = s / SAMPLES;
+            InterpolateSkeletons(&crowdFrames[c][f * num_joints],
+                                 &crowdFrames[c][(f + 1) % num_frames
+                                                 * num_joints],
+                                 num_joints,
+                                 (float)(s % SAMPLES) / SAMPLES,
+                                 skeleton.data());
+        }
+    });
+    double crowdClip = best(iterations, [&]() {
+        ++round;
+        for (int c = 0; c < CROWD; ++c) {
+            int s = (c + round) % samples, f = s / SAMPLES;
+            SampleClip(&crowdClips[c],
+                       NULL,
+                       f,
+                       (f + 1) % num_frames,
+                       (float)(s % SAMPLES) / SAMPLES,
+                       skeleton.data());
+        }
+    });
+    double crowdCursor = best(iterations, [&]() {
+        ++round;
+        for (int c = 0; c < CROWD; ++c) {
+            int s = (c + round) % samples, f = s / SAMPLES;
+            SampleClip(&crowdClips[c],
+                       &crowdCursors[c],
+                       f,
+                       (f + 1) % num_frames,
+                       (float)(s % SAMPLES) / SAMPLES,
+                       skeleton.data());
+        }
+    });
+    printf("crowd of %d: %.3f us/pose whole (%lu bytes), %.3f us/pose "
+           "clipped at %s (%lu bytes), %.3f with a cursor\n",
+           CROWD,
+           crowdWhole * 1e3 / CROWD,
+           animBytes * CROWD,
+           crowdClip * 1e3 / CROWD,
+           crowdBound.name,
+           ClipBytes(&crowdClips[0]) * CROWD,
+           crowdCursor * 1e3 / CROWD);
+    for (int c = 0; c < CROWD; ++c)
+        FreeClipCursor(&crowdCursors[c]);
+    for (int c = 0; c < CROWD; ++c)
+        FreeClip(&crowdClips[c]);
+
+    FreeAnim(&animation);
+    FreeModel(&model);
+
+    if (strayed) {
+        fprintf(stderr, "\na clip strayed past its bound!\n");
+        return 1;
+    }
+    if (differed) {
+        fprintf(stderr, "\na cursor posed differently from its clip!\n");
+        return 1;
+    }
+    return 0;
+}
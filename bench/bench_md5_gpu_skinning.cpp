@@ -0,0 +1,266 @@
+// Draws every frame of an md5 animation skinned on the CPU (PrepareMesh(),
+// DrawMesh()) and in glsl/md5shader.v.glsl (DrawGPUMesh()), and checks the
+// pictures match.
+//
+//      bench_md5_gpu_skinning [mesh] [animation] [iterations]
+//
+// mesh and animation default to assets/FDL/FDL.md5mesh and FDL.md5anim, so
+// run it from the top of the repository.  Pixels more than a few levels
+// apart count as different; only triangle edges, where a vertex moved by
+// rounding tips a pixel in or out, should be, so it fails if more than
+// MAX_DIFFERENT of the pixels the model covers are.  It also reports the
+// best of iterations draws of every frame each way, and what each streams
+// to GL per frame.  Under Mesa's llvmpipe both run on the CPU, so the times
+// say more about the driver than about a GPU.
+
+#include <GL/glew.h>
+
+#include "HeadlessGL.h"
+
+#include "GLTaskQueue.h"
+#include "Shader.hpp"
+#include "MD5/md5mesh.h"
+#include "MD5/md5skin.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+/* pictures are SIZE x SIZE */
+static const int SIZE = 512;
+
+/* a pixel is different if a channel is more than this far off */
+static const int TOLERANCE = 8;
+
+/* the share of the model's pixels allowed to be */
+static const double MAX_DIFFERENT = 0.005;
+
+/* the best time, in milliseconds, of iterations runs of run */
+template <typename F>
+static double best(int iterations, F run) {
+    double fastest = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        bench_clock::time_point start = bench_clock::now();
+        run();
+        glFinish();
+        double ms = chrono::duration<double, milli>(bench_clock::now() - start)
+                        .count();
+        fastest = min(fastest, ms);
+    }
+    return fastest;
+}
+
+int main(int argc, char **argv) {
+    string meshFile      = argc > 1 ? argv[1] : "assets/FDL/FDL.md5mesh";
+    string animationFile = argc > 2 ? argv[2] : "assets/FDL/FDL.md5anim";
+    int iterations       = argc > 3 ? atoi(argv[3]) : 10;
+    if (iterations < 1)
+        iterations = 1;
+
+    if (!makeHeadlessContext()) {
+        fprintf(stderr, "couldn't make a headless GL context\n");
+        return 1;
+    }
+    paone::GLTaskQueue::shared().makeGLThread();
+    glewInit();
+    printf("%s\n", (const char *)glGetString(GL_RENDERER));
+
+    ShaderProgram shader;
+    setupMD5Shaders(shader, "glsl/md5shader.v.glsl", "glsl/md5shader.f.glsl");
+
+    struct md5_model_t model;
+    struct md5_anim_t animation;
+    memset(&model, 0, sizeof(model));
+    memset(&animation, 0, sizeof(animation));
+
+    // the loaders talk on stdout.
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    bool loaded = ReadMD5Model(meshFile.c_str(), &model)
+                  && ReadMD5Anim(animationFile.c_str(), &animation)
+                  && animation.num_joints == model.num_joints;
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(null);
+    close(saved);
+    if (!loaded) {
+        fprintf(stderr,
+                "couldn't load %s with %s\n",
+                meshFile.c_str(),
+                animationFile.c_str());
+        return 1;
+    }
+    if (MaxGPUSkinningJoints(shader) < (int)model.num_joints) {
+        fprintf(stderr,
+                "the shader can't skin %u joints\n",
+                model.num_joints);
+        return 1;
+    }
+    vector<struct md5_gpu_mesh_t> gpuMeshes(model.num_meshes);
+    vector<vec3_t *> cpuVertices(model.num_meshes);
+    size_t vertices = 0;
+    for (unsigned int m = 0; m < model.num_meshes; ++m) {
+        struct md5_gpu_vertex_t *gpuVertices
+            = BuildGPUVertices(&model.meshes[m]);
+        if (!gpuVertices) {
+            fprintf(stderr, "mesh %u has too many joints to a vertex\n", m);
+            return 1;
+        }
+        UploadGPUMesh(&model.meshes[m], gpuVertices, &gpuMeshes[m]);
+        free(gpuVertices);
+        cpuVertices[m] = AllocSkinnedVertices(model.meshes[m].num_verts);
+
+        vertices += model.meshes[m].num_verts;
+    }
+
+    // somewhere to draw.
+    GLuint framebuffer, renderbuffers[2];
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SIZE, SIZE);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER,
+                              renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SIZE, SIZE);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                              GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER,
+                              renderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "couldn't make a framebuffer\n");
+        return 1;
+    }
+    glViewport(0, 0, SIZE, SIZE);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    // the whole animation, square on, stood up the way Md5Object has it.
+    vec3_t lo = {1e30f, 1e30f, 1e30f}, hi = {-1e30f, -1e30f, -1e30f};
+    for (unsigned int f = 0; f < animation.num_frames; ++f) {
+        for (int c = 0; c < 3; ++c) {
+            lo[c] = min(lo[c], animation.bboxes[f].min[c]);
+            hi[c] = max(hi[c], animation.bboxes[f].max[c]);
+        }
+    }
+    float half = max(hi[0] - lo[0], hi[2] - lo[2]) * 0.55f;
+    float cx = (lo[0] + hi[0]) * 0.5f, cz = (lo[2] + hi[2]) * 0.5f;
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(cx - half, cx + half, cz - half, cz + half, lo[1] - 1, hi[1] + 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glRotatef(-90.f, 1.0, 0.0, 0.0);
+
+    shader.use();
+    vector<struct md5_matrix_t> palette(model.num_joints);
+
+    auto drawOnCPU = [&](unsigned int f) {
+        BuildPalette(animation.skelFrames[f],
+                     model.inverseBind,
+                     model.num_joints,
+                     palette.data());
+        SetSkinningPalette(shader, NULL, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (unsigned int m = 0; m < model.num_meshes; ++m) {
+            PrepareMesh(&model.meshes[m], palette.data(), cpuVertices[m]);
+            DrawMesh(&model.meshes[m], cpuVertices[m]);
+        }
+    };
+    auto drawOnGPU = [&](unsigned int f) {
+        BuildPalette(animation.skelFrames[f],
+                     model.inverseBind,
+                     model.num_joints,
+                     palette.data());
+        SetSkinningPalette(shader, palette.data(), model.num_joints);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        for (unsigned int m = 0; m < model.num_meshes; ++m)
+            DrawGPUMesh(&model.meshes[m], &gpuMeshes[m]);
+    };
+
+    // the pictures.
+    vector<unsigned char> want(SIZE * SIZE * 4), got(SIZE * SIZE * 4);
+    size_t covered = 0, different = 0;
+    int worst = 0;
+    for (unsigned int f = 0; f < animation.num_frames; ++f) {
+        drawOnCPU(f);
+        glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, &want[0]);
+        drawOnGPU(f);
+        glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, &got[0]);
+
+        for (int p = 0; p < SIZE * SIZE; ++p) {
+            const unsigned char *a = &want[p * 4], *b = &got[p * 4];
+            int apart = 0;
+            for (int c = 0; c < 4; ++c)
+                apart = max(apart, abs(a[c] - b[c]));
+            covered += a[3] || b[3];
+            different += apart > TOLERANCE;
+            worst = max(worst, apart);
+        }
+    }
+    double share = covered ? (double)different / covered : 1.0;
+    printf("%u frames at %dx%d: %lu of %lu pixels different (%.3f%%), "
+           "worst by %d\n\n",
+           animation.num_frames,
+           SIZE,
+           SIZE,
+           (unsigned long)different,
+           (unsigned long)covered,
+           share * 100.0,
+           worst);
+
+    // the times.
+    double cpuMs = best(iterations, [&]() {
+        for (unsigned int f = 0; f < animation.num_frames; ++f)
+            drawOnCPU(f);
+    });
+    double gpuMs = best(iterations, [&]() {
+        for (unsigned int f = 0; f < animation.num_frames; ++f)
+            drawOnGPU(f);
+    });
+
+    // the CPU streams the skinned positions every frame (the texels and
+    // indices are in buffers already); the GPU just the palette.
+    size_t cpuBytes = vertices * sizeof(vec3_t);
+    size_t gpuBytes = model.num_joints * sizeof(struct md5_matrix_t);
+    printf("%-4s  %10s  %14s\n", "path", "ms/frame", "bytes/frame");
+    printf("%-4s  %10.3f  %14lu\n",
+           "cpu",
+           cpuMs / animation.num_frames,
+           (unsigned long)cpuBytes);
+    printf("%-4s  %10.3f  %14lu\n",
+           "gpu",
+           gpuMs / animation.num_frames,
+           (unsigned long)gpuBytes);
+
+    ShaderProgram::useFFS();
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, renderbuffers);
+    for (unsigned int m = 0; m < model.num_meshes; ++m) {
+        FreeGPUMesh(&gpuMeshes[m]);
+        FreeSkinnedVertices(cpuVertices[m], model.meshes[m].num_verts);
+    }
+    FreeAnim(&animation);
+    FreeModel(&model);
+
+    if (share > MAX_DIFFERENT) {
+        fprintf(stderr, "\nskinning on the GPU strayed from the CPU!\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+// Times md5 skinning (SkinVertices()) against the per-weight
+// Quat_rotatePoint() loop PrepareMesh() used to run, over every frame of an
+// animation.
+//
+//      bench_md5_skinning [mesh] [animation] [iterations]
+//
+// mesh and animation default to assets/FDL/FDL.md5mesh and FDL.md5anim, so
+// run it from the top of the repository.  For every level the CPU supports
+// it reports the best of iterations runs over every frame, and checks every
+// vertex lands within a millionth of the model's size of where the old loop
+// put it.  Last, it skins a crowd of CROWD instances, each a frame apart and
+// each into its own vertices, one after the other and then on the workers.
+
+#include <GL/glew.h>
+
+#include "HeadlessGL.h"
+
+#include "GLTaskQueue.h"
+#include "WorkerPool.h"
+#include "MD5/md5model.h"
+#include "MD5/md5skin.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock bench_clock;
+
+/* instances in the crowd */
+static const int CROWD = 16;
+
+/* what PrepareMesh() did for every vertex before */
+static void legacySkin(const struct md5_mesh_t *mesh,
+                       const struct md5_joint_t *skeleton, vec3_t *out) {
+    for (int i = 0; i < mesh->num_verts; ++i) {
+        vec3_t finalVertex = {0.0f, 0.0f, 0.0f};
+
+        for (int j = 0; j < mesh->vertices[i].count; ++j) {
+            const struct md5_weight_t *weight
+                = &mesh->weights[mesh->vertices[i].start + j];
+            const struct md5_joint_t *joint = &skeleton[weight->joint];
+
+            vec3_t wv;
+            Quat_rotatePoint(joint->orient, weight->pos, wv);
+
+            finalVertex[0] += (joint->pos[0] + wv[0]) * weight->bias;
+            finalVertex[1] += (joint->pos[1] + wv[1]) * weight->bias;
+            finalVertex[2] += (joint->pos[2] + wv[2]) * weight->bias;
+        }
+
+        out[i][0] = finalVertex[0];
+        out[i][1] = finalVertex[1];
+        out[i][2] = finalVertex[2];
+    }
+}
+
+/* the best time, in milliseconds, of iterations runs of run */
+template <typename F>
+static double best(int iterations, F run) {
+    double fastest = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        bench_clock::time_point start = bench_clock::now();
+        run();
+        double ms = chrono::duration<double, milli>(bench_clock::now() - start)
+                        .count();
+        fastest = min(fastest, ms);
+    }
+    return fastest;
+}
+
+static const char *levelName(enum md5_skin_level_t level) {
+    switch (level) {
+    case MD5_SKIN_AVX2:
+        return "avx2";
+    case MD5_SKIN_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+static void report(const char *level, double ms, double vertices,
+                   double baseline, double error) {
+    printf("%-7s  %9.3f ms  %8.2f Mverts/s  %6.2fx  %10.3g\n",
+           level,
+           ms,
+           vertices / (ms * 1e3),
+           baseline / ms,
+           error);
+}
+
+int main(int argc, char **argv) {
+    string meshFile      = argc > 1 ? argv[1] : "assets/FDL/FDL.md5mesh";
+    string animationFile = argc > 2 ? argv[2] : "assets/FDL/FDL.md5anim";
+    int iterations       = argc > 3 ? atoi(argv[3]) : 20;
+    if (iterations < 1)
+        iterations = 1;
+
+    // the loader wants somewhere to put the textures.
+    if (!makeHeadlessContext()) {
+        fprintf(stderr, "couldn't make a headless GL context\n");
+        return 1;
+    }
+    paone::GLTaskQueue::shared().makeGLThread();
+    glewInit();
+
+    struct md5_model_t model;
+    struct md5_anim_t animation;
+    memset(&model, 0, sizeof(model));
+    memset(&animation, 0, sizeof(animation));
+
+    // the loaders talk on stdout.
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    bool loaded = ReadMD5Model(meshFile.c_str(), &model)
+                  && ReadMD5Anim(animationFile.c_str(), &animation)
+                  && animation.num_joints == model.num_joints;
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(null);
+    close(saved);
+    if (!loaded) {
+        fprintf(stderr,
+                "couldn't load %s with %s\n",
+                meshFile.c_str(),
+                animationFile.c_str());
+        return 1;
+    }
+
+    size_t vertices = 0, weights = 0;
+    int maxVerts    = 0;
+    for (unsigned int m = 0; m < model.num_meshes; ++m) {
+        vertices += model.meshes[m].num_verts;
+        weights += model.meshes[m].num_weights;
+        maxVerts = max(maxVerts, model.meshes[m].num_verts);
+    }
+    double skinned = (double)vertices * animation.num_frames;
+    printf("%u meshes, %lu vertices, %lu weights, %u frames, best of %d\n\n",
+           model.num_meshes,
+           (unsigned long)vertices,
+           (unsigned long)weights,
+           animation.num_frames,
+           iterations);
+
+    // where the old loop put every vertex of every frame.
+    vector<vector<float> > expected(model.num_meshes * animation.num_frames);
+    float size = 0.0f;
+    for (unsigned int f = 0; f < animation.num_frames; ++f) {
+        for (unsigned int m = 0; m < model.num_meshes; ++m) {
+            vector<float> &out = expected[f * model.num_meshes + m];
+            out.resize(model.meshes[m].num_verts * 3);
+            legacySkin(&model.meshes[m],
+                       animation.skelFrames[f],
+                       (vec3_t *)out.data());
+            for (size_t i = 0; i < out.size(); ++i)
+                size = max(size, fabsf(out[i]));
+        }
+    }
+
+    vector<float> buffer(maxVerts * 3);
+    vec3_t *out = (vec3_t *)buffer.data();
+    vector<struct md5_matrix_t> palette(model.num_joints);
+
+    double legacyMs = best(iterations, [&]() {
+        for (unsigned int f = 0; f < animation.num_frames; ++f)
+            for (unsigned int m = 0; m < model.num_meshes; ++m)
+                legacySkin(&model.meshes[m], animation.skelFrames[f], out);
+    });
+
+    printf("%-7s  %12s  %17s  %7s  %10s\n",
+           "level",
+           "time",
+           "throughput",
+           "speedup",
+           "max error");
+    report("legacy", legacyMs, skinned, legacyMs, 0.0);
+
+    bool matches = true;
+    for (int level = MD5_SKIN_SCALAR; level <= SupportedSkinLevel();
+         level++) {
+        LimitSkinLevel((enum md5_skin_level_t)level);
+
+        // each frame's palette is part of the cost, as it is in a game.
+        double ms = best(iterations, [&]() {
+            for (unsigned int f = 0; f < animation.num_frames; ++f) {
+                BuildPalette(animation.skelFrames[f],
+                             model.inverseBind,
+                             model.num_joints,
+                             palette.data());
+                for (unsigned int m = 0; m < model.num_meshes; ++m)
+                    SkinVertices(model.meshes[m].skin, palette.data(), out);
+            }
+        });
+
+        float error = 0.0f;
+        for (unsigned int f = 0; f < animation.num_frames; ++f) {
+            BuildPalette(animation.skelFrames[f],
+                         model.inverseBind,
+                         model.num_joints,
+                         palette.data());
+            for (unsigned int m = 0; m < model.num_meshes; ++m) {
+                SkinVertices(model.meshes[m].skin, palette.data(), out);
+                const vector<float> &want = expected[f * model.num_meshes + m];
+                for (size_t i = 0; i < want.size(); ++i)
+                    error = max(error, fabsf(buffer[i] - want[i]));
+            }
+        }
+        matches = matches && error <= size * 1e-6f;
+
+        report(levelName((enum md5_skin_level_t)level),
+               ms,
+               skinned,
+               legacyMs,
+               error);
+    }
+
+    // the crowd, at the best level.
+    LimitSkinLevel(SupportedSkinLevel());
+    vector<vector<struct md5_matrix_t> > poses(CROWD);
+    vector<vector<vec3_t *> > crowd(CROWD);
+    for (int c = 0; c < CROWD; ++c) {
+        poses[c].resize(model.num_joints);
+        for (unsigned int m = 0; m < model.num_meshes; ++m)
+            crowd[c].push_back(
+                AllocSkinnedVertices(model.meshes[m].num_verts));
+    }
+    auto skinInstance = [&](int c, unsigned int f) {
+        BuildPalette(animation.skelFrames[(f + c) % animation.num_frames],
+                     model.inverseBind,
+                     model.num_joints,
+                     poses[c].data());
+        for (unsigned int m = 0; m < model.num_meshes; ++m)
+            SkinVertices(model.meshes[m].skin, poses[c].data(), crowd[c][m]);
+    };
+
+    double serialMs = best(iterations, [&]() {
+        for (unsigned int f = 0; f < animation.num_frames; ++f)
+            for (int c = 0; c < CROWD; ++c)
+                skinInstance(c, f);
+    });
+    double parallelMs = best(iterations, [&]() {
+        vector<function<void()> > jobs;
+        for (unsigned int f = 0; f < animation.num_frames; ++f) {
+            jobs.clear();
+            for (int c = 0; c < CROWD; ++c)
+                jobs.push_back([&, c, f]() { skinInstance(c, f); });
+            paone::WorkerPool::shared().run(jobs);
+        }
+    });
+    printf("\ncrowd of %d: %.3f ms a frame one by one, %.3f ms on %u "
+           "workers (%.2fx)\n",
+           CROWD,
+           serialMs / animation.num_frames,
+           parallelMs / animation.num_frames,
+           paone::WorkerPool::shared().size(),
+           serialMs / parallelMs);
+
+    for (int c = 0; c < CROWD; ++c)
+        for (unsigned int m = 0; m < model.num_meshes; ++m)
+            FreeSkinnedVertices(crowd[c][m], model.meshes[m].num_verts);
+
+    FreeAnim(&animation);
+    FreeModel(&model);
+
+    if (!matches) {
+        fprintf(stderr, "\nskinning strayed from the old loop!\n");
+        return 1;
+    }
+    return 0;
+}
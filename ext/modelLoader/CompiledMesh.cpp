@@ -0,0 +1,286 @@
+#include "CompiledMesh.h"
+#include "Hash.h"
+#include "Point.h"
+#include "Vector.h"
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+#include <unordered_map>
+
+namespace paone {
+
+CompiledMesh::CompiledMesh() { clear(); }
+
+void CompiledMesh::clear() {
+    positions.clear();
+    normals.clear();
+    texCoords.clear();
+    colors.clear();
+    indices.clear();
+    triangleMaterials.clear();
+    batches.clear();
+    levels.clear();
+    materials.clear();
+
+    numFaces = 0;
+    minX = minY = minZ = 999999;
+    maxX = maxY = maxZ = -999999;
+}
+
+MeshArrays CompiledMesh::arrays() const {
+    MeshArrays arrays;
+    arrays.positions   = positions.data();
+    arrays.normals     = normals.data();
+    arrays.texCoords   = texCoords.data();
+    arrays.colors      = colors.empty() ? NULL : colors.data();
+    arrays.numVertices = (GLuint)(positions.size() / 3);
+    arrays.indices     = indices.data();
+    arrays.numIndices  = (GLuint)indices.size();
+    arrays.triangleMaterials = triangleMaterials.data();
+    arrays.batches     = batches.data();
+    arrays.numBatches  = (GLuint)batches.size();
+    arrays.levels      = levels.empty() ? NULL : levels.data();
+    arrays.numLevels   = (GLuint)levels.size();
+    return arrays;
+}
+
+/* what makes two corners the same vertex */
+struct VertexKey {
+    int v, vt, vn;
+    /* the face normal, for faces without normals of their own */
+    GLfloat normal[3];
+
+    bool operator==(const VertexKey &rhs) const {
+        return memcmp(this, &rhs, sizeof(VertexKey)) == 0;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey &key) const {
+        return (size_t)hashBytes(&key, sizeof(VertexKey));
+    }
+};
+
+typedef unordered_map<VertexKey, GLuint, VertexKeyHash> VertexMap;
+
+/* the images a batch is textured with.  empty if it isn't */
+static string textureOf(const MeshBatch &batch,
+                        const vector<MtlMaterial> &materials) {
+    if (batch.material < 0 || materials[batch.material].diffuseMap.empty())
+        return string();
+    return materials[batch.material].diffuseMap + "\n"
+           + materials[batch.material].alphaMap;
+}
+
+/* orders batches by texture, then material, then shade model */
+struct BatchOrder {
+    const vector<MeshBatch> &batches;
+    const vector<MtlMaterial> &materials;
+
+    BatchOrder(const vector<MeshBatch> &batches,
+               const vector<MtlMaterial> &materials)
+        : batches(batches), materials(materials) {}
+
+    bool operator()(unsigned int lhs, unsigned int rhs) const {
+        const MeshBatch &a = batches[lhs], &b = batches[rhs];
+
+        int textures = textureOf(a, materials).compare(textureOf(b, materials));
+        if (textures != 0)
+            return textures < 0;
+        if (a.material != b.material)
+            return a.material < b.material;
+        return a.smooth < b.smooth;
+    }
+};
+
+static bool sameMaterial(Material a, Material b) {
+    return memcmp(a.getAmbient(), b.getAmbient(), 4 * sizeof(GLfloat)) == 0
+           && memcmp(a.getDiffuse(), b.getDiffuse(), 4 * sizeof(GLfloat)) == 0
+           && memcmp(a.getSpecular(), b.getSpecular(), 4 * sizeof(GLfloat))
+                  == 0
+           && memcmp(a.getEmissive(), b.getEmissive(), 4 * sizeof(GLfloat))
+                  == 0
+           && a.getShininess() == b.getShininess();
+}
+
+/* would a and b be drawn with exactly the same state? */
+static bool sameLook(const MeshBatch &a, const MeshBatch &b,
+                     const vector<MtlMaterial> &materials) {
+    if (a.smooth != b.smooth)
+        return false;
+    if (a.material == b.material)
+        return true;
+    if (a.material < 0 || b.material < 0)
+        return false;
+
+    return textureOf(a, materials) == textureOf(b, materials)
+           && sameMaterial(materials[a.material].material,
+                           materials[b.material].material);
+}
+
+static Point vertexAt(const ObjData &data, const ObjCorner &corner) {
+    return Point(data.vertices[corner.v * 3],
+                 data.vertices[corner.v * 3 + 1],
+                 data.vertices[corner.v * 3 + 2]);
+}
+
+void compileMesh(const ObjData &data, const vector<MtlMaterial> &materials,
+                 CompiledMesh &mesh) {
+    mesh.clear();
+    mesh.materials = materials;
+    mesh.numFaces  = (GLuint)data.faces.size();
+    mesh.minX      = data.minX;
+    mesh.maxX      = data.maxX;
+    mesh.minY      = data.minY;
+    mesh.maxY      = data.maxY;
+    mesh.minZ      = data.minZ;
+    mesh.maxZ      = data.maxZ;
+
+    // the first material by a name wins, like it always has.
+    map<string, int> materialIndices;
+    for (size_t i = 0; i < materials.size(); i++)
+        materialIndices.insert(pair<string, int>(materials[i].name, (int)i));
+
+    vector<int> objToMesh(data.materialNames.size(), -1);
+    for (size_t i = 0; i < data.materialNames.size(); i++) {
+        map<string, int>::iterator iter
+            = materialIndices.find(data.materialNames[i]);
+        if (iter != materialIndices.end())
+            objToMesh[i] = iter->second;
+    }
+
+    // corners that share a position, texture coordinate and normal share a
+    // vertex, too.
+    VertexMap vertexIndices;
+    vertexIndices.reserve(data.corners.size());
+
+    // sort the faces into batches, in order of first use.
+    map<pair<int, int>, int> batchIndices;
+    vector<MeshBatch> batches;
+    vector<vector<unsigned int> > batchFaces;
+    for (size_t f = 0; f < data.faces.size(); f++) {
+        const ObjFace &face = data.faces[f];
+
+        MeshBatch batch;
+        batch.material = face.material >= 0 ? objToMesh[face.material] : -1;
+        batch.smooth   = face.smooth;
+
+        pair<int, int> key(batch.material, batch.smooth);
+        map<pair<int, int>, int>::iterator iter = batchIndices.find(key);
+        if (iter == batchIndices.end()) {
+            iter = batchIndices
+                       .insert(pair<pair<int, int>, int>(
+                           key, (int)batches.size()))
+                       .first;
+            batches.push_back(batch);
+            batchFaces.push_back(vector<unsigned int>());
+        }
+        batchFaces[iter->second].push_back((unsigned int)f);
+    }
+
+    // then order the batches so each texture is bound once, and draw
+    // neighbours that end up looking the same as a single batch.
+    vector<unsigned int> order(batches.size());
+    for (size_t b = 0; b < batches.size(); b++)
+        order[b] = (unsigned int)b;
+    stable_sort(order.begin(), order.end(), BatchOrder(batches, materials));
+
+    for (size_t o = 0; o < order.size(); o++) {
+        unsigned int b = order[o];
+
+        if (mesh.batches.empty()
+            || !sameLook(mesh.batches.back(), batches[b], materials)) {
+            mesh.batches.push_back(batches[b]);
+            mesh.batches.back().firstIndex = (GLuint)mesh.indices.size();
+        }
+        MeshBatch &batch = mesh.batches.back();
+
+        for (size_t i = 0; i < batchFaces[b].size(); i++) {
+            const ObjFace &face      = data.faces[batchFaces[b][i]];
+            const ObjCorner *corners = &data.corners[face.firstCorner];
+
+            // a face only uses texture coordinates and normals if every
+            // corner has them.
+            bool faceHasVertexTexCoords = true, faceHasVertexNormals = true;
+            for (unsigned int c = 0; c < face.numCorners; c++) {
+                if (corners[c].vt < 0)
+                    faceHasVertexTexCoords = false;
+                if (corners[c].vn < 0)
+                    faceHasVertexNormals = false;
+            }
+
+            // faces can be either quads or triangles (or maybe more?), so we
+            // fan them out into triangles ourselves.
+            for (unsigned int c = 1; c + 1 < face.numCorners; c++) {
+                const ObjCorner *triangle[3]
+                    = {&corners[0], &corners[c], &corners[c + 1]};
+
+                // without normals in the file, the whole triangle gets its
+                // face normal.
+                GLfloat faceNormal[3] = {0, 0, 0};
+                if (!faceHasVertexNormals) {
+                    Point v1 = vertexAt(data, *triangle[0]),
+                          v2 = vertexAt(data, *triangle[1]),
+                          v3 = vertexAt(data, *triangle[2]);
+
+                    Vector normal = cross(v2 - v1, v3 - v1);
+                    normal.normalize();
+                    faceNormal[0] = normal.getX();
+                    faceNormal[1] = normal.getY();
+                    faceNormal[2] = normal.getZ();
+                }
+
+                for (int k = 0; k < 3; k++) {
+                    const ObjCorner &corner = *triangle[k];
+
+                    VertexKey key;
+                    key.v  = corner.v;
+                    key.vt = faceHasVertexTexCoords ? corner.vt : -1;
+                    key.vn = faceHasVertexNormals ? corner.vn : -1;
+                    memcpy(key.normal, faceNormal, sizeof(key.normal));
+
+                    pair<VertexMap::iterator, bool> welded
+                        = vertexIndices.insert(VertexMap::value_type(
+                            key, (GLuint)(mesh.positions.size() / 3)));
+                    mesh.indices.push_back(welded.first->second);
+                    if (!welded.second)
+                        continue;
+
+                    mesh.positions.push_back(data.vertices[corner.v * 3]);
+                    mesh.positions.push_back(data.vertices[corner.v * 3 + 1]);
+                    mesh.positions.push_back(data.vertices[corner.v * 3 + 2]);
+
+                    if (faceHasVertexNormals) {
+                        mesh.normals.push_back(data.vertexNormals[corner.vn * 3]);
+                        mesh.normals.push_back(
+                            data.vertexNormals[corner.vn * 3 + 1]);
+                        mesh.normals.push_back(
+                            data.vertexNormals[corner.vn * 3 + 2]);
+                    } else {
+                        mesh.normals.insert(
+                            mesh.normals.end(), faceNormal, faceNormal + 3);
+                    }
+
+                    if (faceHasVertexTexCoords) {
+                        mesh.texCoords.push_back(
+                            data.vertexTexCoords[corner.vt * 2]);
+                        mesh.texCoords.push_back(
+                            data.vertexTexCoords[corner.vt * 2 + 1]);
+                    } else {
+                        mesh.texCoords.push_back(0);
+                        mesh.texCoords.push_back(0);
+                    }
+                }
+            }
+        }
+
+        batch.numIndices = (GLuint)mesh.indices.size() - batch.firstIndex;
+    }
+
+    for (size_t b = 0; b < mesh.batches.size(); b++)
+        mesh.triangleMaterials.insert(mesh.triangleMaterials.end(),
+                                      mesh.batches[b].numIndices / 3,
+                                      mesh.batches[b].material);
+}
+}
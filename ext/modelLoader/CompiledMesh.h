@@ -0,0 +1,105 @@
+#ifndef _GOL_COMPILED_MESH_H_
+#define _GOL_COMPILED_MESH_H_ 1
+
+#ifdef __APPLE__
+#include <OpenGL/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "MtlParser.h"
+#include "ObjParser.h"
+
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/* a run of triangles drawn with the same material and shade model */
+struct MeshBatch {
+    /* index into CompiledMesh::materials, -1 for none */
+    GLint material;
+    /* -1 if never set, 0 for flat, 1 for smooth */
+    GLint smooth;
+
+    GLuint firstIndex;
+    GLuint numIndices;
+};
+
+/*
+ * One level of detail of a mesh: its own run of the vertices, indices and
+ * batches.  error is how far (in model units) it may stray from the full
+ * mesh, which is level 0
+ */
+struct MeshLevel {
+    GLuint firstVertex, numVertices;
+    GLuint firstIndex, numIndices;
+    GLuint firstBatch, numBatches;
+    GLfloat error;
+};
+
+/* where the arrays of a compiled mesh are, whoever owns them */
+struct MeshArrays {
+    const GLfloat *positions; /* 3 per vertex */
+    const GLfloat *normals;   /* 3 per vertex */
+    const GLfloat *texCoords; /* 2 per vertex */
+    const GLfloat *colors;    /* 4 per vertex, or NULL */
+    GLuint numVertices;
+
+    const GLuint *indices;
+    GLuint numIndices;
+    /* material of each triangle (numIndices / 3 of them) */
+    const GLint *triangleMaterials;
+
+    const MeshBatch *batches;
+    GLuint numBatches;
+
+    /* 0 if there is only the one */
+    const MeshLevel *levels;
+    GLuint numLevels;
+};
+
+/*
+ * A model flattened into indexed vertex streams ready for glDrawElements,
+ * with one batch of triangles per material (and shade model) and the table
+ * of materials those batches use.  Corners with the same position, texture
+ * coordinate and normal are welded into a single vertex.
+ */
+struct CompiledMesh {
+    vector<GLfloat> positions;
+    vector<GLfloat> normals;
+    vector<GLfloat> texCoords;
+    /* RGBA per vertex, for formats that have them.  empty otherwise */
+    vector<GLfloat> colors;
+    vector<GLuint> indices;
+    vector<GLint> triangleMaterials;
+    vector<MeshBatch> batches;
+    /* empty, or the full mesh followed by simpler ones, which come after it
+     * in every array above.  see buildLevelsOfDetail() */
+    vector<MeshLevel> levels;
+
+    vector<MtlMaterial> materials;
+
+    GLuint numFaces;
+    float minX, maxX, minY, maxY, minZ, maxZ;
+
+    CompiledMesh();
+    void clear();
+
+    MeshArrays arrays() const;
+};
+
+/*
+ * Flatten the faces of data into indexed triangles in mesh, grouped by
+ * material.  Faces without normals get their face normal.  Batches are
+ * ordered by texture so that each one is bound once, and batches that would
+ * be drawn exactly alike are merged.
+ * materials becomes the mesh's material table; faces whose usemtl name is
+ * not in it get no material.
+ */
+void compileMesh(const ObjData &data, const vector<MtlMaterial> &materials,
+                 CompiledMesh &mesh);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "GLTaskQueue.h"
+
+#include <chrono>
+
+namespace paone {
+
+GLTaskQueue::GLTaskQueue() : _hasGLThread(false) {}
+
+void GLTaskQueue::makeGLThread() {
+    unique_lock<mutex> lock(_lock);
+    _glThread    = this_thread::get_id();
+    _hasGLThread = true;
+}
+
+bool GLTaskQueue::onGLThread() const {
+    return !_hasGLThread || this_thread::get_id() == _glThread;
+}
+
+void GLTaskQueue::run(const function<void()> &task) {
+    if (onGLThread()) {
+        task();
+        return;
+    }
+
+    mutex doneLock;
+    condition_variable doneSignal;
+    bool done = false;
+
+    post([&task, &doneLock, &doneSignal, &done]() {
+        task();
+        unique_lock<mutex> lock(doneLock);
+        done = true;
+        doneSignal.notify_all();
+    });
+
+    unique_lock<mutex> lock(doneLock);
+    while (!done)
+        doneSignal.wait(lock);
+}
+
+void GLTaskQueue::post(const function<void()> &task) {
+    if (onGLThread()) {
+        task();
+        return;
+    }
+
+    unique_lock<mutex> lock(_lock);
+    _tasks.push_back(task);
+}
+
+size_t GLTaskQueue::runPending(double budget) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    size_t ran = 0;
+    for (;;) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(_lock);
+            if (_tasks.empty())
+                break;
+            task = _tasks.front();
+            _tasks.pop_front();
+        }
+
+        task();
+        ran++;
+
+        if (chrono::duration<double>(chrono::steady_clock::now() - start)
+                .count()
+            >= budget)
+            break;
+    }
+
+    return ran;
+}
+
+size_t GLTaskQueue::pending() {
+    unique_lock<mutex> lock(_lock);
+    return _tasks.size();
+}
+
+GLTaskQueue &GLTaskQueue::shared() {
+    // never destroyed, so objects destroyed while exiting can still post
+    // their buffers' deletes to it.
+    static GLTaskQueue *queue = new GLTaskQueue;
+    return *queue;
+}
+}
@@ -0,0 +1,60 @@
+#ifndef _GOL_GL_TASK_QUEUE_H_
+#define _GOL_GL_TASK_QUEUE_H_ 1
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * Work for the thread that owns the OpenGL context, handed over by loaders
+ * running anywhere else.
+ *
+ * Until some thread calls makeGLThread(), or when called on that thread,
+ * tasks simply run where they are: loading on the GL thread behaves exactly
+ * as it always has.
+ */
+class GLTaskQueue {
+public:
+    GLTaskQueue();
+
+    /* the calling thread owns the GL context from now on.  call it before
+     * starting any loaders */
+    void makeGLThread();
+    /* true on the GL thread, or if there isn't one yet */
+    bool onGLThread() const;
+
+    /* run task on the GL thread and wait for it to finish */
+    void run(const function<void()> &task);
+    /* run task on the GL thread some time later */
+    void post(const function<void()> &task);
+
+    /*
+     * Run queued tasks on the GL thread until none are left or budget
+     * seconds have gone by (at least one always runs).  Returns how many ran
+     */
+    size_t runPending(double budget);
+    /* tasks waiting for runPending() */
+    size_t pending();
+
+    /* the queue shared by all the loaders */
+    static GLTaskQueue &shared();
+
+private:
+    thread::id _glThread;
+    bool _hasGLThread;
+
+    deque<function<void()> > _tasks;
+    mutex _lock;
+
+    GLTaskQueue(const GLTaskQueue &);
+    GLTaskQueue &operator=(const GLTaskQueue &);
+};
+}
+
+#endif
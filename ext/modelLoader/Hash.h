@@ -0,0 +1,41 @@
+#ifndef _GOL_HASH_H_
+#define _GOL_HASH_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace paone {
+
+
+/*
+ * A fast 64 bit hash of size bytes, for telling whether source files have
+ * changed.  NOT cryptographic.  Pass the previous result as seed to hash
+ * several buffers as one.
+ */
+inline uint64_t hashBytes(const void *data, size_t size,
+                          uint64_t seed = 0xcbf29ce484222325ULL) {
+    static const uint64_t PRIME = 0x100000001b3ULL;
+    static const uint64_t MIX   = 0x9e3779b97f4a7c15ULL;
+
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t hash          = seed ^ (size * MIX);
+
+    // a word at a time, then whatever is left a byte at a time.
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = (hash ^ (word * MIX)) * PRIME;
+        hash ^= hash >> 29;
+    }
+    for (; size > 0; size--, p++)
+        hash = (hash ^ *p) * PRIME;
+
+    hash ^= hash >> 32;
+    hash *= MIX;
+    hash ^= hash >> 29;
+    return hash;
+}
+}
+
+#endif
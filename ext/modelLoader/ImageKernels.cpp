@@ -0,0 +1,383 @@
+#include "ImageKernels.h"
+
+#include <string.h>
+
+#include <atomic>
+
+// the vector kernels are compiled for their instruction sets function by
+// function, so nothing else needs special flags and the CPU is asked before
+// any of them run.
+#if (defined(__GNUC__) || defined(__clang__))                                  \
+    && (defined(__x86_64__) || defined(__i386__))
+#define GOL_X86_KERNELS 1
+#include <immintrin.h>
+#define GOL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define GOL_X86_KERNELS 0
+#endif
+
+namespace paone {
+
+static ImageKernelLevel detectImageKernels() {
+#if GOL_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return IMAGE_KERNELS_AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return IMAGE_KERNELS_SSSE3;
+#endif
+    return IMAGE_KERNELS_SCALAR;
+}
+
+static std::atomic<int> kernelLimit(IMAGE_KERNELS_AVX2);
+
+ImageKernelLevel supportedImageKernels() {
+    static const ImageKernelLevel supported = detectImageKernels();
+    return supported;
+}
+
+ImageKernelLevel imageKernels() {
+    int limit = kernelLimit;
+    return supportedImageKernels() < limit ? supportedImageKernels()
+                                           : (ImageKernelLevel)limit;
+}
+
+void limitImageKernels(ImageKernelLevel level) { kernelLimit = level; }
+
+//
+// Scalar
+//
+
+static void swapRedBlue3Scalar(const unsigned char *src, unsigned char *dst,
+                               size_t numPixels) {
+    for (size_t i = 0; i < numPixels; i++, src += 3, dst += 3) {
+        unsigned char b = src[0], g = src[1], r = src[2];
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+    }
+}
+
+static void swapRedBlue4Scalar(const unsigned char *src, unsigned char *dst,
+                               size_t numPixels) {
+    for (size_t i = 0; i < numPixels; i++, src += 4, dst += 4) {
+        unsigned char b = src[0], g = src[1], r = src[2], a = src[3];
+        dst[0] = r;
+        dst[1] = g;
+        dst[2] = b;
+        dst[3] = a;
+    }
+}
+
+static void interleaveRGBAScalar(const unsigned char *color, int colorChannels,
+                                 const unsigned char *mask, int maskChannels,
+                                 unsigned char *rgba, size_t numPixels) {
+    for (size_t i = 0; i < numPixels; i++) {
+        rgba[0] = color[0];
+        rgba[1] = color[1];
+        rgba[2] = color[2];
+        rgba[3] = mask[0];
+        color += colorChannels;
+        mask += maskChannels;
+        rgba += 4;
+    }
+}
+
+static void halveRows16Scalar(const uint16_t *row0, const uint16_t *row1,
+                              uint16_t *dst, size_t numPixels) {
+    for (size_t i = 0; i < numPixels; i++, row0 += 8, row1 += 8, dst += 4) {
+        for (int c = 0; c < 4; c++) {
+            unsigned int left  = (row0[c] + row1[c] + 1) >> 1;
+            unsigned int right = (row0[c + 4] + row1[c + 4] + 1) >> 1;
+            dst[c]             = (uint16_t)((left + right + 1) >> 1);
+        }
+    }
+}
+
+#if GOL_X86_KERNELS
+
+//
+// SSSE3
+//
+// Each 16 byte load of 3 byte pixels holds 4 whole ones.  The last 4 bytes
+// are shuffled back to where they were, so storing them is harmless even
+// when src is dst: they are the next pixels, still untouched.
+//
+
+GOL_TARGET("ssse3")
+static size_t swapRedBlue3SSSE3(const unsigned char *src, unsigned char *dst,
+                                size_t numPixels) {
+    const __m128i swap
+        = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15);
+
+    // every load reads 16 bytes for 4 pixels (12 bytes).
+    size_t i = 0;
+    for (; i + 6 <= numPixels; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 3 * i));
+        _mm_storeu_si128((__m128i *)(dst + 3 * i), _mm_shuffle_epi8(v, swap));
+    }
+    return i;
+}
+
+GOL_TARGET("ssse3")
+static size_t swapRedBlue4SSSE3(const unsigned char *src, unsigned char *dst,
+                                size_t numPixels) {
+    const __m128i swap
+        = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 4 <= numPixels; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+        _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_shuffle_epi8(v, swap));
+    }
+    return i;
+}
+
+GOL_TARGET("ssse3")
+static size_t interleaveRGBASSSE3(const unsigned char *color,
+                                  const unsigned char *mask, int maskChannels,
+                                  unsigned char *rgba, size_t numPixels) {
+    const char Z = (char)0x80; // pshufb writes 0
+    const __m128i spreadColor
+        = _mm_setr_epi8(0, 1, 2, Z, 3, 4, 5, Z, 6, 7, 8, Z, 9, 10, 11, Z);
+    const __m128i spreadMask3
+        = _mm_setr_epi8(Z, Z, Z, 0, Z, Z, Z, 3, Z, Z, Z, 6, Z, Z, Z, 9);
+    const __m128i spreadMask1
+        = _mm_setr_epi8(Z, Z, Z, 0, Z, Z, Z, 1, Z, Z, Z, 2, Z, Z, Z, 3);
+
+    size_t i = 0;
+    for (; i + 6 <= numPixels; i += 4) {
+        __m128i c = _mm_shuffle_epi8(
+            _mm_loadu_si128((const __m128i *)(color + 3 * i)), spreadColor);
+        __m128i a;
+        if (maskChannels == 3) {
+            a = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)(mask + 3 * i)), spreadMask3);
+        } else {
+            int m;
+            memcpy(&m, mask + i, 4);
+            a = _mm_shuffle_epi8(_mm_cvtsi32_si128(m), spreadMask1);
+        }
+        _mm_storeu_si128((__m128i *)(rgba + 4 * i), _mm_or_si128(c, a));
+    }
+    return i;
+}
+
+// pavgw rounds up just like the scalar loop, one pair at a time: the rows
+// first, then the pixels beside each other, split apart a 64 bit pixel each.
+GOL_TARGET("ssse3")
+static size_t halveRows16SSSE3(const uint16_t *row0, const uint16_t *row1,
+                               uint16_t *dst, size_t numPixels) {
+    size_t i = 0;
+    for (; i + 2 <= numPixels; i += 2) {
+        __m128i v0 = _mm_avg_epu16(
+            _mm_loadu_si128((const __m128i *)(row0 + 8 * i)),
+            _mm_loadu_si128((const __m128i *)(row1 + 8 * i)));
+        __m128i v1 = _mm_avg_epu16(
+            _mm_loadu_si128((const __m128i *)(row0 + 8 * i + 8)),
+            _mm_loadu_si128((const __m128i *)(row1 + 8 * i + 8)));
+        _mm_storeu_si128(
+            (__m128i *)(dst + 4 * i),
+            _mm_avg_epu16(_mm_unpacklo_epi64(v0, v1),
+                          _mm_unpackhi_epi64(v0, v1)));
+    }
+    return i;
+}
+
+//
+// AVX2
+//
+// pshufb only shuffles within 128 bit lanes, so 8 pixels (24 bytes) of a 32
+// byte load are first spread across the lanes 12 bytes each, and gathered
+// back afterwards.  The 8 bytes past them ride along untouched in the
+// leftover dwords, for the same reason as above.
+//
+
+GOL_TARGET("avx2")
+static size_t swapRedBlue3AVX2(const unsigned char *src, unsigned char *dst,
+                               size_t numPixels) {
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 6, 3, 4, 5, 7);
+    const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    const __m256i swap   = _mm256_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10,
+                                          9, 12, 13, 14, 15, 2, 1, 0, 5, 4, 3,
+                                          8, 7, 6, 11, 10, 9, 12, 13, 14, 15);
+
+    // every load reads 32 bytes for 8 pixels (24 bytes).
+    size_t i = 0;
+    for (; i + 11 <= numPixels; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + 3 * i));
+        v         = _mm256_permutevar8x32_epi32(v, spread);
+        v         = _mm256_shuffle_epi8(v, swap);
+        v         = _mm256_permutevar8x32_epi32(v, gather);
+        _mm256_storeu_si256((__m256i *)(dst + 3 * i), v);
+    }
+    return i + swapRedBlue3SSSE3(src + 3 * i, dst + 3 * i, numPixels - i);
+}
+
+GOL_TARGET("avx2")
+static size_t swapRedBlue4AVX2(const unsigned char *src, unsigned char *dst,
+                               size_t numPixels) {
+    const __m256i swap = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 8 <= numPixels; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + 4 * i));
+        _mm256_storeu_si256((__m256i *)(dst + 4 * i),
+                            _mm256_shuffle_epi8(v, swap));
+    }
+    return i + swapRedBlue4SSSE3(src + 4 * i, dst + 4 * i, numPixels - i);
+}
+
+GOL_TARGET("avx2")
+static size_t interleaveRGBAAVX2(const unsigned char *color,
+                                 const unsigned char *mask, int maskChannels,
+                                 unsigned char *rgba, size_t numPixels) {
+    const char Z         = (char)0x80; // pshufb writes 0
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i spreadColor
+        = _mm256_setr_epi8(0, 1, 2, Z, 3, 4, 5, Z, 6, 7, 8, Z, 9, 10, 11, Z,
+                           0, 1, 2, Z, 3, 4, 5, Z, 6, 7, 8, Z, 9, 10, 11, Z);
+    const __m256i spreadMask3
+        = _mm256_setr_epi8(Z, Z, Z, 0, Z, Z, Z, 3, Z, Z, Z, 6, Z, Z, Z, 9,
+                           Z, Z, Z, 0, Z, Z, Z, 3, Z, Z, Z, 6, Z, Z, Z, 9);
+    // both lanes hold all 8 mask bytes; each takes its own 4.
+    const __m256i spreadMask1
+        = _mm256_setr_epi8(Z, Z, Z, 0, Z, Z, Z, 1, Z, Z, Z, 2, Z, Z, Z, 3,
+                           Z, Z, Z, 4, Z, Z, Z, 5, Z, Z, Z, 6, Z, Z, Z, 7);
+
+    size_t i = 0;
+    for (; i + 11 <= numPixels; i += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(color + 3 * i));
+        c         = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(c, spread),
+                                spreadColor);
+        __m256i a;
+        if (maskChannels == 3) {
+            a = _mm256_loadu_si256((const __m256i *)(mask + 3 * i));
+            a = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(a, spread),
+                                    spreadMask3);
+        } else {
+            long long m;
+            memcpy(&m, mask + i, 8);
+            a = _mm256_shuffle_epi8(_mm256_set1_epi64x(m), spreadMask1);
+        }
+        _mm256_storeu_si256((__m256i *)(rgba + 4 * i), _mm256_or_si256(c, a));
+    }
+    return i
+           + interleaveRGBASSSE3(color + 3 * i,
+                                 mask + maskChannels * i,
+                                 maskChannels,
+                                 rgba + 4 * i,
+                                 numPixels - i);
+}
+
+// the unpacks work within lanes, so the 4 results come out as 0 2 1 3.
+GOL_TARGET("avx2")
+static size_t halveRows16AVX2(const uint16_t *row0, const uint16_t *row1,
+                              uint16_t *dst, size_t numPixels) {
+    size_t i = 0;
+    for (; i + 4 <= numPixels; i += 4) {
+        __m256i v0 = _mm256_avg_epu16(
+            _mm256_loadu_si256((const __m256i *)(row0 + 8 * i)),
+            _mm256_loadu_si256((const __m256i *)(row1 + 8 * i)));
+        __m256i v1 = _mm256_avg_epu16(
+            _mm256_loadu_si256((const __m256i *)(row0 + 8 * i + 16)),
+            _mm256_loadu_si256((const __m256i *)(row1 + 8 * i + 16)));
+        __m256i h = _mm256_avg_epu16(_mm256_unpacklo_epi64(v0, v1),
+                                     _mm256_unpackhi_epi64(v0, v1));
+        _mm256_storeu_si256((__m256i *)(dst + 4 * i),
+                            _mm256_permute4x64_epi64(h, 0xD8));
+    }
+    return i
+           + halveRows16SSSE3(
+               row0 + 8 * i, row1 + 8 * i, dst + 4 * i, numPixels - i);
+}
+
+#endif
+
+void swapRedBlue3(const unsigned char *src, unsigned char *dst,
+                  size_t numPixels) {
+    size_t done = 0;
+#if GOL_X86_KERNELS
+    switch (imageKernels()) {
+    case IMAGE_KERNELS_AVX2:
+        done = swapRedBlue3AVX2(src, dst, numPixels);
+        break;
+    case IMAGE_KERNELS_SSSE3:
+        done = swapRedBlue3SSSE3(src, dst, numPixels);
+        break;
+    default:
+        break;
+    }
+#endif
+    swapRedBlue3Scalar(src + 3 * done, dst + 3 * done, numPixels - done);
+}
+
+void swapRedBlue4(const unsigned char *src, unsigned char *dst,
+                  size_t numPixels) {
+    size_t done = 0;
+#if GOL_X86_KERNELS
+    switch (imageKernels()) {
+    case IMAGE_KERNELS_AVX2:
+        done = swapRedBlue4AVX2(src, dst, numPixels);
+        break;
+    case IMAGE_KERNELS_SSSE3:
+        done = swapRedBlue4SSSE3(src, dst, numPixels);
+        break;
+    default:
+        break;
+    }
+#endif
+    swapRedBlue4Scalar(src + 4 * done, dst + 4 * done, numPixels - done);
+}
+
+void interleaveRGBA(const unsigned char *color, int colorChannels,
+                    const unsigned char *mask, int maskChannels,
+                    unsigned char *rgba, size_t numPixels) {
+    size_t done = 0;
+#if GOL_X86_KERNELS
+    // the vector versions cover what the *.mtl loader meets: RGB images with
+    // a grey or RGB mask.
+    if (colorChannels == 3 && (maskChannels == 1 || maskChannels == 3)) {
+        switch (imageKernels()) {
+        case IMAGE_KERNELS_AVX2:
+            done = interleaveRGBAAVX2(
+                color, mask, maskChannels, rgba, numPixels);
+            break;
+        case IMAGE_KERNELS_SSSE3:
+            done = interleaveRGBASSSE3(
+                color, mask, maskChannels, rgba, numPixels);
+            break;
+        default:
+            break;
+        }
+    }
+#endif
+    interleaveRGBAScalar(color + colorChannels * done,
+                         colorChannels,
+                         mask + maskChannels * done,
+                         maskChannels,
+                         rgba + 4 * done,
+                         numPixels - done);
+}
+
+void halveRows16(const uint16_t *row0, const uint16_t *row1, uint16_t *dst,
+                 size_t numPixels) {
+    size_t done = 0;
+#if GOL_X86_KERNELS
+    switch (imageKernels()) {
+    case IMAGE_KERNELS_AVX2:
+        done = halveRows16AVX2(row0, row1, dst, numPixels);
+        break;
+    case IMAGE_KERNELS_SSSE3:
+        done = halveRows16SSSE3(row0, row1, dst, numPixels);
+        break;
+    default:
+        break;
+    }
+#endif
+    halveRows16Scalar(
+        row0 + 8 * done, row1 + 8 * done, dst + 4 * done, numPixels - done);
+}
+}
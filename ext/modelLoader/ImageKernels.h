@@ -0,0 +1,57 @@
+#ifndef _GOL_IMAGE_KERNELS_H_
+#define _GOL_IMAGE_KERNELS_H_ 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace paone {
+
+
+/*
+ * The per-pixel loops of the image decoders and MipmapChain, with SSSE3 and
+ * AVX2 versions picked at runtime by what the CPU supports.  Every level
+ * produces exactly the same bytes; the scalar loops are what everything else
+ * falls back on.
+ */
+enum ImageKernelLevel {
+    IMAGE_KERNELS_SCALAR = 0,
+    IMAGE_KERNELS_SSSE3,
+    IMAGE_KERNELS_AVX2
+};
+
+/* the best level this CPU (and compiler) supports */
+ImageKernelLevel supportedImageKernels();
+/* the level the kernels run at */
+ImageKernelLevel imageKernels();
+/* run at no more than level from now on, mostly for benchmarking */
+void limitImageKernels(ImageKernelLevel level);
+
+/*
+ * copy numPixels 3 byte pixels from src to dst, swapping the first and third
+ * byte of each (BGR <-> RGB).  src may be dst
+ */
+void swapRedBlue3(const unsigned char *src, unsigned char *dst,
+                  size_t numPixels);
+/* the same for 4 byte pixels, leaving the fourth byte alone */
+void swapRedBlue4(const unsigned char *src, unsigned char *dst,
+                  size_t numPixels);
+
+/*
+ * the first three bytes of each color pixel (colorChannels apart) and the
+ * first byte of each mask pixel (maskChannels apart) into numPixels RGBA
+ * pixels at rgba
+ */
+void interleaveRGBA(const unsigned char *color, int colorChannels,
+                    const unsigned char *mask, int maskChannels,
+                    unsigned char *rgba, size_t numPixels);
+
+/*
+ * average each 2x2 block of 4 channel, 16 bit pixels in rows row0 and row1
+ * (2 * numPixels pixels each) into numPixels pixels at dst.  each pair of
+ * rows, then each pair of those, is averaged rounding up
+ */
+void halveRows16(const uint16_t *row0, const uint16_t *row1, uint16_t *dst,
+                 size_t numPixels);
+}
+
+#endif
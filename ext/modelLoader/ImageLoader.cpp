@@ -0,0 +1,444 @@
+#include "ImageLoader.h"
+#include "ImageKernels.h"
+#include "MappedFile.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace paone {
+
+/* map filename, or failing that path + filename */
+static bool openImage(MappedFile &file, const char *filename,
+                      const string &path) {
+    return file.open(filename) || file.open(path + filename);
+}
+
+static uint16_t readLE16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLE32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+           | ((uint32_t)p[3] << 24);
+}
+
+/* swap the rows of an image top to bottom, in place */
+static void flipRows(unsigned char *pixels, size_t rowSize, int height) {
+    unsigned char *temp = (unsigned char *)malloc(rowSize);
+    for (int top = 0, bottom = height - 1; top < bottom; top++, bottom--) {
+        memcpy(temp, pixels + top * rowSize, rowSize);
+        memcpy(pixels + top * rowSize, pixels + bottom * rowSize, rowSize);
+        memcpy(pixels + bottom * rowSize, temp, rowSize);
+    }
+    free(temp);
+}
+
+unsigned char *createTransparentTexture(unsigned char *imageData,
+                                        unsigned char *imageMask, int texWidth,
+                                        int texHeight, int texChannels,
+                                        int maskChannels) {
+    // combine the 'mask' array with the image data array into an RGBA array.
+    // free() it like the rest of the image data.
+    size_t numPixels = (size_t)texWidth * texHeight;
+    unsigned char *fullData = (unsigned char *)malloc(numPixels * 4);
+    if (!fullData)
+        return NULL;
+
+    if (imageData && imageMask) {
+        interleaveRGBA(imageData,
+                       texChannels,
+                       imageMask,
+                       maskChannels,
+                       fullData,
+                       numPixels);
+        return fullData;
+    }
+
+    // only one of them (if that), so the other is all 1s.
+    for (size_t i = 0; i < numPixels; i++) {
+        unsigned char *pixel = fullData + i * 4;
+        if (imageData) {
+            pixel[0] = imageData[i * texChannels + 0]; // R
+            pixel[1] = imageData[i * texChannels + 1]; // G
+            pixel[2] = imageData[i * texChannels + 2]; // B
+        } else {
+            pixel[0] = pixel[1] = pixel[2] = 1;
+        }
+        pixel[3] = imageMask ? imageMask[i * maskChannels] : 1; // A
+    }
+    return fullData;
+}
+
+/* the next whitespace separated integer in a PPM, skipping # comments.
+ * false at the end of the file */
+static bool readPPMInt(const char *&p, const char *end, int &value) {
+    while (p < end) {
+        if (*p == '#') {
+            while (p < end && *p != '\n')
+                p++;
+        } else if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+        } else {
+            break;
+        }
+    }
+
+    bool negative = (p < end && *p == '-');
+    if (negative)
+        p++;
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        value = value * 10 + (*p++ - '0');
+    if (negative)
+        value = -value;
+    return true;
+}
+
+unsigned char *loadPPM(char *filename, int &texWidth, int &texHeight,
+                       int &texChannels, bool &success, bool ERRORS,
+                       string path) {
+    MappedFile file;
+
+    // make sure the file is there.
+    if (!openImage(file, filename, path)) {
+        if (ERRORS)
+            printf("[.ppm]: [ERROR]: File Not Found: %s\n", filename);
+        return 0;
+    }
+
+    const char *p   = file.begin();
+    const char *end = file.end();
+
+    int temp = 0;
+    if (end - p < 2 || p[0] != 'P' || !readPPMInt(++p, end, temp)
+        || temp != 3) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.ppm]: [ERROR]: PPM file is not of correct format! (Must "
+                    "be P3, is P%d.)\n",
+                    temp);
+        return 0;
+    }
+
+    // got the file header right...
+    int maxValue;
+    if (!readPPMInt(p, end, texWidth) || !readPPMInt(p, end, texHeight)
+        || !readPPMInt(p, end, maxValue) || texWidth <= 0 || texHeight <= 0) {
+        if (ERRORS)
+            fprintf(stderr, "[.ppm]: [ERROR]: bad header in %s.\n", filename);
+        return 0;
+    }
+
+    // now that we know how big it is, allocate the buffer...
+    size_t size = (size_t)texWidth * texHeight * 3;
+    unsigned char *imageData = (unsigned char *)malloc(size);
+    if (!imageData) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.ppm]: [ERROR]: couldn't allocate image memory. "
+                    "Dimensions: %d x %d.\n",
+                    texWidth,
+                    texHeight);
+        return 0;
+    }
+
+    // and read the data in, one value per channel.
+    for (size_t i = 0; i < size; i++) {
+        int value;
+        if (!readPPMInt(p, end, value)) {
+            if (ERRORS)
+                fprintf(stderr,
+                        "[.ppm]: [ERROR]: %s ends after %lu of %lu values.\n",
+                        filename,
+                        (unsigned long)i,
+                        (unsigned long)size);
+            free(imageData);
+            return 0;
+        }
+        imageData[i] = (unsigned char)value;
+    }
+
+    texChannels = 3;
+    success     = true;
+    return imageData;
+}
+
+unsigned char *loadBMP(char *filename, int &texWidth, int &texHeight,
+                       int &texChannels, bool &success, bool ERRORS,
+                       string path) {
+    // the parts of the file and info headers we care about.
+    static const size_t BMP_HEADER_SIZE = 54;
+
+    MappedFile file;
+
+    // make sure the file is there.
+    if (!openImage(file, filename, path)) {
+        if (ERRORS)
+            printf("[.bmp]: [ERROR]: File Not Found: %s\n", filename);
+        return 0;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)file.begin();
+    if (file.size() < BMP_HEADER_SIZE) {
+        if (ERRORS)
+            printf("[.bmp]: [ERROR]: reading header from %s.\n", filename);
+        return 0;
+    }
+
+    uint32_t dataOffset = readLE32(bytes + 10);
+    texWidth            = (int32_t)readLE32(bytes + 18);
+    int32_t height      = (int32_t)readLE32(bytes + 22);
+    uint16_t planes     = readLE16(bytes + 26);
+    uint16_t bpp        = readLE16(bytes + 28);
+
+    if (planes != 1) {
+        if (ERRORS)
+            printf("[.bmp]: [ERROR]: Planes from %s is not 1: %u\n",
+                   filename,
+                   planes);
+        return 0;
+    }
+    if (bpp != 24) {
+        if (ERRORS)
+            printf(
+                "[.bmp]: [ERROR]: Bpp from %s is not 24: %u\n", filename, bpp);
+        return 0;
+    }
+
+    // a negative height means the rows are stored top down.
+    bool topDown = height < 0;
+    texHeight    = topDown ? -height : height;
+    if (texWidth <= 0 || texHeight <= 0) {
+        if (ERRORS)
+            printf("[.bmp]: [ERROR]: bad dimensions in %s: %d x %d\n",
+                   filename,
+                   texWidth,
+                   texHeight);
+        return 0;
+    }
+
+    // every row is padded out to a multiple of 4 bytes.
+    size_t rowSize    = (size_t)texWidth * 3;
+    size_t fileStride = (rowSize + 3) & ~(size_t)3;
+    if (dataOffset < BMP_HEADER_SIZE)
+        dataOffset = BMP_HEADER_SIZE;
+    if (dataOffset + fileStride * (texHeight - 1) + rowSize > file.size()) {
+        if (ERRORS)
+            printf("[.bmp]: [ERROR]: reading image data from %s.\n", filename);
+        return 0;
+    }
+
+    unsigned char *data = (unsigned char *)malloc(rowSize * texHeight);
+    if (data == NULL) {
+        if (ERRORS)
+            printf("[.bmp]: [ERROR]: allocating memory for color-corrected "
+                   "image data");
+        return 0;
+    }
+
+    // reverse all of the colors (bgr -> rgb) straight out of the file,
+    // keeping the rows bottom up.
+    const unsigned char *pixels = bytes + dataOffset;
+    if (fileStride == rowSize && !topDown) {
+        swapRedBlue3(pixels, data, (size_t)texWidth * texHeight);
+    } else {
+        for (int j = 0; j < texHeight; j++) {
+            int row = topDown ? texHeight - 1 - j : j;
+            swapRedBlue3(
+                pixels + row * fileStride, data + j * rowSize, texWidth);
+        }
+    }
+
+    texChannels = 3;
+    success     = true;
+    return data;
+}
+
+//
+//  This function reads RGB (or RGBA) data from the Targa image file specified
+//  by filename.  It does not handle color-mapped images -- only RGB/RGBA
+//  images, although it correctly supports both run-length encoding (RLE) for
+//  compression and image origins at the top- or bottom-left.  The pixels come
+//  back with their origin at the top-left either way.
+//
+//  The TGA file format, including the data layout with RLE, is based on a spec
+//  found at:
+//      http://www.dca.fee.unicamp.br/~martino/disciplinas/ea978/tgaffs.pdf
+//
+unsigned char *loadTGA(char *filename, int &texWidth, int &texHeight,
+                       int &texChannels, bool &success, bool ERRORS,
+                       string path) {
+    static const size_t TGA_HEADER_SIZE = 18;
+
+    MappedFile file;
+
+    // make sure the file is there.
+    if (!openImage(file, filename, path)) {
+        if (ERRORS)
+            printf("[.tga]: [ERROR]: File Not Found: %s\n", filename);
+        return 0;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)file.begin();
+    const unsigned char *end   = (const unsigned char *)file.end();
+    if (file.size() < TGA_HEADER_SIZE) {
+        if (ERRORS)
+            printf("[.tga]: [ERROR]: reading header from %s.\n", filename);
+        return 0;
+    }
+
+    // the bits of the header we need.
+    unsigned char idLength            = bytes[0];
+    unsigned char colorMapType        = bytes[1];
+    unsigned char imageType           = bytes[2];
+    unsigned short width              = readLE16(bytes + 12);
+    unsigned short height             = readLE16(bytes + 14);
+    unsigned char bitsPerPixel        = bytes[16];
+    unsigned char imageAttributeFlags = bytes[17];
+
+    // now check to make sure that we actually have the capability to read this
+    // file.
+    if (colorMapType != 0) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.tga]: Error: TGA file (%s) uses colormap instead of "
+                    "RGB/RGBA data; this is unsupported.\n",
+                    filename);
+        return 0;
+    }
+
+    if (imageType != 2 && imageType != 10) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.tga]: Error: unspecified TGA type: %d. Only supports 2 "
+                    "(uncompressed RGB/A) and 10 (RLE, RGB/A).\n",
+                    imageType);
+        return 0;
+    }
+
+    if (bitsPerPixel != 24 && bitsPerPixel != 32) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.tga]: Error: unsupported image depth (%d bits per "
+                    "pixel). Only supports 24bpp and 32bpp.\n",
+                    bitsPerPixel);
+        return 0;
+    }
+
+    if (width == 0 || height == 0) {
+        if (ERRORS)
+            fprintf(stderr, "[.tga]: Error: %s is empty.\n", filename);
+        return 0;
+    }
+
+    // the image id has to fit before anything can be past it.
+    if (TGA_HEADER_SIZE + idLength > file.size()) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.tga]: Error: %s ends inside its image id.\n",
+                    filename);
+        return 0;
+    }
+
+    bool usingRLE = (imageType == 10);
+    int channels  = bitsPerPixel / 8;
+    // whether the origin is at the top-left or bottom-left
+    bool topLeft = (imageAttributeFlags & 32) != 0;
+
+    size_t rowSize   = (size_t)width * channels;
+    size_t numPixels = (size_t)width * height;
+    unsigned char *imageData = (unsigned char *)malloc(rowSize * height);
+    if (!imageData) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.tga]: Error: couldn't allocate image memory. "
+                    "Dimensions: %d x %d.\n",
+                    width,
+                    height);
+        return 0;
+    }
+
+    // skip the image id; without a colormap the pixels are next.  they're BGR
+    // (or BGRA) on disk.
+    const unsigned char *p = bytes + TGA_HEADER_SIZE + idLength;
+
+    if (usingRLE) {
+        // the data comes in packets, each a header byte and either one pixel
+        // to repeat or a run of raw pixels, in whatever rows they fall.
+        size_t pixelsRead = 0;
+        while (pixelsRead < numPixels && p < end) {
+            unsigned char packet = *p++;
+            size_t count         = (packet & 0x7F) + 1;
+            if (count > numPixels - pixelsRead)
+                count = numPixels - pixelsRead;
+
+            unsigned char *dst = imageData + pixelsRead * channels;
+            if (packet & 0x80) {
+                if (end - p < channels)
+                    break;
+                if (channels == 4)
+                    swapRedBlue4(p, dst, 1);
+                else
+                    swapRedBlue3(p, dst, 1);
+                for (size_t i = 1; i < count; i++)
+                    memcpy(dst + i * channels, dst, channels);
+                p += channels;
+            } else {
+                if ((size_t)(end - p) < count * channels)
+                    break;
+                if (channels == 4)
+                    swapRedBlue4(p, dst, count);
+                else
+                    swapRedBlue3(p, dst, count);
+                p += count * channels;
+            }
+            pixelsRead += count;
+        }
+
+        if (pixelsRead < numPixels) {
+            if (ERRORS)
+                fprintf(stderr,
+                        "[.tga]: Error: %s ends after %lu of %lu pixels.\n",
+                        filename,
+                        (unsigned long)pixelsRead,
+                        (unsigned long)numPixels);
+            free(imageData);
+            return 0;
+        }
+
+        // flip it afterwards if its origin was in the bottom left.
+        if (!topLeft)
+            flipRows(imageData, rowSize, height);
+    } else {
+        if ((size_t)(end - p) < rowSize * height) {
+            if (ERRORS)
+                fprintf(stderr,
+                        "[.tga]: Error: %s is missing pixel data.\n",
+                        filename);
+            free(imageData);
+            return 0;
+        }
+
+        // flipping the vertical index as we go if the origin is in the
+        // bottom-left.
+        for (int i = 0; i < height; i++) {
+            int row = topLeft ? i : (height - 1 - i);
+            if (channels == 4)
+                swapRedBlue4(p + i * rowSize, imageData + row * rowSize, width);
+            else
+                swapRedBlue3(p + i * rowSize, imageData + row * rowSize, width);
+        }
+    }
+
+    texWidth    = width;
+    texHeight   = height;
+    texChannels = channels;
+    success     = true;
+    return imageData;
+}
+}
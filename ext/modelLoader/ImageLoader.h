@@ -0,0 +1,43 @@
+#ifndef _GOL_IMAGE_LOADER_H_
+#define _GOL_IMAGE_LOADER_H_ 1
+
+#include <string>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * Our own readers for the simple image formats models use, ahead of SOIL.
+ *
+ * Each maps the file (trying filename, then path + filename) and returns
+ * pixels that must be free()d, setting success.  0 if the file is missing or
+ * isn't something it can read.  Byte order and row order are the same as
+ * they have always been: rows of a BMP stay bottom up, while TGAs come out
+ * top down, as SOIL would give them.
+ */
+
+/* ASCII (P3) portable pixmaps */
+unsigned char *loadPPM(char *filename, int &texWidth, int &texHeight,
+                       int &texChannels, bool &success, bool ERRORS,
+                       string path);
+/* uncompressed 24 bit bitmaps */
+unsigned char *loadBMP(char *filename, int &texWidth, int &texHeight,
+                       int &texChannels, bool &success, bool ERRORS,
+                       string path);
+/* 24 and 32 bit Targas, raw or run length encoded */
+unsigned char *loadTGA(char *filename, int &texWidth, int &texHeight,
+                       int &texChannels, bool &success, bool ERRORS,
+                       string path);
+
+/*
+ * combine imageData's colors with the first channel of imageMask into a new
+ * RGBA image, free()d like the rest.  either may be NULL, leaving 1s
+ */
+unsigned char *createTransparentTexture(unsigned char *imageData,
+                                        unsigned char *imageMask, int texWidth,
+                                        int texHeight, int texChannels,
+                                        int maskChannels);
+}
+
+#endif
@@ -0,0 +1,179 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+
+namespace paone {
+
+MappedFile::MappedFile() : _data(NULL), _size(0), _mapped(false) {
+#ifdef _WIN32
+    _file    = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#endif
+}
+
+MappedFile::MappedFile(const string &filename)
+    : _data(NULL), _size(0), _mapped(false) {
+#ifdef _WIN32
+    _file    = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#endif
+    open(filename);
+}
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::isOpen() const { return _data != NULL; }
+
+const char *MappedFile::begin() const { return _data; }
+
+const char *MappedFile::end() const { return _data + _size; }
+
+size_t MappedFile::size() const { return _size; }
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string &filename) {
+    close();
+
+    _file = CreateFileA(filename.c_str(),
+                        GENERIC_READ,
+                        FILE_SHARE_READ,
+                        NULL,
+                        OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                        NULL);
+    if (_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart == 0) {
+        close();
+        return false;
+    }
+
+    if ((size_t)fileSize.QuadPart < SMALL_FILE_SIZE) {
+        DWORD size = (DWORD)fileSize.QuadPart, got = 0;
+        char *buffer = (char *)malloc(size);
+        bool ok = buffer && ReadFile(_file, buffer, size, &got, NULL)
+                  && got == size;
+        CloseHandle(_file);
+        _file = INVALID_HANDLE_VALUE;
+        if (!ok) {
+            free(buffer);
+            return false;
+        }
+
+        _data = buffer;
+        _size = size;
+        return true;
+    }
+
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (_mapping == NULL) {
+        close();
+        return false;
+    }
+
+    _data = (const char *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (_data == NULL) {
+        close();
+        return false;
+    }
+    _size   = (size_t)fileSize.QuadPart;
+    _mapped = true;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data && _mapped)
+        UnmapViewOfFile(_data);
+    else
+        free((void *)_data);
+    if (_mapping)
+        CloseHandle(_mapping);
+    if (_file != INVALID_HANDLE_VALUE)
+        CloseHandle(_file);
+
+    _data    = NULL;
+    _size    = 0;
+    _mapped  = false;
+    _mapping = NULL;
+    _file    = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const string &filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    if ((size_t)st.st_size < SMALL_FILE_SIZE) {
+        size_t size  = (size_t)st.st_size, got = 0;
+        char *buffer = (char *)malloc(size);
+        while (buffer && got < size) {
+            ssize_t n = read(fd, buffer + got, size - got);
+            if (n <= 0)
+                break;
+            got += (size_t)n;
+        }
+        ::close(fd);
+        if (got != size) {
+            free(buffer);
+            return false;
+        }
+
+        _data = buffer;
+        _size = size;
+        return true;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file.
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    // we always read front to back.
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    _data   = (const char *)data;
+    _size   = (size_t)st.st_size;
+    _mapped = true;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data && _mapped)
+        munmap((void *)_data, _size);
+    else
+        free((void *)_data);
+
+    _data   = NULL;
+    _size   = 0;
+    _mapped = false;
+}
+
+#endif
+}
@@ -0,0 +1,58 @@
+#ifndef _GOL_MAPPED_FILE_H_
+#define _GOL_MAPPED_FILE_H_ 1
+
+#include <stddef.h>
+#include <string>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * A read-only view of an entire file on disk.
+ *
+ * The file is memory mapped where the platform allows it, so the loaders can
+ * scan it in place without copying it into heap buffers first.  Files smaller
+ * than SMALL_FILE_SIZE are read into a buffer instead: setting up and tearing
+ * down a mapping costs more than copying a few pages.  Either way the view is
+ * released when the object goes out of scope.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    MappedFile(const string &filename);
+    ~MappedFile();
+
+    /* map filename, replacing whatever was mapped before */
+    bool open(const string &filename);
+    /* unmap the file, if any */
+    void close();
+
+    bool isOpen() const;
+
+    /* the file contents.  NOT null terminated! */
+    const char *begin() const;
+    const char *end() const;
+    size_t size() const;
+
+    /* files below this many bytes are read rather than mapped */
+    static const size_t SMALL_FILE_SIZE = 64 * 1024;
+
+private:
+    const char *_data;
+    size_t _size;
+    /* false when _data is a buffer we read the file into */
+    bool _mapped;
+
+#ifdef _WIN32
+    void *_file;
+    void *_mapping;
+#endif
+
+    /* mappings own OS resources, so they cannot be shared */
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+}
+
+#endif
@@ -0,0 +1,353 @@
+#include "MeshCache.h"
+#include "Hash.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace paone {
+
+static const char MESH_CACHE_MAGIC[8] = "GOLMESH";
+// bump this whenever the layout (or what compileMesh(), optimizeMesh() or
+// buildLevelsOfDetail() produce) changes.
+static const uint32_t MESH_CACHE_VERSION = 6;
+
+/*
+ * The file is the header followed by, in order:
+ *     positions, normals, texCoords    GLfloat[3, 3, 2 * numVertices]
+ *     indices                          GLuint[numIndices]
+ *     triangleMaterials                GLint[numIndices / 3]
+ *     batches                          MeshBatch[numBatches]
+ *     levels                           MeshLevel[numLevels]
+ *     materials                        CachedMaterial[numMaterials]
+ *     sources                          uint32_t[numSources] string offsets
+ *     strings                          stringBytes of NUL terminated names
+ * Everything is 4 byte sized, so nothing needs padding.
+ */
+struct MeshCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t numSources;
+    uint64_t sourceHash;
+
+    uint32_t numVertices;
+    uint32_t numIndices;
+    uint32_t numBatches;
+    uint32_t numLevels;
+    uint32_t numMaterials;
+    uint32_t numFaces;
+    uint32_t stringBytes;
+
+    float bounds[6];
+};
+
+struct MeshCache::CachedMaterial {
+    GLfloat ambient[4];
+    GLfloat diffuse[4];
+    GLfloat specular[4];
+    GLfloat emissive[4];
+    GLfloat shininess;
+    GLint illumination;
+
+    /* offsets into the string table */
+    uint32_t name;
+    uint32_t diffuseMap;
+    uint32_t alphaMap;
+};
+
+MeshCache::MeshCache() { close(); }
+
+bool MeshCache::open(const string &filename) {
+    close();
+
+    if (!_file.open(filename) || _file.size() < sizeof(Header))
+        return false;
+
+    const Header *header = (const Header *)_file.begin();
+    if (memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != MESH_CACHE_VERSION) {
+        _file.close();
+        return false;
+    }
+
+    // make sure every section is really there before pointing into it.
+    uint64_t expected = sizeof(Header);
+    expected += (uint64_t)header->numVertices * 8 * sizeof(GLfloat);
+    expected += (uint64_t)header->numIndices * sizeof(GLuint);
+    expected += (uint64_t)(header->numIndices / 3) * sizeof(GLint);
+    expected += (uint64_t)header->numBatches * sizeof(MeshBatch);
+    expected += (uint64_t)header->numLevels * sizeof(MeshLevel);
+    expected += (uint64_t)header->numMaterials * sizeof(CachedMaterial);
+    expected += (uint64_t)header->numSources * sizeof(uint32_t);
+    expected += header->stringBytes;
+    if (expected != _file.size()) {
+        _file.close();
+        return false;
+    }
+
+    const char *p = _file.begin() + sizeof(Header);
+    _positions    = (const GLfloat *)p;
+    p += header->numVertices * 3 * sizeof(GLfloat);
+    _normals = (const GLfloat *)p;
+    p += header->numVertices * 3 * sizeof(GLfloat);
+    _texCoords = (const GLfloat *)p;
+    p += header->numVertices * 2 * sizeof(GLfloat);
+    _indices = (const GLuint *)p;
+    p += header->numIndices * sizeof(GLuint);
+    _triangleMaterials = (const GLint *)p;
+    p += (header->numIndices / 3) * sizeof(GLint);
+    _batches = (const MeshBatch *)p;
+    p += header->numBatches * sizeof(MeshBatch);
+    _levels = (const MeshLevel *)p;
+    p += header->numLevels * sizeof(MeshLevel);
+    _materials = (const CachedMaterial *)p;
+    p += header->numMaterials * sizeof(CachedMaterial);
+    _sources = (const uint32_t *)p;
+    p += header->numSources * sizeof(uint32_t);
+    _strings = p;
+
+    // and that nothing in them points outside the file.
+    _header = header;
+    if (!checkContents()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+/* whether count things from first fit in size */
+static bool inRange(GLuint first, GLuint count, uint32_t size) {
+    return (uint64_t)first + count <= size;
+}
+
+bool MeshCache::checkContents() const {
+    const Header *header = _header;
+
+    for (uint32_t i = 0; i < header->numIndices; i++)
+        if (_indices[i] >= header->numVertices)
+            return false;
+
+    GLint numMaterials = (GLint)header->numMaterials;
+    for (uint32_t t = 0; t < header->numIndices / 3; t++)
+        if (_triangleMaterials[t] < -1 || _triangleMaterials[t] >= numMaterials)
+            return false;
+
+    for (uint32_t b = 0; b < header->numBatches; b++) {
+        const MeshBatch &batch = _batches[b];
+        if (!inRange(batch.firstIndex, batch.numIndices, header->numIndices)
+            || batch.material < -1 || batch.material >= numMaterials)
+            return false;
+    }
+
+    for (uint32_t l = 0; l < header->numLevels; l++) {
+        const MeshLevel &level = _levels[l];
+        if (!inRange(level.firstVertex, level.numVertices, header->numVertices)
+            || !inRange(level.firstIndex, level.numIndices, header->numIndices)
+            || !inRange(level.firstBatch, level.numBatches, header->numBatches))
+            return false;
+    }
+
+    // every string ends before the table does, so any offset into it is
+    // NUL terminated.
+    if (header->numSources + header->numMaterials == 0)
+        return true;
+    if (header->stringBytes == 0 || _strings[header->stringBytes - 1] != '\0')
+        return false;
+    for (uint32_t i = 0; i < header->numSources; i++)
+        if (_sources[i] >= header->stringBytes)
+            return false;
+    for (uint32_t i = 0; i < header->numMaterials; i++) {
+        const CachedMaterial &cached = _materials[i];
+        if (cached.name >= header->stringBytes
+            || cached.diffuseMap >= header->stringBytes
+            || cached.alphaMap >= header->stringBytes)
+            return false;
+    }
+    return true;
+}
+
+void MeshCache::close() {
+    _file.close();
+    _header    = NULL;
+    _positions = _normals = _texCoords = NULL;
+    _indices                           = NULL;
+    _triangleMaterials                 = NULL;
+    _batches                           = NULL;
+    _levels                            = NULL;
+    _materials                         = NULL;
+    _sources                           = NULL;
+    _strings                           = NULL;
+}
+
+uint64_t MeshCache::sourceHash() const { return _header->sourceHash; }
+
+vector<string> MeshCache::sources() const {
+    vector<string> sources;
+    for (uint32_t i = 0; i < _header->numSources; i++)
+        sources.push_back(string(_strings + _sources[i]));
+    return sources;
+}
+
+MeshArrays MeshCache::arrays() const {
+    MeshArrays arrays;
+    arrays.positions   = _positions;
+    arrays.normals     = _normals;
+    arrays.texCoords   = _texCoords;
+    arrays.colors      = NULL;
+    arrays.numVertices = _header->numVertices;
+    arrays.indices     = _indices;
+    arrays.numIndices  = _header->numIndices;
+    arrays.triangleMaterials = _triangleMaterials;
+    arrays.batches     = _batches;
+    arrays.numBatches  = _header->numBatches;
+    arrays.levels      = _header->numLevels ? _levels : NULL;
+    arrays.numLevels   = _header->numLevels;
+    return arrays;
+}
+
+void MeshCache::materials(vector<MtlMaterial> &materials) const {
+    materials.resize(_header->numMaterials);
+    for (uint32_t i = 0; i < _header->numMaterials; i++) {
+        const CachedMaterial &cached = _materials[i];
+        MtlMaterial &material        = materials[i];
+
+        material.name       = _strings + cached.name;
+        material.diffuseMap = _strings + cached.diffuseMap;
+        material.alphaMap   = _strings + cached.alphaMap;
+
+        material.material.setAmbient((GLfloat *)cached.ambient);
+        material.material.setDiffuse((GLfloat *)cached.diffuse);
+        material.material.setSpecular((GLfloat *)cached.specular);
+        material.material.setEmissive((GLfloat *)cached.emissive);
+        material.material.setShininess(cached.shininess);
+        material.material.setIllumination(cached.illumination);
+    }
+}
+
+GLuint MeshCache::numFaces() const { return _header->numFaces; }
+
+void MeshCache::bounds(float &minX, float &maxX, float &minY, float &maxY,
+                       float &minZ, float &maxZ) const {
+    minX = _header->bounds[0];
+    maxX = _header->bounds[1];
+    minY = _header->bounds[2];
+    maxY = _header->bounds[3];
+    minZ = _header->bounds[4];
+    maxZ = _header->bounds[5];
+}
+
+/* add s to the string table, returning its offset */
+static uint32_t addString(vector<char> &strings, const string &s) {
+    uint32_t offset = (uint32_t)strings.size();
+    strings.insert(strings.end(), s.begin(), s.end());
+    strings.push_back('\0');
+    return offset;
+}
+
+bool MeshCache::write(const string &filename, const CompiledMesh &mesh,
+                      uint64_t sourceHash, const vector<string> &sources) {
+    vector<char> strings;
+
+    vector<CachedMaterial> materials(mesh.materials.size());
+    for (size_t i = 0; i < mesh.materials.size(); i++) {
+        Material material       = mesh.materials[i].material;
+        CachedMaterial &cached  = materials[i];
+
+        memcpy(cached.ambient, material.getAmbient(), sizeof(cached.ambient));
+        memcpy(cached.diffuse, material.getDiffuse(), sizeof(cached.diffuse));
+        memcpy(
+            cached.specular, material.getSpecular(), sizeof(cached.specular));
+        memcpy(
+            cached.emissive, material.getEmissive(), sizeof(cached.emissive));
+        cached.shininess    = material.getShininess();
+        cached.illumination = material.getIllumination();
+
+        cached.name       = addString(strings, mesh.materials[i].name);
+        cached.diffuseMap = addString(strings, mesh.materials[i].diffuseMap);
+        cached.alphaMap   = addString(strings, mesh.materials[i].alphaMap);
+    }
+
+    vector<uint32_t> sourceOffsets;
+    for (size_t i = 0; i < sources.size(); i++)
+        sourceOffsets.push_back(addString(strings, sources[i]));
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version      = MESH_CACHE_VERSION;
+    header.numSources   = (uint32_t)sources.size();
+    header.sourceHash   = sourceHash;
+    header.numVertices  = (uint32_t)(mesh.positions.size() / 3);
+    header.numIndices   = (uint32_t)mesh.indices.size();
+    header.numBatches   = (uint32_t)mesh.batches.size();
+    header.numLevels    = (uint32_t)mesh.levels.size();
+    header.numMaterials = (uint32_t)materials.size();
+    header.numFaces     = mesh.numFaces;
+    header.stringBytes  = (uint32_t)strings.size();
+    header.bounds[0]    = mesh.minX;
+    header.bounds[1]    = mesh.maxX;
+    header.bounds[2]    = mesh.minY;
+    header.bounds[3]    = mesh.maxY;
+    header.bounds[4]    = mesh.minZ;
+    header.bounds[5]    = mesh.maxZ;
+
+    // write it all out next to the real thing, and only replace the old
+    // cache once the new one is complete.
+    string tempFile = filename + ".tmp";
+    FILE *fp        = fopen(tempFile.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok      = ok
+         && fwrite(mesh.positions.data(), sizeof(GLfloat), mesh.positions.size(), fp)
+                == mesh.positions.size();
+    ok = ok
+         && fwrite(mesh.normals.data(), sizeof(GLfloat), mesh.normals.size(), fp)
+                == mesh.normals.size();
+    ok = ok
+         && fwrite(mesh.texCoords.data(), sizeof(GLfloat), mesh.texCoords.size(), fp)
+                == mesh.texCoords.size();
+    ok = ok
+         && fwrite(mesh.indices.data(), sizeof(GLuint), mesh.indices.size(), fp)
+                == mesh.indices.size();
+    ok = ok
+         && fwrite(mesh.triangleMaterials.data(),
+                   sizeof(GLint),
+                   mesh.triangleMaterials.size(),
+                   fp) == mesh.triangleMaterials.size();
+    ok = ok
+         && fwrite(mesh.batches.data(), sizeof(MeshBatch), mesh.batches.size(), fp)
+                == mesh.batches.size();
+    ok = ok
+         && fwrite(mesh.levels.data(), sizeof(MeshLevel), mesh.levels.size(), fp)
+                == mesh.levels.size();
+    ok = ok
+         && fwrite(materials.data(), sizeof(CachedMaterial), materials.size(), fp)
+                == materials.size();
+    ok = ok
+         && fwrite(sourceOffsets.data(), sizeof(uint32_t), sourceOffsets.size(), fp)
+                == sourceOffsets.size();
+    ok = ok && fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+    ok = (fclose(fp) == 0) && ok;
+
+    if (ok) {
+        remove(filename.c_str());
+        ok = rename(tempFile.c_str(), filename.c_str()) == 0;
+    }
+    if (!ok)
+        remove(tempFile.c_str());
+
+    return ok;
+}
+
+bool MeshCache::hashFiles(const vector<string> &files, uint64_t &hash) {
+    hash = hashBytes(NULL, 0);
+    for (size_t i = 0; i < files.size(); i++) {
+        MappedFile file;
+        if (!file.open(files[i]))
+            return false;
+        hash = hashBytes(file.begin(), file.size(), hash);
+    }
+    return true;
+}
+}
@@ -0,0 +1,78 @@
+#ifndef _GOL_MESH_CACHE_H_
+#define _GOL_MESH_CACHE_H_ 1
+
+#include "CompiledMesh.h"
+#include "MappedFile.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * A CompiledMesh saved to disk, so a model can be loaded again without
+ * parsing any text.
+ *
+ * The file is memory mapped and its vertex streams and index buffer are
+ * used where they lie.  It records a hash of the files the mesh was built
+ * from; when that no longer matches, the cache is stale and must be rebuilt.
+ *
+ * The layout is native endian and only meant to be read back by the machine
+ * that wrote it.
+ */
+class MeshCache {
+public:
+    MeshCache();
+
+    /* map filename.  false if it is missing or not a cache we can read */
+    bool open(const string &filename);
+    void close();
+
+    /* hash of the source files, as written by write() */
+    uint64_t sourceHash() const;
+    /* the files (besides the model itself) the mesh was built from */
+    vector<string> sources() const;
+
+    /* the vertex streams, index buffer, batches and levels of detail.
+     * valid while open */
+    MeshArrays arrays() const;
+    /* copy out the material table */
+    void materials(vector<MtlMaterial> &materials) const;
+
+    GLuint numFaces() const;
+    void bounds(float &minX, float &maxX, float &minY, float &maxY,
+                float &minZ, float &maxZ) const;
+
+    /* save mesh, built from sources hashing to sourceHash, as filename */
+    static bool write(const string &filename, const CompiledMesh &mesh,
+                      uint64_t sourceHash, const vector<string> &sources);
+
+    /* hash the contents of every file in files.  false if one is missing */
+    static bool hashFiles(const vector<string> &files, uint64_t &hash);
+
+private:
+    struct Header;
+    struct CachedMaterial;
+
+    /* whether every range, index, material and string in the open file
+     * points where it should */
+    bool checkContents() const;
+
+    MappedFile _file;
+    const Header *_header;
+
+    const GLfloat *_positions, *_normals, *_texCoords;
+    const GLuint *_indices;
+    const GLint *_triangleMaterials;
+    const MeshBatch *_batches;
+    const MeshLevel *_levels;
+    const CachedMaterial *_materials;
+    const uint32_t *_sources;
+    const char *_strings;
+};
+}
+
+#endif
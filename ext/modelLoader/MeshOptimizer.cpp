@@ -0,0 +1,402 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+// the LRU cache Forsyth's scores are tuned for.  it's bigger than most real
+// caches on purpose: the order it gives degrades gracefully on smaller ones.
+static const int FORSYTH_CACHE_SIZE = 32;
+// the FIFO cache the overdraw pass (and ACMR) is measured against.
+static const unsigned int FIFO_CACHE_SIZE = 16;
+// how much the overdraw pass may raise the ACMR of a batch.
+static const float OVERDRAW_THRESHOLD = 1.05f;
+
+/*
+ * Forsyth's vertex score: high for vertices that were just used (but not
+ * by the very last triangle, whose 3 are about to be reused anyway), and
+ * for vertices with few triangles left, so they get finished off
+ */
+static float vertexScore(int cachePosition, int remaining) {
+    if (remaining == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = powf(1.0f
+                             - (cachePosition - 3)
+                                   / (float)(FORSYTH_CACHE_SIZE - 3),
+                         1.5f);
+    }
+
+    return score + 2.0f * powf((float)remaining, -0.5f);
+}
+
+/*
+ * Tracks which vertices a FIFO cache of size entries would hold.  The
+ * clock only moves forward, so one of these can be reused for many runs of
+ * indices; flush() empties it
+ */
+class FifoCache {
+public:
+    FifoCache(GLuint numVertices, unsigned int size)
+        : _stamps(numVertices, 0), _size(size), _clock(size) {}
+
+    /* use vertex, returning true if it was a miss */
+    bool miss(GLuint vertex) {
+        if (_clock - _stamps[vertex] < _size)
+            return false;
+        _stamps[vertex] = ++_clock;
+        return true;
+    }
+
+    void flush() { _clock += _size; }
+
+private:
+    vector<unsigned int> _stamps;
+    unsigned int _size;
+    unsigned int _clock;
+};
+
+float averageCacheMissRatio(const GLuint *indices, size_t numIndices,
+                            GLuint numVertices, unsigned int cacheSize) {
+    if (numIndices < 3)
+        return 0.0f;
+
+    FifoCache cache(numVertices, cacheSize);
+    size_t misses = 0;
+    for (size_t i = 0; i < numIndices; i++) {
+        if (cache.miss(indices[i]))
+            misses++;
+    }
+
+    return misses / (float)(numIndices / 3);
+}
+
+/*
+ * Reorder the triangles in [indices, indices + numIndices) for the vertex
+ * cache.  localIds must have an entry per vertex of the mesh, all -1; it is
+ * left that way
+ */
+static void optimizeVertexCache(GLuint *indices, size_t numIndices,
+                                vector<int> &localIds) {
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles < 2)
+        return;
+
+    // number the batch's own vertices from 0, to keep everything dense.
+    vector<GLuint> globalIds;
+    vector<int> corners(numIndices);
+    for (size_t i = 0; i < numIndices; i++) {
+        GLuint v = indices[i];
+        if (localIds[v] < 0) {
+            localIds[v] = (int)globalIds.size();
+            globalIds.push_back(v);
+        }
+        corners[i] = localIds[v];
+    }
+    size_t numLocal = globalIds.size();
+
+    // the triangles not yet drawn that use each vertex.
+    vector<int> remaining(numLocal, 0);
+    for (size_t i = 0; i < numIndices; i++)
+        remaining[corners[i]]++;
+
+    vector<int> adjacencyStart(numLocal + 1, 0);
+    for (size_t v = 0; v < numLocal; v++)
+        adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+
+    vector<int> adjacency(numIndices);
+    vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t i = 0; i < numIndices; i++)
+        adjacency[fill[corners[i]]++] = (int)(i / 3);
+
+    vector<int> cachePosition(numLocal, -1);
+    vector<float> vertexScores(numLocal);
+    for (size_t v = 0; v < numLocal; v++)
+        vertexScores[v] = vertexScore(-1, remaining[v]);
+
+    vector<float> triangleScores(numTriangles);
+    vector<char> added(numTriangles, 0);
+    int best         = 0;
+    float bestScore  = -1.0f;
+    for (size_t t = 0; t < numTriangles; t++) {
+        triangleScores[t] = vertexScores[corners[t * 3 + 0]]
+                            + vertexScores[corners[t * 3 + 1]]
+                            + vertexScores[corners[t * 3 + 2]];
+        if (triangleScores[t] > bestScore) {
+            bestScore = triangleScores[t];
+            best      = (int)t;
+        }
+    }
+
+    int cache[FORSYTH_CACHE_SIZE + 3];
+    int cacheSize = 0;
+    size_t deadEndCursor = 0;
+
+    vector<GLuint> ordered;
+    ordered.reserve(numIndices);
+
+    for (size_t n = 0; n < numTriangles; n++) {
+        if (best < 0) {
+            // nothing in the cache has triangles left; start anywhere.
+            while (added[deadEndCursor])
+                deadEndCursor++;
+            best = (int)deadEndCursor;
+        }
+        added[best] = 1;
+
+        // the triangle's vertices go to the front of the cache...
+        int newCache[FORSYTH_CACHE_SIZE + 3];
+        int newSize = 0;
+        for (int k = 0; k < 3; k++) {
+            int v = corners[best * 3 + k];
+            ordered.push_back(globalIds[v]);
+
+            // ...and it is no longer one of their remaining triangles.
+            int *first = &adjacency[adjacencyStart[v]];
+            int *last  = first + remaining[v];
+            *find(first, last, best) = last[-1];
+            remaining[v]--;
+
+            if (find(newCache, newCache + newSize, v) == newCache + newSize)
+                newCache[newSize++] = v;
+        }
+        int triangleSize = newSize;
+        for (int i = 0; i < cacheSize; i++) {
+            if (find(newCache, newCache + triangleSize, cache[i])
+                == newCache + triangleSize)
+                newCache[newSize++] = cache[i];
+        }
+
+        // whatever got pushed off the end scores as uncached again.
+        for (int i = FORSYTH_CACHE_SIZE; i < newSize; i++)
+            cachePosition[newCache[i]] = -1;
+
+        cacheSize = min(newSize, FORSYTH_CACHE_SIZE);
+        copy(newCache, newCache + cacheSize, cache);
+        for (int i = 0; i < cacheSize; i++)
+            cachePosition[cache[i]] = i;
+
+        for (int i = 0; i < newSize; i++) {
+            int v       = newCache[i];
+            float score = vertexScore(cachePosition[v], remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (int a = 0; a < remaining[v]; a++)
+                triangleScores[adjacency[adjacencyStart[v] + a]] += delta;
+        }
+
+        // the next triangle is the best one touching the cache.
+        best      = -1;
+        bestScore = -1.0f;
+        for (int i = 0; i < cacheSize; i++) {
+            int v = cache[i];
+            for (int a = 0; a < remaining[v]; a++) {
+                int t = adjacency[adjacencyStart[v] + a];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best      = t;
+                }
+            }
+        }
+    }
+
+    copy(ordered.begin(), ordered.end(), indices);
+
+    for (size_t v = 0; v < numLocal; v++)
+        localIds[globalIds[v]] = -1;
+}
+
+/* a run of triangles, and which way (and how far out) it faces */
+struct TriangleCluster {
+    size_t firstTriangle;
+    size_t numTriangles;
+    float sortKey;
+};
+
+static bool facesFurtherOut(const TriangleCluster &a,
+                            const TriangleCluster &b) {
+    return a.sortKey > b.sortKey;
+}
+
+/*
+ * Reorder clusters of the (cache optimized) triangles in [indices, indices
+ * + numIndices) so those facing away from the middle of the batch, which
+ * tend to hide the rest, are drawn first.  Clusters start wherever the
+ * FIFO cache would hold none of a triangle's vertices, so moving them
+ * around costs little; if it costs more than OVERDRAW_THRESHOLD, the order
+ * is left alone
+ */
+static void optimizeOverdraw(GLuint *indices, size_t numIndices,
+                             const GLfloat *positions, FifoCache &cache) {
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles < 2)
+        return;
+
+    vector<TriangleCluster> clusters;
+    size_t misses = 0;
+    cache.flush();
+    for (size_t t = 0; t < numTriangles; t++) {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; k++) {
+            if (cache.miss(indices[t * 3 + k]))
+                triangleMisses++;
+        }
+        misses += triangleMisses;
+
+        if (t == 0 || triangleMisses == 3) {
+            TriangleCluster cluster = {t, 0, 0.0f};
+            clusters.push_back(cluster);
+        }
+        clusters.back().numTriangles++;
+    }
+    if (clusters.size() < 2)
+        return;
+
+    // area weighted centroids and normals: the cross product is both.
+    vector<float> centroids(clusters.size() * 3, 0.0f);
+    vector<float> normals(clusters.size() * 3, 0.0f);
+    vector<float> areas(clusters.size(), 0.0f);
+    float middle[3]    = {0.0f, 0.0f, 0.0f};
+    float totalArea    = 0.0f;
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        for (size_t t = clusters[c].firstTriangle;
+             t < clusters[c].firstTriangle + clusters[c].numTriangles;
+             t++) {
+            const GLfloat *p0 = &positions[indices[t * 3 + 0] * 3];
+            const GLfloat *p1 = &positions[indices[t * 3 + 1] * 3];
+            const GLfloat *p2 = &positions[indices[t * 3 + 2] * 3];
+
+            float u[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float v[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float n[3] = {u[1] * v[2] - u[2] * v[1],
+                          u[2] * v[0] - u[0] * v[2],
+                          u[0] * v[1] - u[1] * v[0]};
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int k = 0; k < 3; k++) {
+                float centroid = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                centroids[c * 3 + k] += centroid * area;
+                normals[c * 3 + k] += n[k];
+                middle[k] += centroid * area;
+            }
+            areas[c] += area;
+        }
+        totalArea += areas[c];
+    }
+    if (totalArea <= 0.0f)
+        return;
+
+    for (int k = 0; k < 3; k++)
+        middle[k] /= totalArea;
+
+    for (size_t c = 0; c < clusters.size(); c++) {
+        if (areas[c] <= 0.0f)
+            continue;
+
+        float *n     = &normals[c * 3];
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length <= 0.0f)
+            continue;
+
+        float key = 0.0f;
+        for (int k = 0; k < 3; k++)
+            key += (centroids[c * 3 + k] / areas[c] - middle[k]) * n[k];
+        clusters[c].sortKey = key / length;
+    }
+
+    stable_sort(clusters.begin(), clusters.end(), facesFurtherOut);
+
+    vector<GLuint> sorted;
+    sorted.reserve(numIndices);
+    for (size_t c = 0; c < clusters.size(); c++) {
+        sorted.insert(sorted.end(),
+                      indices + clusters[c].firstTriangle * 3,
+                      indices
+                          + (clusters[c].firstTriangle
+                             + clusters[c].numTriangles)
+                                * 3);
+    }
+
+    size_t sortedMisses = 0;
+    cache.flush();
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (cache.miss(sorted[i]))
+            sortedMisses++;
+    }
+
+    if (sortedMisses <= misses * OVERDRAW_THRESHOLD)
+        copy(sorted.begin(), sorted.end(), indices);
+}
+
+/* renumber the vertices in the order indices first use them */
+static void optimizeVertexFetch(CompiledMesh &mesh) {
+    GLuint numVertices = (GLuint)(mesh.positions.size() / 3);
+    const GLuint UNUSED = (GLuint)-1;
+
+    vector<GLuint> remap(numVertices, UNUSED);
+    GLuint next = 0;
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        GLuint &v = mesh.indices[i];
+        if (remap[v] == UNUSED)
+            remap[v] = next++;
+        v = remap[v];
+    }
+    for (GLuint v = 0; v < numVertices; v++) {
+        if (remap[v] == UNUSED)
+            remap[v] = next++;
+    }
+
+    vector<GLfloat> positions(mesh.positions.size());
+    vector<GLfloat> normals(mesh.normals.size());
+    vector<GLfloat> texCoords(mesh.texCoords.size());
+    vector<GLfloat> colors(mesh.colors.size());
+    for (GLuint v = 0; v < numVertices; v++) {
+        GLuint to = remap[v];
+        copy(&mesh.positions[v * 3], &mesh.positions[v * 3] + 3,
+             &positions[to * 3]);
+        copy(&mesh.normals[v * 3], &mesh.normals[v * 3] + 3,
+             &normals[to * 3]);
+        copy(&mesh.texCoords[v * 2], &mesh.texCoords[v * 2] + 2,
+             &texCoords[to * 2]);
+        if (!colors.empty())
+            copy(&mesh.colors[v * 4], &mesh.colors[v * 4] + 4,
+                 &colors[to * 4]);
+    }
+
+    mesh.positions.swap(positions);
+    mesh.normals.swap(normals);
+    mesh.texCoords.swap(texCoords);
+    mesh.colors.swap(colors);
+}
+
+void optimizeMesh(CompiledMesh &mesh, MeshOptimizerStats &stats) {
+    GLuint numVertices = (GLuint)(mesh.positions.size() / 3);
+
+    stats.acmrBefore = averageCacheMissRatio(
+        mesh.indices.data(), mesh.indices.size(), numVertices);
+
+    vector<int> localIds(numVertices, -1);
+    FifoCache cache(numVertices, FIFO_CACHE_SIZE);
+    for (size_t b = 0; b < mesh.batches.size(); b++) {
+        GLuint *indices = mesh.indices.data() + mesh.batches[b].firstIndex;
+        size_t numIndices = mesh.batches[b].numIndices;
+
+        optimizeVertexCache(indices, numIndices, localIds);
+        optimizeOverdraw(indices, numIndices, mesh.positions.data(), cache);
+    }
+
+    optimizeVertexFetch(mesh);
+
+    stats.acmrAfter = averageCacheMissRatio(
+        mesh.indices.data(), mesh.indices.size(), numVertices);
+}
+}
@@ -0,0 +1,41 @@
+#ifndef _GOL_MESH_OPTIMIZER_H_
+#define _GOL_MESH_OPTIMIZER_H_ 1
+
+#include "CompiledMesh.h"
+
+#include <stddef.h>
+
+namespace paone {
+
+
+/* average cache miss ratio (vertices transformed per triangle) of a mesh */
+struct MeshOptimizerStats {
+    float acmrBefore;
+    float acmrAfter;
+};
+
+/*
+ * Reorder mesh for the GPU without changing what it looks like:
+ *
+ *  1. the triangles of each batch for post-transform vertex cache hits
+ *     (Forsyth's "Linear-Speed Vertex Cache Optimisation"),
+ *  2. clusters of those triangles so outward facing ones come first, which
+ *     cuts overdraw, as long as the cache hit rate barely suffers,
+ *  3. the vertices into the order they are first used, so fetches walk
+ *     the vertex streams front to back.
+ *
+ * Batches keep their place and their triangles; only the order within each
+ * one changes.
+ */
+void optimizeMesh(CompiledMesh &mesh, MeshOptimizerStats &stats);
+
+/*
+ * vertices missed per triangle when indices are drawn through a FIFO
+ * cache of cacheSize entries.  1/2 is ideal on a big regular grid, 3 is
+ * the worst there is
+ */
+float averageCacheMissRatio(const GLuint *indices, size_t numIndices,
+                            GLuint numVertices, unsigned int cacheSize = 16);
+}
+
+#endif
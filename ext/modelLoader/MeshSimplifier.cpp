@@ -0,0 +1,777 @@
+#include "MeshSimplifier.h"
+#include "Hash.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+// levels stop once they'd have fewer triangles than this.
+static const size_t LOD_MIN_TRIANGLES = 32;
+// a level has to get down to this much of the one before it to be kept.
+static const float LOD_MIN_REDUCTION = 0.8f;
+// how much harder seams and borders are held in place than faces.
+static const double SEAM_WEIGHT = 10.0;
+// a pass may collapse edges up to this much dearer than its goal.
+static const double PASS_ERROR_SLACK = 1.5;
+
+/* a symmetric 4x4 matrix of summed squared plane distances */
+struct Quadric {
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+    /* total area (or length) of what was added */
+    double weight;
+};
+
+/* add the plane n.p + d = 0, weighted by weight */
+static void addPlane(Quadric &q, const double n[3], double d, double weight) {
+    q.a00 += weight * n[0] * n[0];
+    q.a01 += weight * n[0] * n[1];
+    q.a02 += weight * n[0] * n[2];
+    q.a03 += weight * n[0] * d;
+    q.a11 += weight * n[1] * n[1];
+    q.a12 += weight * n[1] * n[2];
+    q.a13 += weight * n[1] * d;
+    q.a22 += weight * n[2] * n[2];
+    q.a23 += weight * n[2] * d;
+    q.a33 += weight * d * d;
+    q.weight += weight;
+}
+
+static Quadric sumQuadrics(const Quadric &a, const Quadric &b) {
+    Quadric q;
+    q.a00    = a.a00 + b.a00;
+    q.a01    = a.a01 + b.a01;
+    q.a02    = a.a02 + b.a02;
+    q.a03    = a.a03 + b.a03;
+    q.a11    = a.a11 + b.a11;
+    q.a12    = a.a12 + b.a12;
+    q.a13    = a.a13 + b.a13;
+    q.a22    = a.a22 + b.a22;
+    q.a23    = a.a23 + b.a23;
+    q.a33    = a.a33 + b.a33;
+    q.weight = a.weight + b.weight;
+    return q;
+}
+
+/* mean squared distance of p from the planes in q */
+static double quadricError(const Quadric &q, const GLfloat *p) {
+    double x = p[0], y = p[1], z = p[2];
+    double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+               + 2 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+               + 2 * (q.a03 * x + q.a13 * y + q.a23 * z) + q.a33;
+    return q.weight > 0 ? fabs(r) / q.weight : 0;
+}
+
+/* (b - a) x (c - a), in doubles */
+static void faceNormal(const GLfloat *a, const GLfloat *b, const GLfloat *c,
+                       double n[3]) {
+    double u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    double v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    n[0]        = u[1] * v[2] - u[2] * v[1];
+    n[1]        = u[2] * v[0] - u[0] * v[2];
+    n[2]        = u[0] * v[1] - u[1] * v[0];
+}
+
+static double length(const double v[3]) {
+    return sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+}
+
+/* what makes vertices the same point of the surface (or the same corner of
+ * it, with the attributes) */
+struct SurfaceKey {
+    GLfloat position[3];
+    GLfloat texCoord[2];
+    GLfloat color[4];
+    GLfloat normal[3];
+
+    bool operator==(const SurfaceKey &rhs) const {
+        return memcmp(this, &rhs, sizeof(SurfaceKey)) == 0;
+    }
+};
+
+struct SurfaceKeyHash {
+    size_t operator()(const SurfaceKey &key) const {
+        return (size_t)hashBytes(&key, sizeof(SurfaceKey));
+    }
+};
+
+typedef unordered_map<SurfaceKey, GLuint, SurfaceKeyHash> SurfaceMap;
+
+/*
+ * Collapses the edges of a mesh, cheapest first.
+ *
+ * Vertices are looked at two ways: as points ("positions"), which is what
+ * edges join and what collapses move, and as points with the attributes of
+ * one side of a seam ("wedges"), which is what triangle corners are.  A
+ * position on a texture seam has a wedge for each side of it.  Normals are
+ * part of a wedge unless the whole mesh is faceted, in which case they're
+ * worked out again afterwards
+ */
+class Simplifier {
+public:
+    Simplifier(const CompiledMesh &mesh);
+
+    /* collapse edges until about targetTriangles are left, or none can be */
+    void simplify(size_t targetTriangles);
+
+    size_t numTriangles() const { return _numTriangles; }
+    /* largest distance collapsed across so far */
+    float error() const { return (float)_error; }
+
+    /* the triangles that are left, as a mesh of their own */
+    void extract(CompiledMesh &level) const;
+
+private:
+    enum Kind { FREE, SEAM, LOCKED };
+
+    struct Edge {
+        GLuint a, b;
+        /* a triangle the edge belongs to */
+        GLuint triangle;
+        bool seam;
+    };
+
+    struct Collapse {
+        GLuint from, to;
+        double cost;
+
+        bool operator<(const Collapse &rhs) const { return cost < rhs.cost; }
+    };
+
+    const CompiledMesh &_mesh;
+    vector<MeshBatch> _batches;
+    bool _faceted;
+
+    /* a vertex of _mesh with each wedge's attributes, and its position */
+    vector<GLuint> _wedgeVertices, _wedgePositions;
+    /* a vertex of _mesh at each position */
+    vector<GLuint> _positionVertices;
+    vector<Quadric> _quadrics;
+
+    /* three wedges per triangle, and its batch */
+    vector<GLuint> _corners;
+    vector<GLuint> _triangleBatches;
+    vector<bool> _alive;
+    size_t _numTriangles;
+    double _error;
+
+    /* rebuilt before every pass: the live triangles around each position,
+     * every edge, and how free each position is to move */
+    vector<GLuint> _around, _aroundOffsets;
+    vector<Edge> _edges;
+    vector<unsigned char> _kinds;
+
+    const GLfloat *position(GLuint p) const {
+        return &_mesh.positions[_positionVertices[p] * 3];
+    }
+    GLuint cornerPosition(size_t triangle, int k) const {
+        return _wedgePositions[_corners[triangle * 3 + k]];
+    }
+    /* which corner of triangle is at p, or -1 */
+    int cornerAt(size_t triangle, GLuint p) const;
+
+    void buildTopology();
+    void buildQuadrics();
+    bool tryCollapse(GLuint from, GLuint to);
+};
+
+Simplifier::Simplifier(const CompiledMesh &mesh)
+    : _mesh(mesh), _batches(mesh.batches), _numTriangles(0), _error(0) {
+    GLuint numVertices = (GLuint)(mesh.positions.size() / 3);
+    size_t numTriangles = mesh.indices.size() / 3;
+    bool hasColors      = !mesh.colors.empty();
+
+    // faceted meshes (every corner has its face's normal) are all the
+    // shipped levels: their normals mustn't count as seams.
+    _faceted = true;
+    for (size_t t = 0; t < numTriangles && _faceted; t++) {
+        const GLuint *triangle = &mesh.indices[t * 3];
+        double n[3];
+        faceNormal(&mesh.positions[triangle[0] * 3],
+                   &mesh.positions[triangle[1] * 3],
+                   &mesh.positions[triangle[2] * 3],
+                   n);
+        double l = length(n);
+        if (l == 0)
+            continue;
+
+        for (int k = 0; k < 3; k++) {
+            const GLfloat *normal = &mesh.normals[triangle[k] * 3];
+            if ((normal[0] * n[0] + normal[1] * n[1] + normal[2] * n[2]) / l
+                < 0.999)
+                _faceted = false;
+        }
+    }
+
+    SurfaceMap positions, wedges;
+    vector<GLuint> vertexWedges(numVertices);
+    for (GLuint v = 0; v < numVertices; v++) {
+        SurfaceKey key;
+        memset(&key, 0, sizeof(key));
+        memcpy(key.position, &mesh.positions[v * 3], sizeof(key.position));
+
+        pair<SurfaceMap::iterator, bool> p = positions.insert(
+            SurfaceMap::value_type(key, (GLuint)_positionVertices.size()));
+        if (p.second)
+            _positionVertices.push_back(v);
+
+        memcpy(key.texCoord, &mesh.texCoords[v * 2], sizeof(key.texCoord));
+        if (hasColors)
+            memcpy(key.color, &mesh.colors[v * 4], sizeof(key.color));
+        if (!_faceted)
+            memcpy(key.normal, &mesh.normals[v * 3], sizeof(key.normal));
+
+        pair<SurfaceMap::iterator, bool> w = wedges.insert(
+            SurfaceMap::value_type(key, (GLuint)_wedgeVertices.size()));
+        if (w.second) {
+            _wedgeVertices.push_back(v);
+            _wedgePositions.push_back(p.first->second);
+        }
+        vertexWedges[v] = w.first->second;
+    }
+
+    _corners.resize(numTriangles * 3);
+    _triangleBatches.resize(numTriangles);
+    _alive.assign(numTriangles, true);
+    for (size_t b = 0; b < _batches.size(); b++) {
+        for (GLuint t = _batches[b].firstIndex / 3;
+             t < (_batches[b].firstIndex + _batches[b].numIndices) / 3;
+             t++)
+            _triangleBatches[t] = (GLuint)b;
+    }
+    for (size_t t = 0; t < numTriangles; t++) {
+        for (int k = 0; k < 3; k++)
+            _corners[t * 3 + k] = vertexWedges[mesh.indices[t * 3 + k]];
+
+        // triangles that are already just a line or a point go now.
+        GLuint a = cornerPosition(t, 0), b = cornerPosition(t, 1),
+               c = cornerPosition(t, 2);
+        if (a == b || b == c || c == a)
+            _alive[t] = false;
+        else
+            _numTriangles++;
+    }
+
+    buildTopology();
+    buildQuadrics();
+}
+
+int Simplifier::cornerAt(size_t triangle, GLuint p) const {
+    for (int k = 0; k < 3; k++) {
+        if (cornerPosition(triangle, k) == p)
+            return k;
+    }
+    return -1;
+}
+
+void Simplifier::buildTopology() {
+    size_t numPositions = _positionVertices.size();
+
+    // the triangles around each position, bucketed by position.
+    _aroundOffsets.assign(numPositions + 1, 0);
+    for (size_t t = 0; t < _alive.size(); t++) {
+        if (_alive[t]) {
+            for (int k = 0; k < 3; k++)
+                _aroundOffsets[cornerPosition(t, k) + 1]++;
+        }
+    }
+    for (size_t p = 0; p < numPositions; p++)
+        _aroundOffsets[p + 1] += _aroundOffsets[p];
+
+    _around.resize(_aroundOffsets[numPositions]);
+    vector<GLuint> fill(_aroundOffsets.begin(), _aroundOffsets.end() - 1);
+    for (size_t t = 0; t < _alive.size(); t++) {
+        if (_alive[t]) {
+            for (int k = 0; k < 3; k++)
+                _around[fill[cornerPosition(t, k)]++] = (GLuint)t;
+        }
+    }
+
+    // every edge once, with the triangles on either side of it.
+    struct Sides {
+        GLuint count;
+        GLuint triangles[2];
+    };
+    unordered_map<uint64_t, Sides> sides;
+    sides.reserve(_numTriangles * 2);
+
+    _edges.clear();
+    for (size_t t = 0; t < _alive.size(); t++) {
+        if (!_alive[t])
+            continue;
+
+        for (int k = 0; k < 3; k++) {
+            GLuint a = cornerPosition(t, k), b = cornerPosition(t, (k + 1) % 3);
+            uint64_t key = a < b ? ((uint64_t)a << 32) | b
+                                 : ((uint64_t)b << 32) | a;
+
+            Sides &s = sides[key];
+            if (s.count == 0) {
+                Edge edge = {min(a, b), max(a, b), (GLuint)t, false};
+                _edges.push_back(edge);
+            }
+            if (s.count < 2)
+                s.triangles[s.count] = (GLuint)t;
+            s.count++;
+        }
+    }
+
+    // an edge is a seam if it's a border, joins two batches, or the corners
+    // at either end differ from one side to the other.
+    _kinds.assign(numPositions, 0);
+    for (size_t e = 0; e < _edges.size(); e++) {
+        Edge &edge = _edges[e];
+        const Sides &s
+            = sides[((uint64_t)edge.a << 32) | edge.b];
+
+        if (s.count != 2) {
+            edge.seam = true;
+        } else {
+            GLuint t0 = s.triangles[0], t1 = s.triangles[1];
+            edge.seam
+                = _triangleBatches[t0] != _triangleBatches[t1]
+                  || _corners[t0 * 3 + cornerAt(t0, edge.a)]
+                         != _corners[t1 * 3 + cornerAt(t1, edge.a)]
+                  || _corners[t0 * 3 + cornerAt(t0, edge.b)]
+                         != _corners[t1 * 3 + cornerAt(t1, edge.b)];
+        }
+
+        if (edge.seam) {
+            _kinds[edge.a] = (unsigned char)min(_kinds[edge.a] + 1, 255);
+            _kinds[edge.b] = (unsigned char)min(_kinds[edge.b] + 1, 255);
+        }
+    }
+
+    // free positions have no seam through them, positions on one can slide
+    // along it, and anything else (ends and crossings) stays put.
+    for (size_t p = 0; p < numPositions; p++)
+        _kinds[p] = _kinds[p] == 0 ? FREE : _kinds[p] == 2 ? SEAM : LOCKED;
+}
+
+void Simplifier::buildQuadrics() {
+    Quadric zero;
+    memset(&zero, 0, sizeof(zero));
+    _quadrics.assign(_positionVertices.size(), zero);
+
+    // each position starts out with the planes of its faces...
+    for (size_t t = 0; t < _alive.size(); t++) {
+        if (!_alive[t])
+            continue;
+
+        GLuint p[3] = {cornerPosition(t, 0), cornerPosition(t, 1),
+                       cornerPosition(t, 2)};
+        double n[3];
+        faceNormal(position(p[0]), position(p[1]), position(p[2]), n);
+        double l = length(n);
+        if (l == 0)
+            continue;
+
+        n[0] /= l;
+        n[1] /= l;
+        n[2] /= l;
+        const GLfloat *a = position(p[0]);
+        double d         = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+        for (int k = 0; k < 3; k++)
+            addPlane(_quadrics[p[k]], n, d, l / 2);
+    }
+
+    // ...and seams get a plane at right angles to them as well, so sliding
+    // along one doesn't bend it.
+    for (size_t e = 0; e < _edges.size(); e++) {
+        const Edge &edge = _edges[e];
+        if (!edge.seam)
+            continue;
+
+        size_t t = edge.triangle;
+        double normal[3];
+        faceNormal(position(cornerPosition(t, 0)),
+                   position(cornerPosition(t, 1)),
+                   position(cornerPosition(t, 2)),
+                   normal);
+
+        const GLfloat *a = position(edge.a), *b = position(edge.b);
+        double along[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        double n[3]     = {along[1] * normal[2] - along[2] * normal[1],
+                       along[2] * normal[0] - along[0] * normal[2],
+                       along[0] * normal[1] - along[1] * normal[0]};
+        double l = length(n);
+        if (l == 0)
+            continue;
+
+        n[0] /= l;
+        n[1] /= l;
+        n[2] /= l;
+        double d      = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]);
+        double weight = SEAM_WEIGHT * length(along);
+        addPlane(_quadrics[edge.a], n, d, weight);
+        addPlane(_quadrics[edge.b], n, d, weight);
+    }
+}
+
+/*
+ * Move position from onto position to, if the mesh stays the same shape
+ * (no triangles flip over, and no edges fold together) and each corner at
+ * from knows which corner at to it becomes
+ */
+bool Simplifier::tryCollapse(GLuint from, GLuint to) {
+    // the triangles on the edge go, and tell us which wedge each side of
+    // the collapse ends up with.
+    vector<pair<GLuint, GLuint> > wedgeMap;
+    vector<GLuint> opposite;
+    for (GLuint i = _aroundOffsets[from]; i < _aroundOffsets[from + 1]; i++) {
+        GLuint t = _around[i];
+        if (!_alive[t])
+            continue;
+
+        int kt = cornerAt(t, to);
+        if (kt < 0)
+            continue;
+        int kf = cornerAt(t, from);
+
+        GLuint fromWedge = _corners[t * 3 + kf], toWedge = _corners[t * 3 + kt];
+        for (size_t m = 0; m < wedgeMap.size(); m++) {
+            if (wedgeMap[m].first == fromWedge && wedgeMap[m].second != toWedge)
+                return false;
+        }
+        wedgeMap.push_back(make_pair(fromWedge, toWedge));
+        opposite.push_back(cornerPosition(t, 3 - kt - kf));
+    }
+
+    // someone else's collapse already took this edge away.
+    if (wedgeMap.empty())
+        return false;
+
+    // the only neighbours the two ends may share are the corners across
+    // the edge; any other would end up with two edges to the same place.
+    vector<GLuint> toNeighbours;
+    for (GLuint i = _aroundOffsets[to]; i < _aroundOffsets[to + 1]; i++) {
+        GLuint t = _around[i];
+        if (_alive[t]) {
+            for (int k = 0; k < 3; k++)
+                toNeighbours.push_back(cornerPosition(t, k));
+        }
+    }
+    for (GLuint i = _aroundOffsets[from]; i < _aroundOffsets[from + 1]; i++) {
+        GLuint t = _around[i];
+        if (!_alive[t])
+            continue;
+
+        for (int k = 0; k < 3; k++) {
+            GLuint p = cornerPosition(t, k);
+            if (p != from && p != to
+                && find(opposite.begin(), opposite.end(), p) == opposite.end()
+                && find(toNeighbours.begin(), toNeighbours.end(), p)
+                       != toNeighbours.end())
+                return false;
+        }
+    }
+
+    // the triangles that stay mustn't turn over (or flatten out).
+    for (GLuint i = _aroundOffsets[from]; i < _aroundOffsets[from + 1]; i++) {
+        GLuint t = _around[i];
+        if (!_alive[t] || cornerAt(t, to) >= 0)
+            continue;
+
+        const GLfloat *before[3], *after[3];
+        for (int k = 0; k < 3; k++) {
+            GLuint p  = cornerPosition(t, k);
+            before[k] = position(p);
+            after[k]  = position(p == from ? to : p);
+        }
+
+        double n0[3], n1[3];
+        faceNormal(before[0], before[1], before[2], n0);
+        faceNormal(after[0], after[1], after[2], n1);
+        if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0)
+            return false;
+
+        GLuint fromWedge = _corners[t * 3 + cornerAt(t, from)];
+        bool known       = false;
+        for (size_t m = 0; m < wedgeMap.size(); m++)
+            known |= wedgeMap[m].first == fromWedge;
+        if (!known)
+            return false;
+    }
+
+    for (GLuint i = _aroundOffsets[from]; i < _aroundOffsets[from + 1]; i++) {
+        GLuint t = _around[i];
+        if (!_alive[t])
+            continue;
+
+        if (cornerAt(t, to) >= 0) {
+            _alive[t] = false;
+            _numTriangles--;
+            continue;
+        }
+
+        GLuint &corner = _corners[t * 3 + cornerAt(t, from)];
+        for (size_t m = 0; m < wedgeMap.size(); m++) {
+            if (wedgeMap[m].first == corner) {
+                corner = wedgeMap[m].second;
+                break;
+            }
+        }
+    }
+
+    _quadrics[to] = sumQuadrics(_quadrics[to], _quadrics[from]);
+    return true;
+}
+
+void Simplifier::simplify(size_t targetTriangles) {
+    while (_numTriangles > targetTriangles) {
+        // what every edge would cost to collapse, whichever way round is
+        // allowed and cheaper.
+        vector<Collapse> collapses;
+        collapses.reserve(_edges.size());
+        for (size_t e = 0; e < _edges.size(); e++) {
+            const Edge &edge = _edges[e];
+            GLuint ends[2]   = {edge.a, edge.b};
+
+            Collapse best = {0, 0, -1};
+            for (int k = 0; k < 2; k++) {
+                GLuint from = ends[k], to = ends[1 - k];
+                if (!(_kinds[from] == FREE
+                      || (_kinds[from] == SEAM && edge.seam)))
+                    continue;
+
+                double cost = quadricError(
+                    sumQuadrics(_quadrics[from], _quadrics[to]), position(to));
+                if (best.cost < 0 || cost < best.cost) {
+                    best.from = from;
+                    best.to   = to;
+                    best.cost = cost;
+                }
+            }
+            if (best.cost >= 0)
+                collapses.push_back(best);
+        }
+        if (collapses.empty())
+            break;
+        sort(collapses.begin(), collapses.end());
+
+        // each collapse takes about two triangles with it.  go for that many
+        // of the cheapest, touching each position once, so the costs stay
+        // right until the next pass works them out again.
+        size_t goal  = (_numTriangles - targetTriangles) / 2 + 1;
+        double limit = collapses[min(goal, collapses.size()) - 1].cost
+                       * PASS_ERROR_SLACK;
+
+        vector<bool> touched(_positionVertices.size(), false);
+        size_t collapsed = 0;
+        for (size_t c = 0; c < collapses.size() && collapsed < goal
+                           && _numTriangles > targetTriangles;
+             c++) {
+            const Collapse &collapse = collapses[c];
+            if (collapse.cost > limit)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            if (!tryCollapse(collapse.from, collapse.to))
+                continue;
+
+            touched[collapse.from] = touched[collapse.to] = true;
+            _error = max(_error, sqrt(collapse.cost));
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+
+        buildTopology();
+    }
+}
+
+void Simplifier::extract(CompiledMesh &level) const {
+    level.clear();
+    level.minX = _mesh.minX;
+    level.maxX = _mesh.maxX;
+    level.minY = _mesh.minY;
+    level.maxY = _mesh.maxY;
+    level.minZ = _mesh.minZ;
+    level.maxZ = _mesh.maxZ;
+
+    bool hasColors = !_mesh.colors.empty();
+
+    // one vertex per wedge, or, for faceted meshes, per wedge and face
+    // normal.
+    vector<GLint> wedgeVertices(_wedgeVertices.size(), -1);
+    SurfaceMap facetedVertices;
+
+    for (size_t b = 0; b < _batches.size(); b++) {
+        MeshBatch batch  = _batches[b];
+        batch.firstIndex = (GLuint)level.indices.size();
+
+        for (GLuint t = _batches[b].firstIndex / 3;
+             t < (_batches[b].firstIndex + _batches[b].numIndices) / 3;
+             t++) {
+            if (!_alive[t])
+                continue;
+
+            GLfloat normal[3] = {0, 0, 0};
+            if (_faceted) {
+                double n[3];
+                faceNormal(position(cornerPosition(t, 0)),
+                           position(cornerPosition(t, 1)),
+                           position(cornerPosition(t, 2)),
+                           n);
+                double l = length(n);
+                if (l > 0) {
+                    normal[0] = (GLfloat)(n[0] / l);
+                    normal[1] = (GLfloat)(n[1] / l);
+                    normal[2] = (GLfloat)(n[2] / l);
+                }
+            }
+
+            for (int k = 0; k < 3; k++) {
+                GLuint wedge  = _corners[t * 3 + k];
+                GLuint source = _wedgeVertices[wedge];
+                GLuint vertex = (GLuint)(level.positions.size() / 3);
+
+                bool added;
+                if (_faceted) {
+                    SurfaceKey key;
+                    memset(&key, 0, sizeof(key));
+                    memcpy(key.position,
+                           &_mesh.positions[source * 3],
+                           sizeof(key.position));
+                    memcpy(key.texCoord,
+                           &_mesh.texCoords[source * 2],
+                           sizeof(key.texCoord));
+                    if (hasColors)
+                        memcpy(key.color,
+                               &_mesh.colors[source * 4],
+                               sizeof(key.color));
+                    memcpy(key.normal, normal, sizeof(key.normal));
+
+                    pair<SurfaceMap::iterator, bool> p = facetedVertices.insert(
+                        SurfaceMap::value_type(key, vertex));
+                    vertex = p.first->second;
+                    added  = p.second;
+                } else {
+                    added = wedgeVertices[wedge] < 0;
+                    if (added)
+                        wedgeVertices[wedge] = (GLint)vertex;
+                    vertex = (GLuint)wedgeVertices[wedge];
+                }
+                level.indices.push_back(vertex);
+                if (!added)
+                    continue;
+
+                level.positions.insert(level.positions.end(),
+                                       &_mesh.positions[source * 3],
+                                       &_mesh.positions[source * 3 + 3]);
+                if (_faceted)
+                    level.normals.insert(
+                        level.normals.end(), normal, normal + 3);
+                else
+                    level.normals.insert(level.normals.end(),
+                                         &_mesh.normals[source * 3],
+                                         &_mesh.normals[source * 3 + 3]);
+                level.texCoords.insert(level.texCoords.end(),
+                                       &_mesh.texCoords[source * 2],
+                                       &_mesh.texCoords[source * 2 + 2]);
+                if (hasColors)
+                    level.colors.insert(level.colors.end(),
+                                        &_mesh.colors[source * 4],
+                                        &_mesh.colors[source * 4 + 4]);
+            }
+        }
+
+        batch.numIndices = (GLuint)level.indices.size() - batch.firstIndex;
+        if (batch.numIndices == 0)
+            continue;
+
+        level.batches.push_back(batch);
+        level.triangleMaterials.insert(level.triangleMaterials.end(),
+                                       batch.numIndices / 3,
+                                       batch.material);
+    }
+
+    level.numFaces = (GLuint)(level.indices.size() / 3);
+}
+
+/* put level after everything already in mesh, as its next level */
+static void appendLevel(CompiledMesh &mesh, const CompiledMesh &level,
+                        float error) {
+    MeshLevel entry;
+    entry.firstVertex = (GLuint)(mesh.positions.size() / 3);
+    entry.numVertices = (GLuint)(level.positions.size() / 3);
+    entry.firstIndex  = (GLuint)mesh.indices.size();
+    entry.numIndices  = (GLuint)level.indices.size();
+    entry.firstBatch  = (GLuint)mesh.batches.size();
+    entry.numBatches  = (GLuint)level.batches.size();
+    entry.error       = error;
+    mesh.levels.push_back(entry);
+
+    mesh.positions.insert(
+        mesh.positions.end(), level.positions.begin(), level.positions.end());
+    mesh.normals.insert(
+        mesh.normals.end(), level.normals.begin(), level.normals.end());
+    mesh.texCoords.insert(
+        mesh.texCoords.end(), level.texCoords.begin(), level.texCoords.end());
+    mesh.colors.insert(
+        mesh.colors.end(), level.colors.begin(), level.colors.end());
+
+    // every level indexes the one vertex buffer.
+    for (size_t i = 0; i < level.indices.size(); i++)
+        mesh.indices.push_back(entry.firstVertex + level.indices[i]);
+    mesh.triangleMaterials.insert(mesh.triangleMaterials.end(),
+                                  level.triangleMaterials.begin(),
+                                  level.triangleMaterials.end());
+
+    for (size_t b = 0; b < level.batches.size(); b++) {
+        MeshBatch batch = level.batches[b];
+        batch.firstIndex += entry.firstIndex;
+        mesh.batches.push_back(batch);
+    }
+}
+
+void buildLevelsOfDetail(CompiledMesh &mesh, unsigned int maxLevels) {
+    mesh.levels.clear();
+
+    size_t numTriangles = mesh.indices.size() / 3;
+    MeshLevel full;
+    full.firstVertex = 0;
+    full.numVertices = (GLuint)(mesh.positions.size() / 3);
+    full.firstIndex  = 0;
+    full.numIndices  = (GLuint)mesh.indices.size();
+    full.firstBatch  = 0;
+    full.numBatches  = (GLuint)mesh.batches.size();
+    full.error       = 0;
+
+    // every level carries on from the one before, so errors add up against
+    // the full mesh.  they only go into mesh once the simplifier is done
+    // looking at it.
+    vector<CompiledMesh> levels;
+    vector<float> errors;
+    {
+        Simplifier simplifier(mesh);
+        size_t previous = numTriangles;
+        for (unsigned int l = 1; l < maxLevels; l++) {
+            size_t target = numTriangles >> l;
+            if (target < LOD_MIN_TRIANGLES)
+                break;
+
+            simplifier.simplify(target);
+            if (simplifier.numTriangles() > previous * LOD_MIN_REDUCTION)
+                break;
+            previous = simplifier.numTriangles();
+
+            levels.push_back(CompiledMesh());
+            simplifier.extract(levels.back());
+            errors.push_back(simplifier.error());
+
+            MeshOptimizerStats optimized;
+            optimizeMesh(levels.back(), optimized);
+        }
+    }
+
+    mesh.levels.push_back(full);
+    for (size_t l = 0; l < levels.size(); l++)
+        appendLevel(mesh, levels[l], errors[l]);
+}
+}
@@ -0,0 +1,29 @@
+#ifndef _GOL_MESH_SIMPLIFIER_H_
+#define _GOL_MESH_SIMPLIFIER_H_ 1
+
+#include "CompiledMesh.h"
+
+namespace paone {
+
+
+/*
+ * Give mesh a chain of simpler levels of detail, each with about half the
+ * triangles of the one before it, for drawing it far away.  They are made
+ * by collapsing the edges that move the surface least, as measured by
+ * Garland and Heckbert's quadric error metric.
+ *
+ * Vertices only ever collapse onto their neighbours, so texture
+ * coordinates stay exactly where they were.  Vertices on a texture seam,
+ * the edge of a batch (a change of material) or an open border may only
+ * slide along it, and where such edges meet they don't move at all, so
+ * seams and material boundaries keep their shape.  Meshes with face normals
+ * get new face normals for their simplified triangles.
+ *
+ * Level 0 (the mesh as it is) and up to maxLevels - 1 simpler ones end up
+ * in mesh.levels; levels that wouldn't save at least a fifth of the
+ * triangles are left out.  Each is optimized with optimizeMesh().
+ */
+void buildLevelsOfDetail(CompiledMesh &mesh, unsigned int maxLevels = 5);
+}
+
+#endif
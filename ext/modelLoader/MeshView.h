@@ -0,0 +1,62 @@
+#ifndef _GOL_MESH_VIEW_H_
+#define _GOL_MESH_VIEW_H_ 1
+
+#ifdef __APPLE__
+#include <OpenGL/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "MtlParser.h"
+
+#include <stddef.h>
+
+namespace paone {
+
+
+/* a read-only, contiguous run of T that belongs to someone else */
+template <typename T>
+class ArrayView {
+public:
+    ArrayView() : _data(NULL), _size(0) {}
+    ArrayView(const T *data, size_t size) : _data(data), _size(size) {}
+
+    const T *data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    const T &operator[](size_t i) const { return _data[i]; }
+
+    const T *begin() const { return _data; }
+    const T *end() const { return _data + _size; }
+
+private:
+    const T *_data;
+    size_t _size;
+};
+
+/*
+ * The triangles of a loaded model, as flat arrays.
+ *
+ * Nothing is copied: the arrays belong to the Object the view came from and
+ * stay valid until it loads another file or is destroyed.
+ */
+struct MeshView {
+    ArrayView<GLfloat> positions; /* x y z per vertex */
+    ArrayView<GLfloat> normals;   /* x y z per vertex */
+    ArrayView<GLfloat> texCoords; /* s t per vertex */
+    ArrayView<GLfloat> colors;    /* r g b a per vertex, if the file had any */
+
+    /* three vertex indices per triangle */
+    ArrayView<GLuint> indices;
+    /* index into materials per triangle, -1 for none */
+    ArrayView<GLint> triangleMaterials;
+
+    ArrayView<MtlMaterial> materials;
+
+    size_t numVertices() const { return positions.size() / 3; }
+    size_t numTriangles() const { return indices.size() / 3; }
+};
+}
+
+#endif
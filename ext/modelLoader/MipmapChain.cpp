@@ -0,0 +1,400 @@
+#include <GL/glew.h>
+
+#include "ImageKernels.h"
+#include "MipmapChain.h"
+#include "WorkerPool.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace paone {
+
+/* about how many pixels are worth handing a worker */
+static const size_t PIXELS_PER_JOB = 32 * 1024;
+
+/* colour bytes to 16 bit linear values and back, rounding to the nearest.
+ * sRGB bytes are decoded to linear light; anything else is just widened */
+struct ChannelTables {
+    uint16_t toLinear[256];
+    unsigned char fromLinear[65536];
+
+    ChannelTables(bool srgb) {
+        for (int i = 0; i < 256; i++)
+            toLinear[i]
+                = (uint16_t)(linear(i / 255.0, srgb) * 65535.0 + 0.5);
+
+        // byte i takes over from i - 1 at the value of byte i - 0.5.
+        int value = 0;
+        for (int i = 1; i < 256; i++) {
+            double start = linear((i - 0.5) / 255.0, srgb) * 65535.0;
+            for (; value < 65536 && value < start; value++)
+                fromLinear[value] = (unsigned char)(i - 1);
+        }
+        for (; value < 65536; value++)
+            fromLinear[value] = 255;
+    }
+
+    static double linear(double value, bool srgb) {
+        if (!srgb)
+            return value;
+        return value <= 0.04045 ? value / 12.92
+                                : pow((value + 0.055) / 1.055, 2.4);
+    }
+};
+
+static const ChannelTables &channelTables(MipmapChain::Encoding encoding) {
+    static const ChannelTables srgbTables(true), linearTables(false);
+    return encoding == MipmapChain::SRGB ? srgbTables : linearTables;
+}
+
+/*
+ * numPixels pixels of channels bytes into 4 linear channels each.  the last
+ * channel of 2 and 4 is alpha, left linear; missing channels are 0
+ */
+static void toLinear(const unsigned char *src, int channels, uint16_t *dst,
+                     size_t numPixels, MipmapChain::Encoding encoding) {
+    const uint16_t *table = channelTables(encoding).toLinear;
+    switch (channels) {
+    case 3:
+        for (size_t i = 0; i < numPixels; i++, src += 3, dst += 4) {
+            dst[0] = table[src[0]];
+            dst[1] = table[src[1]];
+            dst[2] = table[src[2]];
+            dst[3] = 0;
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < numPixels; i++, src += 4, dst += 4) {
+            dst[0] = table[src[0]];
+            dst[1] = table[src[1]];
+            dst[2] = table[src[2]];
+            dst[3] = src[3] * 257;
+        }
+        break;
+    default:
+        for (size_t i = 0; i < numPixels; i++, src += channels, dst += 4) {
+            dst[0] = table[src[0]];
+            dst[1] = channels == 2 ? src[1] * 257 : 0;
+            dst[2] = dst[3] = 0;
+        }
+        break;
+    }
+}
+
+/* 16 bit linear alpha to a byte, rounding to the nearest */
+static unsigned char alphaByte(uint16_t alpha) {
+    return (unsigned char)((alpha * 255u + 32767u) / 65535u);
+}
+
+/* a normal's component, -1 to 1, back to a byte */
+static unsigned char normalByte(double value) {
+    return (unsigned char)lrint((value * 0.5 + 0.5) * 255.0);
+}
+
+/* the RGB of numPixels linear pixels, as normals scaled to unit length */
+static void fromLinearNormals(const uint16_t *src, unsigned char *dst,
+                              int channels, size_t numPixels) {
+    for (size_t i = 0; i < numPixels; i++, src += 4, dst += channels) {
+        double n[3];
+        for (int c = 0; c < 3; c++)
+            n[c] = src[c] / 65535.0 * 2.0 - 1.0;
+
+        // averaging shortens them, so the mipmaps would light dimmer.
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (int c = 0; c < 3; c++)
+            dst[c] = normalByte(length > 0.0 ? n[c] / length : n[c]);
+        if (channels == 4)
+            dst[3] = alphaByte(src[3]);
+    }
+}
+
+/* and back */
+static void fromLinear(const uint16_t *src, unsigned char *dst, int channels,
+                       size_t numPixels, MipmapChain::Encoding encoding) {
+    if (encoding == MipmapChain::NORMALS && channels >= 3) {
+        fromLinearNormals(src, dst, channels, numPixels);
+        return;
+    }
+
+    const unsigned char *table = channelTables(encoding).fromLinear;
+    switch (channels) {
+    case 3:
+        for (size_t i = 0; i < numPixels; i++, src += 4, dst += 3) {
+            dst[0] = table[src[0]];
+            dst[1] = table[src[1]];
+            dst[2] = table[src[2]];
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < numPixels; i++, src += 4, dst += 4) {
+            dst[0] = table[src[0]];
+            dst[1] = table[src[1]];
+            dst[2] = table[src[2]];
+            dst[3] = alphaByte(src[3]);
+        }
+        break;
+    default:
+        for (size_t i = 0; i < numPixels; i++, src += 4, dst += channels) {
+            dst[0] = table[src[0]];
+            if (channels == 2)
+                dst[1] = alphaByte(src[1]);
+        }
+        break;
+    }
+}
+
+/* the average of numColumns pixels from column on, in each of numRows
+ * linear rows, rounding to the nearest */
+static void boxPixel(const uint16_t *const *rows, int numRows, int column,
+                     int numColumns, uint16_t *dst) {
+    unsigned int count = numRows * numColumns;
+    for (int c = 0; c < 4; c++) {
+        unsigned int sum = 0;
+        for (int r = 0; r < numRows; r++)
+            for (int x = column; x < column + numColumns; x++)
+                sum += rows[r][x * 4 + c];
+        dst[c] = (uint16_t)((sum + count / 2) / count);
+    }
+}
+
+/*
+ * how many rows from 2 * y on make row y of the level below one srcHeight
+ * tall: an odd height folds its last row into the last row below
+ */
+static int rowsBelow(int y, int srcHeight, int dstHeight) {
+    if (srcHeight == 1)
+        return 1;
+    return y == dstHeight - 1 && (srcHeight & 1) ? 3 : 2;
+}
+
+/* one row of a level from the numRows linear rows above it.  an odd width
+ * folds its last column into the last pixel the same way */
+static void halveRow(const uint16_t *const *rows, int numRows, int srcWidth,
+                     uint16_t *dst, int dstWidth) {
+    if (numRows == 2 && srcWidth > 1) {
+        halveRows16(rows[0], rows[1], dst, dstWidth);
+    } else {
+        for (int x = 0; x < dstWidth; x++)
+            boxPixel(rows, numRows, 2 * x, min(2, srcWidth), dst + x * 4);
+    }
+
+    if (srcWidth > 1 && (srcWidth & 1))
+        boxPixel(rows, numRows, srcWidth - 3, 3, dst + (dstWidth - 1) * 4);
+}
+
+/* rows [first, last) of a level from the linear level above it */
+static void halveLevel(const uint16_t *src, int srcWidth, int srcHeight,
+                       uint16_t *dst, int dstWidth, int dstHeight, int first,
+                       int last) {
+    size_t rowSize = (size_t)srcWidth * 4;
+    for (int y = first; y < last; y++) {
+        const uint16_t *rows[3];
+        int numRows = rowsBelow(y, srcHeight, dstHeight);
+        for (int r = 0; r < numRows; r++)
+            rows[r] = src + (2 * y + r) * rowSize;
+        halveRow(
+            rows, numRows, srcWidth, dst + (size_t)y * dstWidth * 4, dstWidth);
+    }
+}
+
+/* the same for the first level, straight from the image, the rows it needs
+ * made linear as it goes */
+static void halveImage(const unsigned char *pixels, int width, int height,
+                       int channels, MipmapChain::Encoding encoding,
+                       uint16_t *dst, int dstWidth, int dstHeight, int first,
+                       int last) {
+    vector<uint16_t> linear((size_t)width * 12);
+    size_t rowSize = (size_t)width * channels;
+    for (int y = first; y < last; y++) {
+        const uint16_t *rows[3];
+        int numRows = rowsBelow(y, height, dstHeight);
+        for (int r = 0; r < numRows; r++) {
+            uint16_t *row = &linear[(size_t)width * 4 * r];
+            toLinear(pixels + (2 * y + r) * rowSize,
+                     channels,
+                     row,
+                     width,
+                     encoding);
+            rows[r] = row;
+        }
+        halveRow(
+            rows, numRows, width, dst + (size_t)y * dstWidth * 4, dstWidth);
+    }
+}
+
+/* one job for each band of rows of a width x height level, worth about
+ * PIXELS_PER_JOB */
+static void addBands(vector<function<void()> > &jobs, int width, int height,
+                     const function<void(int, int)> &band) {
+    int rows = max(1, (int)(PIXELS_PER_JOB / width));
+    for (int first = 0; first < height; first += rows) {
+        int last = min(height, first + rows);
+        jobs.push_back([band, first, last]() { band(first, last); });
+    }
+}
+
+/* run jobs, covering numPixels between them, on the workers if there's
+ * enough to share out */
+static void runJobs(const vector<function<void()> > &jobs, size_t numPixels,
+                    bool parallel) {
+    if (parallel && numPixels >= 2 * PIXELS_PER_JOB) {
+        WorkerPool::shared().run(jobs);
+    } else {
+        for (size_t i = 0; i < jobs.size(); i++)
+            jobs[i]();
+    }
+}
+
+MipmapChain::MipmapChain() { clear(); }
+
+void MipmapChain::build(const unsigned char *pixels, int width, int height,
+                        int channels, Encoding encoding, bool parallel) {
+    clear();
+    _width    = width;
+    _height   = height;
+    _channels = channels;
+    _encoding = encoding;
+
+    // lay out every level first, so they can be filled in any order.
+    int levelWidth = width, levelHeight = height;
+    size_t size = 0;
+    while (levelWidth > 1 || levelHeight > 1) {
+        Level level;
+        level.width  = levelWidth = max(1, levelWidth / 2);
+        level.height = levelHeight = max(1, levelHeight / 2);
+        level.offset = size;
+        size += (size_t)level.width * level.height * channels;
+        _levels.push_back(level);
+    }
+    if (_levels.empty())
+        return;
+    _data.resize(size);
+
+    // two linear levels at a time: the one being read and the one being
+    // made.  the image itself is only needed a couple of rows at a time.
+    vector<uint16_t> linear[2];
+    linear[1].resize((size_t)_levels[0].width * _levels[0].height * 4);
+    if (_levels.size() > 1)
+        linear[0].resize((size_t)_levels[1].width * _levels[1].height * 4);
+
+    vector<function<void()> > jobs;
+    int srcWidth = width, srcHeight = height;
+    for (size_t i = 0; i <= _levels.size(); i++) {
+        const uint16_t *src = linear[i & 1].data();
+        jobs.clear();
+
+        // bytes for the level made last time around...
+        if (i > 0) {
+            const Level &done = _levels[i - 1];
+            addBands(
+                jobs, done.width, done.height, [&, src](int first, int last) {
+                    size_t start = (size_t)first * done.width;
+                    fromLinear(src + start * 4,
+                               &_data[done.offset + start * _channels],
+                               _channels,
+                               (size_t)(last - first) * done.width,
+                               _encoding);
+                });
+        }
+
+        // ...while the next one is filtered from it.
+        if (i < _levels.size()) {
+            const Level &next = _levels[i];
+            uint16_t *dst     = linear[(i + 1) & 1].data();
+            addBands(jobs,
+                     next.width,
+                     next.height,
+                     [&, src, dst, srcWidth, srcHeight](int first, int last) {
+                         if (i == 0)
+                             halveImage(pixels,
+                                        width,
+                                        height,
+                                        channels,
+                                        encoding,
+                                        dst,
+                                        next.width,
+                                        next.height,
+                                        first,
+                                        last);
+                         else
+                             halveLevel(src,
+                                        srcWidth,
+                                        srcHeight,
+                                        dst,
+                                        next.width,
+                                        next.height,
+                                        first,
+                                        last);
+                     });
+        }
+
+        runJobs(jobs, (size_t)srcWidth * srcHeight, parallel);
+
+        if (i < _levels.size()) {
+            srcWidth  = _levels[i].width;
+            srcHeight = _levels[i].height;
+        }
+    }
+}
+
+void MipmapChain::clear() {
+    _width = _height = _channels = 0;
+    _levels.clear();
+    _data.clear();
+    _encoding = SRGB;
+}
+
+GLenum MipmapChain::format() const {
+    switch (_channels) {
+    case 1:
+        return GL_LUMINANCE;
+    case 2:
+        return GL_LUMINANCE_ALPHA;
+    case 3:
+        return GL_RGB;
+    default:
+        return GL_RGBA;
+    }
+}
+
+int MipmapChain::numLevels() const { return (int)_levels.size(); }
+
+int MipmapChain::width(int level) const { return _levels[level - 1].width; }
+
+int MipmapChain::height(int level) const { return _levels[level - 1].height; }
+
+const unsigned char *MipmapChain::pixels(int level) const {
+    return &_data[_levels[level - 1].offset];
+}
+
+void MipmapChain::upload(const unsigned char *pixels,
+                         GLint internalFormat) const {
+    GLint maxSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+    GLint unpackAlignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLint level = 0;
+    for (int i = 0; i <= numLevels(); i++) {
+        int w = i == 0 ? _width : width(i);
+        int h = i == 0 ? _height : height(i);
+        if (w > maxSize || h > maxSize)
+            continue;
+        glTexImage2D(GL_TEXTURE_2D,
+                     level++,
+                     internalFormat,
+                     w,
+                     h,
+                     0,
+                     format(),
+                     GL_UNSIGNED_BYTE,
+                     i == 0 ? pixels : this->pixels(i));
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+}
+}
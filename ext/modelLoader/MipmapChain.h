@@ -0,0 +1,84 @@
+#ifndef _GOL_MIPMAP_CHAIN_H_
+#define _GOL_MIPMAP_CHAIN_H_ 1
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * Every mipmap level below an image, made on the CPU before anything is
+ * uploaded.
+ *
+ * Each level is a 2x2 box filter of the one above, halving each side down to
+ * 1x1.  Odd sides round down, their last row or column folded into the last
+ * of the level below as a 3 wide box.  By default colours are taken to be
+ * sRGB and averaged in linear light, 16 bits a channel the whole way down,
+ * so darker and brighter texels mix the way they look rather than going
+ * muddy; images that aren't colours say so with an Encoding.  Alpha is
+ * always averaged as it is.  The filtering uses
+ * ImageKernels, and big levels are split across WorkerPool::shared(), each
+ * level's conversion back to bytes overlapping the filtering of the next.
+ */
+class MipmapChain {
+public:
+    /* what an image's colour channels hold, and so how they are averaged */
+    enum Encoding {
+        /* colours, averaged in linear light */
+        SRGB,
+        /* data such as height maps, averaged as they are */
+        LINEAR,
+        /* tangent space normals in RGB, averaged as they are and then made
+         * unit length again */
+        NORMALS
+    };
+
+    MipmapChain();
+
+    /*
+     * make every level below the image at pixels: width x height, channels
+     * (1 to 4) bytes each, holding encoding.  parallel lets it use the
+     * workers
+     */
+    void build(const unsigned char *pixels, int width, int height,
+               int channels, Encoding encoding = SRGB, bool parallel = true);
+    void clear();
+
+    /* the glTexImage format of the pixels */
+    GLenum format() const;
+
+    /* levels below the image.  level 1 is the first of them, as in GL */
+    int numLevels() const;
+    int width(int level) const;
+    int height(int level) const;
+    const unsigned char *pixels(int level) const;
+
+    /*
+     * glTexImage2D pixels (the image it was built from) and every level below
+     * into the bound GL_TEXTURE_2D as internalFormat, skipping any too big
+     * for the driver.  GL thread only
+     */
+    void upload(const unsigned char *pixels, GLint internalFormat) const;
+
+private:
+    struct Level {
+        int width, height;
+        size_t offset;
+    };
+
+    int _width, _height, _channels;
+    Encoding _encoding;
+    vector<Level> _levels;
+    vector<unsigned char> _data;
+};
+}
+
+#endif
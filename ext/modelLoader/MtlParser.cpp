@@ -0,0 +1,79 @@
+#include "MtlParser.h"
+#include "TextScanner.h"
+
+namespace paone {
+
+/* read the r g b of a colour line; alpha is left alone */
+static void readColor(TextScanner &scanner, GLfloat color[4]) {
+    color[0] = scanner.readFloat();
+    color[1] = scanner.readFloat();
+    color[2] = scanner.readFloat();
+}
+
+void parseMTL(const char *begin, const char *end,
+              vector<MtlMaterial> &materials, vector<string> &ignoredLines) {
+    TextScanner scanner(begin, end);
+
+    MtlMaterial *current = NULL;
+    const char *tokBegin, *tokEnd;
+
+    for (; !scanner.atEnd(); scanner.nextLine()) {
+        if (!scanner.token(tokBegin, tokEnd) || *tokBegin == '#')
+            continue;
+
+        if (TextScanner::equals(tokBegin, tokEnd, "newmtl")) {
+            const char *nameBegin, *nameEnd;
+            scanner.restOfLine(nameBegin, nameEnd);
+
+            materials.push_back(MtlMaterial());
+            current       = &materials.back();
+            current->name = string(nameBegin, nameEnd);
+            continue;
+        }
+
+        const char *argBegin, *argEnd;
+
+        if (current == NULL) {
+            // nothing to apply it to.
+        } else if (TextScanner::equals(tokBegin, tokEnd, "Ka")) {
+            readColor(scanner, current->material.getAmbient());
+        } else if (TextScanner::equals(tokBegin, tokEnd, "Kd")) {
+            readColor(scanner, current->material.getDiffuse());
+        } else if (TextScanner::equals(tokBegin, tokEnd, "Ks")) {
+            readColor(scanner, current->material.getSpecular());
+        } else if (TextScanner::equals(tokBegin, tokEnd, "Ke")) {
+            readColor(scanner, current->material.getEmissive());
+        } else if (TextScanner::equals(tokBegin, tokEnd, "Ns")) {
+            current->material.setShininess(scanner.readFloat());
+        } else if (TextScanner::equals(tokBegin, tokEnd, "Tr")
+                   || TextScanner::equals(tokBegin, tokEnd, "d")) {
+            // transparency - Tr or d can be used depending on the format
+            GLfloat alpha                       = scanner.readFloat();
+            current->material.getAmbient()[3]  = alpha;
+            current->material.getDiffuse()[3]  = alpha;
+            current->material.getSpecular()[3] = alpha;
+        } else if (TextScanner::equals(tokBegin, tokEnd, "illum")) {
+            current->material.setIllumination(scanner.readInt());
+        } else if (TextScanner::equals(tokBegin, tokEnd, "map_Kd")) {
+            scanner.restOfLine(argBegin, argEnd);
+            current->diffuseMap = string(argBegin, argEnd);
+        } else if (TextScanner::equals(tokBegin, tokEnd, "map_d")) {
+            scanner.restOfLine(argBegin, argEnd);
+            current->alphaMap = string(argBegin, argEnd);
+        } else if (TextScanner::equals(tokBegin, tokEnd, "map_Ka")
+                   || TextScanner::equals(tokBegin, tokEnd, "map_Ks")
+                   || TextScanner::equals(tokBegin, tokEnd, "map_Ns")
+                   || TextScanner::equals(tokBegin, tokEnd, "Ni")
+                   || TextScanner::equals(tokBegin, tokEnd, "Tf")
+                   || TextScanner::equals(tokBegin, tokEnd, "bump")
+                   || TextScanner::equals(tokBegin, tokEnd, "map_bump")) {
+            // understood, but not something we can render.
+            continue;
+        } else {
+            scanner.seek(tokBegin);
+            scanner.restOfLine(argBegin, argEnd);
+            ignoredLines.push_back(string(argBegin, argEnd));
+        }
+    }
+}
+}
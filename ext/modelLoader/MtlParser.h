@@ -0,0 +1,31 @@
+#ifndef _GOL_MTL_PARSER_H_
+#define _GOL_MTL_PARSER_H_ 1
+
+#include "Material.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/* one newmtl block of a WaveFront *.mtl file */
+struct MtlMaterial {
+    string name;
+    Material material;
+
+    /* map_Kd and map_d image files, as written.  empty if not given */
+    string diffuseMap;
+    string alphaMap;
+};
+
+/*
+ * Parse the *.mtl text in [begin, end), appending each material to
+ * materials.  Lines we do not use are appended to ignoredLines.
+ */
+void parseMTL(const char *begin, const char *end,
+              vector<MtlMaterial> &materials, vector<string> &ignoredLines);
+}
+
+#endif
@@ -0,0 +1,422 @@
+#include "ObjParser.h"
+#include "TextScanner.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+
+namespace paone {
+
+ObjData::ObjData() { clear(); }
+
+void ObjData::clear() {
+    vertices.clear();
+    vertexNormals.clear();
+    vertexTexCoords.clear();
+    corners.clear();
+    faces.clear();
+    materialNames.clear();
+    materialLibraries.clear();
+    ignoredLines.clear();
+
+    minX = minY = minZ = 999999;
+    maxX = maxY = maxZ = -999999;
+}
+
+/* material and smooth state of a chunk that does not start the file */
+static const int INHERITED = -2;
+
+/* a relative index that reached back past the start of the file */
+static const int BAD_INDEX = -2;
+
+/*
+ * Read one "v", "v/vt", "v//vn" or "v/vt/vn" group.  Negative (relative)
+ * indices are resolved against how many of each we have read so far; if
+ * fixups is given, the slot of each one is recorded there (as corner * 3 +
+ * field) so it can be shifted once we know what came before this chunk.
+ */
+static bool parseCorner(const char *p, const char *end, const ObjData &data,
+                        ObjCorner &corner, vector<unsigned int> *fixups) {
+    corner.v = corner.vt = corner.vn = -1;
+
+    int *fields[3] = {&corner.v, &corner.vt, &corner.vn};
+    int counts[3]  = {(int)(data.vertices.size() / 3),
+                     (int)(data.vertexTexCoords.size() / 2),
+                     (int)(data.vertexNormals.size() / 3)};
+    unsigned int slot = (unsigned int)data.corners.size() * 3;
+    bool hasVertex    = false;
+
+    for (int field = 0; p < end; field++) {
+        if (field > 2)
+            return false;
+
+        if (*p != '/') {
+            int index = TextScanner::parseInt(p, end);
+            if (index == 0)
+                return false;
+            if (index < 0) {
+                *fields[field] = counts[field] + index;
+                if (fixups)
+                    fixups->push_back(slot + field);
+                else if (*fields[field] < 0)
+                    return false;
+            } else {
+                *fields[field] = index - 1;
+            }
+            if (field == 0)
+                hasVertex = true;
+        }
+
+        if (p < end) {
+            if (*p != '/')
+                return false;
+            p++;
+        }
+    }
+
+    return hasVertex;
+}
+
+/*
+ * Parse the lines in [begin, end), starting out with the given material and
+ * smooth state.  Material indices are local to data.materialNames.
+ */
+static bool parseLines(const char *begin, const char *end, ObjData &data,
+                       vector<unsigned int> *fixups, int &currentMaterial,
+                       int &currentSmooth, string &error) {
+    TextScanner scanner(begin, end);
+
+    map<string, int> materialIndices;
+
+    const char *tokBegin, *tokEnd;
+
+    for (; !scanner.atEnd(); scanner.nextLine()) {
+        if (!scanner.token(tokBegin, tokEnd) || *tokBegin == '#')
+            continue;
+
+        size_t len = tokEnd - tokBegin;
+        char c0    = tokBegin[0];
+        char c1    = len > 1 ? tokBegin[1] : '\0';
+
+        if (len == 1 && c0 == 'v') { // vertex
+            float x = scanner.readFloat(), y = scanner.readFloat(),
+                  z = scanner.readFloat();
+
+            if (x < data.minX)
+                data.minX = x;
+            if (x > data.maxX)
+                data.maxX = x;
+            if (y < data.minY)
+                data.minY = y;
+            if (y > data.maxY)
+                data.maxY = y;
+            if (z < data.minZ)
+                data.minZ = z;
+            if (z > data.maxZ)
+                data.maxZ = z;
+
+            data.vertices.push_back(x);
+            data.vertices.push_back(y);
+            data.vertices.push_back(z);
+        } else if (len == 2 && c0 == 'v' && c1 == 'n') { // vertex normal
+            data.vertexNormals.push_back(scanner.readFloat());
+            data.vertexNormals.push_back(scanner.readFloat());
+            data.vertexNormals.push_back(scanner.readFloat());
+        } else if (len == 2 && c0 == 'v' && c1 == 't') { // vertex tex coord
+            data.vertexTexCoords.push_back(scanner.readFloat());
+            data.vertexTexCoords.push_back(scanner.readFloat());
+        } else if (len == 1 && c0 == 'f') { // face!
+            ObjFace face;
+            face.firstCorner = (unsigned int)data.corners.size();
+            face.numCorners  = 0;
+            face.material    = currentMaterial;
+            face.smooth      = currentSmooth;
+
+            const char *groupBegin, *groupEnd;
+            while (scanner.token(groupBegin, groupEnd)) {
+                ObjCorner corner;
+                if (!parseCorner(groupBegin, groupEnd, data, corner, fixups)) {
+                    error = "Malformed OBJ file, bad face: "
+                            + string(groupBegin, groupEnd);
+                    return false;
+                }
+                data.corners.push_back(corner);
+                face.numCorners++;
+            }
+
+            data.faces.push_back(face);
+        } else if (TextScanner::equals(tokBegin, tokEnd, "usemtl")) {
+            const char *nameBegin, *nameEnd;
+            scanner.token(nameBegin, nameEnd);
+            string name(nameBegin, nameEnd);
+
+            map<string, int>::iterator iter = materialIndices.find(name);
+            if (iter == materialIndices.end()) {
+                iter = materialIndices
+                           .insert(pair<string, int>(
+                               name, (int)data.materialNames.size()))
+                           .first;
+                data.materialNames.push_back(name);
+            }
+            currentMaterial = iter->second;
+        } else if (len == 1 && c0 == 's') { // smooth shading
+            const char *argBegin, *argEnd;
+            scanner.token(argBegin, argEnd);
+            currentSmooth = TextScanner::equals(argBegin, argEnd, "off") ? 0 : 1;
+        } else if (TextScanner::equals(tokBegin, tokEnd, "mtllib")) {
+            const char *nameBegin, *nameEnd;
+            scanner.token(nameBegin, nameEnd);
+            data.materialLibraries.push_back(string(nameBegin, nameEnd));
+        } else if (len == 1 && (c0 == 'o' || c0 == 'g')) {
+            // object and polygon group names are ignored
+        } else {
+            scanner.seek(tokBegin);
+            const char *lineBegin, *lineEnd;
+            scanner.restOfLine(lineBegin, lineEnd);
+            data.ignoredLines.push_back(string(lineBegin, lineEnd));
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Faces may refer forward, so indices can only be checked against how many
+ * of each there are once the whole file has been read.
+ */
+static bool checkIndices(const ObjData &data, string &error) {
+    int counts[3] = {(int)(data.vertices.size() / 3),
+                     (int)(data.vertexTexCoords.size() / 2),
+                     (int)(data.vertexNormals.size() / 3)};
+
+    for (size_t i = 0; i < data.corners.size(); i++) {
+        const ObjCorner &corner = data.corners[i];
+        int fields[3]           = {corner.v, corner.vt, corner.vn};
+
+        // only the vertex is required; -1 means the others were not given.
+        for (int field = 0; field < 3; field++) {
+            if (fields[field] >= counts[field]
+                || fields[field] < (field == 0 ? 0 : -1)) {
+                char buff[64];
+                snprintf(buff,
+                         sizeof(buff),
+                         "%d/%d/%d",
+                         corner.v + 1,
+                         corner.vt + 1,
+                         corner.vn + 1);
+                error = "Malformed OBJ file, face index out of range: "
+                        + string(buff);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool parseOBJ(const char *begin, const char *end, ObjData &data,
+              string &error) {
+    int currentMaterial = -1, currentSmooth = -1;
+    return parseLines(
+               begin, end, data, NULL, currentMaterial, currentSmooth, error)
+           && checkIndices(data, error);
+}
+
+/* one newline aligned piece of the file, parsed on its own */
+struct ObjChunk {
+    const char *begin, *end;
+
+    ObjData data;
+    vector<unsigned int> fixups;
+
+    /* state at the start (INHERITED unless this is the first chunk) and end */
+    int firstMaterial, firstSmooth;
+    int lastMaterial, lastSmooth;
+
+    bool ok;
+    string error;
+
+    /* where this chunk's records land in the merged arrays */
+    size_t vertexBase, texCoordBase, normalBase, cornerBase, faceBase;
+    /* chunk material index -> merged material index */
+    vector<int> materialMap;
+    /* the merged state inherited from the chunks before this one */
+    int inheritedMaterial, inheritedSmooth;
+};
+
+static void parseChunk(ObjChunk *chunk) {
+    chunk->lastMaterial = chunk->firstMaterial;
+    chunk->lastSmooth   = chunk->firstSmooth;
+    chunk->ok           = parseLines(chunk->begin,
+                           chunk->end,
+                           chunk->data,
+                           &chunk->fixups,
+                           chunk->lastMaterial,
+                           chunk->lastSmooth,
+                           chunk->error);
+}
+
+static void copyChunk(ObjChunk *chunk, ObjData *merged) {
+    const ObjData &data = chunk->data;
+
+    copy(data.vertices.begin(),
+         data.vertices.end(),
+         merged->vertices.begin() + chunk->vertexBase * 3);
+    copy(data.vertexTexCoords.begin(),
+         data.vertexTexCoords.end(),
+         merged->vertexTexCoords.begin() + chunk->texCoordBase * 2);
+    copy(data.vertexNormals.begin(),
+         data.vertexNormals.end(),
+         merged->vertexNormals.begin() + chunk->normalBase * 3);
+
+    // relative indices were resolved against this chunk alone; shift them
+    // past everything the earlier chunks read.
+    ObjCorner *corners = merged->corners.data() + chunk->cornerBase;
+    copy(data.corners.begin(), data.corners.end(), corners);
+
+    int bases[3] = {(int)chunk->vertexBase,
+                    (int)chunk->texCoordBase,
+                    (int)chunk->normalBase};
+    for (size_t i = 0; i < chunk->fixups.size(); i++) {
+        ObjCorner &corner = corners[chunk->fixups[i] / 3];
+        int field         = chunk->fixups[i] % 3;
+        int *fields[3]    = {&corner.v, &corner.vt, &corner.vn};
+        *fields[field] += bases[field];
+        if (*fields[field] < 0)
+            *fields[field] = BAD_INDEX;
+    }
+
+    ObjFace *faces = merged->faces.data() + chunk->faceBase;
+    for (size_t i = 0; i < data.faces.size(); i++) {
+        ObjFace face = data.faces[i];
+        face.firstCorner += (unsigned int)chunk->cornerBase;
+
+        if (face.material == INHERITED)
+            face.material = chunk->inheritedMaterial;
+        else if (face.material >= 0)
+            face.material = chunk->materialMap[face.material];
+
+        if (face.smooth == INHERITED)
+            face.smooth = chunk->inheritedSmooth;
+
+        faces[i] = face;
+    }
+}
+
+bool parseOBJ(const char *begin, const char *end, ObjData &data,
+              string &error, WorkerPool &pool) {
+    // below this, handing the work out costs more than it saves.
+    static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+    size_t size      = end - begin;
+    size_t numChunks = (size_t)pool.size() * 4;
+    if (numChunks > size / MIN_CHUNK_SIZE)
+        numChunks = size / MIN_CHUNK_SIZE;
+    if (pool.size() < 2 || numChunks < 2)
+        return parseOBJ(begin, end, data, error);
+
+    vector<ObjChunk> chunks(numChunks);
+    const char *chunkBegin = begin;
+    for (size_t i = 0; i < numChunks; i++) {
+        const char *chunkEnd = end;
+        if (i + 1 < numChunks) {
+            chunkEnd = begin + size * (i + 1) / numChunks;
+            if (chunkEnd < chunkBegin)
+                chunkEnd = chunkBegin;
+            const char *nl
+                = (const char *)memchr(chunkEnd, '\n', end - chunkEnd);
+            chunkEnd = nl ? nl + 1 : end;
+        }
+
+        chunks[i].begin         = chunkBegin;
+        chunks[i].end           = chunkEnd;
+        chunks[i].firstMaterial = i == 0 ? -1 : INHERITED;
+        chunks[i].firstSmooth   = i == 0 ? -1 : INHERITED;
+
+        chunkBegin = chunkEnd;
+    }
+
+    vector<function<void()> > jobs;
+    for (size_t i = 0; i < numChunks; i++)
+        jobs.push_back(bind(parseChunk, &chunks[i]));
+    pool.run(jobs);
+
+    // work out where everything goes, and carry the usemtl / s state and
+    // material names across the chunk boundaries in file order.
+    data.clear();
+
+    map<string, int> materialIndices;
+    size_t numVertices = 0, numTexCoords = 0, numNormals = 0;
+    size_t numCorners = 0, numFaces = 0;
+    int currentMaterial = -1, currentSmooth = -1;
+
+    for (size_t i = 0; i < numChunks; i++) {
+        ObjChunk &chunk = chunks[i];
+        if (!chunk.ok) {
+            error = chunk.error;
+            return false;
+        }
+
+        chunk.vertexBase   = numVertices;
+        chunk.texCoordBase = numTexCoords;
+        chunk.normalBase   = numNormals;
+        chunk.cornerBase   = numCorners;
+        chunk.faceBase     = numFaces;
+
+        numVertices += chunk.data.vertices.size() / 3;
+        numTexCoords += chunk.data.vertexTexCoords.size() / 2;
+        numNormals += chunk.data.vertexNormals.size() / 3;
+        numCorners += chunk.data.corners.size();
+        numFaces += chunk.data.faces.size();
+
+        for (size_t m = 0; m < chunk.data.materialNames.size(); m++) {
+            const string &name = chunk.data.materialNames[m];
+
+            map<string, int>::iterator iter = materialIndices.find(name);
+            if (iter == materialIndices.end()) {
+                iter = materialIndices
+                           .insert(pair<string, int>(
+                               name, (int)data.materialNames.size()))
+                           .first;
+                data.materialNames.push_back(name);
+            }
+            chunk.materialMap.push_back(iter->second);
+        }
+
+        chunk.inheritedMaterial = currentMaterial;
+        chunk.inheritedSmooth   = currentSmooth;
+        if (chunk.lastMaterial >= 0)
+            currentMaterial = chunk.materialMap[chunk.lastMaterial];
+        if (chunk.lastSmooth != INHERITED)
+            currentSmooth = chunk.lastSmooth;
+
+        data.materialLibraries.insert(data.materialLibraries.end(),
+                                      chunk.data.materialLibraries.begin(),
+                                      chunk.data.materialLibraries.end());
+        data.ignoredLines.insert(data.ignoredLines.end(),
+                                 chunk.data.ignoredLines.begin(),
+                                 chunk.data.ignoredLines.end());
+
+        data.minX = min(data.minX, chunk.data.minX);
+        data.maxX = max(data.maxX, chunk.data.maxX);
+        data.minY = min(data.minY, chunk.data.minY);
+        data.maxY = max(data.maxY, chunk.data.maxY);
+        data.minZ = min(data.minZ, chunk.data.minZ);
+        data.maxZ = max(data.maxZ, chunk.data.maxZ);
+    }
+
+    data.vertices.resize(numVertices * 3);
+    data.vertexTexCoords.resize(numTexCoords * 2);
+    data.vertexNormals.resize(numNormals * 3);
+    data.corners.resize(numCorners);
+    data.faces.resize(numFaces);
+
+    jobs.clear();
+    for (size_t i = 0; i < numChunks; i++)
+        jobs.push_back(bind(copyChunk, &chunks[i], &data));
+    pool.run(jobs);
+
+    return checkIndices(data, error);
+}
+}
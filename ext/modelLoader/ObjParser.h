@@ -0,0 +1,77 @@
+#ifndef _GOL_OBJ_PARSER_H_
+#define _GOL_OBJ_PARSER_H_ 1
+
+#ifdef __APPLE__
+#include <OpenGL/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "WorkerPool.h"
+
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/* one corner of a face.  indices are 0 based, -1 when not given */
+struct ObjCorner {
+    int v, vt, vn;
+};
+
+/* one polygon, as its run of corners plus the state it was declared in */
+struct ObjFace {
+    unsigned int firstCorner;
+    unsigned int numCorners;
+
+    /* index into ObjData::materialNames, -1 before the first usemtl */
+    int material;
+    /* -1 before the first s line, 0 for "s off", 1 otherwise */
+    int smooth;
+};
+
+/* everything the geometry records of a WaveFront *.obj file describe */
+struct ObjData {
+    vector<GLfloat> vertices;
+    vector<GLfloat> vertexNormals;
+    vector<GLfloat> vertexTexCoords;
+
+    vector<ObjCorner> corners;
+    vector<ObjFace> faces;
+
+    /* every distinct usemtl name, in order of first use */
+    vector<string> materialNames;
+    /* every mtllib line, in file order */
+    vector<string> materialLibraries;
+    /* lines we did not understand, for INFO output */
+    vector<string> ignoredLines;
+
+    float minX, maxX, minY, maxY, minZ, maxZ;
+
+    ObjData();
+    void clear();
+};
+
+/*
+ * Parse the *.obj text in [begin, end) into data.
+ *
+ * The text is tokenized in place; the only allocations are the growth of the
+ * output arrays.  Returns false (with a message in error) on malformed faces
+ * or face indices out of range.
+ */
+bool parseOBJ(const char *begin, const char *end, ObjData &data,
+              string &error);
+
+/*
+ * Same as above, but newline aligned chunks of the file are parsed on pool's
+ * threads and then merged in file order.  Relative face indices and the
+ * usemtl / s state carry across chunk boundaries, so the result is identical
+ * to the single threaded parse.  Small files are parsed single threaded.
+ */
+bool parseOBJ(const char *begin, const char *end, ObjData &data,
+              string &error, WorkerPool &pool);
+}
+
+#endif
@@ -1,3 +1,5 @@
+#include <GL/glew.h>
+
 #ifdef __APPLE__
 #include <OpenGL/glut.h>
 #else
@@ -6,12 +8,33 @@
 
 #include <SOIL/SOIL.h>
 
+#include "CompiledMesh.h"
+#include "GLTaskQueue.h"
+#include "ImageLoader.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshView.h"
+#include "MipmapChain.h"
+#include "MtlParser.h"
 #include "Object.h"
+#include "ObjParser.h"
+#include "PlyParser.h"
 #include "Point.h"
+#include "StlParser.h"
+#include "TextureCache.h"
+#include "TextureRegistry.h"
 #include "Vector.h"
+#include "WorkerPool.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sstream>
 using namespace std;
 
 #include <stdlib.h>
@@ -20,19 +43,27 @@ using namespace std;
 namespace paone {
 
 vector<string> tokenizeString(string input, string delimiters);
-unsigned char *createTransparentTexture(unsigned char *imageData,
-                                        unsigned char *imageMask, int texWidth,
-                                        int texHeight, int texChannels,
-                                        int maskChannels);
-unsigned char *loadPPM(char *filename, int &texWidth, int &texHeight,
-                       int &texChannels, bool &success, bool ERRORS,
-                       string path);
-unsigned char *loadBMP(char *filename, int &texWidth, int &texHeight,
-                       int &texChannels, bool &success, bool ERRORS,
-                       string path);
-unsigned char *loadTGA(char *filename, int &texWidth, int &texHeight,
-                       int &texChannels, bool &success, bool ERRORS,
-                       string path);
+
+bool Object::_parallelParsing = true;
+Object::DrawStats Object::_drawStats;
+
+Object::DrawStats::DrawStats()
+    : drawCalls(0),
+      triangles(0),
+      materialChanges(0),
+      textureBinds(0),
+      enableChanges(0),
+      shadeModelChanges(0) {}
+
+unsigned int Object::DrawStats::stateChanges() const {
+    return materialChanges + textureBinds + enableChanges + shadeModelChanges;
+}
+
+Object::DrawStats Object::drawStats() { return _drawStats; }
+
+void Object::resetDrawStats() { _drawStats = DrawStats(); }
+
+void Object::setParallelParsing(bool parallel) { _parallelParsing = parallel; }
 
 Object::Object() { init(); }
 
@@ -44,9 +75,35 @@ Object::Object(string filename) : _objFile(filename) {
 Object::~Object() {
     delete _materials;
     delete _textureHandles;
+
+    for (size_t i = 0; i < _registeredTextures.size(); i++)
+        TextureRegistry::shared().release(_registeredTextures[i]);
+
+    // the buffers belong to the GL context, so they have to go on its thread.
+    GLuint buffers[2] = {_vertexBuffer, _indexBuffer};
+    if (buffers[0] || buffers[1]) {
+        GLTaskQueue::shared().post([buffers]() {
+            glDeleteBuffers(2, buffers);
+        });
+    }
 }
 
 bool Object::loadObjectFile(string filename, bool INFO, bool ERRORS) {
+    _cacheFile.clear();
+    return loadFile(filename, INFO, ERRORS);
+}
+
+bool Object::loadCachedObjectFile(string filename, string cacheFile, bool INFO,
+                                  bool ERRORS) {
+    _objFile   = filename;
+    _cacheFile = cacheFile;
+    if (filename.find(".obj") != string::npos && loadMeshCache(INFO, ERRORS))
+        return true;
+
+    return loadFile(filename, INFO, ERRORS);
+}
+
+bool Object::loadFile(string filename, bool INFO, bool ERRORS) {
     bool result = true;
     _objFile = filename;
     if (filename.find(".obj") != string::npos) {
@@ -67,244 +124,78 @@ bool Object::loadObjectFile(string filename, bool INFO, bool ERRORS) {
     return result;
 }
 
-bool Object::draw() const {
+bool Object::draw(unsigned int level) const {
     bool result = true;
 
     glPushMatrix();
-    { glCallList(_objectDisplayList); };
+    {
+        // *.obj files are drawn from buffers, everything else from a list.
+        if (_vertexBuffer) {
+            drawMesh(level);
+        } else {
+            glCallList(_objectDisplayList);
+            _drawStats.drawCalls++;
+        }
+    };
     glPopMatrix();
 
     return result;
 }
 
-Point *Object::getLocation() { return _location; }
-
-vector<Face *> *Object::getFaces() {
-    vector<Face *> *faces = new vector<Face *>();
-
-    delete _materials;
-    delete _textureHandles;
-
-    _materials      = new map<string, Material *>();
-    _textureHandles = new map<string, GLuint>();
-
-    Material *materialForFace = NULL;
-    GLuint textureForFace     = 0;
-    bool smoothForFace        = true;
-
-    ifstream in(_objFile.c_str());
-    string line;
-    while (getline(in, line)) {
-        line.erase(line.find_last_not_of(" \n\r\t") + 1);
+unsigned int Object::numLevels() const {
+    return _levels.empty() ? 1 : (unsigned int)_levels.size();
+}
 
-        vector<string> tokens = tokenizeString(line, " ");
-        if (tokens.size() < 1)
-            continue;
+float Object::levelError(unsigned int level) const {
+    return level < _levels.size() ? _levels[level].error : 0.0f;
+}
 
-        // the line should have a single character that lets us know if it's
-        // a...
-        if (!tokens[0].compare("#")) {             // comment ignore
-        } else if (!tokens[0].compare("o")) {      // object name ignore
-        } else if (!tokens[0].compare("g")) {      // polygon group name ignore
-        } else if (!tokens[0].compare("mtllib")) { // material library
-            loadMTLFile();
-        } else if (!tokens[0].compare("usemtl")) { // use material library
-            map<string, Material *>::iterator materialIter
-                = _materials->find(tokens[1]);
-            if (materialIter != _materials->end()) {
-                materialForFace = materialIter->second;
-            } else {
-                materialForFace = NULL;
-            }
+Point *Object::getLocation() { return _location; }
 
-            map<string, GLuint>::iterator textureIter
-                = _textureHandles->find(tokens[1]);
-            if (textureIter != _textureHandles->end()) {
-                textureForFace = textureIter->second;
-            } else {
-                textureForFace = 0;
-            }
-        } else if (!tokens[0].compare("s")) { // smooth shading
-            if (!tokens[1].compare("off")) {
-                smoothForFace = false;
-            } else {
-                smoothForFace = true;
-            }
-        } else if (!tokens[0].compare("v")) {     // vertex
-        } else if (!tokens.at(0).compare("vn")) { // vertex normal
-        } else if (!tokens.at(0).compare("vt")) { // vertex tex coord
-        } else if (!tokens.at(0).compare("f")) {  // face!
-
-            // now, faces can be either quads or triangles (or maybe more?)
-            // split the string on spaces to get the number of verts+attrs.
-            vector<string> faceTokens = tokenizeString(line, " ");
-
-            // some local variables to hold the vertex+attribute indices we read
-            // in.
-            // we do it this way because we'll have to split quads into
-            // triangles ourselves.
-            vector<int> v, vn, vt;
-
-            bool faceHasVertexTexCoords = false, faceHasVertexNormals = false;
-
-            for (long unsigned int i = 1; i < faceTokens.size(); i++) {
-                // need to use both the tokens and number of slashes to
-                // determine what info is there.
-                vector<string> groupTokens = tokenizeString(faceTokens[i], "/");
-                int numSlashes = 0;
-                for (long unsigned int j = 0; j < faceTokens[i].length(); j++) {
-                    if (faceTokens[i][j] == '/')
-                        numSlashes++;
-                }
+const MeshView &Object::getMesh() const { return _meshView; }
 
-                int vert = atoi(groupTokens[0].c_str());
-                if (vert < 0)
-                    vert = (vertices.size() / 3) + vert + 1;
-
-                // regardless, we always get a vertex index.
-                v.push_back(vert - 1);
-
-                // based on combination of number of tokens and slashes, we can
-                // determine what we have.
-                if (groupTokens.size() == 2 && numSlashes == 1) {
-                    int vtI = atoi(groupTokens[1].c_str());
-                    if (vtI < 0)
-                        vtI = (vertexTexCoords.size() / 2) + vtI + 1;
-
-                    vtI--;
-                    vt.push_back(vtI);
-                    objHasVertexTexCoords  = true;
-                    faceHasVertexTexCoords = true;
-                } else if (groupTokens.size() == 2 && numSlashes == 2) {
-                    int vnI = atoi(groupTokens[1].c_str());
-                    if (vnI < 0)
-                        vnI = vertexNormals.size() + vnI + 1;
-
-                    vnI--;
-                    vn.push_back(vnI);
-                    objHasVertexNormals  = true;
-                    faceHasVertexNormals = true;
-                } else if (groupTokens.size() == 3) {
-                    int vtI = atoi(groupTokens[1].c_str());
-                    if (vtI < 0)
-                        vtI = vertexTexCoords.size() + vtI + 1;
-
-                    vtI--;
-                    vt.push_back(vtI);
-                    objHasVertexTexCoords  = true;
-                    faceHasVertexTexCoords = true;
-
-                    int vnI = atoi(groupTokens[2].c_str());
-                    if (vnI < 0)
-                        vnI = vertexNormals.size() + vnI + 1;
-
-                    vnI--;
-                    vn.push_back(vnI);
-                    objHasVertexNormals  = true;
-                    faceHasVertexNormals = true;
-                } else if (groupTokens.size() != 1) {
-                }
-            }
-
-            // now the local variables have been filled up; push them onto our
-            // global
-            // variables appropriately.
+vector<Face *> *Object::getFaces() {
+    vector<Face *> *faces = new vector<Face *>();
+    faces->reserve(_meshView.numTriangles());
 
-            for (long unsigned int i = 1; i < v.size() - 1; i++) {
-                Face *f = new Face();
-                f->setMaterial(materialForFace);
-                f->setTextureHandle(textureForFace);
-                f->setSmooth(smoothForFace);
+    const MeshView &mesh = _meshView;
+    for (size_t t = 0; t < mesh.numTriangles(); t++) {
+        Face *f = new Face();
 
-                if (faceHasVertexNormals) {
-                    f->setPNormal(Vector(vertexNormals.at(vn[0] * 3 + 0),
-                                         vertexNormals.at(vn[0] * 3 + 1),
-                                         vertexNormals.at(vn[0] * 3 + 2)));
-                } else {
-                    Point v1 = Point(vertices.at(v[0] * 3),
-                                     vertices.at(v[0] * 3 + 1),
-                                     vertices.at(v[0] * 3 + 2));
-                    Point v2 = Point(vertices.at(v[i] * 3),
-                                     vertices.at(v[i] * 3 + 1),
-                                     vertices.at(v[i] * 3 + 2));
-                    Point v3 = Point(vertices.at(v[i + 1] * 3),
-                                     vertices.at(v[i + 1] * 3 + 1),
-                                     vertices.at(v[i + 1] * 3 + 2));
-                    Vector normal = cross(v2 - v1, v3 - v1);
-                    normal.normalize();
-
-                    f->setPNormal(normal);
-                }
-                if (faceHasVertexTexCoords) {
-                    f->setPTexCoord(Point(vertexTexCoords.at(vt[0] * 2 + 0),
-                                          vertexTexCoords.at(vt[0] * 2 + 1),
-                                          0.0f));
-                }
-                f->setP(Point(vertices.at(v[0] * 3 + 0),
-                              vertices.at(v[0] * 3 + 1),
-                              vertices.at(v[0] * 3 + 2)));
-
-                if (faceHasVertexNormals) {
-                    f->setQNormal(Vector(vertexNormals.at(vn[i] * 3 + 0),
-                                         vertexNormals.at(vn[i] * 3 + 1),
-                                         vertexNormals.at(vn[i] * 3 + 2)));
-                } else {
-                    Point v1 = Point(vertices.at(v[0] * 3),
-                                     vertices.at(v[0] * 3 + 1),
-                                     vertices.at(v[0] * 3 + 2));
-                    Point v2 = Point(vertices.at(v[i] * 3),
-                                     vertices.at(v[i] * 3 + 1),
-                                     vertices.at(v[i] * 3 + 2));
-                    Point v3 = Point(vertices.at(v[i + 1] * 3),
-                                     vertices.at(v[i + 1] * 3 + 1),
-                                     vertices.at(v[i + 1] * 3 + 2));
-                    Vector normal = cross(v3 - v2, v1 - v2);
-                    normal.normalize();
-
-                    f->setQNormal(normal);
-                }
-                if (faceHasVertexTexCoords) {
-                    f->setQTexCoord(Point(vertexTexCoords.at(vt[i] * 2 + 0),
-                                          vertexTexCoords.at(vt[i] * 2 + 1),
-                                          0.0f));
-                }
-                f->setQ(Point(vertices.at(v[i] * 3 + 0),
-                              vertices.at(v[i] * 3 + 1),
-                              vertices.at(v[i] * 3 + 2)));
-
-                if (faceHasVertexNormals) {
-                    f->setRNormal(Vector(vertexNormals.at(vn[i + 1] * 3 + 0),
-                                         vertexNormals.at(vn[i + 1] * 3 + 1),
-                                         vertexNormals.at(vn[i + 1] * 3 + 2)));
-                } else {
-                    Point v1 = Point(vertices.at(v[0] * 3),
-                                     vertices.at(v[0] * 3 + 1),
-                                     vertices.at(v[0] * 3 + 2));
-                    Point v2 = Point(vertices.at(v[i] * 3),
-                                     vertices.at(v[i] * 3 + 1),
-                                     vertices.at(v[i] * 3 + 2));
-                    Point v3 = Point(vertices.at(v[i + 1] * 3),
-                                     vertices.at(v[i + 1] * 3 + 1),
-                                     vertices.at(v[i + 1] * 3 + 2));
-                    Vector normal = cross(v1 - v3, v2 - v3);
-                    normal.normalize();
-
-                    f->setRNormal(normal);
-                }
-                if (faceHasVertexTexCoords) {
-                    f->setRTexCoord(Point(vertexTexCoords.at(vt[i + 1] * 2 + 0),
-                                          vertexTexCoords.at(vt[i + 1] * 2 + 1),
-                                          0.0f));
-                }
-                f->setR(Point(vertices.at(v[i + 1] * 3 + 0),
-                              vertices.at(v[i + 1] * 3 + 1),
-                              vertices.at(v[i + 1] * 3 + 2)));
+        GLint material = mesh.triangleMaterials[t];
+        if (material >= 0) {
+            f->setMaterial(_batchMaterials[material]);
+            f->setTextureHandle(_batchTextures[material]);
+        }
 
-                faces->push_back(f);
-            }
+        Point points[3], texCoords[3];
+        Vector normals[3];
+        for (int k = 0; k < 3; k++) {
+            GLuint i = mesh.indices[t * 3 + k];
+            points[k]
+                = Point(mesh.positions[i * 3 + 0],
+                        mesh.positions[i * 3 + 1],
+                        mesh.positions[i * 3 + 2]);
+            normals[k]
+                = Vector(mesh.normals[i * 3 + 0],
+                         mesh.normals[i * 3 + 1],
+                         mesh.normals[i * 3 + 2]);
+            texCoords[k] = Point(
+                mesh.texCoords[i * 2 + 0], mesh.texCoords[i * 2 + 1], 0.0f);
         }
+
+        f->setP(points[0]);
+        f->setQ(points[1]);
+        f->setR(points[2]);
+        f->setPNormal(normals[0]);
+        f->setQNormal(normals[1]);
+        f->setRNormal(normals[2]);
+        f->setPTexCoord(texCoords[0]);
+        f->setQTexCoord(texCoords[1]);
+        f->setRTexCoord(texCoords[2]);
+
+        faces->push_back(f);
     }
-    in.close();
 
     return faces;
 }
@@ -312,14 +203,50 @@ vector<Face *> *Object::getFaces() {
 vector<Point *> *Object::getVertices() {
     vector<Point *> *resultantVertices = new vector<Point *>();
 
-    for (unsigned int i = 0; i < vertices.size(); i += 3) {
+    // *.obj files keep only their mesh; everything else has vertices.
+    const GLfloat *positions = vertices.data();
+    size_t numFloats         = vertices.size();
+    if (!_meshView.positions.empty()) {
+        positions = _meshView.positions.data();
+        numFloats = _meshView.positions.size();
+    }
+
+    resultantVertices->reserve(numFloats / 3);
+    for (size_t i = 0; i < numFloats; i += 3) {
         resultantVertices->push_back(
-            new Point(vertices[i + 0], vertices[i + 1], vertices[i + 2]));
+            new Point(positions[i + 0], positions[i + 1], positions[i + 2]));
     }
 
     return resultantVertices;
 }
 
+/*
+ * Point _meshView at arrays, which must stay around as long as it does
+ */
+void Object::setMeshView(const MeshArrays &arrays,
+                         const vector<MtlMaterial> &materials) {
+    if (&materials != &_meshMaterials)
+        _meshMaterials = materials;
+
+    // only the full mesh; simpler levels come after it.
+    GLuint numVertices = arrays.numVertices, numIndices = arrays.numIndices;
+    if (arrays.numLevels) {
+        numVertices = arrays.levels[0].numVertices;
+        numIndices  = arrays.levels[0].numIndices;
+    }
+
+    _meshView.positions = ArrayView<GLfloat>(arrays.positions, numVertices * 3);
+    _meshView.normals   = ArrayView<GLfloat>(arrays.normals, numVertices * 3);
+    _meshView.texCoords = ArrayView<GLfloat>(arrays.texCoords, numVertices * 2);
+    _meshView.colors    = ArrayView<GLfloat>(
+        arrays.colors, arrays.colors ? numVertices * 4 : 0);
+    _meshView.indices = ArrayView<GLuint>(arrays.indices, numIndices);
+    _meshView.triangleMaterials
+        = ArrayView<GLint>(arrays.triangleMaterials, numIndices / 3);
+    _meshView.materials = ArrayView<MtlMaterial>(_meshMaterials.data(),
+                                                 _meshMaterials.size());
+}
+
 void Object::init() {
     objHasVertexTexCoords = false;
     objHasVertexNormals   = false;
@@ -328,6 +255,10 @@ void Object::init() {
 
     _materials      = new map<string, Material *>();
     _textureHandles = new map<string, GLuint>();
+
+    _objectDisplayList = 0;
+    _vertexBuffer = _indexBuffer = 0;
+    _normalOffset = _texCoordOffset = _colorOffset = 0;
 }
 
 /*
@@ -340,11 +271,10 @@ bool Object::loadOBJFile(bool INFO, bool ERRORS) {
         cout << "[.obj]: -=-=-=-=-=-=-=- BEGIN " << _objFile
              << " Info -=-=-=-=-=-=-=- " << endl;
 
-    time_t start, end;
-    time(&start);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-    ifstream in(_objFile.c_str());
-    if (!in.is_open()) {
+    MappedFile in(_objFile);
+    if (!in.isOpen()) {
         if (ERRORS)
             cout << "[.obj]: [ERROR]: Could not open \"" << _objFile << "\""
                  << endl;
@@ -354,333 +284,366 @@ bool Object::loadOBJFile(bool INFO, bool ERRORS) {
         return false;
     }
 
-    int numFaces = 0, numTriangles = 0;
-    float minX = 999999, maxX = -999999, minY = 999999, maxY = -999999,
-          minZ = 999999, maxZ = -999999;
-    string line;
-
-    Material *solidWhiteMaterial = new Material(GOL_MATERIAL_WHITE);
-
-    _objectDisplayList = glGenLists(1);
-
-    glNewList(_objectDisplayList, GL_COMPILE);
-    {
+    ObjData data;
+    string parseError;
+    bool parsedOK = _parallelParsing ? parseOBJ(in.begin(),
+                                                in.end(),
+                                                data,
+                                                parseError,
+                                                WorkerPool::shared())
+                                     : parseOBJ(in.begin(), in.end(), data,
+                                                parseError);
+    if (!parsedOK) {
+        if (ERRORS)
+            fprintf(stderr,
+                    "[.obj]: [ERROR]: %s (%s).\n",
+                    parseError.c_str(),
+                    _objFile.c_str());
+        if (INFO)
+            cout << "[.obj]: -=-=-=-=-=-=-=-  END " << _objFile
+                 << " Info  -=-=-=-=-=-=-=- " << endl;
+        return false;
+    }
 
-        int progressCounter = 0;
+    chrono::steady_clock::time_point parsed = chrono::steady_clock::now();
 
-        while (getline(in, line)) {
-            line.erase(line.find_last_not_of(" \n\r\t") + 1);
+    if (INFO) {
+        for (size_t i = 0; i < data.ignoredLines.size(); i++)
+            cout << "[.obj]: ignoring line: " << data.ignoredLines[i] << endl;
+    }
 
-            vector<string> tokens = tokenizeString(line, " \t");
-            if (tokens.size() < 1)
-                continue;
+    // materials have to exist (and their textures uploaded) before we can
+    // refer to them in the display list.
+    vector<MtlMaterial> materials;
+    _mtlSources.clear();
+    for (size_t i = 0; i < data.materialLibraries.size(); i++) {
+        _mtlFile = data.materialLibraries[i];
+        loadMTLFile(materials, INFO, ERRORS);
+    }
 
-            // the line should have a single character that lets us know if it's
-            // a...
-            if (!tokens[0].compare("#")
-                || tokens[0].find_first_of("#") == 0) { // comment ignore
-            } else if (!tokens[0].compare("o")) {       // object name ignore
-            } else if (!tokens[0].compare("g")) { // polygon group name ignore
-            } else if (!tokens[0].compare("mtllib")) { // material library
-                _mtlFile = tokens[1];
-                loadMTLFile(INFO, ERRORS);
-            } else if (!tokens[0].compare("usemtl")) { // use material library
-                map<string, Material *>::iterator materialIter
-                    = _materials->find(tokens[1]);
-                if (materialIter != _materials->end()) {
-                    setCurrentMaterial(materialIter->second);
-                } else {
-                }
+    // we keep the compiled mesh around for getMesh().
+    _meshCache.close();
+    CompiledMesh &mesh = _mesh;
+    compileMesh(data, materials, mesh);
+
+    MeshOptimizerStats optimized;
+    optimizeMesh(mesh, optimized);
+    buildLevelsOfDetail(mesh);
+
+    vector<Material *> meshMaterials;
+    vector<GLuint> meshTextures;
+    useMaterials(mesh.materials, meshMaterials, meshTextures, INFO, ERRORS);
+
+    GLTaskQueue::shared().run(
+        [&]() { uploadMesh(mesh.arrays(), meshMaterials, meshTextures); });
+    setMeshView(mesh.arrays(), mesh.materials);
+
+    for (size_t f = 0; f < data.faces.size(); f++) {
+        const ObjFace &face = data.faces[f];
+        for (unsigned int i = 0; i < face.numCorners; i++) {
+            const ObjCorner &corner = data.corners[face.firstCorner + i];
+            objHasVertexTexCoords |= corner.vt >= 0;
+            objHasVertexNormals |= corner.vn >= 0;
+        }
+    }
 
-                map<string, GLuint>::iterator textureIter
-                    = _textureHandles->find(tokens[1]);
-                if (textureIter != _textureHandles->end()) {
-                    glEnable(GL_TEXTURE_2D);
-                    glBindTexture(GL_TEXTURE_2D, textureIter->second);
-                } else {
-                    glDisable(GL_TEXTURE_2D);
-                }
-            } else if (!tokens[0].compare("s")) { // smooth shading
-                if (!tokens[1].compare("off")) {
-                    glShadeModel(GL_FLAT);
-                } else {
-                    glShadeModel(GL_SMOOTH);
-                }
-            } else if (!tokens[0].compare("v")) { // vertex
-                float x = atof(tokens[1].c_str()), y = atof(tokens[2].c_str()),
-                      z = atof(tokens[3].c_str());
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double parseSeconds = chrono::duration<double>(parsed - start).count();
+    double seconds      = chrono::duration<double>(end - start).count();
 
-                if (x < minX)
-                    minX = x;
-                if (x > maxX)
-                    maxX = x;
-                if (y < minY)
-                    minY = y;
-                if (y > maxY)
-                    maxY = y;
-                if (z < minZ)
-                    minZ = z;
-                if (z > maxZ)
-                    maxZ = z;
+    if (INFO) {
+        printf("[.obj]: reading in %s...done!  (Time: %.3fs, parsed at "
+               "%.1f MB/s, %s)\n",
+               _objFile.c_str(),
+               seconds,
+               parseSeconds > 0 ? in.size() / parseSeconds / (1024 * 1024)
+                                : 0.0,
+               _parallelParsing ? "parallel" : "single threaded");
+        cout << "[.obj]: Vertices:  \t" << data.vertices.size() / 3
+             << "\tNormals:   \t" << data.vertexNormals.size() / 3
+             << "\tTex Coords:\t" << data.vertexTexCoords.size() / 2 << endl
+             << "[.obj]: Faces:     \t" << mesh.numFaces << "\tTriangles: \t"
+             << mesh.levels[0].numIndices / 3 << endl
+             << "[.obj]: Welded:    \t" << mesh.levels[0].numVertices
+             << " vertices for " << mesh.levels[0].numIndices << " corners"
+             << endl
+             << "[.obj]: ACMR:      \t" << optimized.acmrBefore << " -> "
+             << optimized.acmrAfter << " vertices per triangle" << endl
+             << "[.obj]: Levels:    \t";
+        for (size_t l = 0; l < mesh.levels.size(); l++)
+            cout << (l ? ", " : "") << mesh.levels[l].numIndices / 3 << " ("
+                 << mesh.levels[l].error << ")";
+        cout << " triangles (error)" << endl
+             << "[.obj]: Dimensions:\t(" << (mesh.maxX - mesh.minX) << ", "
+             << (mesh.maxY - mesh.minY) << ", " << (mesh.maxZ - mesh.minZ)
+             << ")" << endl;
+    }
 
-                vertices.push_back(x);
-                vertices.push_back(y);
-                vertices.push_back(z);
-            } else if (!tokens.at(0).compare("vn")) { // vertex normal
-                vertexNormals.push_back(atof(tokens[1].c_str()));
-                vertexNormals.push_back(atof(tokens[2].c_str()));
-                vertexNormals.push_back(atof(tokens[3].c_str()));
-            } else if (!tokens.at(0).compare("vt")) { // vertex tex coord
-                vertexTexCoords.push_back(atof(tokens[1].c_str()));
-                vertexTexCoords.push_back(atof(tokens[2].c_str()));
-            } else if (!tokens.at(0).compare("f")) { // face!
-
-                // now, faces can be either quads or triangles (or maybe more?)
-                // split the string on spaces to get the number of verts+attrs.
-                vector<string> faceTokens = tokenizeString(line, " ");
+    if (!_cacheFile.empty()) {
+        vector<string> sources(1, _objFile);
+        sources.insert(sources.end(), _mtlSources.begin(), _mtlSources.end());
 
-                // some local variables to hold the vertex+attribute indices we
-                // read in.
-                // we do it this way because we'll have to split quads into
-                // triangles ourselves.
-                vector<int> v, vn, vt;
-
-                bool faceHasVertexTexCoords = false,
-                     faceHasVertexNormals   = false;
-
-                for (long unsigned int i = 1; i < faceTokens.size(); i++) {
-                    // need to use both the tokens and number of slashes to
-                    // determine what info is there.
-                    vector<string> groupTokens
-                        = tokenizeString(faceTokens[i], "/");
-                    int numSlashes = 0;
-                    for (long unsigned int j = 0; j < faceTokens[i].length();
-                         j++) {
-                        if (faceTokens[i][j] == '/')
-                            numSlashes++;
-                    }
+        uint64_t sourceHash;
+        if (!MeshCache::hashFiles(sources, sourceHash)
+            || !MeshCache::write(_cacheFile, mesh, sourceHash, _mtlSources)) {
+            if (ERRORS)
+                cerr << "[.obj]: [ERROR]: could not write mesh cache "
+                     << _cacheFile << endl;
+        } else if (INFO) {
+            cout << "[.obj]: wrote mesh cache " << _cacheFile << endl;
+        }
+    }
 
-                    int vert = atoi(groupTokens[0].c_str());
-                    if (vert < 0)
-                        vert = (vertices.size() / 3) + vert + 1;
+    if (INFO)
+        cout << "[.obj]: -=-=-=-=-=-=-=-  END " << _objFile
+             << " Info  -=-=-=-=-=-=-=- " << endl;
 
-                    // regardless, we always get a vertex index.
-                    v.push_back(vert - 1);
-
-                    // based on combination of number of tokens and slashes, we
-                    // can determine what we have.
-                    if (groupTokens.size() == 2 && numSlashes == 1) {
-                        int vtI = atoi(groupTokens[1].c_str());
-                        if (vtI < 0)
-                            vtI = (vertexTexCoords.size() / 2) + vtI + 1;
-
-                        vtI--;
-                        vt.push_back(vtI);
-                        objHasVertexTexCoords  = true;
-                        faceHasVertexTexCoords = true;
-                    } else if (groupTokens.size() == 2 && numSlashes == 2) {
-                        int vnI = atoi(groupTokens[1].c_str());
-                        if (vnI < 0)
-                            vnI = vertexNormals.size() + vnI + 1;
-
-                        vnI--;
-                        vn.push_back(vnI);
-                        objHasVertexNormals  = true;
-                        faceHasVertexNormals = true;
-                    } else if (groupTokens.size() == 3) {
-                        int vtI = atoi(groupTokens[1].c_str());
-                        if (vtI < 0)
-                            vtI = vertexTexCoords.size() + vtI + 1;
-
-                        vtI--;
-                        vt.push_back(vtI);
-                        objHasVertexTexCoords  = true;
-                        faceHasVertexTexCoords = true;
-
-                        int vnI = atoi(groupTokens[2].c_str());
-                        if (vnI < 0)
-                            vnI = vertexNormals.size() + vnI + 1;
-
-                        vnI--;
-                        vn.push_back(vnI);
-                        objHasVertexNormals  = true;
-                        faceHasVertexNormals = true;
-                    } else if (groupTokens.size() != 1) {
-                        if (ERRORS)
-                            fprintf(
-                                stderr,
-                                "[.obj]: [ERROR]: Malformed OBJ file, %s.\n",
-                                _objFile.c_str());
-                        return false;
-                    }
-                }
+    return result;
+}
 
-                // now the local variables have been filled up; push them onto
-                // our global
-                // variables appropriately.
+/*
+ * Load _objFile from the compiled mesh in _cacheFile, if that was built from
+ * the files as they are now
+ */
+bool Object::loadMeshCache(bool INFO, bool ERRORS) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-                glBegin(GL_TRIANGLES);
-                {
-                    for (long unsigned int i = 1; i < v.size() - 1; i++) {
-
-                        if (faceHasVertexNormals) {
-                            glNormal3f(vertexNormals.at(vn[0] * 3),
-                                       vertexNormals.at(vn[0] * 3 + 1),
-                                       vertexNormals.at(vn[0] * 3 + 2));
-                        } else {
-                            Point v1 = Point(vertices.at(v[0] * 3),
-                                             vertices.at(v[0] * 3 + 1),
-                                             vertices.at(v[0] * 3 + 2));
-                            Point v2 = Point(vertices.at(v[i] * 3),
-                                             vertices.at(v[i] * 3 + 1),
-                                             vertices.at(v[i] * 3 + 2));
-                            Point v3 = Point(vertices.at(v[i + 1] * 3),
-                                             vertices.at(v[i + 1] * 3 + 1),
-                                             vertices.at(v[i + 1] * 3 + 2));
-                            Vector normal = cross(v2 - v1, v3 - v1);
-                            normal.normalize();
-                            glNormal3f(
-                                normal.getX(), normal.getY(), normal.getZ());
-                        }
-                        if (faceHasVertexTexCoords)
-                            glTexCoord2f(vertexTexCoords.at(vt[0] * 2),
-                                         vertexTexCoords.at(vt[0] * 2 + 1));
+    // the mapping stays open for getMesh().
+    MeshCache &cache = _meshCache;
+    if (!cache.open(_cacheFile))
+        return false;
 
-                        glVertex3f(vertices.at(v[0] * 3),
-                                   vertices.at(v[0] * 3 + 1),
-                                   vertices.at(v[0] * 3 + 2));
+    vector<string> sources(1, _objFile);
+    vector<string> mtlSources = cache.sources();
+    sources.insert(sources.end(), mtlSources.begin(), mtlSources.end());
 
-                        if (faceHasVertexNormals) {
-                            glNormal3f(vertexNormals.at(vn[i] * 3),
-                                       vertexNormals.at(vn[i] * 3 + 1),
-                                       vertexNormals.at(vn[i] * 3 + 2));
-                        } else {
-                            Point v1 = Point(vertices.at(v[0] * 3),
-                                             vertices.at(v[0] * 3 + 1),
-                                             vertices.at(v[0] * 3 + 2));
-                            Point v2 = Point(vertices.at(v[i] * 3),
-                                             vertices.at(v[i] * 3 + 1),
-                                             vertices.at(v[i] * 3 + 2));
-                            Point v3 = Point(vertices.at(v[i + 1] * 3),
-                                             vertices.at(v[i + 1] * 3 + 1),
-                                             vertices.at(v[i + 1] * 3 + 2));
-                            Vector normal = cross(v3 - v2, v1 - v2);
-                            normal.normalize();
-                            glNormal3f(
-                                normal.getX(), normal.getY(), normal.getZ());
-                        }
-                        if (faceHasVertexTexCoords)
-                            glTexCoord2f(vertexTexCoords.at(vt[i] * 2),
-                                         vertexTexCoords.at(vt[i] * 2 + 1));
-                        glVertex3f(vertices.at(v[i] * 3),
-                                   vertices.at(v[i] * 3 + 1),
-                                   vertices.at(v[i] * 3 + 2));
+    uint64_t sourceHash;
+    if (!MeshCache::hashFiles(sources, sourceHash)
+        || sourceHash != cache.sourceHash()) {
+        if (INFO)
+            cout << "[.obj]: mesh cache " << _cacheFile
+                 << " is out of date, rebuilding it" << endl;
+        cache.close();
+        return false;
+    }
 
-                        if (faceHasVertexNormals) {
-                            glNormal3f(vertexNormals.at(vn[i + 1] * 3),
-                                       vertexNormals.at(vn[i + 1] * 3 + 1),
-                                       vertexNormals.at(vn[i + 1] * 3 + 2));
-                        } else {
-                            Point v1 = Point(vertices.at(v[0] * 3),
-                                             vertices.at(v[0] * 3 + 1),
-                                             vertices.at(v[0] * 3 + 2));
-                            Point v2 = Point(vertices.at(v[i] * 3),
-                                             vertices.at(v[i] * 3 + 1),
-                                             vertices.at(v[i] * 3 + 2));
-                            Point v3 = Point(vertices.at(v[i + 1] * 3),
-                                             vertices.at(v[i + 1] * 3 + 1),
-                                             vertices.at(v[i + 1] * 3 + 2));
-                            Vector normal = cross(v1 - v3, v2 - v3);
-                            normal.normalize();
-                            glNormal3f(
-                                normal.getX(), normal.getY(), normal.getZ());
-                        }
-                        if (faceHasVertexTexCoords)
-                            glTexCoord2f(vertexTexCoords.at(vt[i + 1] * 2),
-                                         vertexTexCoords.at(vt[i + 1] * 2 + 1));
-                        glVertex3f(vertices.at(v[i + 1] * 3),
-                                   vertices.at(v[i + 1] * 3 + 1),
-                                   vertices.at(v[i + 1] * 3 + 2));
+    if (INFO)
+        cout << "[.obj]: -=-=-=-=-=-=-=- BEGIN " << _objFile
+             << " Info -=-=-=-=-=-=-=- " << endl;
 
-                        numTriangles++;
-                    }
-                };
-                glEnd();
+    _mesh.clear();
+    cache.materials(_meshMaterials);
+    _mtlSources = mtlSources;
 
-                numFaces++;
-            } else {
-                if (INFO)
-                    cout << "[.obj]: ignoring line: " << line << endl;
-            }
+    vector<Material *> meshMaterials;
+    vector<GLuint> meshTextures;
+    useMaterials(_meshMaterials, meshMaterials, meshTextures, INFO, ERRORS);
 
-            if (INFO) {
-                progressCounter++;
-                if (progressCounter % 5000 == 0) {
-                    printf("\33[2K\r");
-                    switch (progressCounter) {
-                    case 5000:
-                        printf("[.obj]: reading in %s...\\", _objFile.c_str());
-                        break;
-                    case 10000:
-                        printf("[.obj]: reading in %s...|", _objFile.c_str());
-                        break;
-                    case 15000:
-                        printf("[.obj]: reading in %s.../", _objFile.c_str());
-                        break;
-                    case 20000:
-                        printf("[.obj]: reading in %s...-", _objFile.c_str());
-                        break;
-                    }
-                    fflush(stdout);
-                }
-                if (progressCounter == 20000)
-                    progressCounter = 0;
-            }
-        }
-        in.close();
-        setCurrentMaterial(solidWhiteMaterial);
-        glDisable(GL_TEXTURE_2D);
-    };
-    glEndList();
+    MeshArrays arrays = cache.arrays();
+    GLTaskQueue::shared().run(
+        [&]() { uploadMesh(arrays, meshMaterials, meshTextures); });
+    setMeshView(arrays, _meshMaterials);
 
-    time(&end);
-    double seconds = difftime(end, start);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
 
     if (INFO) {
-        printf("\33[2K\r");
-        printf("[.obj]: reading in %s...done!  (Time: %.1fs)\n",
+        float minX, maxX, minY, maxY, minZ, maxZ;
+        cache.bounds(minX, maxX, minY, maxY, minZ, maxZ);
+
+        printf("[.obj]: reading in %s from %s...done!  (Time: %.3fs)\n",
                _objFile.c_str(),
-               seconds);
-        cout << "[.obj]: Vertices:  \t" << vertices.size() / 3
-             << "\tNormals:   \t" << vertexNormals.size() / 3
-             << "\tTex Coords:\t" << vertexTexCoords.size() / 2 << endl
-             << "[.obj]: Faces:     \t" << numFaces << "\tTriangles: \t"
-             << numTriangles << endl
+               _cacheFile.c_str(),
+               chrono::duration<double>(end - start).count());
+        cout << "[.obj]: Faces:     \t" << cache.numFaces()
+             << "\tTriangles: \t" << getMesh().numTriangles() << endl
              << "[.obj]: Dimensions:\t(" << (maxX - minX) << ", "
              << (maxY - minY) << ", " << (maxZ - minZ) << ")" << endl;
         cout << "[.obj]: -=-=-=-=-=-=-=-  END " << _objFile
              << " Info  -=-=-=-=-=-=-=- " << endl;
     }
 
-    return result;
+    return true;
+}
+
+/*
+ * Upload arrays into our vertex and index buffers, and remember the batches
+ * to draw them with
+ */
+void Object::uploadMesh(const MeshArrays &arrays,
+                        const vector<Material *> &materials,
+                        const vector<GLuint> &textures) {
+    GLsizeiptr positionBytes = arrays.numVertices * 3 * sizeof(GLfloat);
+    GLsizeiptr normalBytes   = arrays.numVertices * 3 * sizeof(GLfloat);
+    GLsizeiptr texCoordBytes = arrays.numVertices * 2 * sizeof(GLfloat);
+    GLsizeiptr colorBytes
+        = arrays.colors ? arrays.numVertices * 4 * sizeof(GLfloat) : 0;
+
+    _normalOffset   = positionBytes;
+    _texCoordOffset = positionBytes + normalBytes;
+    _colorOffset    = colorBytes ? _texCoordOffset + texCoordBytes : 0;
+
+    // one buffer, with each stream one after the other.
+    if (_vertexBuffer == 0)
+        glGenBuffers(1, &_vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 positionBytes + normalBytes + texCoordBytes + colorBytes,
+                 NULL,
+                 GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, arrays.positions);
+    glBufferSubData(GL_ARRAY_BUFFER, _normalOffset, normalBytes, arrays.normals);
+    glBufferSubData(
+        GL_ARRAY_BUFFER, _texCoordOffset, texCoordBytes, arrays.texCoords);
+    if (colorBytes)
+        glBufferSubData(GL_ARRAY_BUFFER, _colorOffset, colorBytes, arrays.colors);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (_indexBuffer == 0)
+        glGenBuffers(1, &_indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 arrays.numIndices * sizeof(GLuint),
+                 arrays.indices,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    _batches.assign(arrays.batches, arrays.batches + arrays.numBatches);
+    _levels.assign(arrays.levels, arrays.levels + arrays.numLevels);
+    _batchMaterials = materials;
+    _batchTextures  = textures;
+}
+
+/*
+ * Draw our vertex buffer, one glDrawElements per batch.  State is only
+ * changed when the next batch needs something different
+ */
+void Object::drawMesh(unsigned int level) const {
+    static Material solidWhiteMaterial(GOL_MATERIAL_WHITE);
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, (const GLvoid *)0);
+    glNormalPointer(GL_FLOAT, 0, (const GLvoid *)_normalOffset);
+    glTexCoordPointer(2, GL_FLOAT, 0, (const GLvoid *)_texCoordOffset);
+
+    // vertex colours stand in for the material's ambient and diffuse, like
+    // a black material with glMaterial per vertex in the display lists did.
+    if (_colorOffset) {
+        static Material blackMaterial(GOL_MATERIAL_BLACK);
+
+        glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_LIGHTING_BIT);
+        setCurrentMaterial(&blackMaterial);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, GL_FLOAT, 0, (const GLvoid *)_colorOffset);
+        glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+        glEnable(GL_COLOR_MATERIAL);
+    }
+
+    // whatever was set before we were called is unknown.
+    Material *currentMaterial = NULL;
+    GLuint currentTexture     = 0;
+    int texturing             = -1;
+    GLint currentSmooth       = -1;
+
+    size_t firstBatch = 0, endBatch = _batches.size();
+    if (!_levels.empty()) {
+        const MeshLevel &drawn
+            = _levels[min(level, (unsigned int)_levels.size() - 1)];
+        firstBatch = drawn.firstBatch;
+        endBatch   = drawn.firstBatch + drawn.numBatches;
+    }
+
+    for (size_t b = firstBatch; b < endBatch; b++) {
+        const MeshBatch &batch = _batches[b];
+
+        // faces before any usemtl keep whatever material the caller set.
+        // they sort first, so nothing of ours has replaced it yet.
+        Material *material = NULL;
+        GLuint texture     = 0;
+        if (batch.material >= 0) { // use material library
+            material = _batchMaterials[batch.material];
+            texture  = _batchTextures[batch.material];
+        }
+
+        if (material && material != currentMaterial) {
+            setCurrentMaterial(material);
+            currentMaterial = material;
+            _drawStats.materialChanges++;
+        }
+
+        if (texture && texturing != 1) {
+            glEnable(GL_TEXTURE_2D);
+            texturing = 1;
+            _drawStats.enableChanges++;
+        } else if (!texture && texturing != 0) {
+            glDisable(GL_TEXTURE_2D);
+            texturing = 0;
+            _drawStats.enableChanges++;
+        }
+        if (texture && texture != currentTexture) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            currentTexture = texture;
+            _drawStats.textureBinds++;
+        }
+
+        if (batch.smooth >= 0 && batch.smooth != currentSmooth) {
+            glShadeModel(batch.smooth ? GL_SMOOTH : GL_FLAT);
+            currentSmooth = batch.smooth;
+            _drawStats.shadeModelChanges++;
+        }
+
+        glDrawElements(GL_TRIANGLES,
+                       batch.numIndices,
+                       GL_UNSIGNED_INT,
+                       (const GLvoid *)(batch.firstIndex * sizeof(GLuint)));
+        _drawStats.drawCalls++;
+        _drawStats.triangles += batch.numIndices / 3;
+    }
+
+    // leave things the way the display lists always did.
+    if (currentMaterial != &solidWhiteMaterial) {
+        setCurrentMaterial(&solidWhiteMaterial);
+        _drawStats.materialChanges++;
+    }
+    if (texturing != 0) {
+        glDisable(GL_TEXTURE_2D);
+        _drawStats.enableChanges++;
+    }
+
+    if (_colorOffset)
+        glPopAttrib();
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glPopClientAttrib();
 }
 
-bool Object::loadMTLFile(bool INFO, bool ERRORS) {
+/*
+ * Read in a WaveFront *.mtl File, adding its materials to materials
+ */
+bool Object::loadMTLFile(vector<MtlMaterial> &materials, bool INFO,
+                         bool ERRORS) {
     bool result = true;
 
     if (INFO)
         cout << "[.mtl]: -*-*-*-*-*-*-*- BEGIN " << _mtlFile
              << " Info -*-*-*-*-*-*-*- " << endl;
 
-    string line;
     string path = _objFile.substr(0, _objFile.find_last_of("/") + 1);
 
-    ifstream in;
-    in.open(_mtlFile.c_str());
-    if (!in.is_open()) {
-        string folderMtlFile = path + _mtlFile;
-        in.open(folderMtlFile.c_str());
-        if (!in.is_open()) {
+    string mtlFile = _mtlFile;
+    MappedFile in(mtlFile);
+    if (!in.isOpen()) {
+        mtlFile = path + _mtlFile;
+        in.open(mtlFile);
+        if (!in.isOpen()) {
             if (ERRORS)
                 cerr << "[.mtl]: [ERROR]: could not open material file: "
                      << _mtlFile << endl;
@@ -690,411 +653,558 @@ bool Object::loadMTLFile(bool INFO, bool ERRORS) {
             return false;
         }
     }
+    _mtlSources.push_back(mtlFile);
 
-    Material *currMaterial;
-    string materialName;
+    size_t numMaterials = materials.size();
+    vector<string> ignoredLines;
+    parseMTL(in.begin(), in.end(), materials, ignoredLines);
+    numMaterials = materials.size() - numMaterials;
 
-    unsigned char *textureData = NULL;
-    unsigned char *maskData    = NULL;
-    unsigned char *fullData;
-    int texWidth, texHeight, textureChannels = 1, maskChannels = 1;
-    GLuint textureHandle = 0;
+    if (INFO) {
+        for (size_t i = 0; i < ignoredLines.size(); i++)
+            cout << "[.mtl]: ignoring line: " << ignoredLines[i] << endl;
+        cout << "[.mtl]: Materials:\t" << numMaterials << endl;
+        cout << "[.mtl]: -*-*-*-*-*-*-*-  END " << _mtlFile
+             << " Info  -*-*-*-*-*-*-*- " << endl;
+    }
 
-    map<string, GLuint> imageHandles;
+    return result;
+}
 
-    int numMaterials = 0;
+/*
+ * Decode an image file the way the *.mtl loader always has: our own BMP, PPM
+ * and TGA readers first, then SOIL, then SOIL again relative to path.  The
+ * returned pixels must be free()d
+ */
+static unsigned char *loadImage(const string &filename, const string &path,
+                                int &texWidth, int &texHeight,
+                                int &texChannels, bool ERRORS) {
+    unsigned char *imageData = NULL;
+    bool success             = false;
+
+    if (filename.find(".bmp") != string::npos
+        || filename.find(".BMP") != string::npos) {
+        imageData = loadBMP((char *)filename.c_str(),
+                            texWidth,
+                            texHeight,
+                            texChannels,
+                            success,
+                            ERRORS,
+                            path);
+    } else if (filename.find(".ppm") != string::npos
+               || filename.find(".PPM") != string::npos) {
+        imageData = loadPPM((char *)filename.c_str(),
+                            texWidth,
+                            texHeight,
+                            texChannels,
+                            success,
+                            ERRORS,
+                            path);
+    } else if (filename.find(".tga") != string::npos
+               || filename.find(".TGA") != string::npos) {
+        imageData = loadTGA((char *)filename.c_str(),
+                            texWidth,
+                            texHeight,
+                            texChannels,
+                            success,
+                            ERRORS,
+                            path);
+    }
 
-    while (getline(in, line)) {
-        line.erase(line.find_last_not_of(" \n\r\t") + 1);
+    if (!success) {
+        imageData = SOIL_load_image(filename.c_str(),
+                                    &texWidth,
+                                    &texHeight,
+                                    &texChannels,
+                                    SOIL_LOAD_AUTO);
+        if (!imageData) {
+            string folderName = path + filename;
+            imageData         = SOIL_load_image(folderName.c_str(),
+                                        &texWidth,
+                                        &texHeight,
+                                        &texChannels,
+                                        SOIL_LOAD_AUTO);
+        }
+    }
 
-        vector<string> tokens = tokenizeString(line, " /");
-        if (tokens.size() < 1)
-            continue;
+    return imageData;
+}
 
-        // the line should have a single character that lets us know if it's
-        // a...
-        if (!tokens[0].compare("#")) {             // comment
-        } else if (!tokens[0].compare("newmtl")) { // new material
-            currMaterial = new Material();
-            materialName = tokens[1];
-            _materials->insert(
-                pair<string, Material *>(materialName, currMaterial));
-
-            textureHandle   = 0;
-            textureData     = NULL;
-            maskData        = NULL;
-            textureChannels = 1;
-            maskChannels    = 1;
-
-            numMaterials++;
-        } else if (!tokens[0].compare("Ka")) { // ambient component
-            GLfloat ambient[4];
-            ambient[0] = atof(tokens[1].c_str());
-            ambient[1] = atof(tokens[2].c_str());
-            ambient[2] = atof(tokens[3].c_str());
-            ambient[3] = 1;
-            currMaterial->setAmbient(ambient);
-        } else if (!tokens[0].compare("Kd")) { // diffuse component
-            GLfloat diffuse[4];
-            diffuse[0] = atof(tokens[1].c_str());
-            diffuse[1] = atof(tokens[2].c_str());
-            diffuse[2] = atof(tokens[3].c_str());
-            diffuse[3] = 1;
-            currMaterial->setDiffuse(diffuse);
-        } else if (!tokens[0].compare("Ks")) { // specular component
-            GLfloat specular[4];
-            specular[0] = atof(tokens[1].c_str());
-            specular[1] = atof(tokens[2].c_str());
-            specular[2] = atof(tokens[3].c_str());
-            specular[3] = 1;
-            currMaterial->setSpecular(specular);
-        } else if (!tokens[0].compare("Ke")) { // emissive component
-            GLfloat emissive[4];
-            emissive[0] = atof(tokens[1].c_str());
-            emissive[1] = atof(tokens[2].c_str());
-            emissive[2] = atof(tokens[3].c_str());
-            currMaterial->setEmissive(emissive);
-        } else if (!tokens[0].compare("Ns")) { // shininess component
-            currMaterial->setShininess(atof(tokens[1].c_str()));
-        } else if (!tokens[0].compare("Tr")
-                   || !tokens[0].compare("d")) { // transparency component - Tr
-                                                 // or d can be used depending
-                                                 // on the format
-            currMaterial->getAmbient()[3] = atof(tokens[1].c_str());
-            currMaterial->getDiffuse()[3] = atof(tokens[1].c_str());
-            currMaterial->getSpecular()[3] = atof(tokens[1].c_str());
-        } else if (!tokens[0].compare("illum")) { // illumination type component
-            currMaterial->setIllumination(atoi(tokens[1].c_str()));
-        } else if (!tokens[0].compare("map_Kd")) { // diffuse color texture map
-            if (imageHandles.find(tokens[1]) != imageHandles.end()) {
-                _textureHandles->insert(pair<string, GLuint>(
-                    materialName, imageHandles.find(tokens[1])->second));
-            } else {
-                if (tokens[1].find(".bmp") != string::npos
-                    || tokens[1].find(".BMP") != string::npos) {
-                    bool success = false;
-                    textureData  = loadBMP((char *)tokens[1].c_str(),
-                                          texWidth,
-                                          texHeight,
-                                          textureChannels,
-                                          success,
-                                          ERRORS,
-                                          path);
-                    if (!success) {
-                        textureData = SOIL_load_image(tokens[1].c_str(),
-                                                      &texWidth,
-                                                      &texHeight,
-                                                      &textureChannels,
-                                                      SOIL_LOAD_AUTO);
-                        if (!textureData) {
-                            string folderName = path + tokens[1];
-                            textureData       = SOIL_load_image(folderName.c_str(),
-                                                          &texWidth,
-                                                          &texHeight,
-                                                          &textureChannels,
-                                                          SOIL_LOAD_AUTO);
-                        }
-                    } else {
-                    }
-                } else if (tokens[1].find(".ppm") != string::npos
-                           || tokens[1].find(".PPM") != string::npos) {
-                    bool success = false;
-                    textureData  = loadPPM((char *)tokens[1].c_str(),
-                                          texWidth,
-                                          texHeight,
-                                          textureChannels,
-                                          success,
-                                          ERRORS,
-                                          path);
-                    if (!success) {
-                        textureData = SOIL_load_image(tokens[1].c_str(),
-                                                      &texWidth,
-                                                      &texHeight,
-                                                      &textureChannels,
-                                                      SOIL_LOAD_AUTO);
-                        if (!textureData) {
-                            string folderName = path + tokens[1];
-                            textureData       = SOIL_load_image(folderName.c_str(),
-                                                          &texWidth,
-                                                          &texHeight,
-                                                          &textureChannels,
-                                                          SOIL_LOAD_AUTO);
-                        }
-                    } else {
-                    }
-                } /*else if( tokens[1].find( ".tga" ) != string::npos || tokens[1].find( ".TGA" ) != string::npos ) {
-						bool success = false;
-						textureData = loadTGA( (char*)tokens[1].c_str(), texWidth, texHeight, textureChannels, success, ERRORS, path );
-						if( !success ) {
-							textureData = SOIL_load_image( tokens[1].c_str(), &texWidth, &texHeight, &textureChannels, SOIL_LOAD_AUTO );
-							if( !textureData ) {
-								string folderName = path + tokens[1];
-								textureData = SOIL_load_image( folderName.c_str(), &texWidth, &texHeight, &textureChannels, SOIL_LOAD_AUTO );
-							}
-						}
-					}*/ else {
-                    textureData = SOIL_load_image(tokens[1].c_str(),
-                                                  &texWidth,
-                                                  &texHeight,
-                                                  &textureChannels,
-                                                  SOIL_LOAD_AUTO);
-                    if (!textureData) {
-                        string folderName = path + tokens[1];
-                        textureData       = SOIL_load_image(folderName.c_str(),
-                                                      &texWidth,
-                                                      &texHeight,
-                                                      &textureChannels,
-                                                      SOIL_LOAD_AUTO);
-                    }
-                }
+/*
+ * One distinct diffuse (and alpha) image pair from a *.mtl file, decoded (and
+ * combined) into pixels ready for glTexImage with their mipmaps, or found in
+ * its TextureCache.
+ * Decoding happens on a worker, so anything worth printing is saved up in log
+ * for the GL thread.
+ */
+struct DecodedImage {
+    string diffuseMap;
+    string alphaMap;
+    /* the files themselves, as TextureCache hashes them */
+    vector<string> sources;
+    /* what TextureRegistry knows this pair by */
+    string key;
+
+    /* free()d once uploaded.  NULL if the diffuse map would not load, or if
+     * it was cached */
+    unsigned char *pixels;
+    int width, height;
+    GLenum format;
+    uint64_t contentHash;
+    /* every level below pixels */
+    MipmapChain mipmaps;
+
+    /* false if the sources couldn't be hashed, so can't be cached */
+    bool hashed;
+    uint64_t sourceHash;
+    /* deleted once uploaded.  NULL unless a cache was up to date */
+    TextureCache *cache;
+
+    string log;
+    double decodeSeconds;
+    double mipmapSeconds;
+
+    DecodedImage() : pixels(NULL), width(0), height(0), format(GL_RGB),
+                     contentHash(0), hashed(false), sourceHash(0), cache(NULL),
+                     decodeSeconds(0), mipmapSeconds(0) {}
+};
+
+/* TextureRegistry variant for *.mtl textures; well clear of SOIL's flags */
+static const unsigned int MTL_TEXTURE_VARIANT = 0x80000000u;
 
-                if (!textureData) {
-                    cout << "[.mtl]: [ERROR]: File Not Found: " << tokens[1]
-                         << endl;
-                } else {
-                    if (INFO)
-                        cout << "[.mtl]: TextureMap:\t" << tokens[1]
-                             << "\tSize: " << texWidth << "x" << texHeight
-                             << "\tColors: " << textureChannels << endl;
-
-                    if (maskData == NULL) {
-                        if (textureHandle == 0)
-                            glGenTextures(1, &textureHandle);
-
-                        glBindTexture(GL_TEXTURE_2D, textureHandle);
-
-                        glTexEnvf(
-                            GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-
-                        glTexParameterf(GL_TEXTURE_2D,
-                                        GL_TEXTURE_MIN_FILTER,
-                                        GL_LINEAR_MIPMAP_LINEAR);
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-                        GLenum colorSpace = GL_RGB;
-                        if (textureChannels == 4)
-                            colorSpace = GL_RGBA;
-                        gluBuild2DMipmaps(GL_TEXTURE_2D,
-                                          colorSpace,
-                                          texWidth,
-                                          texHeight,
-                                          colorSpace,
-                                          GL_UNSIGNED_BYTE,
-                                          textureData);
-
-                        _textureHandles->insert(
-                            pair<string, GLuint>(materialName, textureHandle));
-                        imageHandles.insert(
-                            pair<string, GLuint>(tokens[1], textureHandle));
-                    } else {
-                        fullData = createTransparentTexture(textureData,
-                                                            maskData,
-                                                            texWidth,
-                                                            texHeight,
-                                                            textureChannels,
-                                                            maskChannels);
-
-                        if (textureHandle == 0)
-                            glGenTextures(1, &textureHandle);
-
-                        glBindTexture(GL_TEXTURE_2D, textureHandle);
-
-                        glTexEnvf(
-                            GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-
-                        glTexParameterf(GL_TEXTURE_2D,
-                                        GL_TEXTURE_MIN_FILTER,
-                                        GL_LINEAR_MIPMAP_LINEAR);
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-                        gluBuild2DMipmaps(GL_TEXTURE_2D,
-                                          GL_RGBA,
-                                          texWidth,
-                                          texHeight,
-                                          GL_RGBA,
-                                          GL_UNSIGNED_BYTE,
-                                          fullData);
-
-                        delete fullData;
-
-                        _textureHandles->insert(
-                            pair<string, GLuint>(materialName, textureHandle));
-                    }
-                }
-            }
-        } else if (!tokens[0].compare("map_d")) { // alpha texture map
-            if (imageHandles.find(tokens[1]) != imageHandles.end()) {
-                _textureHandles->insert(pair<string, GLuint>(
-                    materialName, imageHandles.find(tokens[1])->second));
-            } else {
-                if (tokens[1].find(".bmp") != string::npos
-                    || tokens[1].find(".BMP") != string::npos) {
-                    bool success = false;
-                    maskData     = loadBMP((char *)tokens[1].c_str(),
-                                       texWidth,
-                                       texHeight,
-                                       maskChannels,
-                                       success,
-                                       ERRORS,
-                                       path);
-                    if (!success) {
-                        maskData = SOIL_load_image(tokens[1].c_str(),
-                                                   &texWidth,
-                                                   &texHeight,
-                                                   &maskChannels,
-                                                   SOIL_LOAD_AUTO);
-                        if (!maskData) {
-                            string folderName = path + tokens[1];
-                            maskData          = SOIL_load_image(folderName.c_str(),
-                                                       &texWidth,
-                                                       &texHeight,
-                                                       &maskChannels,
-                                                       SOIL_LOAD_AUTO);
-                        }
-                    } else {
-                    }
-                } else if (tokens[1].find(".ppm") != string::npos
-                           || tokens[1].find(".PPM") != string::npos) {
-                    bool success = false;
-                    maskData     = loadPPM((char *)tokens[1].c_str(),
-                                       texWidth,
-                                       texHeight,
-                                       maskChannels,
-                                       success,
-                                       ERRORS,
-                                       path);
-                    if (!success) {
-                        maskData = SOIL_load_image(tokens[1].c_str(),
-                                                   &texWidth,
-                                                   &texHeight,
-                                                   &maskChannels,
-                                                   SOIL_LOAD_AUTO);
-                        if (!maskData) {
-                            string folderName = path + tokens[1];
-                            maskData          = SOIL_load_image(folderName.c_str(),
-                                                       &texWidth,
-                                                       &texHeight,
-                                                       &maskChannels,
-                                                       SOIL_LOAD_AUTO);
-                        }
-                    } else {
-                    }
-                } else {
-                    maskData = SOIL_load_image(tokens[1].c_str(),
-                                               &texWidth,
-                                               &texHeight,
-                                               &maskChannels,
-                                               SOIL_LOAD_AUTO);
-                    if (!maskData) {
-                        string folderName = path + tokens[1];
-                        maskData          = SOIL_load_image(folderName.c_str(),
-                                                   &texWidth,
-                                                   &texHeight,
-                                                   &maskChannels,
-                                                   SOIL_LOAD_AUTO);
-                    }
-                }
+/*
+ * Decoded images waiting for the GL thread, handed over by index in the order
+ * they finish
+ */
+class DecodedImageQueue {
+public:
+    /* notifies under the lock: once the last image is popped the queue
+     * goes out of scope, and must not be touched after */
+    void push(size_t image) {
+        unique_lock<mutex> lock(_lock);
+        _done.push_back(image);
+        _ready.notify_one();
+    }
 
-                if (!maskData) {
-                    cout << "[.mtl]: [ERROR]: File Not Found: " << tokens[1]
-                         << endl;
-                } else {
-                    if (INFO)
-                        cout << "[.mtl]: AlphaMap:  \t" << tokens[1]
-                             << "\tSize: " << texWidth << "x" << texHeight
-                             << "\tColors: " << maskChannels << endl;
-
-                    if (textureData != NULL) {
-                        fullData = createTransparentTexture(textureData,
-                                                            maskData,
-                                                            texWidth,
-                                                            texHeight,
-                                                            textureChannels,
-                                                            maskChannels);
-
-                        if (INFO)
-                            cout << "[.mtl]: " << tokens[1]
-                                 << " alpha texture map of size " << texWidth
-                                 << "x" << texHeight << " with "
-                                 << textureChannels << " colors read in"
-                                 << endl;
+    size_t pop() {
+        unique_lock<mutex> lock(_lock);
+        while (_done.empty())
+            _ready.wait(lock);
+        size_t image = _done.front();
+        _done.pop_front();
+        return image;
+    }
 
-                        if (textureHandle == 0)
-                            glGenTextures(1, &textureHandle);
+private:
+    mutex _lock;
+    condition_variable _ready;
+    deque<size_t> _done;
+};
+
+static void decodeImage(DecodedImage &image, const string &path,
+                        bool parallel, bool INFO, bool ERRORS) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ostringstream log;
+
+    // the mipmaps made last time can go straight back up.
+    image.hashed = MeshCache::hashFiles(image.sources, image.sourceHash);
+    if (image.hashed) {
+        image.cache = new TextureCache();
+        if (image.cache->open(TextureCache::cacheFile(image.sources,
+                                                      MTL_TEXTURE_VARIANT),
+                              image.sourceHash,
+                              MTL_TEXTURE_VARIANT)) {
+            image.width       = image.cache->width();
+            image.height      = image.cache->height();
+            image.format      = image.cache->channels() == 4 ? GL_RGBA : GL_RGB;
+            image.contentHash = image.cache->contentHash();
+            if (INFO)
+                log << "[.mtl]: TextureMap:\t" << image.diffuseMap
+                    << "\tSize: " << image.width << "x" << image.height
+                    << "\tColors: " << image.cache->channels()
+                    << "\t(cached)" << endl;
+            image.log = log.str();
+            image.decodeSeconds
+                = chrono::duration<double>(chrono::steady_clock::now() - start)
+                      .count();
+            return;
+        }
+        delete image.cache;
+        image.cache = NULL;
+    }
 
-                        glBindTexture(GL_TEXTURE_2D, textureHandle);
+    int texWidth, texHeight, textureChannels = 1;
+    unsigned char *textureData = loadImage(image.diffuseMap,
+                                           path,
+                                           texWidth,
+                                           texHeight,
+                                           textureChannels,
+                                           ERRORS);
+    if (!textureData) {
+        if (ERRORS)
+            log << "[.mtl]: [ERROR]: File Not Found: " << image.diffuseMap
+                << endl;
+        image.log = log.str();
+        return;
+    }
+    if (INFO)
+        log << "[.mtl]: TextureMap:\t" << image.diffuseMap
+            << "\tSize: " << texWidth << "x" << texHeight
+            << "\tColors: " << textureChannels << endl;
+
+    unsigned char *maskData = NULL;
+    int maskWidth, maskHeight, maskChannels = 1;
+    if (!image.alphaMap.empty()) {
+        maskData = loadImage(image.alphaMap,
+                             path,
+                             maskWidth,
+                             maskHeight,
+                             maskChannels,
+                             ERRORS);
+        if (!maskData) {
+            if (ERRORS)
+                log << "[.mtl]: [ERROR]: File Not Found: " << image.alphaMap
+                    << endl;
+        } else if (maskWidth != texWidth || maskHeight != texHeight) {
+            if (ERRORS)
+                log << "[.mtl]: [ERROR]: " << image.alphaMap
+                    << " is not the same size as " << image.diffuseMap
+                    << endl;
+            free(maskData);
+            maskData = NULL;
+        } else if (INFO) {
+            log << "[.mtl]: AlphaMap:  \t" << image.alphaMap
+                << "\tSize: " << maskWidth << "x" << maskHeight
+                << "\tColors: " << maskChannels << endl;
+        }
+    }
 
-                        glTexEnvf(
-                            GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    image.width  = texWidth;
+    image.height = texHeight;
+    if (maskData == NULL) {
+        image.pixels = textureData;
+        image.format = (textureChannels == 4) ? GL_RGBA : GL_RGB;
+    } else {
+        image.pixels = createTransparentTexture(textureData,
+                                                maskData,
+                                                texWidth,
+                                                texHeight,
+                                                textureChannels,
+                                                maskChannels);
+        image.format = GL_RGBA;
+        free(maskData);
+        free(textureData);
+    }
+    image.contentHash = TextureRegistry::hashPixels(image.pixels,
+                                                    image.width,
+                                                    image.height,
+                                                    image.format == GL_RGBA
+                                                        ? 4
+                                                        : 3);
+
+    image.log = log.str();
+    chrono::steady_clock::time_point decoded = chrono::steady_clock::now();
+    image.decodeSeconds = chrono::duration<double>(decoded - start).count();
+
+    image.mipmaps.build(image.pixels,
+                        image.width,
+                        image.height,
+                        image.format == GL_RGBA ? 4 : 3,
+                        MipmapChain::SRGB,
+                        parallel);
+    image.mipmapSeconds
+        = chrono::duration<double>(chrono::steady_clock::now() - decoded)
+              .count();
+}
 
-                        glTexParameterf(GL_TEXTURE_2D,
-                                        GL_TEXTURE_MIN_FILTER,
-                                        GL_LINEAR_MIPMAP_LINEAR);
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+/* filename the way loadImage() will find it: as given, or under path */
+static string resolveImage(const string &filename, const string &path) {
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL)
+        return path + filename;
+    fclose(fp);
+    return filename;
+}
 
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                        glTexParameterf(
-                            GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+static GLuint uploadImage(const DecodedImage &image) {
+    GLuint textureHandle;
+    glGenTextures(1, &textureHandle);
+    glBindTexture(GL_TEXTURE_2D, textureHandle);
 
-                        gluBuild2DMipmaps(GL_TEXTURE_2D,
-                                          GL_RGBA,
-                                          texWidth,
-                                          texHeight,
-                                          GL_RGBA,
-                                          GL_UNSIGNED_BYTE,
-                                          fullData);
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
-                        delete fullData;
-                    }
-                }
-            }
-        } else if (!tokens[0].compare("map_Ka")) { // ambient color texture map
+    glTexParameterf(
+        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    image.mipmaps.upload(image.pixels, image.format);
 
-        } else if (!tokens[0].compare("map_Ks")) { // specular color texture map
+    return textureHandle;
+}
 
-        } else if (!tokens[0].compare(
-                       "map_Ns")) { // specular highlight map (shininess map)
+/*
+ * Create each material, and upload its texture (if it has one).  The results
+ * are also returned in the same order as materials.
+ *
+ * Images some other model already loaded come from TextureRegistry::shared().
+ * The rest are decoded on WorkerPool::shared() while this thread uploads each
+ * one as soon as it is ready, through GLTaskQueue::shared() if this isn't the
+ * GL thread
+ */
+void Object::useMaterials(const vector<MtlMaterial> &materials,
+                          vector<Material *> &materialObjects,
+                          vector<GLuint> &textureHandles, bool INFO,
+                          bool ERRORS) {
+    string path = _objFile.substr(0, _objFile.find_last_of("/") + 1);
 
-        } else if (!tokens[0].compare(
-                       "Ni")) { // optical density / index of refraction
+    materialObjects.assign(materials.size(), (Material *)NULL);
+    textureHandles.assign(materials.size(), 0);
 
-        } else if (!tokens[0].compare("Tf")) { // transmission filter
+    // materials sharing the same images share the texture, too.
+    map<string, size_t> imageIndices;
+    vector<DecodedImage> images;
+    vector<size_t> materialImages(materials.size(), (size_t)-1);
 
-        } else if (!tokens[0].compare("bump")
-                   || !tokens[0].compare("map_bump")) { // bump map
+    for (size_t i = 0; i < materials.size(); i++) {
+        const MtlMaterial &mtl = materials[i];
 
+        Material *currMaterial = new Material(mtl.material);
+        _materials->insert(pair<string, Material *>(mtl.name, currMaterial));
+        materialObjects[i] = currMaterial;
+
+        if (mtl.diffuseMap.empty())
+            continue;
+
+        string imageKey = mtl.diffuseMap + "\n" + mtl.alphaMap;
+        map<string, size_t>::iterator imageIter = imageIndices.find(imageKey);
+        if (imageIter == imageIndices.end()) {
+            imageIter = imageIndices
+                            .insert(pair<string, size_t>(imageKey,
+                                                         images.size()))
+                            .first;
+            images.push_back(DecodedImage());
+            images.back().diffuseMap = mtl.diffuseMap;
+            images.back().alphaMap   = mtl.alphaMap;
+            DecodedImage &image = images.back();
+            image.sources.push_back(TextureRegistry::canonicalPath(
+                resolveImage(mtl.diffuseMap, path)));
+            if (!mtl.alphaMap.empty())
+                image.sources.push_back(TextureRegistry::canonicalPath(
+                    resolveImage(mtl.alphaMap, path)));
+
+            image.key = "mtl " + image.sources[0];
+            if (image.sources.size() > 1)
+                image.key += "\n" + image.sources[1];
+        }
+        materialImages[i] = imageIter->second;
+    }
+
+    if (images.empty())
+        return;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // anything some other model already loaded needn't be decoded again.
+    vector<GLuint> imageHandles(images.size(), 0);
+    size_t numDecoding = 0, numShared = 0;
+    GLTaskQueue::shared().run([&]() {
+        for (size_t i = 0; i < images.size(); i++) {
+            imageHandles[i] = TextureRegistry::shared().acquire(images[i].key);
+            if (imageHandles[i]) {
+                _registeredTextures.push_back(imageHandles[i]);
+                numShared++;
+            }
+        }
+    });
+
+    DecodedImageQueue decoded;
+    for (size_t i = 0; i < images.size(); i++) {
+        if (imageHandles[i])
+            continue;
+        numDecoding++;
+
+        DecodedImage *image = &images[i];
+        if (_parallelParsing) {
+            WorkerPool::shared().enqueue(
+                [image, i, &path, &decoded, INFO, ERRORS]() {
+                    decodeImage(*image, path, true, INFO, ERRORS);
+                    decoded.push(i);
+                });
         } else {
-            if (INFO)
-                cout << "[.mtl]: ignoring line: " << line << endl;
+            decodeImage(*image, path, false, INFO, ERRORS);
+            decoded.push(i);
         }
     }
 
-    in.close();
+    double decodeSeconds = 0, mipmapSeconds = 0, uploadSeconds = 0;
+    size_t numCached = 0;
+    for (size_t n = 0; n < numDecoding; n++) {
+        size_t i            = decoded.pop();
+        DecodedImage &image = images[i];
+
+        cout << image.log;
+        decodeSeconds += image.decodeSeconds;
+        mipmapSeconds += image.mipmapSeconds;
+        if (!image.pixels && !image.cache)
+            continue;
+        if (image.cache)
+            numCached++;
+
+        chrono::steady_clock::time_point uploadStart
+            = chrono::steady_clock::now();
+        GLTaskQueue::shared().run([&]() {
+            int channels = image.format == GL_RGBA ? 4 : 3;
+            if (image.cache) {
+                imageHandles[i] = TextureRegistry::shared().acquire(
+                    image.key,
+                    image.contentHash,
+                    image.width,
+                    image.height,
+                    channels,
+                    MTL_TEXTURE_VARIANT,
+                    [&image]() { return image.cache->upload(); });
+                return;
+            }
+
+            imageHandles[i] = TextureRegistry::shared().acquire(
+                image.key,
+                image.contentHash,
+                image.width,
+                image.height,
+                channels,
+                MTL_TEXTURE_VARIANT,
+                [&image]() { return uploadImage(image); });
+            if (imageHandles[i] && image.hashed)
+                TextureCache::write(TextureCache::cacheFile(
+                                        image.sources, MTL_TEXTURE_VARIANT),
+                                    imageHandles[i],
+                                    image.sourceHash,
+                                    MTL_TEXTURE_VARIANT,
+                                    image.contentHash,
+                                    image.width,
+                                    image.height,
+                                    channels);
+        });
+        if (imageHandles[i])
+            _registeredTextures.push_back(imageHandles[i]);
+        uploadSeconds += chrono::duration<double>(chrono::steady_clock::now()
+                                                  - uploadStart)
+                             .count();
+
+        free(image.pixels);
+        image.pixels = NULL;
+        image.mipmaps.clear();
+        delete image.cache;
+        image.cache = NULL;
+    }
+
+    for (size_t i = 0; i < materials.size(); i++) {
+        if (materialImages[i] == (size_t)-1 || !imageHandles[materialImages[i]])
+            continue;
+        textureHandles[i] = imageHandles[materialImages[i]];
+        _textureHandles->insert(
+            pair<string, GLuint>(materials[i].name, textureHandles[i]));
+    }
 
     if (INFO) {
-        cout << "[.mtl]: Materials:\t" << numMaterials << endl;
-        cout << "[.mtl]: -*-*-*-*-*-*-*-  END " << _mtlFile
-             << " Info  -*-*-*-*-*-*-*- " << endl;
+        double seconds = chrono::duration<double>(chrono::steady_clock::now()
+                                                  - start)
+                             .count();
+        printf("[.mtl]: %u images in %.3fs (%u already loaded, %u cached, "
+               "decode: %.3fs, mipmaps: %.3fs %s, upload: %.3fs)\n",
+               (unsigned int)images.size(),
+               seconds,
+               (unsigned int)numShared,
+               (unsigned int)numCached,
+               decodeSeconds,
+               mipmapSeconds,
+               _parallelParsing ? "across workers" : "single threaded",
+               uploadSeconds);
     }
+}
 
-    return result;
+/*
+ * Read the binary *.ply (when plyHeader is given) or *.stl file mapped as in
+ * into _mesh, and upload it
+ */
+bool Object::loadBinaryMeshFile(const MappedFile &in,
+                                const PlyHeader *plyHeader, const char *tag,
+                                bool INFO, bool ERRORS) {
+    if (INFO)
+        cout << tag << ": -=-=-=-=-=-=-=- BEGIN " << _objFile
+             << " Info -=-=-=-=-=-=-=- " << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    _meshCache.close();
+    _meshMaterials.clear();
+
+    string error;
+    bool readOK = plyHeader ? readBinaryPLY(*plyHeader, in.end(), _mesh, error)
+                            : readBinarySTL(in.begin(), in.end(), _mesh, error);
+    if (!readOK) {
+        if (ERRORS)
+            cout << tag << ": [ERROR]: " << _objFile << ": " << error << endl;
+        if (INFO)
+            cout << tag << ": -=-=-=-=-=-=-=-  END " << _objFile
+                 << " Info  -=-=-=-=-=-=-=- " << endl;
+        _mesh.clear();
+        return false;
+    }
+
+    chrono::steady_clock::time_point read = chrono::steady_clock::now();
+
+    // only shared vertices have anything to gain.
+    MeshOptimizerStats optimized;
+    optimized.acmrBefore = optimized.acmrAfter = 3.0f;
+    if (_mesh.positions.size() / 3 < _mesh.indices.size())
+        optimizeMesh(_mesh, optimized);
+
+    GLTaskQueue::shared().run([&]() {
+        uploadMesh(_mesh.arrays(), vector<Material *>(), vector<GLuint>());
+    });
+    setMeshView(_mesh.arrays(), _mesh.materials);
+
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double readSeconds = chrono::duration<double>(read - start).count();
+    double seconds     = chrono::duration<double>(end - start).count();
+
+    if (INFO) {
+        printf("%s: reading in %s...done!  (Time: %.3fs, binary, read at "
+               "%.1f MB/s)\n",
+               tag,
+               _objFile.c_str(),
+               seconds,
+               readSeconds > 0 ? in.size() / readSeconds / (1024 * 1024)
+                               : 0.0);
+        cout << tag << ": Vertices:  \t" << _mesh.positions.size() / 3
+             << "\tColors:    \t" << _mesh.colors.size() / 4 << endl
+             << tag << ": Faces:     \t" << _mesh.numFaces
+             << "\tTriangles: \t" << _mesh.indices.size() / 3 << endl
+             << tag << ": ACMR:      \t" << optimized.acmrBefore << " -> "
+             << optimized.acmrAfter << " vertices per triangle" << endl
+             << tag << ": Dimensions:\t(" << (_mesh.maxX - _mesh.minX)
+             << ", " << (_mesh.maxY - _mesh.minY) << ", "
+             << (_mesh.maxZ - _mesh.minZ) << ")" << endl;
+        cout << tag << ": -=-=-=-=-=-=-=-  END " << _objFile
+             << " Info  -=-=-=-=-=-=-=- " << endl;
+    }
+
+    return true;
 }
 
 bool Object::loadOFFFile(bool INFO, bool ERRORS) {
+    // the display list is compiled as the file is read.
+    if (!GLTaskQueue::shared().onGLThread()) {
+        bool result;
+        GLTaskQueue::shared().run(
+            [&]() { result = loadOFFFile(INFO, ERRORS); });
+        return result;
+    }
+
     bool result = true;
 
     if (INFO)
@@ -1393,6 +1503,24 @@ bool Object::loadOFFFile(bool INFO, bool ERRORS) {
 }
 
 bool Object::loadPLYFile(bool INFO, bool ERRORS) {
+    // binary files are read straight out of a mapping instead.
+    {
+        MappedFile in(_objFile);
+        PlyHeader header;
+        string error;
+        if (in.isOpen() && parsePLYHeader(in.begin(), in.end(), header, error)
+            && header.format != PlyHeader::ASCII)
+            return loadBinaryMeshFile(in, &header, "[.ply]", INFO, ERRORS);
+    }
+
+    // text files compile a display list as they're read.
+    if (!GLTaskQueue::shared().onGLThread()) {
+        bool result;
+        GLTaskQueue::shared().run(
+            [&]() { result = loadPLYFile(INFO, ERRORS); });
+        return result;
+    }
+
     bool result = true;
 
     if (INFO)
@@ -1719,6 +1847,21 @@ bool Object::loadPLYFile(bool INFO, bool ERRORS) {
 }
 
 bool Object::loadSTLFile(bool INFO, bool ERRORS) {
+    // binary files are read straight out of a mapping instead.
+    {
+        MappedFile in(_objFile);
+        if (in.isOpen() && isBinarySTL(in.begin(), in.end()))
+            return loadBinaryMeshFile(in, NULL, "[.stl]", INFO, ERRORS);
+    }
+
+    // text files compile a display list as they're read.
+    if (!GLTaskQueue::shared().onGLThread()) {
+        bool result;
+        GLTaskQueue::shared().run(
+            [&]() { result = loadSTLFile(INFO, ERRORS); });
+        return result;
+    }
+
     bool result = true;
 
     if (INFO)
@@ -1914,447 +2057,4 @@ vector<string> tokenizeString(string input, string delimiters) {
     return retVec;
 }
 
-unsigned char *createTransparentTexture(unsigned char *imageData,
-                                        unsigned char *imageMask, int texWidth,
-                                        int texHeight, int texChannels,
-                                        int maskChannels) {
-    // combine the 'mask' array with the image data array into an RGBA array.
-    unsigned char *fullData = new unsigned char[texWidth * texHeight * 4];
-
-    for (int j = 0; j < texHeight; j++) {
-        for (int i = 0; i < texWidth; i++) {
-            if (imageData) {
-                fullData[(j * texWidth + i) * 4 + 0]
-                    = imageData[(j * texWidth + i) * texChannels + 0]; // R
-                fullData[(j * texWidth + i) * 4 + 1]
-                    = imageData[(j * texWidth + i) * texChannels + 1]; // G
-                fullData[(j * texWidth + i) * 4 + 2]
-                    = imageData[(j * texWidth + i) * texChannels + 2]; // B
-            } else {
-                fullData[(j * texWidth + i) * 4 + 0] = 1; // R
-                fullData[(j * texWidth + i) * 4 + 1] = 1; // G
-                fullData[(j * texWidth + i) * 4 + 2] = 1; // B
-            }
-
-            if (imageMask) {
-                fullData[(j * texWidth + i) * 4 + 3]
-                    = imageMask[(j * texWidth + i) * maskChannels + 0]; // A
-            } else {
-                fullData[(j * texWidth + i) * 4 + 3] = 1; // A
-            }
-        }
-    }
-    return fullData;
-}
-
-unsigned char *loadPPM(char *filename, int &texWidth, int &texHeight,
-                       int &texChannels, bool &success, bool ERRORS,
-                       string path) {
-    FILE *fp;
-
-    // make sure the file is there.
-    if ((fp = fopen(filename, "rb")) == NULL) {
-        string folderName = path + filename;
-        if ((fp = fopen(folderName.c_str(), "rb")) == NULL) {
-            if (ERRORS)
-                printf("[.ppm]: [ERROR]: File Not Found: %s\n", filename);
-            return 0;
-        }
-    }
-
-    unsigned char *imageData;
-
-    int temp, maxValue;
-    fscanf(fp, "P%d", &temp);
-    if (temp != 3) {
-        if (ERRORS)
-            fprintf(stderr,
-                    "[.ppm]: [ERROR]: PPM file is not of correct format! (Must "
-                    "be P3, is P%d.)\n",
-                    temp);
-        fclose(fp);
-        return 0;
-    }
-
-    // got the file header right...
-    fscanf(fp, "%d", &texWidth);
-    fscanf(fp, "%d", &texHeight);
-    fscanf(fp, "%d", &maxValue);
-
-    // now that we know how big it is, allocate the buffer...
-    imageData = new unsigned char[texWidth * texHeight * 3];
-    if (!imageData) {
-        if (ERRORS)
-            fprintf(stderr,
-                    "[.ppm]: [ERROR]: couldn't allocate image memory. "
-                    "Dimensions: %d x %d.\n",
-                    texWidth,
-                    texHeight);
-        fclose(fp);
-        return 0;
-    }
-
-    // and read the data in.
-    for (int j = 0; j < texHeight; j++) {
-        for (int i = 0; i < texWidth; i++) {
-            // read the data into integers (4 bytes) before casting them to
-            // unsigned characters
-            // and storing them in the unsigned char array.
-            int r, g, b;
-            fscanf(fp, "%d", &r);
-            fscanf(fp, "%d", &g);
-            fscanf(fp, "%d", &b);
-
-            imageData[(j * texWidth + i) * 3 + 0] = (unsigned char)r;
-            imageData[(j * texWidth + i) * 3 + 1] = (unsigned char)g;
-            imageData[(j * texWidth + i) * 3 + 2] = (unsigned char)b;
-        }
-    }
-
-    fclose(fp);
-
-    texChannels = 3;
-    success     = true;
-    return imageData;
-}
-
-unsigned char *loadBMP(char *filename, int &texWidth, int &texHeight,
-                       int &texChannels, bool &success, bool ERRORS,
-                       string path) {
-    FILE *file;
-    unsigned long size;        // size of the image in bytes.
-    size_t i;                  // standard counter.
-    unsigned short int planes; // number of planes in image (must be 1)
-    unsigned short int bpp;    // number of bits per pixel (must be 24)
-    char temp;                 // used to convert bgr to rgb color.
-    unsigned char *data;
-
-    // make sure the file is there.
-    if ((file = fopen(filename, "rb")) == NULL) {
-        string folderName = path + filename;
-        if ((file = fopen(folderName.c_str(), "rb")) == NULL) {
-            if (ERRORS)
-                printf("[.bmp]: [ERROR]: File Not Found: %s\n", filename);
-            return 0;
-        }
-    }
-
-    // seek through the bmp header, up to the width/height:
-    fseek(file, 18, SEEK_CUR);
-
-    // read the width
-    if ((i = fread(&texWidth, 4, 1, file)) != 1) {
-        if (ERRORS)
-            printf("[.bmp]: [ERROR]: reading width from %s.\n", filename);
-        return 0;
-    }
-    // printf("Width of %s: %lu\n", filename, image->sizeX);
-
-    // read the height
-    if ((i = fread(&texHeight, 4, 1, file)) != 1) {
-        if (ERRORS)
-            printf("[.bmp]: [ERROR]: reading height from %s.\n", filename);
-        return 0;
-    }
-    // printf("Height of %s: %lu\n", filename, image->sizeY);
-
-    // calculate the size (assuming 24 bits or 3 bytes per pixel).
-    size = texWidth * texHeight * 3;
-
-    // read the planes
-    if ((fread(&planes, 2, 1, file)) != 1) {
-        if (ERRORS)
-            printf("[.bmp]: [ERROR]: reading planes from %s.\n", filename);
-        return 0;
-    }
-    if (planes != 1) {
-        if (ERRORS)
-            printf("[.bmp]: [ERROR]: Planes from %s is not 1: %u\n",
-                   filename,
-                   planes);
-        return 0;
-    }
-
-    // read the bpp
-    if ((i = fread(&bpp, 2, 1, file)) != 1) {
-        if (ERRORS)
-            printf("[.bmp]: [ERROR]: reading bpp from %s.\n", filename);
-        return 0;
-    }
-    if (bpp != 24) {
-        if (ERRORS)
-            printf(
-                "[.bmp]: [ERROR]: Bpp from %s is not 24: %u\n", filename, bpp);
-        return 0;
-    }
-
-    // seek past the rest of the bitmap header.
-    fseek(file, 24, SEEK_CUR);
-
-    // read the data.
-    data = (unsigned char *)malloc(size);
-    if (data == NULL) {
-        if (ERRORS)
-            printf("[.bmp]: [ERROR]: allocating memory for color-corrected "
-                   "image data");
-        return 0;
-    }
-
-    if ((i = fread(data, size, 1, file)) != 1) {
-        if (ERRORS)
-            printf("[.bmp]: [ERROR]: reading image data from %s.\n", filename);
-        return 0;
-    }
-
-    for (i = 0; i < size; i += 3) { // reverse all of the colors. (bgr -> rgb)
-        temp        = data[i];
-        data[i]     = data[i + 2];
-        data[i + 2] = temp;
-    }
-
-    texChannels = 3;
-    success     = true;
-    return data;
-}
-
-//
-//  bool loadTGA(string filename, int &imageWidth, int &imageHeight, unsigned
-//  char* &imageData)
-//
-//  This function reads RGB (or RGBA) data from the Targa image file specified
-//  by filename.
-//  It does not handle color-mapped images -- only RGB/RGBA images, although it
-//  correctly supports
-//      both run-length encoding (RLE) for compression and image origins at the
-//      top- or bottom-left.
-//
-//  This function fills in imageWidth and imageHeight with the corresponding
-//  height and width of
-//      the image that it reads in from disk, and allocates imageData
-//      appropriately. It also sets
-//      wasRGBA to true if the data contained an alpha channel and false if it
-//      did not. If the function
-//      completes successfully and wasRGBA is true, then imageData is a pointer
-//      to valid image data
-//      that is (imageWidth*imageHeight*4) bytes in size; if wasRBGA is false,
-//      it is (imageWidth*imageHeight*3)
-//      bytes large.
-//
-//  If the function fails for any reason, the error message will be sent to
-//  stderr, the function will
-//      return false, and imageData will be set to NULL (and deallocated, if the
-//      error occurred post-allocation).
-//
-//  The TGA file format, including the data layout with RLE, is based on a spec
-//  found at:
-//      http://www.dca.fee.unicamp.br/~martino/disciplinas/ea978/tgaffs.pdf
-//
-unsigned char *loadTGA(char *filename, int &texWidth, int &texHeight,
-                       int &texChannels, bool &success, bool ERRORS,
-                       string path) {
-    unsigned char *imageData;
-
-    FILE *fp;
-    // make sure the file is there.
-    if ((fp = fopen(filename, "rb")) == NULL) {
-        string folderName = path + filename;
-        if ((fp = fopen(folderName.c_str(), "rb")) == NULL) {
-            if (ERRORS)
-                printf("[.tga]: [ERROR]: File Not Found: %s\n", filename);
-            return 0;
-        }
-    }
-
-    // bunch of data fields in the file header that we read in en masse
-    unsigned char idLength, colorMapType, imageType;
-    unsigned short idxOfFirstColorMapEntry, countOfColorMapEntries;
-    unsigned char numBitsPerColorMapEntry;
-    unsigned short xCoordOfLowerLeft, yCoordOfLowerLeft;
-    unsigned short width, height;
-    unsigned char bytesPerPixel;
-    unsigned char imageAttributeFlags;
-
-    fread(&idLength, sizeof(unsigned char), 1, fp);
-    fread(&colorMapType, sizeof(unsigned char), 1, fp);
-    fread(&imageType, sizeof(unsigned char), 1, fp);
-    fread(&idxOfFirstColorMapEntry, sizeof(unsigned short), 1, fp);
-    fread(&countOfColorMapEntries, sizeof(unsigned short), 1, fp);
-    fread(&numBitsPerColorMapEntry, sizeof(unsigned char), 1, fp);
-    fread(&xCoordOfLowerLeft, sizeof(unsigned short), 1, fp);
-    fread(&yCoordOfLowerLeft, sizeof(unsigned short), 1, fp);
-    fread(&width, sizeof(unsigned short), 1, fp);
-    fread(&height, sizeof(unsigned short), 1, fp);
-    fread(&bytesPerPixel, sizeof(unsigned char), 1, fp);
-    fread(&imageAttributeFlags, sizeof(unsigned char), 1, fp);
-
-    // now check to make sure that we actually have the capability to read this
-    // file.
-    if (colorMapType != 0) {
-        fprintf(stderr,
-                "[.tga]: Error: TGA file (%s) uses colormap instead of "
-                "RGB/RGBA data; this is unsupported.\n",
-                filename);
-        imageData = NULL;
-        return 0;
-    }
-
-    if (imageType != 2 && imageType != 10) {
-        fprintf(stderr,
-                "[.tga]: Error: unspecified TGA type: %d. Only supports 2 "
-                "(uncompressed RGB/A) and 10 (RLE, RGB/A).\n",
-                imageType);
-        imageData = NULL;
-        return 0;
-    }
-
-    if (bytesPerPixel != 24 && bytesPerPixel != 32) {
-        fprintf(stderr,
-                "[.tga]: Error: unsupported image depth (%d bits per pixel). "
-                "Only supports 24bpp and 32bpp.\n",
-                bytesPerPixel);
-        imageData = NULL;
-        return 0;
-    }
-
-    // set some helpful variables based on the header information:
-    bool usingRLE
-        = (imageType
-           == 10); // whether the file uses run-length encoding (compression)
-    bool wasRGBA = (bytesPerPixel
-                    == 32); // whether the file is RGB or RGBA (RGBA = 32bpp)
-    bool topLeft
-        = (imageAttributeFlags
-           & 32); // whether the origin is at the top-left or bottom-left
-
-    if (wasRGBA) {
-        texChannels = 4;
-    } else {
-        texChannels = 3;
-    }
-
-    // this should never happen, since we should never have a color map,
-    // but just in case the data is setting around in there anyway... skip it.
-    if (idLength != 0) {
-        fseek(fp, idLength, SEEK_CUR);
-    }
-
-    // allocate our image data before we get started.
-    int imageWidth  = texWidth;
-    int imageHeight = texHeight;
-    imageData       = new unsigned char[imageWidth * imageHeight * (wasRGBA ? 4 : 3)];
-
-    // ok so we can assume at this point that there's no colormap, and
-    // consequently that the next part of the image is the actual image data.
-    if (usingRLE) {
-        // ok... the data comes in in packets, but we don't know how many of
-        // these there'll be.
-        int numberOfPixelsRead = 0;
-        unsigned char dummy;
-        while (numberOfPixelsRead < imageWidth * imageHeight) {
-            // alright let's read the packet header.
-            fread(&dummy, sizeof(unsigned char), 1, fp);
-            bool isRLEPacket = (dummy & 0x80);
-
-            unsigned char theOtherBitsYesThatWasAPun = (dummy & 0x7F);
-            if (isRLEPacket) {
-                // the other bits (+1) gives the number of times we need to
-                // repeat the next real set of color values (RGB/A).
-                unsigned char repeatedR, repeatedG, repeatedB, repeatedA;
-                fread(&repeatedR, sizeof(unsigned char), 1, fp);
-                fread(&repeatedG, sizeof(unsigned char), 1, fp);
-                fread(&repeatedB, sizeof(unsigned char), 1, fp);
-                if (wasRGBA)
-                    fread(&repeatedA, sizeof(unsigned char), 1, fp);
-
-                // and go ahead and copy those into the new image. repetitively.
-                for (int i = 0; i < ((int)theOtherBitsYesThatWasAPun + 1);
-                     i++) {
-                    int idx            = numberOfPixelsRead * (wasRGBA ? 4 : 3);
-                    imageData[idx + 2] = repeatedR;
-                    imageData[idx + 1] = repeatedG;
-                    imageData[idx + 0] = repeatedB;
-                    if (wasRGBA)
-                        imageData[idx + 3] = repeatedA;
-
-                    numberOfPixelsRead++;
-                }
-            } else {
-                // the other bits (+1) gives the number of consecutive
-                // pixels we get to read in from the stream willy nilly.
-                for (int i = 0; i < ((int)theOtherBitsYesThatWasAPun + 1);
-                     i++) {
-                    int idx = numberOfPixelsRead * (wasRGBA ? 4 : 3);
-                    fread(&imageData[idx + 2], sizeof(unsigned char), 1, fp);
-                    fread(&imageData[idx + 1], sizeof(unsigned char), 1, fp);
-                    fread(&imageData[idx + 0], sizeof(unsigned char), 1, fp);
-                    if (wasRGBA)
-                        fread(
-                            &imageData[idx + 3], sizeof(unsigned char), 1, fp);
-
-                    numberOfPixelsRead++;
-                }
-            }
-        }
-
-
-        // and you know what? we're not going to have worried about flipping the
-        // image before
-        // if its origin was in the bottom left or top left or whatever. flip it
-        // afterwards here if need be.
-        if (!topLeft) {
-            unsigned char *tempCopy = new unsigned char[imageWidth * imageHeight
-                                                        * (wasRGBA ? 4 : 3)];
-            for (int i = 0; i < imageHeight; i++) {
-                for (int j = 0; j < imageWidth; j++) {
-                    int copyIdx = (i * imageWidth + j) * (wasRGBA ? 4 : 3);
-                    int pullIdx = ((imageHeight - i - 1) * imageWidth + j)
-                                  * (wasRGBA ? 4 : 3);
-                    tempCopy[copyIdx + 0] = imageData[pullIdx + 0];
-                    tempCopy[copyIdx + 1] = imageData[pullIdx + 1];
-                    tempCopy[copyIdx + 2] = imageData[pullIdx + 2];
-                    if (wasRGBA)
-                        tempCopy[copyIdx + 3] = imageData[pullIdx + 3];
-                }
-            }
-
-            delete imageData;
-            imageData = tempCopy;
-        }
-
-    } else {
-
-        // uh well if we're not using run-length encoding, i guess we'll
-        // just try reading bytes in straight like a normal binary file.
-        unsigned char byte1, byte2, byte3, maybeEvenByte4;
-        for (int i = 0; i < imageHeight; i++) {
-            for (int j = 0; j < imageWidth; j++) {
-                int multiplierThing = wasRGBA ? 4 : 3;
-
-                // read in the data from file...
-                fread(&byte1, sizeof(unsigned char), 1, fp);
-                fread(&byte2, sizeof(unsigned char), 1, fp);
-                fread(&byte3, sizeof(unsigned char), 1, fp);
-                if (wasRGBA)
-                    fread(&maybeEvenByte4, sizeof(unsigned char), 1, fp);
-
-                // flip the vertical index if the origin is in the bottom-left.
-                int wutHeight = topLeft ? i : (imageHeight - 1 - i);
-                int idx       = (wutHeight * imageWidth + j) * multiplierThing;
-
-                // and load that image into file. seems to be BGR instead of
-                // RGB...
-                imageData[idx + 2] = byte1;
-                imageData[idx + 1] = byte2;
-                imageData[idx + 0] = byte3;
-                if (wasRGBA)
-                    imageData[idx + 3] = maybeEvenByte4;
-            }
-        }
-    }
-
-    fclose(fp);
-    success = true;
-    return imageData;
-}
-
 }
@@ -1,8 +1,13 @@
 #ifndef _OPENGL_OBJECT_H_
 #define _OPENGL_OBJECT_H_
 
+#include "CompiledMesh.h"
 #include "Face.h"
 #include "Material.h"
+#include "MeshCache.h"
+#include "MeshView.h"
+#include "MtlParser.h"
+#include "PlyParser.h"
 #include "Point.h"
 
 #include <map>
@@ -20,28 +25,114 @@ public:
     ~Object();
 
     bool loadObjectFile(string filename, bool INFO = true, bool ERRORS = true);
+    /* load filename through the compiled mesh in cacheFile.  the cache is
+     * used if it was built from the files as they are now, and is (re)built
+     * otherwise.  only *.obj files are cached */
+    bool loadCachedObjectFile(string filename, string cacheFile,
+                              bool INFO = true, bool ERRORS = true);
 
-    bool draw() const;
+    /* draw level of detail level (see numLevels()); 0 is the full model */
+    bool draw(unsigned int level = 0) const;
+
+    /* *.obj files get simpler versions of themselves for drawing far away.
+     * 1 if there's only the full model */
+    unsigned int numLevels() const;
+    /* how far (in model units) level may stray from the full model */
+    float levelError(unsigned int level) const;
 
     Point *getLocation();
 
+    /* the loaded triangles as flat arrays.  built once at load time, so
+     * this is free.  only *.obj files have one */
+    const MeshView &getMesh() const;
+
+    /* the same triangles, copied out one new Face at a time.  the caller
+     * owns (and must delete) the vector and everything in it */
     vector<Face *> *getFaces();
+    /* likewise, one new Point per vertex */
     vector<Point *> *getVertices();
 
+    /* what draw() has asked of OpenGL, across every Object */
+    struct DrawStats {
+        unsigned int drawCalls;
+        /* drawn from buffers; display lists aren't counted */
+        unsigned int triangles;
+        unsigned int materialChanges;
+        unsigned int textureBinds;
+        /* GL_TEXTURE_2D turned on or off */
+        unsigned int enableChanges;
+        unsigned int shadeModelChanges;
+
+        DrawStats();
+        unsigned int stateChanges() const;
+    };
+
+    /* the counts since the last resetDrawStats(), e.g. once per frame */
+    static DrawStats drawStats();
+    static void resetDrawStats();
+
+    /* parse *.obj files and decode their textures across
+     * WorkerPool::shared() (the default) or on the calling thread only */
+    static void setParallelParsing(bool parallel);
+
 private:
     string _objFile;
     string _mtlFile;
+    string _cacheFile;
+    /* every *.mtl file actually read for _objFile */
+    vector<string> _mtlSources;
     GLuint _objectDisplayList;
 
+    /* *.obj files (and binary *.ply and *.stl): positions, normals, tex
+     * coords and any colours, one after the other.  _colorOffset is 0 when
+     * there are no colours */
+    GLuint _vertexBuffer;
+    GLintptr _normalOffset, _texCoordOffset, _colorOffset;
+    GLuint _indexBuffer;
+    vector<MeshBatch> _batches;
+    /* runs of _batches, simplest last.  empty if there's only the one */
+    vector<MeshLevel> _levels;
+    /* what each batch's material index refers to */
+    vector<Material *> _batchMaterials;
+    vector<GLuint> _batchTextures;
+
+    /* our references into TextureRegistry::shared(), released with us */
+    vector<GLuint> _registeredTextures;
+
+    /* what getMesh() looks at: either _mesh or the mapped _meshCache */
+    CompiledMesh _mesh;
+    MeshCache _meshCache;
+    vector<MtlMaterial> _meshMaterials;
+    MeshView _meshView;
+
     bool objHasVertexTexCoords;
     bool objHasVertexNormals;
 
     void init();
 
+    bool loadFile(string filename, bool INFO, bool ERRORS);
+
     /* read in a WaveFront *.obj file */
     bool loadOBJFile(bool INFO = false, bool ERRORS = false);
     /* read in a WaveFront *.mtl file */
-    bool loadMTLFile(bool INFO = false, bool ERRORS = false);
+    bool loadMTLFile(vector<MtlMaterial> &materials, bool INFO = false,
+                     bool ERRORS = false);
+    /* create materials and their textures */
+    void useMaterials(const vector<MtlMaterial> &materials,
+                      vector<Material *> &materialObjects,
+                      vector<GLuint> &textureHandles, bool INFO, bool ERRORS);
+
+    /* read _objFile back out of _cacheFile */
+    bool loadMeshCache(bool INFO = false, bool ERRORS = false);
+    /* point _meshView at arrays */
+    void setMeshView(const MeshArrays &arrays,
+                     const vector<MtlMaterial> &materials);
+
+    /* put arrays into our vertex and index buffers */
+    void uploadMesh(const MeshArrays &arrays,
+                    const vector<Material *> &materials,
+                    const vector<GLuint> &textures);
+    void drawMesh(unsigned int level) const;
 
     /* read in a GEOMVIEW *.off file */
     bool loadOFFFile(bool INFO = false, bool ERRORS = false);
@@ -52,6 +143,10 @@ private:
     /* read in a STL *.stl file */
     bool loadSTLFile(bool INFO = false, bool ERRORS = false);
 
+    /* read in a binary *.ply or *.stl file, already mapped */
+    bool loadBinaryMeshFile(const MappedFile &in, const PlyHeader *plyHeader,
+                            const char *tag, bool INFO, bool ERRORS);
+
     vector<GLfloat> vertices;
     vector<GLfloat> vertexNormals;
     vector<GLfloat> vertexTexCoords;
@@ -61,6 +156,9 @@ private:
     map<string, GLuint> *_textureHandles;
 
     Point *_location;
+
+    static bool _parallelParsing;
+    static DrawStats _drawStats;
 };
 }
 
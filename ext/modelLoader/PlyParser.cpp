@@ -0,0 +1,502 @@
+#include "PlyParser.h"
+#include "TextScanner.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace paone {
+
+/* the binary types a property can have, by every name they go by */
+struct PlyType {
+    const char *name;
+    int size;
+    bool isFloat, isSigned;
+};
+
+static const PlyType PLY_TYPES[] = {
+    {"char", 1, false, true},     {"int8", 1, false, true},
+    {"uchar", 1, false, false},   {"uint8", 1, false, false},
+    {"short", 2, false, true},    {"int16", 2, false, true},
+    {"ushort", 2, false, false},  {"uint16", 2, false, false},
+    {"int", 4, false, true},      {"int32", 4, false, true},
+    {"uint", 4, false, false},    {"uint32", 4, false, false},
+    {"float", 4, true, true},     {"float32", 4, true, true},
+    {"double", 8, true, true},    {"float64", 8, true, true}};
+
+static const PlyType *findType(const char *tokBegin, const char *tokEnd) {
+    for (size_t i = 0; i < sizeof(PLY_TYPES) / sizeof(PlyType); i++) {
+        if (TextScanner::equals(tokBegin, tokEnd, PLY_TYPES[i].name))
+            return &PLY_TYPES[i];
+    }
+    return NULL;
+}
+
+bool parsePLYHeader(const char *begin, const char *end, PlyHeader &header,
+                    string &error) {
+    header.format = PlyHeader::ASCII;
+    header.elements.clear();
+    header.data = NULL;
+
+    TextScanner in(begin, end);
+    const char *tokBegin, *tokEnd;
+
+    if (!in.token(tokBegin, tokEnd)
+        || !TextScanner::equals(tokBegin, tokEnd, "ply")) {
+        error = "not a ply file";
+        return false;
+    }
+    in.nextLine();
+
+    while (!in.atEnd()) {
+        if (!in.token(tokBegin, tokEnd)) {
+            in.nextLine();
+            continue;
+        }
+
+        if (TextScanner::equals(tokBegin, tokEnd, "format")) {
+            in.token(tokBegin, tokEnd);
+            if (TextScanner::equals(tokBegin, tokEnd, "ascii")) {
+                header.format = PlyHeader::ASCII;
+            } else if (TextScanner::equals(
+                           tokBegin, tokEnd, "binary_little_endian")) {
+                header.format = PlyHeader::BINARY_LITTLE_ENDIAN;
+            } else if (TextScanner::equals(
+                           tokBegin, tokEnd, "binary_big_endian")) {
+                header.format = PlyHeader::BINARY_BIG_ENDIAN;
+            } else {
+                error = "unknown format " + string(tokBegin, tokEnd);
+                return false;
+            }
+        } else if (TextScanner::equals(tokBegin, tokEnd, "element")) {
+            PlyElement element;
+            in.token(tokBegin, tokEnd);
+            element.name  = string(tokBegin, tokEnd);
+            element.count = (size_t)in.readInt();
+            header.elements.push_back(element);
+        } else if (TextScanner::equals(tokBegin, tokEnd, "property")) {
+            if (header.elements.empty()) {
+                error = "property before any element";
+                return false;
+            }
+
+            PlyProperty property;
+            property.countSize = 0;
+
+            in.token(tokBegin, tokEnd);
+            if (TextScanner::equals(tokBegin, tokEnd, "list")) {
+                in.token(tokBegin, tokEnd);
+                const PlyType *countType = findType(tokBegin, tokEnd);
+                if (!countType || countType->isFloat) {
+                    error = "bad list count type " + string(tokBegin, tokEnd);
+                    return false;
+                }
+                property.countSize = countType->size;
+                in.token(tokBegin, tokEnd);
+            }
+
+            const PlyType *type = findType(tokBegin, tokEnd);
+            if (!type) {
+                error = "unknown property type " + string(tokBegin, tokEnd);
+                return false;
+            }
+            property.valueSize = type->size;
+            property.isFloat   = type->isFloat;
+            property.isSigned  = type->isSigned;
+
+            in.token(tokBegin, tokEnd);
+            property.name = string(tokBegin, tokEnd);
+            header.elements.back().properties.push_back(property);
+        } else if (TextScanner::equals(tokBegin, tokEnd, "end_header")) {
+            in.nextLine();
+            header.data = in.position();
+            return true;
+        }
+        // comment, obj_info and anything else we don't need.
+
+        in.nextLine();
+    }
+
+    error = "no end_header";
+    return false;
+}
+
+/*
+ * Reads binary values out of the file, swapping their bytes if the file's
+ * byte order isn't ours, and never reading past the end
+ */
+class PlyReader {
+public:
+    PlyReader(const char *begin, const char *end, bool swapBytes)
+        : cur(begin), last(end), swap(swapBytes), truncated(false) {}
+
+    double read(int size, bool isFloat, bool isSigned) {
+        if (last - cur < size) {
+            truncated = true;
+            cur       = last;
+            return 0.0;
+        }
+
+        unsigned char bytes[8];
+        memcpy(bytes, cur, size);
+        cur += size;
+        if (swap)
+            reverse(bytes, bytes + size);
+
+        switch (size) {
+        case 1:
+            return isSigned ? (double)(int8_t)bytes[0] : (double)bytes[0];
+        case 2: {
+            uint16_t u;
+            memcpy(&u, bytes, 2);
+            return isSigned ? (double)(int16_t)u : (double)u;
+        }
+        case 4:
+            if (isFloat) {
+                float f;
+                memcpy(&f, bytes, 4);
+                return f;
+            } else {
+                uint32_t u;
+                memcpy(&u, bytes, 4);
+                return isSigned ? (double)(int32_t)u : (double)u;
+            }
+        default: {
+            double d;
+            memcpy(&d, bytes, 8);
+            return d;
+        }
+        }
+    }
+
+    double read(const PlyProperty &property) {
+        return read(
+            property.valueSize, property.isFloat, property.isSigned);
+    }
+
+    size_t readCount(const PlyProperty &property) {
+        return (size_t)read(property.countSize, false, false);
+    }
+
+    void skip(const PlyProperty &property) {
+        size_t count = 1;
+        if (property.countSize)
+            count = readCount(property);
+        if (!holds(count, property.valueSize))
+            return;
+        cur += count * property.valueSize;
+    }
+
+    /* is there room left for count values of size bytes?  if not, we're
+     * truncated, so a bad count can't have us loop or allocate on it */
+    bool holds(size_t count, size_t size) {
+        if (size && count > (size_t)(last - cur) / size) {
+            truncated = true;
+            cur       = last;
+        }
+        return !truncated;
+    }
+
+    bool isTruncated() const { return truncated; }
+
+private:
+    const char *cur;
+    const char *last;
+    bool swap;
+    bool truncated;
+};
+
+/* where each vertex attribute we use lives among the vertex properties */
+enum PlyAttribute {
+    PLY_X, PLY_Y, PLY_Z,
+    PLY_NX, PLY_NY, PLY_NZ,
+    PLY_S, PLY_T,
+    PLY_RED, PLY_GREEN, PLY_BLUE, PLY_ALPHA,
+    PLY_NONE
+};
+
+static PlyAttribute vertexAttribute(const string &name) {
+    static const struct {
+        const char *name;
+        PlyAttribute attribute;
+    } NAMES[] = {{"x", PLY_X},          {"y", PLY_Y},
+                 {"z", PLY_Z},          {"nx", PLY_NX},
+                 {"ny", PLY_NY},        {"nz", PLY_NZ},
+                 {"s", PLY_S},          {"t", PLY_T},
+                 {"u", PLY_S},          {"v", PLY_T},
+                 {"texture_u", PLY_S},  {"texture_v", PLY_T},
+                 {"red", PLY_RED},      {"green", PLY_GREEN},
+                 {"blue", PLY_BLUE},    {"alpha", PLY_ALPHA},
+                 {"diffuse_red", PLY_RED},
+                 {"diffuse_green", PLY_GREEN},
+                 {"diffuse_blue", PLY_BLUE}};
+
+    for (size_t i = 0; i < sizeof(NAMES) / sizeof(NAMES[0]); i++) {
+        if (name == NAMES[i].name)
+            return NAMES[i].attribute;
+    }
+    return PLY_NONE;
+}
+
+/* 0-3 for red, green, blue and alpha; -1 for anything else */
+static int colorChannel(const PlyProperty &property) {
+    if (property.countSize)
+        return -1;
+    if (property.name == "red")
+        return 0;
+    if (property.name == "green")
+        return 1;
+    if (property.name == "blue")
+        return 2;
+    if (property.name == "alpha")
+        return 3;
+    return -1;
+}
+
+/* colours are 0-255 when they're integers, 0-1 when they're floats */
+static float colorScale(const PlyProperty &property) {
+    return property.isFloat ? 1.0f : 1.0f / 255.0f;
+}
+
+/* the fewest bytes one of element's items can take: lists may be empty */
+static size_t minimumSize(const PlyElement &element) {
+    size_t size = 0;
+    for (size_t p = 0; p < element.properties.size(); p++) {
+        const PlyProperty &property = element.properties[p];
+        size += property.countSize ? property.countSize : property.valueSize;
+    }
+    return size;
+}
+
+static void faceNormal(const GLfloat *p0, const GLfloat *p1,
+                       const GLfloat *p2, GLfloat *normal) {
+    GLfloat u[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    GLfloat v[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    normal[0]    = u[1] * v[2] - u[2] * v[1];
+    normal[1]    = u[2] * v[0] - u[0] * v[2];
+    normal[2]    = u[0] * v[1] - u[1] * v[0];
+
+    GLfloat length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1]
+                           + normal[2] * normal[2]);
+    if (length > 0) {
+        normal[0] /= length;
+        normal[1] /= length;
+        normal[2] /= length;
+    }
+}
+
+bool readBinaryPLY(const PlyHeader &header, const char *end,
+                   CompiledMesh &mesh, string &error) {
+    mesh.clear();
+
+    if (header.format == PlyHeader::ASCII || !header.data) {
+        error = "not a binary ply file";
+        return false;
+    }
+
+    uint16_t one        = 1;
+    bool hostIsLittle   = *(unsigned char *)&one == 1;
+    bool fileIsLittle   = header.format == PlyHeader::BINARY_LITTLE_ENDIAN;
+    PlyReader in(header.data, end, hostIsLittle != fileIsLittle);
+
+    bool hasNormals = false, hasTexCoords = false, hasColors = false;
+    bool hasFaceColors = false;
+
+    // what the vertex and face elements hold, before they become a mesh.
+    vector<GLfloat> positions, normals, texCoords, colors;
+    vector<GLuint> faceCorners, faceSizes;
+    vector<GLfloat> faceColors;
+
+    for (size_t e = 0; e < header.elements.size(); e++) {
+        const PlyElement &element = header.elements[e];
+
+        // a corrupt count in the header mustn't get as far as a resize().
+        if (!in.holds(element.count, minimumSize(element))) {
+            error = "file ends in the middle of its " + element.name
+                    + " element";
+            return false;
+        }
+
+        if (element.name == "vertex") {
+            vector<PlyAttribute> attributes;
+            bool attributeFound[PLY_NONE] = {false};
+            for (size_t p = 0; p < element.properties.size(); p++) {
+                PlyAttribute attribute = PLY_NONE;
+                if (!element.properties[p].countSize)
+                    attribute = vertexAttribute(element.properties[p].name);
+                attributes.push_back(attribute);
+                if (attribute != PLY_NONE)
+                    attributeFound[attribute] = true;
+            }
+            hasNormals = attributeFound[PLY_NX] && attributeFound[PLY_NY]
+                         && attributeFound[PLY_NZ];
+            hasTexCoords = attributeFound[PLY_S] && attributeFound[PLY_T];
+            hasColors    = attributeFound[PLY_RED] && attributeFound[PLY_GREEN]
+                        && attributeFound[PLY_BLUE];
+
+            positions.resize(element.count * 3);
+            normals.assign(element.count * 3, 0.0f);
+            texCoords.assign(element.count * 2, 0.0f);
+            if (hasColors)
+                colors.assign(element.count * 4, 1.0f);
+
+            for (size_t v = 0; v < element.count && !in.isTruncated(); v++) {
+                GLfloat values[PLY_NONE] = {0};
+                values[PLY_ALPHA]        = 1.0f;
+                for (size_t p = 0; p < element.properties.size(); p++) {
+                    const PlyProperty &property = element.properties[p];
+                    PlyAttribute attribute      = attributes[p];
+                    if (attribute == PLY_NONE) {
+                        in.skip(property);
+                        continue;
+                    }
+
+                    GLfloat value = (GLfloat)in.read(property);
+                    if (attribute >= PLY_RED)
+                        value *= colorScale(property);
+                    values[attribute] = value;
+                }
+
+                copy(values + PLY_X, values + PLY_Z + 1, &positions[v * 3]);
+                copy(values + PLY_NX, values + PLY_NZ + 1, &normals[v * 3]);
+                copy(values + PLY_S, values + PLY_T + 1, &texCoords[v * 2]);
+                if (hasColors)
+                    copy(values + PLY_RED,
+                         values + PLY_ALPHA + 1,
+                         &colors[v * 4]);
+            }
+        } else if (element.name == "face") {
+            faceSizes.reserve(element.count);
+            faceCorners.reserve(element.count * 3);
+
+            int colorChannels = 0;
+            for (size_t p = 0; p < element.properties.size(); p++) {
+                int channel = colorChannel(element.properties[p]);
+                if (channel >= 0 && channel < 3)
+                    colorChannels++;
+            }
+            hasFaceColors = colorChannels == 3;
+            if (hasFaceColors)
+                faceColors.reserve(element.count * 4);
+
+            for (size_t f = 0; f < element.count && !in.isTruncated(); f++) {
+                GLfloat color[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+                for (size_t p = 0; p < element.properties.size(); p++) {
+                    const PlyProperty &property = element.properties[p];
+
+                    if (property.countSize
+                        && (property.name == "vertex_indices"
+                            || property.name == "vertex_index")) {
+                        size_t count = in.readCount(property);
+                        if (!in.holds(count, property.valueSize))
+                            break;
+                        for (size_t c = 0; c < count; c++)
+                            faceCorners.push_back((GLuint)in.read(property));
+                        faceSizes.push_back((GLuint)count);
+                    } else if (hasFaceColors && colorChannel(property) >= 0) {
+                        color[colorChannel(property)]
+                            = (GLfloat)in.read(property) * colorScale(property);
+                    } else {
+                        in.skip(property);
+                    }
+                }
+                if (hasFaceColors)
+                    faceColors.insert(faceColors.end(), color, color + 4);
+            }
+        } else {
+            // edges, materials, whatever: step over them.
+            for (size_t i = 0; i < element.count && !in.isTruncated(); i++) {
+                for (size_t p = 0; p < element.properties.size(); p++)
+                    in.skip(element.properties[p]);
+            }
+        }
+
+        if (in.isTruncated()) {
+            error = "file ends in the middle of its " + element.name
+                    + " element";
+            return false;
+        }
+    }
+
+    GLuint numVertices = (GLuint)(positions.size() / 3);
+    for (size_t i = 0; i < faceCorners.size(); i++) {
+        if (faceCorners[i] >= numVertices) {
+            error = "face uses a vertex that doesn't exist";
+            return false;
+        }
+    }
+
+    for (size_t v = 0; v < numVertices; v++) {
+        const GLfloat *p = &positions[v * 3];
+        mesh.minX        = min(mesh.minX, p[0]);
+        mesh.maxX        = max(mesh.maxX, p[0]);
+        mesh.minY        = min(mesh.minY, p[1]);
+        mesh.maxY        = max(mesh.maxY, p[1]);
+        mesh.minZ        = min(mesh.minZ, p[2]);
+        mesh.maxZ        = max(mesh.maxZ, p[2]);
+    }
+    mesh.numFaces = (GLuint)faceSizes.size();
+
+    bool flat = !hasNormals || hasFaceColors;
+    if (!flat) {
+        // the file's vertices can be used just as they are.
+        mesh.positions.swap(positions);
+        mesh.normals.swap(normals);
+        mesh.texCoords.swap(texCoords);
+        mesh.colors.swap(colors);
+    }
+
+    size_t corner = 0;
+    for (size_t f = 0; f < faceSizes.size(); f++) {
+        const GLuint *v = &faceCorners[corner];
+        corner += faceSizes[f];
+
+        // faces are fanned into triangles, like the text loader does.
+        for (GLuint i = 1; i + 1 < faceSizes[f]; i++) {
+            GLuint triangle[3] = {v[0], v[i], v[i + 1]};
+
+            if (!flat) {
+                mesh.indices.insert(mesh.indices.end(), triangle, triangle + 3);
+                continue;
+            }
+
+            GLfloat normal[3];
+            faceNormal(&positions[triangle[0] * 3],
+                       &positions[triangle[1] * 3],
+                       &positions[triangle[2] * 3],
+                       normal);
+
+            for (int k = 0; k < 3; k++) {
+                GLuint from = triangle[k];
+                mesh.indices.push_back((GLuint)(mesh.positions.size() / 3));
+                mesh.positions.insert(mesh.positions.end(),
+                                      &positions[from * 3],
+                                      &positions[from * 3] + 3);
+                mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+                mesh.texCoords.insert(mesh.texCoords.end(),
+                                      &texCoords[from * 2],
+                                      &texCoords[from * 2] + 2);
+                if (hasFaceColors)
+                    mesh.colors.insert(mesh.colors.end(),
+                                       &faceColors[f * 4],
+                                       &faceColors[f * 4] + 4);
+                else if (hasColors)
+                    mesh.colors.insert(mesh.colors.end(),
+                                       &colors[from * 4],
+                                       &colors[from * 4] + 4);
+            }
+        }
+    }
+
+    MeshBatch batch;
+    batch.material   = -1;
+    batch.smooth     = -1;
+    batch.firstIndex = 0;
+    batch.numIndices = (GLuint)mesh.indices.size();
+    mesh.batches.push_back(batch);
+    mesh.triangleMaterials.assign(mesh.indices.size() / 3, -1);
+
+    return true;
+}
+}
@@ -0,0 +1,57 @@
+#ifndef _GOL_PLY_PARSER_H_
+#define _GOL_PLY_PARSER_H_ 1
+
+#include "CompiledMesh.h"
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/* one property of a *.ply element, as the header declares it */
+struct PlyProperty {
+    string name;
+    /* 0 if it isn't a list, else the size in bytes of the list's count */
+    int countSize;
+    /* size in bytes of the value (or of each list item) */
+    int valueSize;
+    bool isFloat, isSigned;
+};
+
+struct PlyElement {
+    string name;
+    size_t count;
+    vector<PlyProperty> properties;
+};
+
+/* everything a *.ply header says */
+struct PlyHeader {
+    enum Format { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+
+    Format format;
+    vector<PlyElement> elements;
+    /* where the data starts, just past end_header */
+    const char *data;
+};
+
+/* read the header of the *.ply file in [begin, end) */
+bool parsePLYHeader(const char *begin, const char *end, PlyHeader &header,
+                    string &error);
+
+/*
+ * Read the vertex and face elements of a binary *.ply file into mesh, using
+ * header to find them.  Positions, normals, texture coordinates and vertex
+ * colours are read wherever the vertex element declares them, converted
+ * straight from their binary type.  Faces are fanned into triangles.
+ *
+ * A file without normals (or with face colours) gets flat shading, like the
+ * text loader gives it: each triangle then has its own three vertices.
+ */
+bool readBinaryPLY(const PlyHeader &header, const char *end,
+                   CompiledMesh &mesh, string &error);
+}
+
+#endif
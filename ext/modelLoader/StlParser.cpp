@@ -0,0 +1,104 @@
+#include "StlParser.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace paone {
+
+// an 80 byte header, then a little endian count of triangles.
+static const size_t STL_HEADER_SIZE = 84;
+// per triangle: a normal, three corners, and two bytes of "attributes".
+static const size_t STL_TRIANGLE_SIZE = 50;
+
+static uint32_t readUint32(const char *p) {
+    const unsigned char *b = (const unsigned char *)p;
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16)
+           | ((uint32_t)b[3] << 24);
+}
+
+static void readFloats(const char *p, GLfloat *out, int count) {
+    for (int i = 0; i < count; i++) {
+        uint32_t bits = readUint32(p + i * 4);
+        memcpy(&out[i], &bits, 4);
+    }
+}
+
+bool isBinarySTL(const char *begin, const char *end) {
+    size_t size = end - begin;
+    if (size < STL_HEADER_SIZE)
+        return false;
+
+    uint32_t numTriangles = readUint32(begin + 80);
+    return size == STL_HEADER_SIZE + (size_t)numTriangles * STL_TRIANGLE_SIZE;
+}
+
+bool readBinarySTL(const char *begin, const char *end, CompiledMesh &mesh,
+                   string &error) {
+    mesh.clear();
+
+    if (!isBinarySTL(begin, end)) {
+        error = "not a binary stl file";
+        return false;
+    }
+
+    uint32_t numTriangles = readUint32(begin + 80);
+    mesh.positions.resize((size_t)numTriangles * 9);
+    mesh.normals.resize((size_t)numTriangles * 9);
+    mesh.texCoords.assign((size_t)numTriangles * 6, 0.0f);
+    mesh.indices.resize((size_t)numTriangles * 3);
+
+    const char *p = begin + STL_HEADER_SIZE;
+    for (uint32_t t = 0; t < numTriangles; t++, p += STL_TRIANGLE_SIZE) {
+        GLfloat *positions = &mesh.positions[t * 9];
+        GLfloat normal[3];
+        readFloats(p, normal, 3);
+        readFloats(p + 12, positions, 9);
+
+        if (normal[0] == 0 && normal[1] == 0 && normal[2] == 0) {
+            GLfloat u[3], v[3];
+            for (int k = 0; k < 3; k++) {
+                u[k] = positions[3 + k] - positions[k];
+                v[k] = positions[6 + k] - positions[k];
+            }
+            normal[0] = u[1] * v[2] - u[2] * v[1];
+            normal[1] = u[2] * v[0] - u[0] * v[2];
+            normal[2] = u[0] * v[1] - u[1] * v[0];
+
+            GLfloat length = sqrtf(normal[0] * normal[0]
+                                   + normal[1] * normal[1]
+                                   + normal[2] * normal[2]);
+            if (length > 0) {
+                normal[0] /= length;
+                normal[1] /= length;
+                normal[2] /= length;
+            }
+        }
+
+        for (int k = 0; k < 3; k++) {
+            copy(normal, normal + 3, &mesh.normals[t * 9 + k * 3]);
+            mesh.indices[t * 3 + k] = t * 3 + k;
+
+            const GLfloat *corner = &positions[k * 3];
+            mesh.minX             = min(mesh.minX, corner[0]);
+            mesh.maxX             = max(mesh.maxX, corner[0]);
+            mesh.minY             = min(mesh.minY, corner[1]);
+            mesh.maxY             = max(mesh.maxY, corner[1]);
+            mesh.minZ             = min(mesh.minZ, corner[2]);
+            mesh.maxZ             = max(mesh.maxZ, corner[2]);
+        }
+    }
+    mesh.numFaces = numTriangles;
+
+    MeshBatch batch;
+    batch.material   = -1;
+    batch.smooth     = -1;
+    batch.firstIndex = 0;
+    batch.numIndices = (GLuint)mesh.indices.size();
+    mesh.batches.push_back(batch);
+    mesh.triangleMaterials.assign(numTriangles, -1);
+
+    return true;
+}
+}
@@ -0,0 +1,28 @@
+#ifndef _GOL_STL_PARSER_H_
+#define _GOL_STL_PARSER_H_ 1
+
+#include "CompiledMesh.h"
+
+#include <string>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * Is [begin, end) a binary *.stl file?  Its size has to match the triangle
+ * count in its header exactly; some binary files start with "solid" too, so
+ * that alone doesn't tell
+ */
+bool isBinarySTL(const char *begin, const char *end);
+
+/*
+ * Read the triangles of the binary *.stl file in [begin, end) into mesh,
+ * each with its own three vertices and its facet normal.  Facets with a
+ * zero normal get their computed one
+ */
+bool readBinarySTL(const char *begin, const char *end, CompiledMesh &mesh,
+                   string &error);
+}
+
+#endif
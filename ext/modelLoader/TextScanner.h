@@ -0,0 +1,229 @@
+#ifndef _GOL_TEXT_SCANNER_H_
+#define _GOL_TEXT_SCANNER_H_ 1
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace paone {
+
+
+/*
+ * Scans whitespace separated tokens straight out of a (mapped) text buffer.
+ *
+ * Nothing is copied and nothing is allocated: tokens are handed back as
+ * [begin, end) pointer pairs into the buffer, and numbers are converted in
+ * place.  Lines are never crossed unless nextLine() is called.
+ */
+class TextScanner {
+public:
+    TextScanner(const char *begin, const char *end) : cur(begin), last(end) {}
+
+    bool atEnd() const { return cur >= last; }
+    /* true at the end of the current line (or the buffer) */
+    bool atEOL() const {
+        return cur >= last || *cur == '\n' || *cur == '\r';
+    }
+
+    /* skip spaces and tabs on the current line */
+    void skipBlanks() {
+        while (cur < last && (*cur == ' ' || *cur == '\t'))
+            cur++;
+    }
+
+    /* skip whatever is left of the current line, including the newline */
+    void nextLine() {
+        const char *nl = (const char *)memchr(cur, '\n', last - cur);
+        cur            = nl ? nl + 1 : last;
+    }
+
+    /* the next blank separated token on this line.  false if there is none */
+    bool token(const char *&tokBegin, const char *&tokEnd) {
+        skipBlanks();
+        tokBegin = cur;
+        while (cur < last && !isBlankOrEOL(*cur))
+            cur++;
+        tokEnd = cur;
+        return tokEnd != tokBegin;
+    }
+
+    /* the rest of the line with surrounding blanks removed */
+    bool restOfLine(const char *&tokBegin, const char *&tokEnd) {
+        skipBlanks();
+        tokBegin = cur;
+        while (cur < last && *cur != '\n' && *cur != '\r')
+            cur++;
+        tokEnd = cur;
+        while (tokEnd > tokBegin && (tokEnd[-1] == ' ' || tokEnd[-1] == '\t'))
+            tokEnd--;
+        return tokEnd != tokBegin;
+    }
+
+    /* the next token, read as a float.  0 (like atof) if it isn't one */
+    float readFloat() {
+        skipBlanks();
+        const char *tokEnd = cur;
+        while (tokEnd < last && !isBlankOrEOL(*tokEnd))
+            tokEnd++;
+        float f = parseFloat(cur, tokEnd);
+        cur     = tokEnd;
+        return f;
+    }
+
+    /* the next token, read as an int.  0 (like atoi) if it isn't one */
+    int readInt() {
+        skipBlanks();
+        const char *tokEnd = cur;
+        while (tokEnd < last && !isBlankOrEOL(*tokEnd))
+            tokEnd++;
+        int i = parseInt(cur, tokEnd);
+        cur   = tokEnd;
+        return i;
+    }
+
+    const char *position() const { return cur; }
+    void seek(const char *p) { cur = p; }
+
+    static bool isBlankOrEOL(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    /* does [tokBegin, tokEnd) spell out keyword? */
+    static bool equals(const char *tokBegin, const char *tokEnd,
+                       const char *keyword) {
+        size_t len = strlen(keyword);
+        return (size_t)(tokEnd - tokBegin) == len
+               && memcmp(tokBegin, keyword, len) == 0;
+    }
+
+    /* atoi() on [p, end), leaving p just past the digits. */
+    static int parseInt(const char *&p, const char *end) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            p++;
+        }
+        int value = 0;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            value = value * 10 + (*p - '0');
+            p++;
+        }
+        return negative ? -value : value;
+    }
+
+    /*
+     * atof() on [p, end), leaving p just past the number.
+     *
+     * Decimal numbers with at most 19 significant digits and a small
+     * exponent are exact as a double mantissa and power of ten, so a single
+     * multiply or divide gives the correctly rounded double, bit for bit
+     * what strtod() produces.  Anything else (long mantissas, huge
+     * exponents, inf, nan, hex) falls back to strtod() itself.
+     */
+    static float parseFloat(const char *&p, const char *end) {
+        static const double powersOf10[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+            1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+            1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        const char *start = p;
+        bool negative     = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            p++;
+        }
+
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool anyDigits = false, exact = true;
+
+        for (; p < end && (unsigned)(*p - '0') < 10; p++) {
+            anyDigits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa)
+                    digits++;
+            } else {
+                exponent++;
+                exact = false;
+            }
+        }
+        if (p < end && *p == '.') {
+            p++;
+            for (; p < end && (unsigned)(*p - '0') < 10; p++) {
+                anyDigits = true;
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa)
+                        digits++;
+                    exponent--;
+                } else {
+                    exact = false;
+                }
+            }
+        }
+        if (anyDigits && p < end && (*p == 'e' || *p == 'E')) {
+            const char *expStart = p;
+            p++;
+            bool expNegative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                expNegative = (*p == '-');
+                p++;
+            }
+            if (p < end && (unsigned)(*p - '0') < 10) {
+                int e = 0;
+                for (; p < end && (unsigned)(*p - '0') < 10; p++) {
+                    if (e < 100000)
+                        e = e * 10 + (*p - '0');
+                }
+                exponent += expNegative ? -e : e;
+            } else {
+                // "1e" is just 1, as far as strtod is concerned.
+                p = expStart;
+            }
+        }
+
+        if (!anyDigits || (p < end && !isBlankOrEOL(*p))) {
+            // inf, nan, hex floats or plain garbage.
+            return slowParseFloat(start, p, end);
+        }
+
+        if (exact && mantissa <= (1ULL << 53) && exponent >= -22
+            && exponent <= 22) {
+            double value = (double)mantissa;
+            if (exponent < 0)
+                value /= powersOf10[-exponent];
+            else
+                value *= powersOf10[exponent];
+            return (float)(negative ? -value : value);
+        }
+
+        return slowParseFloat(start, p, end);
+    }
+
+private:
+    const char *cur;
+    const char *last;
+
+    static float slowParseFloat(const char *start, const char *&p,
+                                const char *end) {
+        // strtod needs a terminator, and the buffer may not have one.
+        char buf[128];
+        const char *tokEnd = start;
+        while (tokEnd < end && !isBlankOrEOL(*tokEnd))
+            tokEnd++;
+        size_t len = tokEnd - start;
+        if (len >= sizeof(buf))
+            len = sizeof(buf) - 1;
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+
+        char *parsedEnd;
+        double value = strtod(buf, &parsedEnd);
+        p            = start + (parsedEnd - buf);
+        return (float)value;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,274 @@
+#include <GL/glew.h>
+
+#include "TextureCache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace paone {
+
+static const char TEXTURE_CACHE_MAGIC[8] = "GOLTEX";
+// bump this whenever the layout, or how the levels are made, changes.
+static const uint32_t TEXTURE_CACHE_VERSION = 2;
+
+/*
+ * The file is the header followed by, in order:
+ *     levels    Level[numLevels], largest first
+ *     data      each level's blocks or pixels, at its offset from here
+ * Uncompressed levels are tightly packed rows of channels bytes a pixel.
+ */
+struct TextureCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t sourceHash;
+    uint64_t contentHash;
+
+    /* the decoded image, which the levels may have been scaled from */
+    int32_t width, height, channels;
+    uint32_t internalFormat;
+    uint32_t compressed;
+    uint32_t numLevels;
+
+    /* the sampler state it was made with */
+    int32_t minFilter, magFilter, wrapS, wrapT;
+};
+
+struct TextureCache::Level {
+    int32_t width, height;
+    uint32_t offset, size;
+};
+
+/* the glTexImage format for decoded pixels with channels bytes each */
+static GLenum pixelFormat(int channels) {
+    switch (channels) {
+    case 1:
+        return GL_LUMINANCE;
+    case 2:
+        return GL_LUMINANCE_ALPHA;
+    case 3:
+        return GL_RGB;
+    default:
+        return GL_RGBA;
+    }
+}
+
+TextureCache::TextureCache() { close(); }
+
+bool TextureCache::open(const string &filename, uint64_t sourceHash,
+                        unsigned int flags) {
+    close();
+
+    if (!_file.open(filename) || _file.size() < sizeof(Header))
+        return false;
+
+    const Header *header = (const Header *)_file.begin();
+    if (memcmp(header->magic, TEXTURE_CACHE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != TEXTURE_CACHE_VERSION
+        || header->sourceHash != sourceHash || header->flags != flags
+        || header->numLevels == 0 || header->channels < 1
+        || header->channels > 4) {
+        _file.close();
+        return false;
+    }
+
+    // make sure every level is really there, and holds as many pixels as
+    // glTexImage2D() will read for it, before pointing into it.
+    uint64_t dataStart
+        = sizeof(Header) + (uint64_t)header->numLevels * sizeof(Level);
+    if (dataStart > _file.size()) {
+        _file.close();
+        return false;
+    }
+    const Level *levels = (const Level *)(_file.begin() + sizeof(Header));
+    for (uint32_t i = 0; i < header->numLevels; i++) {
+        const Level &level = levels[i];
+        uint64_t pixelBytes
+            = (uint64_t)level.width * level.height * header->channels;
+        if (level.width <= 0 || level.height <= 0
+            || dataStart + level.offset + level.size > _file.size()
+            || (!header->compressed && level.size != pixelBytes)) {
+            _file.close();
+            return false;
+        }
+    }
+
+    _header = header;
+    _levels = levels;
+    return true;
+}
+
+void TextureCache::close() {
+    _file.close();
+    _header = NULL;
+    _levels = NULL;
+}
+
+uint64_t TextureCache::contentHash() const { return _header->contentHash; }
+
+int TextureCache::width() const { return _header->width; }
+
+int TextureCache::height() const { return _header->height; }
+
+int TextureCache::channels() const { return _header->channels; }
+
+GLuint TextureCache::upload() const {
+    const char *data = _file.begin() + sizeof(Header)
+                       + _header->numLevels * sizeof(Level);
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    GLint unpackAlignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (uint32_t i = 0; i < _header->numLevels; i++) {
+        const Level &level = _levels[i];
+        if (_header->compressed)
+            glCompressedTexImage2D(GL_TEXTURE_2D,
+                                   i,
+                                   _header->internalFormat,
+                                   level.width,
+                                   level.height,
+                                   0,
+                                   level.size,
+                                   data + level.offset);
+        else
+            glTexImage2D(GL_TEXTURE_2D,
+                         i,
+                         _header->internalFormat,
+                         level.width,
+                         level.height,
+                         0,
+                         pixelFormat(_header->channels),
+                         GL_UNSIGNED_BYTE,
+                         data + level.offset);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _header->minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, _header->magFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _header->wrapS);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _header->wrapT);
+
+    return texture;
+}
+
+bool TextureCache::write(const string &filename, GLuint texture,
+                         uint64_t sourceHash, unsigned int flags,
+                         uint64_t contentHash, int width, int height,
+                         int channels) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXTURE_CACHE_MAGIC, sizeof(header.magic));
+    header.version     = TEXTURE_CACHE_VERSION;
+    header.flags       = flags;
+    header.sourceHash  = sourceHash;
+    header.contentHash = contentHash;
+    header.width       = width;
+    header.height      = height;
+    header.channels    = channels;
+
+    GLint value;
+    glGetTexLevelParameteriv(
+        GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &value);
+    header.internalFormat = value;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &value);
+    header.compressed = value ? 1 : 0;
+
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &value);
+    header.minFilter = value;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &value);
+    header.magFilter = value;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &value);
+    header.wrapS = value;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &value);
+    header.wrapT = value;
+
+    GLint packAlignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    // read every level back, the way it will be uploaded again.
+    vector<Level> levels;
+    vector<unsigned char> data;
+    for (GLint i = 0; i < 32; i++) {
+        Level level;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_WIDTH, &value);
+        level.width = value;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_HEIGHT, &value);
+        level.height = value;
+        if (level.width == 0 || level.height == 0)
+            break;
+
+        if (header.compressed) {
+            glGetTexLevelParameteriv(
+                GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &value);
+            level.size = value;
+        } else {
+            level.size = level.width * level.height * channels;
+        }
+        level.offset = (uint32_t)data.size();
+        data.resize(data.size() + level.size);
+
+        if (header.compressed)
+            glGetCompressedTexImage(GL_TEXTURE_2D, i, &data[level.offset]);
+        else
+            glGetTexImage(GL_TEXTURE_2D,
+                          i,
+                          pixelFormat(channels),
+                          GL_UNSIGNED_BYTE,
+                          &data[level.offset]);
+
+        levels.push_back(level);
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+
+    if (levels.empty())
+        return false;
+    header.numLevels = (uint32_t)levels.size();
+
+    // write it all out next to the real thing, and only replace the old
+    // cache once the new one is complete.
+    string tempFile = filename + ".tmp";
+    FILE *fp        = fopen(tempFile.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok
+         && fwrite(levels.data(), sizeof(Level), levels.size(), fp)
+                == levels.size();
+    ok = ok && fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok = (fclose(fp) == 0) && ok;
+
+    if (ok) {
+        remove(filename.c_str());
+        ok = rename(tempFile.c_str(), filename.c_str()) == 0;
+    }
+    if (!ok)
+        remove(tempFile.c_str());
+
+    return ok;
+}
+
+string TextureCache::cacheFile(const vector<string> &sources,
+                               unsigned int flags) {
+    // a diffuse map with an alpha map is a different image from either, and
+    // so is the same image loaded another way: each gets its own file, rather
+    // than overwriting one another's on every load.
+    string file = sources.empty() ? string() : sources[0];
+    for (size_t i = 1; i < sources.size(); i++)
+        file += "." + sources[i].substr(sources[i].find_last_of("/\\") + 1);
+
+    char suffix[24];
+    snprintf(suffix, sizeof(suffix), ".%08x.texcache", flags);
+    return file + suffix;
+}
+}
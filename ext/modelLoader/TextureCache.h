@@ -0,0 +1,77 @@
+#ifndef _GOL_TEXTURE_CACHE_H_
+#define _GOL_TEXTURE_CACHE_H_ 1
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include "MappedFile.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * A texture's whole mipmap chain saved to disk the way the driver holds it,
+ * so it can be uploaded again without decoding, scaling or compressing a
+ * thing.
+ *
+ * Compressed levels (SOIL's DXT, say) are kept as their blocks and go
+ * straight back up with glCompressedTexImage2D; anything else is kept as
+ * plain pixels.  Like MeshCache, it records a hash of the images it was made
+ * from and the flags they were loaded with, and is stale once either
+ * changes.  The layout is native endian.
+ */
+class TextureCache {
+public:
+    TextureCache();
+
+    /*
+     * map filename.  false if it is missing, not a cache we can read, or was
+     * not made from sources hashing to sourceHash loaded with flags
+     */
+    bool open(const string &filename, uint64_t sourceHash,
+              unsigned int flags);
+    void close();
+
+    /* the decoded image: a hash of its pixels (as TextureRegistry tells
+     * images apart) and its shape */
+    uint64_t contentHash() const;
+    int width() const;
+    int height() const;
+    int channels() const;
+
+    /* a new texture holding every cached level.  GL thread only */
+    GLuint upload() const;
+
+    /*
+     * save every level of texture, made from sources hashing to sourceHash
+     * loaded with flags, as filename.  the rest describe the decoded image.
+     * GL thread only
+     */
+    static bool write(const string &filename, GLuint texture,
+                      uint64_t sourceHash, unsigned int flags,
+                      uint64_t contentHash, int width, int height,
+                      int channels);
+
+    /* where the cache for the image made from sources, loaded with flags,
+     * lives */
+    static string cacheFile(const vector<string> &sources, unsigned int flags);
+
+private:
+    struct Header;
+    struct Level;
+
+    MappedFile _file;
+    const Header *_header;
+    const Level *_levels;
+};
+}
+
+#endif
@@ -0,0 +1,353 @@
+#include <GL/glew.h>
+
+#include <SOIL/SOIL.h>
+
+#include "GLTaskQueue.h"
+#include "Hash.h"
+#include "MeshCache.h"
+#include "MipmapChain.h"
+#include "TextureCache.h"
+#include "TextureRegistry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+namespace paone {
+
+TextureRegistry &TextureRegistry::shared() {
+    // never destroyed, so objects destroyed while exiting can still release
+    // their textures into it.
+    static TextureRegistry *registry = new TextureRegistry;
+    return *registry;
+}
+
+GLuint TextureRegistry::acquire(const string &key) {
+    map<string, GLuint>::iterator found = _byKey.find(key);
+    if (found == _byKey.end())
+        return 0;
+
+    return addReference(found->second, key);
+}
+
+GLuint TextureRegistry::acquire(const string &key,
+                                const unsigned char *pixels, int width,
+                                int height, int channels, unsigned int variant,
+                                const function<GLuint()> &upload) {
+    GLuint handle = acquire(key);
+    if (handle)
+        return handle;
+
+    return acquire(key,
+                   hashPixels(pixels, width, height, channels),
+                   width,
+                   height,
+                   channels,
+                   variant,
+                   upload);
+}
+
+GLuint TextureRegistry::acquire(const string &key, uint64_t contentHash,
+                                int width, int height, int channels,
+                                unsigned int variant,
+                                const function<GLuint()> &upload) {
+    GLuint handle = acquire(key);
+    if (handle)
+        return handle;
+
+    // 64 bits of hash plus the shape is plenty to tell images apart.
+    char contentKey[80];
+    snprintf(contentKey,
+             sizeof(contentKey),
+             "%016llx %dx%dx%d %08x",
+             (unsigned long long)contentHash,
+             width,
+             height,
+             channels,
+             variant);
+
+    map<string, GLuint>::iterator found = _byContent.find(contentKey);
+    if (found != _byContent.end())
+        return addReference(found->second, key);
+
+    handle = upload();
+    if (!handle)
+        return 0;
+
+    Entry &entry          = _textures[handle];
+    entry.info.name       = key;
+    entry.info.handle     = handle;
+    entry.info.width      = width;
+    entry.info.height     = height;
+    entry.info.references = 0;
+    entry.info.gpuBytes   = measure(handle);
+    entry.contentKey      = contentKey;
+    _byContent[contentKey] = handle;
+
+    return addReference(handle, key);
+}
+
+void TextureRegistry::release(GLuint handle) {
+    map<GLuint, Entry>::iterator found = _textures.find(handle);
+    if (found == _textures.end())
+        return;
+
+    Entry &entry = found->second;
+    if (--entry.info.references > 0)
+        return;
+
+    for (size_t i = 0; i < entry.keys.size(); i++)
+        _byKey.erase(entry.keys[i]);
+    _byContent.erase(entry.contentKey);
+    _textures.erase(found);
+
+    glDeleteTextures(1, &handle);
+}
+
+/* the SOIL flags loadFile() can follow while making the mipmaps itself */
+static const unsigned int MIPMAP_CHAIN_FLAGS
+    = SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB
+      | SOIL_FLAG_COMPRESS_TO_DXT | SOIL_FLAG_TEXTURE_REPEATS
+      | TEXTURE_FLAG_LINEAR | TEXTURE_FLAG_NORMAL_MAP;
+
+/* the flags that are ours rather than SOIL's */
+static const unsigned int OWN_FLAGS
+    = TEXTURE_FLAG_LINEAR | TEXTURE_FLAG_NORMAL_MAP;
+
+/* how the MipmapChain for soilFlags averages */
+static MipmapChain::Encoding encodingOf(unsigned int soilFlags) {
+    if (soilFlags & TEXTURE_FLAG_NORMAL_MAP)
+        return MipmapChain::NORMALS;
+    if (soilFlags & TEXTURE_FLAG_LINEAR)
+        return MipmapChain::LINEAR;
+    return MipmapChain::SRGB;
+}
+
+/* SOIL_FLAG_INVERT_Y */
+static void flipRows(unsigned char *pixels, int width, int height,
+                     int channels) {
+    size_t rowSize = (size_t)width * channels;
+    for (int top = 0, bottom = height - 1; top < bottom; top++, bottom--)
+        swap_ranges(pixels + top * rowSize,
+                    pixels + (top + 1) * rowSize,
+                    pixels + bottom * rowSize);
+}
+
+/* SOIL_FLAG_NTSC_SAFE_RGB: squeeze the colours (not alpha) into 16..235,
+ * exactly as SOIL does */
+static void scaleToNTSCSafe(unsigned char *pixels, int width, int height,
+                            int channels) {
+    const float low = 16.0f - 0.499f, high = 235.0f + 0.499f;
+    unsigned char scale[256];
+    for (int i = 0; i < 256; i++)
+        scale[i] = (unsigned char)((high - low) * i / 255.0f + low);
+
+    int colors  = (channels & 1) ? channels : channels - 1;
+    size_t size = (size_t)width * height * channels;
+    for (size_t i = 0; i < size; i += channels)
+        for (int c = 0; c < colors; c++)
+            pixels[i + c] = scale[pixels[i + c]];
+}
+
+/* the texture SOIL_create_OGL_texture() would have made, mipmaps and all */
+static GLuint createTexture(const unsigned char *pixels,
+                            const MipmapChain &mipmaps, int channels,
+                            unsigned int soilFlags) {
+    GLint internalFormat = mipmaps.format();
+    if ((soilFlags & SOIL_FLAG_COMPRESS_TO_DXT)
+        && GLEW_EXT_texture_compression_s3tc)
+        internalFormat = (channels & 1) ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                                        : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    mipmaps.upload(pixels, internalFormat);
+
+    GLint wrap = (soilFlags & SOIL_FLAG_TEXTURE_REPEATS) ? GL_REPEAT
+                                                          : GL_CLAMP_TO_EDGE;
+    glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+
+    return texture;
+}
+
+GLuint TextureRegistry::loadFile(const string &filename,
+                                 unsigned int soilFlags) {
+    char flags[16];
+    snprintf(flags, sizeof(flags), "%08x ", soilFlags);
+    string key = string("soil ") + flags + canonicalPath(filename);
+
+    GLuint handle = 0;
+    GLTaskQueue::shared().run([&]() { handle = acquire(key); });
+    if (handle)
+        return handle;
+
+    // SOIL makes mipmaps and compresses on the CPU, which is slow enough to
+    // keep what it made for next time.
+    vector<string> sources(1, canonicalPath(filename));
+    string cacheFile = TextureCache::cacheFile(sources, soilFlags);
+    uint64_t sourceHash;
+    bool hashed = MeshCache::hashFiles(sources, sourceHash);
+
+    TextureCache cache;
+    if (hashed && cache.open(cacheFile, sourceHash, soilFlags)) {
+        GLTaskQueue::shared().run([&]() {
+            handle = acquire(key,
+                             cache.contentHash(),
+                             cache.width(),
+                             cache.height(),
+                             cache.channels(),
+                             soilFlags,
+                             [&cache]() { return cache.upload(); });
+        });
+        return handle;
+    }
+
+    int width, height, channels;
+    unsigned char *pixels = SOIL_load_image(
+        filename.c_str(), &width, &height, &channels, SOIL_LOAD_AUTO);
+    if (!pixels)
+        return 0;
+    uint64_t contentHash = hashPixels(pixels, width, height, channels);
+
+    // when it's only flags we can follow, the mipmaps are made here, off the
+    // GL thread, and properly.
+    MipmapChain mipmaps;
+    bool ownMipmaps = (soilFlags & SOIL_FLAG_MIPMAPS)
+                      && (soilFlags & ~MIPMAP_CHAIN_FLAGS) == 0;
+    if (ownMipmaps) {
+        if (soilFlags & SOIL_FLAG_INVERT_Y)
+            flipRows(pixels, width, height, channels);
+        if (soilFlags & SOIL_FLAG_NTSC_SAFE_RGB)
+            scaleToNTSCSafe(pixels, width, height, channels);
+        mipmaps.build(
+            pixels, width, height, channels, encodingOf(soilFlags));
+    }
+
+    GLTaskQueue::shared().run([&]() {
+        handle = acquire(
+            key, contentHash, width, height, channels, soilFlags, [&]() {
+                if (ownMipmaps)
+                    return createTexture(pixels, mipmaps, channels, soilFlags);
+                return (GLuint)SOIL_create_OGL_texture(pixels,
+                                                       width,
+                                                       height,
+                                                       channels,
+                                                       SOIL_CREATE_NEW_ID,
+                                                       soilFlags & ~OWN_FLAGS);
+            });
+
+        if (handle && hashed)
+            TextureCache::write(cacheFile,
+                                handle,
+                                sourceHash,
+                                soilFlags,
+                                contentHash,
+                                width,
+                                height,
+                                channels);
+    });
+    SOIL_free_image_data(pixels);
+
+    return handle;
+}
+
+vector<TextureInfo> TextureRegistry::textures() const {
+    vector<TextureInfo> result;
+    for (map<GLuint, Entry>::const_iterator i = _textures.begin();
+         i != _textures.end();
+         ++i)
+        result.push_back(i->second.info);
+    return result;
+}
+
+size_t TextureRegistry::gpuBytes() const {
+    size_t total = 0;
+    for (map<GLuint, Entry>::const_iterator i = _textures.begin();
+         i != _textures.end();
+         ++i)
+        total += i->second.info.gpuBytes;
+    return total;
+}
+
+string TextureRegistry::canonicalPath(const string &path) {
+#ifdef _WIN32
+    char *resolved = _fullpath(NULL, path.c_str(), 0);
+#else
+    char *resolved = realpath(path.c_str(), NULL);
+#endif
+    if (!resolved)
+        return path;
+
+    string result = resolved;
+    free(resolved);
+    return result;
+}
+
+uint64_t TextureRegistry::hashPixels(const unsigned char *pixels, int width,
+                                     int height, int channels) {
+    return hashBytes(pixels, (size_t)width * height * channels);
+}
+
+GLuint TextureRegistry::addReference(GLuint handle, const string &key) {
+    Entry &entry = _textures[handle];
+    if (_byKey.insert(pair<string, GLuint>(key, handle)).second)
+        entry.keys.push_back(key);
+    entry.info.references++;
+    return handle;
+}
+
+/*
+ * Add up what the driver says every mipmap level of handle takes.  Leaves
+ * handle bound
+ */
+size_t TextureRegistry::measure(GLuint handle) {
+    glBindTexture(GL_TEXTURE_2D, handle);
+
+    size_t bytes = 0;
+    for (GLint level = 0; level < 32; level++) {
+        GLint width = 0, height = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(
+            GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0)
+            break;
+
+        GLint compressed = GL_FALSE;
+        glGetTexLevelParameteriv(
+            GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &compressed);
+        if (compressed) {
+            GLint size = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D,
+                                     level,
+                                     GL_TEXTURE_COMPRESSED_IMAGE_SIZE,
+                                     &size);
+            bytes += size;
+            continue;
+        }
+
+        static const GLenum componentSizes[]
+            = {GL_TEXTURE_RED_SIZE,
+               GL_TEXTURE_GREEN_SIZE,
+               GL_TEXTURE_BLUE_SIZE,
+               GL_TEXTURE_ALPHA_SIZE,
+               GL_TEXTURE_LUMINANCE_SIZE,
+               GL_TEXTURE_INTENSITY_SIZE};
+        GLint bits = 0;
+        for (size_t i = 0; i < sizeof(componentSizes) / sizeof(GLenum); i++) {
+            GLint componentBits = 0;
+            glGetTexLevelParameteriv(
+                GL_TEXTURE_2D, level, componentSizes[i], &componentBits);
+            bits += componentBits;
+        }
+        bytes += (size_t)width * height * bits / 8;
+    }
+
+    return bytes;
+}
+}
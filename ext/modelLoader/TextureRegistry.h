@@ -0,0 +1,122 @@
+#ifndef _GOL_TEXTURE_REGISTRY_H_
+#define _GOL_TEXTURE_REGISTRY_H_ 1
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * loadFile() flags of our own, above SOIL's, for images that aren't colours:
+ * their mipmaps are averaged as stored rather than in linear light (see
+ * MipmapChain::Encoding), and normal maps' are made unit length again
+ */
+static const unsigned int TEXTURE_FLAG_LINEAR     = 0x20000000u;
+static const unsigned int TEXTURE_FLAG_NORMAL_MAP = 0x40000000u;
+
+/* what the registry knows about one texture */
+struct TextureInfo {
+    /* the key it was first registered under, usually its file */
+    string name;
+    GLuint handle;
+    int width, height;
+    unsigned int references;
+    /* every mipmap level, as the driver reports it */
+    size_t gpuBytes;
+};
+
+/*
+ * Every texture the loaders have uploaded, shared between them.
+ *
+ * A texture is found again either by key (a canonical path, plus whatever
+ * else changes how it was made) before anything is decoded, or by a hash of
+ * its decoded pixels, so two files with the same image still upload once.
+ * Each acquire() adds a reference and each release() drops one; the texture
+ * is deleted with the last.
+ *
+ * Everything here talks to OpenGL, so only use it from the GL thread, bar
+ * loadFile() and the static helpers.
+ */
+class TextureRegistry {
+public:
+    static TextureRegistry &shared();
+
+    /* a reference to the texture registered under key.  0 if there is none */
+    GLuint acquire(const string &key);
+
+    /*
+     * a reference to the texture for these pixels.  if identical pixels were
+     * uploaded with the same variant, that texture is registered under key
+     * too; otherwise upload() makes a new one.  0 if upload() fails
+     */
+    GLuint acquire(const string &key, const unsigned char *pixels, int width,
+                   int height, int channels, unsigned int variant,
+                   const function<GLuint()> &upload);
+    /* the same, for pixels hashing to contentHash (see hashPixels()) */
+    GLuint acquire(const string &key, uint64_t contentHash, int width,
+                   int height, int channels, unsigned int variant,
+                   const function<GLuint()> &upload);
+
+    /* drop one reference to handle, deleting it after the last */
+    void release(GLuint handle);
+
+    /*
+     * SOIL_load_OGL_texture(), through the registry.  soilFlags are the
+     * usual SOIL_FLAG_* and are part of what makes a texture the same.
+     *
+     * with SOIL_FLAG_MIPMAPS (plus any of INVERT_Y, NTSC_SAFE_RGB,
+     * COMPRESS_TO_DXT, TEXTURE_REPEATS and our TEXTURE_FLAG_*) the mipmaps
+     * are a MipmapChain rather than SOIL's, and DXT compression is left to
+     * the driver.
+     * whatever was made is kept in a TextureCache next to the file, and later
+     * loads upload that instead.
+     *
+     * safe on any thread: the file is read and filtered where it is called,
+     * and only the upload goes through GLTaskQueue::shared()
+     */
+    GLuint loadFile(const string &filename, unsigned int soilFlags);
+
+    vector<TextureInfo> textures() const;
+    size_t gpuBytes() const;
+
+    /* path with ., .. and links resolved.  path itself if it doesn't exist */
+    static string canonicalPath(const string &path);
+    /* what acquire() tells decoded images apart by.  safe on any thread */
+    static uint64_t hashPixels(const unsigned char *pixels, int width,
+                               int height, int channels);
+
+private:
+    struct Entry {
+        TextureInfo info;
+        vector<string> keys;
+        string contentKey;
+    };
+
+    map<GLuint, Entry> _textures;
+    map<string, GLuint> _byKey;
+    map<string, GLuint> _byContent;
+
+    /* add key -> handle and a reference to it */
+    GLuint addReference(GLuint handle, const string &key);
+    static size_t measure(GLuint handle);
+
+    TextureRegistry() {}
+    TextureRegistry(const TextureRegistry &);
+    TextureRegistry &operator=(const TextureRegistry &);
+};
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include "WorkerPool.h"
+
+namespace paone {
+
+WorkerPool::WorkerPool(unsigned int numThreads) : _busy(0), _stopping(false) {
+    if (numThreads == 0)
+        numThreads = thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+
+    for (unsigned int i = 0; i < numThreads; i++)
+        _threads.push_back(thread(&WorkerPool::workerLoop, this));
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        unique_lock<mutex> lock(_lock);
+        _stopping = true;
+    }
+    _jobReady.notify_all();
+
+    for (size_t i = 0; i < _threads.size(); i++)
+        _threads[i].join();
+}
+
+void WorkerPool::enqueue(const function<void()> &job) {
+    {
+        unique_lock<mutex> lock(_lock);
+        _jobs.push_back(job);
+    }
+    _jobReady.notify_one();
+}
+
+void WorkerPool::wait() {
+    unique_lock<mutex> lock(_lock);
+    while (!_jobs.empty() || _busy > 0)
+        _allDone.wait(lock);
+}
+
+void WorkerPool::run(const vector<function<void()> > &jobs) {
+    if (jobs.empty())
+        return;
+
+    mutex doneLock;
+    condition_variable doneSignal;
+    size_t remaining = jobs.size();
+
+    {
+        unique_lock<mutex> lock(_lock);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            function<void()> job = jobs[i];
+            _jobs.push_back([job, &doneLock, &doneSignal, &remaining]() {
+                job();
+                unique_lock<mutex> lock(doneLock);
+                if (--remaining == 0)
+                    doneSignal.notify_all();
+            });
+        }
+    }
+    _jobReady.notify_all();
+
+    // help out rather than sit idle.  this also keeps nested calls from
+    // deadlocking when every worker is already waiting on something.
+    unique_lock<mutex> lock(_lock);
+    while (runOne(lock)) {
+        unique_lock<mutex> done(doneLock);
+        if (remaining == 0)
+            return;
+    }
+    lock.unlock();
+
+    unique_lock<mutex> done(doneLock);
+    while (remaining > 0)
+        doneSignal.wait(done);
+}
+
+unsigned int WorkerPool::size() const { return (unsigned int)_threads.size(); }
+
+WorkerPool &WorkerPool::shared() {
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::workerLoop() {
+    unique_lock<mutex> lock(_lock);
+    for (;;) {
+        while (_jobs.empty() && !_stopping)
+            _jobReady.wait(lock);
+        if (_jobs.empty())
+            return;
+
+        runOne(lock);
+    }
+}
+
+bool WorkerPool::runOne(unique_lock<mutex> &lock) {
+    if (_jobs.empty())
+        return false;
+
+    function<void()> job = _jobs.front();
+    _jobs.pop_front();
+    _busy++;
+
+    lock.unlock();
+    job();
+    lock.lock();
+
+    _busy--;
+    if (_jobs.empty() && _busy == 0)
+        _allDone.notify_all();
+
+    return true;
+}
+}
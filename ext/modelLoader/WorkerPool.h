@@ -0,0 +1,63 @@
+#ifndef _GOL_WORKER_POOL_H_
+#define _GOL_WORKER_POOL_H_ 1
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace paone {
+
+
+/*
+ * A fixed set of threads that run queued jobs in the background.
+ *
+ * Jobs are plain functions.  They must not touch OpenGL: the context belongs
+ * to whichever thread created it.
+ */
+class WorkerPool {
+public:
+    /* 0 threads means one per hardware thread */
+    WorkerPool(unsigned int numThreads = 0);
+    ~WorkerPool();
+
+    /* queue job to run on some worker */
+    void enqueue(const function<void()> &job);
+    /* block until every queued job has finished */
+    void wait();
+    /*
+     * run jobs on the pool and return once all of them have finished.  the
+     * calling thread works through the queue too, so this is safe to call
+     * from inside a job.
+     */
+    void run(const vector<function<void()> > &jobs);
+
+    unsigned int size() const;
+
+    /* the pool shared by all the loaders */
+    static WorkerPool &shared();
+
+private:
+    vector<thread> _threads;
+    deque<function<void()> > _jobs;
+
+    mutex _lock;
+    condition_variable _jobReady;
+    condition_variable _allDone;
+
+    unsigned int _busy;
+    bool _stopping;
+
+    void workerLoop();
+    /* pop and run one queued job, if there is one.  _lock must be held */
+    bool runOne(unique_lock<mutex> &lock);
+
+    WorkerPool(const WorkerPool &);
+    WorkerPool &operator=(const WorkerPool &);
+};
+}
+
+#endif
@@ -11,12 +11,50 @@ varying vec2 vTexCoord;
 
 uniform sampler2D heightMap;
 
+/*****************************************/
+/*********       Skinning        *********/
+/*****************************************/
+
+// When skinned, gl_Vertex is in the bind pose, and is moved by up to 12
+// joints, blended by weight. Each joint's palette matrix is 3 rows.
+uniform bool skinned;
+uniform vec4 palette[3 * 64];
+
+attribute vec4 joints0;
+attribute vec4 joints1;
+attribute vec4 joints2;
+attribute vec4 weights0;
+attribute vec4 weights1;
+attribute vec4 weights2;
+
+void blend(vec4 joints, vec4 weights, inout vec4 row0, inout vec4 row1,
+           inout vec4 row2) {
+    for (int i = 0; i < 4; i++) {
+        int j = int(joints[i]) * 3;
+        row0 += weights[i] * palette[j];
+        row1 += weights[i] * palette[j + 1];
+        row2 += weights[i] * palette[j + 2];
+    }
+}
+
 void main(void) {
     /*****************************************/
     /********* Vertex Calculations  **********/
     /*****************************************/
     
-    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+    vec4 vertex = gl_Vertex;
+    if (skinned) {
+        vec4 row0 = vec4(0.0), row1 = vec4(0.0), row2 = vec4(0.0);
+        blend(joints0, weights0, row0, row1, row2);
+        blend(joints1, weights1, row0, row1, row2);
+        blend(joints2, weights2, row0, row1, row2);
+
+        vertex = vec4(
+            dot(row0, gl_Vertex), dot(row1, gl_Vertex), dot(row2, gl_Vertex),
+            1.0);
+    }
+
+    gl_Position = gl_ModelViewProjectionMatrix * vertex;
     
     /*****************************************/
     /********* Texture Calculations  *********/
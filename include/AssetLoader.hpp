@@ -0,0 +1,55 @@
+// Loads assets on background threads while the GL thread keeps drawing, and
+// keeps score for the loading screen.
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class AssetLoader {
+public:
+    // load() runs on a thread of its own. Anything it does with OpenGL has
+    // to go through paone::GLTaskQueue::shared(), which the model loaders
+    // already do. done() then runs on the GL thread with what load()
+    // returned.
+    // files are only used to weigh the asset on the progress bar, by their
+    // size on disk. The scene can start once every required asset is done.
+    void add(const std::string &name, std::function<bool()> load,
+             std::function<void(bool)> done,
+             const std::vector<std::string> &files, bool required = false);
+
+    // Start every asset loading. finished() runs on the GL thread once
+    // they're all done.
+    void start(std::function<void()> finished);
+
+    // How much of the total weight is done, from 0 to 1.
+    float progress() const;
+    // The names of the assets still loading.
+    std::string status() const;
+
+    // Every required asset is done.
+    bool ready() const;
+    // Every asset is done.
+    bool finished() const;
+
+private:
+    enum class State { Queued, Loading, Done };
+
+    struct Asset {
+        std::string name;
+        std::function<bool()> load;
+        std::function<void(bool)> done;
+        double weight;
+        bool required;
+        State state;
+    };
+
+    // The Assets only ever grow before start(), so indices stay good.
+    std::vector<Asset> m_assets;
+    std::function<void()> m_finished;
+
+    mutable std::mutex m_lock;
+
+    void loadAsset(size_t index);
+};
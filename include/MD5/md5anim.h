@@ -87,10 +87,18 @@ void BuildFrameSkeleton (const struct joint_info_t *jointInfos,
                                 unsigned int num_joints);
 
 /**
- * Load an MD5 animation from file.
+ * Load an MD5 animation from file.  anim is cleared first, so it is ready for
+ * FreeAnim() whether or not this succeeds.
  */
 int ReadMD5Anim (const char *filename, struct md5_anim_t *anim);
 
+/**
+ * The same, from cacheFile if it was compiled from filename as it is now,
+ * otherwise compiling it there for next time (see md5binary.h).
+ */
+int ReadMD5AnimCached (const char *filename, const char *cacheFile,
+                       struct md5_anim_t *anim);
+
 /**
  * Free resources allocated for the animation.
  */
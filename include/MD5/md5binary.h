@@ -0,0 +1,68 @@
+/*
+ * md5binary.h -- compiled md5 models and animations
+ *
+ * Everything ReadMD5Model() and ReadMD5Anim() build from the text files
+ * (joints, each mesh's vertices, triangles and weights, the skinning data
+ * and every frame's skeleton) saved in a versioned layout, so a later load
+ * maps the file and points the structures straight into it.  Nothing is
+ * parsed or copied; the pages are read as they are first touched.
+ * An animation's file can also hold the clip compressed from it (see
+ * md5clip.h), which is small enough to copy out instead.
+ *
+ * A file records a hash of the text it was compiled from, and is ignored
+ * once that no longer matches.  The layout is native endian and only meant
+ * to be read back by the machine that wrote it.
+ */
+
+#ifndef _MD5_MD5BINARY_H_
+#define _MD5_MD5BINARY_H_ 1
+
+#include <stdint.h>
+
+#include "MD5/md5model.h"
+
+struct md5_clip_t;
+
+/**
+ * Hash filename's contents, for the functions below.  0 if it can't be read.
+ */
+int HashMD5Source (const char *filename, uint64_t *hash);
+
+/**
+ * Save mdl, read from text hashing to sourceHash, as filename.
+ */
+int WriteMD5ModelBinary (const char *filename, const struct md5_model_t *mdl,
+                         uint64_t sourceHash);
+
+/**
+ * Map a model saved by WriteMD5ModelBinary(), if it was compiled from text
+ * hashing to sourceHash.  Its arrays are read only, and the meshes have no
+ * textures or GL buffers yet.  FreeModel() unmaps it.
+ */
+int MapMD5ModelBinary (const char *filename, uint64_t sourceHash,
+                       struct md5_model_t *mdl);
+
+/**
+ * The same for animations, along with clip, compressed from anim, if it isn't
+ * NULL.  FreeAnim() unmaps them.
+ */
+int WriteMD5AnimBinary (const char *filename, const struct md5_anim_t *anim,
+                        const struct md5_clip_t *clip, uint64_t sourceHash);
+int MapMD5AnimBinary (const char *filename, uint64_t sourceHash,
+                      struct md5_anim_t *anim);
+
+/**
+ * Read the clip saved with an animation, if it was compiled from text hashing
+ * to sourceHash and compressed within maxPosError and maxAngleError.  The
+ * clip is copied out rather than mapped, for FreeClip() to free.
+ */
+int ReadMD5ClipBinary (const char *filename, uint64_t sourceHash,
+                       float maxPosError, float maxAngleError,
+                       struct md5_clip_t *clip);
+
+/**
+ * Let go of a file mapped by the functions above.
+ */
+void UnmapMD5Binary (void *mapping);
+
+#endif
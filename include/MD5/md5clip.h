@@ -0,0 +1,140 @@
+/*
+ * md5clip.h -- compressed md5 animations
+ *
+ * An md5_anim_t keeps every joint of every frame whole: its name and parent,
+ * which never change, alongside its position and orientation.  A clip keeps
+ * the hierarchy once, and of each frame only the positions, by axis, and the
+ * orientations, packed to 48 bits each (smallest three: the largest
+ * component of the unit quaternion is dropped, as it follows from the other
+ * three, and those are stored in 15 bits apiece).
+ *
+ * Frames that interpolating their neighbours reproduces closely enough can be
+ * dropped too (see CompressAnim()).  The frames kept are the clip's keys;
+ * SampleClip() interpolates between them, so it stands in for
+ * InterpolateSkeletons() whichever frames were dropped.
+ *
+ * Compressing is slow enough to keep: ReadMD5ClipCached() saves the clip in
+ * the animation's compiled file (see md5binary.h) and reads it back.
+ */
+
+#ifndef _MD5_MD5CLIP_H_
+#define _MD5_MD5CLIP_H_ 1
+
+#include "MD5/md5model.h"
+
+/* A joint of the hierarchy, the same in every frame */
+struct md5_clip_joint_t
+{
+    char name[64];
+    int parent;
+};
+
+/* An orientation, smallest three.  The top bits of c[0] and c[1] say which
+ * component was dropped */
+struct md5_packed_quat_t
+{
+    unsigned short c[3];
+};
+
+/* An md5_anim_t, compressed */
+struct md5_clip_t
+{
+    /* of the animation it was compressed from */
+    unsigned int num_frames;
+    unsigned int num_joints;
+    int frameRate;
+
+    /* the bounds it was compressed within (see CompressAnim()) */
+    float maxPosError;
+    float maxAngleError;
+
+    struct md5_clip_joint_t *joints;
+
+    /* the frames kept, in order: the first and last always are.  Frame f is
+     * between keys frameKey[f] and the one after */
+    unsigned int num_keys;
+    int *keyFrames;
+    int *frameKey;
+
+    /* key k's joints are x[k * num_joints] onwards, and so on */
+    float *x;
+    float *y;
+    float *z;
+    struct md5_packed_quat_t *orients;
+};
+
+/* The two keys a clip was last sampled between, unpacked.  An animation
+ * samples between the same two for a few frames running, and then nothing
+ * needs unpacking */
+struct md5_clip_cursor_t
+{
+    /* -1 until anything is unpacked */
+    int key;
+
+    /* the key's joints, then the next key's */
+    vec3_t *pos;
+    quat4_t *orient;
+};
+
+/**
+ * Pack a unit quaternion, and unpack it again.
+ */
+void PackQuat (const quat4_t q, struct md5_packed_quat_t *out);
+void UnpackQuat (const struct md5_packed_quat_t *packed, quat4_t out);
+
+/**
+ * Compress anim into clip, for FreeClip() to free.  Frames are dropped while
+ * interpolating the frames kept puts every joint within maxPosError of where
+ * it was, and turned by no more than maxAngleError radians; with both 0 every
+ * frame is kept.
+ */
+void CompressAnim (const struct md5_anim_t *anim, float maxPosError,
+                   float maxAngleError, struct md5_clip_t *clip);
+void FreeClip (struct md5_clip_t *clip);
+
+/**
+ * Zero clip and make room in it for num_keys keys of num_joints joints over
+ * num_frames frames, leaving clip->num_keys 0 for the caller to fill.
+ */
+void AllocClip (struct md5_clip_t *clip, unsigned int num_frames,
+                unsigned int num_joints, unsigned int num_keys);
+
+/**
+ * Load an MD5 animation as a clip compressed within maxPosError and
+ * maxAngleError (see CompressAnim()), from cacheFile if it holds one that was
+ * compiled from filename as it is now, otherwise compressing it and saving
+ * it there for next time.
+ */
+int ReadMD5ClipCached (const char *filename, const char *cacheFile,
+                       float maxPosError, float maxAngleError,
+                       struct md5_clip_t *clip);
+
+/**
+ * What clip takes in memory, all told.
+ */
+unsigned long ClipBytes (const struct md5_clip_t *clip);
+
+/**
+ * A cursor for sampling clip, and freeing it.
+ */
+void InitClipCursor (const struct md5_clip_t *clip,
+                     struct md5_clip_cursor_t *cursor);
+void FreeClipCursor (struct md5_clip_cursor_t *cursor);
+
+/**
+ * The skeleton interp of the way from frameA on to frameB, as
+ * InterpolateSkeletons() makes it from the whole frames.  Only each joint's
+ * parent, pos and orient are written; names are in clip->joints.  cursor,
+ * if not NULL, keeps the keys unpacked from one call to the next.
+ */
+void SampleClip (const struct md5_clip_t *clip,
+                 struct md5_clip_cursor_t *cursor, int frameA, int frameB,
+                 float interp, struct md5_joint_t *out);
+
+/**
+ * Animate(), for a clip.
+ */
+void AnimateClip (const struct md5_clip_t *clip, struct anim_info_t *animInfo,
+                  double dt);
+
+#endif
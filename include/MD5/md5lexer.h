@@ -0,0 +1,67 @@
+/*
+ * md5lexer.h -- tokens for the md5mesh and md5anim text formats
+ *
+ * Reads a file in place (see MappedFile.h) in one pass.  The loaders take a
+ * word at a time and dispatch on it with LookupKeyword(), then read what that
+ * keyword is followed by, rather than trying each line against every
+ * sscanf() pattern in turn.  Numbers come out the same as scanf()'s.
+ */
+
+#ifndef _MD5_MD5LEXER_H_
+#define _MD5_MD5LEXER_H_ 1
+
+struct md5_lexer_t
+{
+    const char *p;
+    const char *end;
+
+    /* where p is, for error messages */
+    int line;
+};
+
+/* A span of the file.  NOT null terminated! */
+struct md5_token_t
+{
+    const char *start;
+    int length;
+};
+
+void InitLexer (struct md5_lexer_t *lex, const char *begin, const char *end);
+
+/**
+ * The next run of anything but whitespace, past // comments.  0 at the end
+ * of the file.
+ */
+int NextWord (struct md5_lexer_t *lex, struct md5_token_t *word);
+
+/**
+ * Which of keywords word is, or -1.
+ */
+int LookupKeyword (const struct md5_token_t *word,
+                   const char *const *keywords, int num_keywords);
+
+/**
+ * Read c, an int, a float, or text in double quotes (without them).  0 if
+ * that isn't what's next.
+ */
+int ExpectChar (struct md5_lexer_t *lex, char c);
+int ReadInt (struct md5_lexer_t *lex, int *out);
+int ReadFloat (struct md5_lexer_t *lex, float *out);
+int ReadQuoted (struct md5_lexer_t *lex, struct md5_token_t *out);
+
+/**
+ * Read n floats in brackets, as md5 files write vectors: ( x y z ).
+ */
+int ReadVector (struct md5_lexer_t *lex, float *out, int n);
+
+/**
+ * token, cut to fit size bytes and null terminated, into out.
+ */
+void CopyToken (const struct md5_token_t *token, char *out, int size);
+
+/**
+ * Skip what's left of the line.
+ */
+void SkipLine (struct md5_lexer_t *lex);
+
+#endif
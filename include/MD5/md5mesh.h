@@ -60,13 +60,25 @@ void Quat_multVec (const quat4_t q, const vec3_t v, quat4_t out);
 
 void Quat_rotatePoint (const quat4_t q, const vec3_t in, vec3_t out);
 
-GLuint loadTexture( string filename );
+/**
+ * Load a texture map.  flags are TextureRegistry's TEXTURE_FLAG_* for maps
+ * that aren't colours, such as normal maps.
+ */
+GLuint loadTexture( string filename, unsigned int flags = 0 );
 
 /**
- * Load an MD5 model from file.
+ * Load an MD5 model from file.  mdl is cleared first, so it is ready for
+ * FreeModel() whether or not this succeeds.
  */
 int ReadMD5Model (const char *filename, struct md5_model_t *mdl);
 
+/**
+ * The same, from cacheFile if it was compiled from filename as it is now,
+ * otherwise compiling it there for next time (see md5binary.h).
+ */
+int ReadMD5ModelCached (const char *filename, const char *cacheFile,
+                        struct md5_model_t *mdl);
+
 /**
  * Free resources allocated for the model.
  */
@@ -74,15 +86,49 @@ void FreeModel (struct md5_model_t *mdl);
 
 /**
  * Prepare a mesh for drawing.  Compute mesh's final vertex positions
- * given a skeleton.  Put the vertices in vertex arrays.
+ * given a skeleton's palette (see BuildPalette()), into vertices: at least
+ * mesh->num_verts of them, from AllocSkinnedVertices() say.
  */
-void PrepareMesh (const struct md5_mesh_t *mesh, const struct md5_joint_t *skeleton);
+void PrepareMesh (const struct md5_mesh_t *mesh,
+                  const struct md5_matrix_t *palette, vec3_t *vertices);
 
-void DrawMesh ( const struct md5_mesh_t *mesh );
+/**
+ * Draw a mesh skinned to vertices, or, when that's NULL, to the vertices
+ * it was last drawn with.
+ */
+void DrawMesh (const struct md5_mesh_t *mesh, const vec3_t *vertices);
+
+/**
+ * A mesh in GL buffers, to be skinned on the GPU by glsl/md5shader.v.glsl.
+ */
+struct md5_gpu_mesh_t
+{
+    GLuint vertexBuffer; /* md5_gpu_vertex_t (see md5skin.h) */
+};
 
-void AllocVertexArrays();
+/**
+ * How many joints prog can skin on the GPU; 0 if it can't.
+ */
+int MaxGPUSkinningJoints (const ShaderProgram &prog);
+
+/**
+ * Upload a mesh, with vertices from BuildGPUVertices(), to skin on the GPU.
+ */
+void UploadGPUMesh (const struct md5_mesh_t *mesh,
+                    const struct md5_gpu_vertex_t *vertices,
+                    struct md5_gpu_mesh_t *gpu);
+
+void FreeGPUMesh (struct md5_gpu_mesh_t *gpu);
+
+/**
+ * Tell prog (in use) to skin with palette, or, when it's NULL, that the
+ * vertices it gets were skinned already.
+ */
+void SetSkinningPalette (const ShaderProgram &prog,
+                         const struct md5_matrix_t *palette, int num_joints);
 
-void FreeVertexArrays ();
+void DrawGPUMesh (const struct md5_mesh_t *mesh,
+                  const struct md5_gpu_mesh_t *gpu);
 
 /**
  * Draw the skeleton as lines and points (for joints).
@@ -96,6 +96,15 @@ struct md5_mesh_t
     struct md5_triangle_t *triangles;
     struct md5_weight_t *weights;
     struct md5_texture_t textures[4];
+
+    /* the weights again, for skinning (see md5skin.h) */
+    struct md5_skin_t *skin;
+
+    /* GL buffers: triangles and texels, which never change, and room for
+     * the skinned positions streamed in to draw them */
+    unsigned int indexBuffer;
+    unsigned int texelBuffer;
+    unsigned int positionBuffer;
     
     int num_verts;
     int num_tris;
@@ -109,6 +118,12 @@ struct md5_model_t
 {
     struct md5_joint_t *baseSkel;
     struct md5_mesh_t *meshes;
+
+    /* undoes each joint of baseSkel, for BuildPalette() (see md5skin.h) */
+    struct md5_matrix_t *inverseBind;
+
+    /* the compiled file the arrays point into, if mapped (see md5binary.h) */
+    void *mapping;
     
     unsigned int num_joints;
     unsigned int num_meshes;
@@ -123,6 +138,9 @@ struct md5_anim_t
     
     struct md5_joint_t **skelFrames;
     struct md5_bbox_t *bboxes;
+
+    /* the compiled file the frames point into, if mapped (see md5binary.h) */
+    void *mapping;
 };
 
 /* Animation info */
@@ -150,11 +168,11 @@ void Quat_slerp (const quat4_t qa, const quat4_t qb, float t, quat4_t out);
  * md5mesh prototypes
  */
 int ReadMD5Model (const char *filename, struct md5_model_t *mdl);
+int ReadMD5ModelCached (const char *filename, const char *cacheFile,
+                        struct md5_model_t *mdl);
 void FreeModel (struct md5_model_t *mdl);
 void PrepareMesh (const struct md5_mesh_t *mesh,
-                  const struct md5_joint_t *skeleton);
-void AllocVertexArrays ();
-void FreeVertexArrays ();
+                  const struct md5_matrix_t *palette, vec3_t *vertices);
 void DrawSkeleton (const struct md5_joint_t *skeleton, int num_joints);
 
 /**
@@ -163,6 +181,8 @@ void DrawSkeleton (const struct md5_joint_t *skeleton, int num_joints);
 int CheckAnimValidity (const struct md5_model_t *mdl,
                        const struct md5_anim_t *anim);
 int ReadMD5Anim (const char *filename, struct md5_anim_t *anim);
+int ReadMD5AnimCached (const char *filename, const char *cacheFile,
+                       struct md5_anim_t *anim);
 void FreeAnim (struct md5_anim_t *anim);
 void InterpolateSkeletons (const struct md5_joint_t *skelA,
                            const struct md5_joint_t *skelB,
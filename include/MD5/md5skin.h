@@ -0,0 +1,150 @@
+/*
+ * md5skin.h -- vectorized skinning for md5 meshes
+ *
+ * A mesh's weights, repacked at load time into blocks of vertices laid out
+ * structure-of-arrays, one influence per slot, so SkinVertices() can skin a
+ * block at once with SSE2 or AVX2 (picked at runtime by what the CPU
+ * supports) rather than one Quat_rotatePoint() per weight.
+ *
+ * Each weight is kept where it sits in the bind pose (the model's base
+ * skeleton), and skinned by its joint's palette matrix: the joint's pose now
+ * times the inverse of its pose then.  That is worked out once per joint per
+ * frame (BuildPalette()), not once per weight.  Weights a vertex has on the
+ * same joint go through the same matrix, so they are summed into one
+ * influence.  Every block has as many slots as its busiest vertex; the rest
+ * pad with a bias of 0.
+ */
+
+#ifndef _MD5_MD5SKIN_H_
+#define _MD5_MD5SKIN_H_ 1
+
+#include "MD5/md5model.h"
+
+/* vertices skinned together: one AVX2 register of floats */
+#define MD5_SKIN_BLOCK 8
+
+/* An affine transform: rows of x, y and z, the last column a translation */
+struct md5_matrix_t
+{
+    float m[3][4];
+};
+
+/* One influence on each vertex of a block */
+struct md5_skin_slot_t
+{
+    int joint[MD5_SKIN_BLOCK];
+    float bias[MD5_SKIN_BLOCK];
+
+    /* bind pose position, already scaled by bias */
+    float x[MD5_SKIN_BLOCK];
+    float y[MD5_SKIN_BLOCK];
+    float z[MD5_SKIN_BLOCK];
+};
+
+/* A mesh's weights, ready to skin */
+struct md5_skin_t
+{
+    int num_verts;
+    int num_blocks;
+    /* one past the highest joint any weight is on */
+    int num_joints;
+
+    /* block i is slots[first_slot[i]] up to slots[first_slot[i + 1]] */
+    int *first_slot;
+    struct md5_skin_slot_t *slots;
+
+    /* first_slot and slots point into a mapped file (see md5binary.h) */
+    int mapped;
+};
+
+/* joints a vertex skinned on the GPU can have */
+#define MD5_GPU_INFLUENCES 12
+
+/**
+ * A vertex for skinning on the GPU: where it is in the bind pose, moved by
+ * its joints' palette matrices, blended by weight.  Unused joints weigh 0.
+ */
+struct md5_gpu_vertex_t
+{
+    vec3_t pos;
+    vec2_t st;
+
+    unsigned char joint[MD5_GPU_INFLUENCES];
+    float weight[MD5_GPU_INFLUENCES];
+};
+
+/* What SkinVertices() runs on */
+enum md5_skin_level_t
+{
+    MD5_SKIN_SCALAR = 0,
+    MD5_SKIN_SSE2,
+    MD5_SKIN_AVX2
+};
+
+/**
+ * The best level this CPU (and compiler) supports, and the level skinning
+ * runs at.  LimitSkinLevel() caps the latter, mostly for benchmarking.
+ */
+enum md5_skin_level_t SupportedSkinLevel ();
+enum md5_skin_level_t SkinLevel ();
+void LimitSkinLevel (enum md5_skin_level_t level);
+
+/**
+ * Where a joint takes points on it: its orient (scaled by its length, as
+ * Quat_rotatePoint() does), then its position.
+ */
+void JointMatrix (const struct md5_joint_t *joint, struct md5_matrix_t *out);
+
+/**
+ * The inverse of each of a bind pose's joint matrices, for BuildPalette().
+ */
+void InverseBindMatrices (const struct md5_joint_t *bindSkel, int num_joints,
+                          struct md5_matrix_t *out);
+
+/**
+ * Each joint's palette matrix, from the bind pose to skeleton.  Anything
+ * posed in the bind pose follows the joint when multiplied by it.
+ */
+void BuildPalette (const struct md5_joint_t *skeleton,
+                   const struct md5_matrix_t *inverseBind, int num_joints,
+                   struct md5_matrix_t *palette);
+
+/**
+ * point, multiplied by matrix.
+ */
+void TransformPoint (const struct md5_matrix_t *matrix, const vec3_t point,
+                     vec3_t out);
+
+/**
+ * Repack a mesh's weights, put in the bind pose by bindSkel, for FreeSkin()
+ * to free.
+ */
+struct md5_skin_t *BuildSkin (const struct md5_mesh_t *mesh,
+                              const struct md5_joint_t *bindSkel);
+void FreeSkin (struct md5_skin_t *skin);
+
+/**
+ * A mesh's vertices (weights from mesh->skin) for skinning on the GPU, for
+ * free() to free.  NULL if a vertex has more than MD5_GPU_INFLUENCES joints,
+ * or one past 255.
+ */
+struct md5_gpu_vertex_t *BuildGPUVertices (const struct md5_mesh_t *mesh);
+
+/**
+ * Every vertex of skin, posed by palette (at least skin->num_joints
+ * matrices from BuildPalette()), into out.  The same as PrepareMesh() always
+ * did, give or take rounding.
+ */
+void SkinVertices (const struct md5_skin_t *skin,
+                   const struct md5_matrix_t *palette, vec3_t *out);
+
+/**
+ * Somewhere to skin num_verts vertices to, for FreeSkinnedVertices() to give
+ * back.  Arrays given back are kept, by size, for the next instance of the
+ * same mesh to reuse rather than going back to malloc().  Both are safe to
+ * call from any thread.
+ */
+vec3_t *AllocSkinnedVertices (int num_verts);
+void FreeSkinnedVertices (vec3_t *vertices, int num_verts);
+
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 #include "Utils.hpp"
 
+#include "AssetLoader.hpp"
 #include "Cameras.hpp"
 #include "RenderPass.hpp"
 #include "Shader.hpp"
@@ -14,6 +15,10 @@
 // Pointers stored here can expect to live the duration of the program.
 extern std::vector<WorldObject *> drawn;
 
+// Everything the scene loads in the background. The scene isn't updated or
+// drawn until it's ready().
+extern AssetLoader assetLoader;
+
 // Cameras
 extern FreeCamera freecam;
 extern ArcBallCamera arcballcam;
@@ -3,6 +3,10 @@
 void trace_helper(const char *file, int line, const char *func);
 void check_helper(const char *file, int line);
 
+// SOIL only remembers the last result for the whole process. While images are
+// being decoded on other threads it says nothing about ours, so turn it off.
+void enable_SOIL_checks(bool enable);
+
 #ifdef NDEBUG
 
 #define trace()
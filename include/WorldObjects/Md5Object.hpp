@@ -3,10 +3,13 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "WorldObjects/WorldObjectBase.hpp"
 #include "MD5/md5mesh.h" //includes md5model.h already
 #include "MD5/md5anim.h"
+#include "MD5/md5clip.h"
+#include "MD5/md5skin.h"
 
 class Md5Object : public WorldObject {
 public:
@@ -17,6 +20,37 @@ public:
 
     void update(double t, double dt) override;
 
+    // Skin the model in its pose this frame, if the CPU does its skinning and
+    // it hasn't yet. Drawing does it anyway; this is so it can be done ahead,
+    // off the GL thread.
+    void skin() const;
+
+    // Skin all of objects on the workers, at once.
+    static void skinAll(const std::vector<Md5Object *> &objects);
+
+    // How often a draw reused the vertices of a pose skinned for an earlier
+    // frame, and how often a pose had to be skinned.
+    unsigned long skinHits() const { return m_skinHits; }
+    unsigned long skinMisses() const { return m_skinMisses; }
+
+    // ==== Joints ============================================================
+    // Things attached to the model can follow one of its joints (bones) by
+    // looking it up once with jointIndex() and asking where it is each frame.
+
+    // The index of the joint called name (without quotes), or -1.
+    int jointIndex(const std::string &name) const;
+
+    // Where joint is in the world this frame.
+    Vec jointPos(int joint) const;
+
+    // Where a point, given in the model's bind pose (as the .md5mesh has it),
+    // is in the world this frame if it moves with joint.
+    Vec attachedPos(int joint, const Vec &bindPoint) const;
+
+    // Every joint's palette matrix this frame (see BuildPalette()).
+    const struct md5_matrix_t *palette() const { return m_palette.data(); }
+    int numJoints() const { return m_model.num_joints; }
+
 protected:
     virtual void internalDraw() const override;
 
@@ -24,11 +58,37 @@ private:
     bool loadModel(const std::string &filename);
     bool loadAnimation(const std::string &filename);
 
-    struct md5_model_t m_model;
-    struct md5_anim_t m_animation;
+    struct md5_model_t m_model = {};
+
+    // The animation, compressed (see md5clip.h), and the keys it was last
+    // sampled between.
+    struct md5_clip_t m_clip          = {};
+    struct md5_clip_cursor_t m_cursor = {-1, nullptr, nullptr};
     struct anim_info_t m_anim_info;
     struct md5_joint_t *m_skeleton;
 
+    // m_skeleton against the bind pose, rebuilt whenever m_skeleton moves.
+    std::vector<struct md5_matrix_t> m_palette;
+
+    // Which pose m_skeleton is in: the frames it's between and how far, and
+    // a count bumped every time that changes.
+    int m_poseFrames[2]            = {-1, -1};
+    float m_poseInterp             = 0.0f;
+    unsigned long m_poseGeneration = 1;
+
+    // Each mesh, for the vertex shader to skin with m_palette. Empty if the
+    // shader can't, and the CPU does it instead.
+    std::vector<struct md5_gpu_mesh_t> m_gpuMeshes;
+
+    // Otherwise, where each mesh was skinned to, the pose it was skinned in
+    // and the pose GL was last given.
+    mutable std::vector<vec3_t *> m_vertices;
+    mutable unsigned long m_skinnedGeneration  = 0;
+    mutable unsigned long m_uploadedGeneration = 0;
+
+    mutable unsigned long m_skinHits   = 0;
+    mutable unsigned long m_skinMisses = 0;
+
     bool m_animated;
     float m_scale;
 };
@@ -11,9 +11,24 @@ public:
     WorldObjModel();
     bool loadObjectFile(const std::string &filename);
 
+    // How many pixels tall something one unit tall and one unit in front of
+    // the camera is drawn, for picking levels of detail. Set once a frame,
+    // whenever the projection or viewport might have changed.
+    static void projectionScale(float pixels) { s_projectionScale = pixels; }
+
 protected:
     virtual void internalDraw() const override;
 
+    // The simplest level of detail of the model that's still within a pixel
+    // of the real thing, where it's nearest the camera.
+    unsigned int levelOfDetail() const;
+
 private:
     paone::Object m_obj;
+
+    // The model's bounding box, in model space.
+    Vec m_lo;
+    Vec m_hi;
+
+    static float s_projectionScale;
 };
@@ -0,0 +1,131 @@
+#include "AssetLoader.hpp"
+
+#include "Utils.hpp"
+
+#include "GLTaskQueue.h"
+
+#include <fstream>
+#include <thread>
+
+// How much an asset with no files we can measure weighs: a small model.
+static const double DEFAULT_WEIGHT = 64 * 1024;
+
+static double sizeOnDisk(const std::vector<std::string> &files) {
+    double size = 0;
+    for (const auto &file : files) {
+        std::ifstream in(file, std::ios::binary | std::ios::ate);
+        if (in) {
+            size += as<double>(in.tellg());
+        }
+    }
+    // Nothing might have been found, and that shouldn't set errno off later.
+    errno = 0;
+    return size > 0 ? size : DEFAULT_WEIGHT;
+}
+
+void AssetLoader::add(const std::string &name, std::function<bool()> load,
+                      std::function<void(bool)> done,
+                      const std::vector<std::string> &files, bool required) {
+    Asset asset;
+    asset.name     = name;
+    asset.load     = load;
+    asset.done     = done;
+    asset.weight   = sizeOnDisk(files);
+    asset.required = required;
+    asset.state    = State::Queued;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_assets.push_back(asset);
+}
+
+void AssetLoader::start(std::function<void()> finished) {
+    m_finished = finished;
+
+    // SOIL keeps one "last result" for the whole process, so once images
+    // are decoded on other threads, it says nothing about ours.
+    enable_SOIL_checks(false);
+
+    for (size_t i = 0; i < m_assets.size(); ++i) {
+        std::thread(&AssetLoader::loadAsset, this, i).detach();
+    }
+}
+
+void AssetLoader::loadAsset(size_t index) {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_assets[index].state = State::Loading;
+    }
+
+    auto start = timer_clock::now();
+    bool ok    = m_assets[index].load();
+    auto took  = timer_clock::now() - start;
+
+    paone::GLTaskQueue::shared().post([this, index, ok, took]() {
+        Asset &asset = m_assets[index];
+        info("Loaded %s in %.3fs.",
+             asset.name,
+             std::chrono::duration<double>(took).count());
+
+        if (asset.done) {
+            asset.done(ok);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            asset.state = State::Done;
+        }
+
+        if (finished()) {
+            enable_SOIL_checks(true);
+            if (m_finished) {
+                m_finished();
+            }
+        }
+    });
+}
+
+float AssetLoader::progress() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    double total = 0, done = 0;
+    for (const auto &asset : m_assets) {
+        total += asset.weight;
+        if (asset.state == State::Done) {
+            done += asset.weight;
+        }
+    }
+    return total > 0 ? as<float>(done / total) : 1.0f;
+}
+
+std::string AssetLoader::status() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    std::string loading;
+    for (const auto &asset : m_assets) {
+        if (asset.state != State::Done) {
+            loading += (loading.empty() ? "" : ", ") + asset.name;
+        }
+    }
+    return loading;
+}
+
+bool AssetLoader::ready() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (const auto &asset : m_assets) {
+        if (asset.required && asset.state != State::Done) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AssetLoader::finished() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (const auto &asset : m_assets) {
+        if (asset.state != State::Done) {
+            return false;
+        }
+    }
+    return true;
+}
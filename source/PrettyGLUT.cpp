@@ -3,6 +3,9 @@
 #include "Cameras.hpp"
 #include "Shader.hpp"
 
+#include "GLTaskQueue.h"
+#include "TextureRegistry.h"
+
 #include <algorithm>
 
 // NVidia's drivers (e.g. for Optimus) look for this symbol.
@@ -56,6 +59,8 @@ GLsizei fbo_height = fbo_width;
 // Things to draw
 std::vector<WorldObject *> drawn = std::vector<WorldObject *>();
 
+AssetLoader assetLoader;
+
 std::vector<RenderPass> renderPasses;
 
 int passIdx = -1;
@@ -121,7 +126,7 @@ void renderHUD() {
     // What's the largest number we ever hope to see?
     static const size_t numLength = 12;
     static const size_t pixelsFromRight
-        = (numLength + std::string(" ms / frame").size() + 1) * charWidth;
+        = (numLength + std::string(" state changes").size() + 1) * charWidth;
 
     static const size_t lineSpacing = charHeight;
 
@@ -159,6 +164,23 @@ void renderHUD() {
 
     drawText(tfm::format("%s resolution", dims), pos, white);
 
+    // What the models asked of OpenGL this frame.
+    auto stats = paone::Object::drawStats();
+    pos.y -= lineSpacing;
+    drawText(tfm::format("%*u draw calls", numLength, stats.drawCalls),
+             pos,
+             white);
+    pos.y -= lineSpacing;
+    drawText(tfm::format("%*u state changes", numLength, stats.stateChanges()),
+             pos,
+             white);
+
+    // Whatever the scene could start without.
+    if (!assetLoader.finished()) {
+        pos.y -= lineSpacing;
+        drawText(tfm::format("Loading %s", assetLoader.status()), pos, white);
+    }
+
     glEnable(GL_LIGHTING);
 }
 
@@ -175,9 +197,23 @@ void resize(int w, int h) {
     gluPerspective(FOV, aspectRatio(), 0.1, 1e6);
 }
 
+void renderLoadingScreen(float progress, const std::string &status);
+
 void render() {
+    paone::Object::resetDrawStats();
+
     glDrawBuffer(GL_BACK);
 
+    // Keep the loading screen up until there's a scene to show.
+    if (!assetLoader.ready()) {
+        resize(windowWidth, windowHeight);
+        renderLoadingScreen(assetLoader.progress(), assetLoader.status());
+
+        glutSwapBuffers();
+        updateFrameCounter();
+        return;
+    }
+
     glClearColor(0.0, 0.0, 0.0, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -196,6 +232,10 @@ void render() {
         glLoadIdentity();
         activeCam->adjustGLU();
 
+        // What resize()'s perspective makes of a unit at unit distance.
+        WorldObjModel::projectionScale(
+            fbo_height / (2.0f * std::tan(FOV * PI / 360.0f)));
+
         pushMatrixAnd([&]() {
             auto scale = 1000.0f;
             glScalef(scale, scale, scale);
@@ -425,10 +465,8 @@ void printOpenGLInformation() {
 
 void loadLoadingScreen() {
     glChk();
-    loading = SOIL_load_OGL_texture(
+    loading = paone::TextureRegistry::shared().loadFile(
         "assets/textures/Legend-of-Zelda-Ocarina-of-Time-Title-Screen.png",
-        SOIL_LOAD_AUTO,
-        SOIL_CREATE_NEW_ID,
         SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB
             | SOIL_FLAG_COMPRESS_TO_DXT);
     glChk();
@@ -445,15 +483,18 @@ void loadLoadingScreen() {
     glChk();
 }
 
-void renderLoadingScreen() {
+// Draws to whichever buffer is current, with a bar for how far along loading
+// is and what it's still waiting on.
+void renderLoadingScreen(float progress, const std::string &status) {
     if (loading == 0) {
         info("Loading 'loading screen'.");
         loadLoadingScreen();
     }
     glChk();
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
     glDisable(GL_LIGHTING);
-
-    glDrawBuffer(GL_FRONT);
+    // The bar is drawn right over the picture.
+    glDisable(GL_DEPTH_TEST);
 
     glChk();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -487,20 +528,39 @@ void renderLoadingScreen() {
             glVertex2f(0.0f, 1.0f);
 
             glEnd();
+
+            glDisable(GL_TEXTURE_2D);
+
+            // The bar, along the bottom.
+            const float left = 0.1f, right = 0.9f;
+            const float bottom = 0.05f, top = 0.07f;
+            const float filled
+                = left + (right - left) * clamp(progress, 0.0f, 1.0f);
+
+            glColor3f(0.1f, 0.1f, 0.1f);
+            glRectf(left, bottom, right, top);
+            glColor3f(1.0f, 1.0f, 1.0f);
+            glRectf(left, bottom, filled, top);
+
+            if (!status.empty()) {
+                drawText(tfm::format("Loading %s", status),
+                         Vec(left, top + 0.01f),
+                         Color(1.0, 1.0, 1.0));
+            }
         });
 
         glMatrixMode(GL_PROJECTION);
     });
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
     glChk();
 }
 
 void initSkybox() {
-    skybox = SOIL_load_OGL_texture("assets/textures/clouds-skybox.jpg",
-                                   SOIL_LOAD_AUTO,
-                                   SOIL_CREATE_NEW_ID,
-                                   SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y
-                                       | SOIL_FLAG_NTSC_SAFE_RGB
-                                       | SOIL_FLAG_COMPRESS_TO_DXT);
+    skybox = paone::TextureRegistry::shared().loadFile(
+        "assets/textures/clouds-skybox.jpg",
+        SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB
+            | SOIL_FLAG_COMPRESS_TO_DXT);
     glChk();
     {
         glBindTexture(GL_TEXTURE_2D, skybox);
@@ -532,11 +592,18 @@ void doFrame(int) {
     auto dt          = now - then;
     then             = now;
 
+    // Whatever the loaders need done with OpenGL. While the loading screen is
+    // up it can have most of the frame, after that it mustn't cause a hitch.
+    auto budget = assetLoader.ready() ? 0.004 : 1.0 / 30;
+    paone::GLTaskQueue::shared().runPending(budget);
+
     // TODO: Pass a t which changes. We're pushing out all of our precision
     // with really big numbers.
     static double running = 0.0;
     running += duration<double>(dt).count();
-    updateScene(running, duration<double>(dt).count());
+    if (assetLoader.ready()) {
+        updateScene(running, duration<double>(dt).count());
+    }
 
     glutPostRedisplay();
 }
@@ -707,7 +774,8 @@ void initGLUT(int *argcp, char **argv) {
     glutCreateWindow(windowTitle);
 
     // Display this until we start rendering "for real".
-    renderLoadingScreen();
+    glDrawBuffer(GL_FRONT);
+    renderLoadingScreen(0.0f, "");
 
     // Our boat-load of callbacks.
     glutKeyboardFunc(normalKeysDown);
@@ -734,6 +802,9 @@ void initGLUT(int *argcp, char **argv) {
 }
 
 void initOpenGL(int *argcp, char **argv) {
+    // Loaders on other threads hand their OpenGL work back to this one.
+    paone::GLTaskQueue::shared().makeGLThread();
+
     initGLUT(argcp, argv);
 
     glewInit();
@@ -1,5 +1,10 @@
 #include "Utils.hpp"
 
+#include "GLTaskQueue.h"
+
+#include <atomic>
+#include <vector>
+
 #ifndef _WIN32
 #include "execinfo.h"
 #endif
@@ -39,6 +44,11 @@ void trace_helper(const char *file, int line, const char *func) {
 }
 
 void check_opengl(const char *file, int line) {
+    // Loader threads have no context to ask.
+    if (!paone::GLTaskQueue::shared().onGLThread()) {
+        return;
+    }
+
     const char *str = nullptr;
 
     int err = GL_NO_ERROR;
@@ -81,7 +91,15 @@ void check_errno(const char *file, int line) {
     }
 }
 
+static std::atomic<bool> SOIL_checks_enabled(true);
+
+void enable_SOIL_checks(bool enable) { SOIL_checks_enabled = enable; }
+
 void check_SOIL(const char *file, int line) {
+    if (!SOIL_checks_enabled) {
+        return;
+    }
+
     std::string err = SOIL_last_result();
     if (err == "Image loaded as an OpenGL texture" || err == "SOIL initialized"
         || err == "Image loaded") {
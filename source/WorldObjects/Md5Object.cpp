@@ -2,6 +2,16 @@
 
 #include "Utils/Logging.hpp"
 
+#include "GLTaskQueue.h"
+#include "WorkerPool.h"
+
+// How far a frame dropped from an animation may leave a joint from where the
+// file has it: in model units, and in radians. FDL's walk keeps 11 of its 21
+// frames at this, and no vertex moves by more than about 0.2% of his size
+// (see bench_md5_clip).
+static const float MAX_POSITION_ERROR = 0.03f;
+static const float MAX_ANGLE_ERROR    = 0.006f;
+
 Md5Object::Md5Object(const std::string &modelFile, float scale) {
     m_skeleton = NULL;
     m_animated = false;
@@ -28,28 +38,46 @@ Md5Object::Md5Object(const std::string &modelFile,
 
 
 Md5Object::~Md5Object() {
+    if (m_skinHits || m_skinMisses)
+        info("Skinned %lu poses, reused %lu\n", m_skinMisses, m_skinHits);
+
+    for (auto &gpu : m_gpuMeshes)
+        FreeGPUMesh(&gpu);
+    for (unsigned int i = 0; i < m_vertices.size(); ++i)
+        FreeSkinnedVertices(m_vertices[i], m_model.meshes[i].num_verts);
+
     FreeModel(&m_model);
-    FreeAnim(&m_animation);
+    FreeClipCursor(&m_cursor);
+    FreeClip(&m_clip);
     if (m_animated && m_skeleton)
         free(m_skeleton);
-
-    FreeVertexArrays();
 }
 
 
 void Md5Object::internalDraw() const {
-    md5_mesh_t mesh;
-
     glPushMatrix();
     glDisable(GL_CULL_FACE);
     glEnable(GL_LIGHTING);
     glTranslatef(pos().x, pos().y, pos().z);
     glRotatef(-90.f, 1.0, 0.0, 0.0); // orient models along Y instead of Z
     glScalef(m_scale, m_scale, m_scale);
-    for (unsigned int i = 0; i < m_model.num_meshes; ++i) {
-        mesh = m_model.meshes[i];
-        PrepareMesh(&mesh, m_skeleton);
-        DrawMesh(&mesh);
+    if (!m_gpuMeshes.empty()) {
+        SetSkinningPalette(m_shader, m_palette.data(), m_model.num_joints);
+        for (unsigned int i = 0; i < m_model.num_meshes; ++i)
+            DrawGPUMesh(&m_model.meshes[i], &m_gpuMeshes[i]);
+    } else {
+        skin();
+        SetSkinningPalette(m_shader, nullptr, 0);
+
+        // GL still has the positions if the pose hasn't moved since, and
+        // only then was skinning it again skipped: skinAll() having done it
+        // already this frame doesn't count.
+        bool upload          = m_uploadedGeneration != m_poseGeneration;
+        m_uploadedGeneration = m_poseGeneration;
+        if (!upload)
+            ++m_skinHits;
+        for (unsigned int i = 0; i < m_model.num_meshes; ++i)
+            DrawMesh(&m_model.meshes[i], upload ? m_vertices[i] : nullptr);
     }
     glPopMatrix();
 
@@ -60,38 +88,83 @@ void Md5Object::internalDraw() const {
 
 bool Md5Object::loadModel(const std::string &filename) {
 
-    setupMD5Shaders(m_shader,
-                    "glsl/md5shader.v.glsl",
-                    "glsl/md5shader.f.glsl"); // setup our shaders
+    paone::GLTaskQueue::shared().run([&]() {
+        setupMD5Shaders(m_shader,
+                        "glsl/md5shader.v.glsl",
+                        "glsl/md5shader.f.glsl"); // setup our shaders
+    });
 
-    if (!ReadMD5Model(filename.c_str(), &m_model)) {
+    if (!ReadMD5ModelCached(
+            filename.c_str(), (filename + ".md5cache").c_str(), &m_model)) {
         error("Could not load md5 model from %s\n", filename.c_str());
         return false;
     }
     errno = 0; // will always have not found .tga textures
 
     m_skeleton = m_model.baseSkel;
+    m_palette.resize(m_model.num_joints);
+    BuildPalette(m_skeleton,
+                 m_model.inverseBind,
+                 m_model.num_joints,
+                 m_palette.data());
 
-    AllocVertexArrays();
+    // Skin on the GPU if the shader and every mesh are up to it.
+    std::vector<struct md5_gpu_vertex_t *> vertices;
+    for (unsigned int i = 0; i < m_model.num_meshes; ++i) {
+        vertices.push_back(BuildGPUVertices(&m_model.meshes[i]));
+        if (!vertices.back())
+            break;
+    }
+
+    paone::GLTaskQueue::shared().run([&]() {
+        if (vertices.empty() || vertices.size() != m_model.num_meshes
+            || !vertices.back()
+            || MaxGPUSkinningJoints(m_shader) < (int)m_model.num_joints)
+            return;
+
+        m_gpuMeshes.resize(m_model.num_meshes);
+        for (unsigned int i = 0; i < m_model.num_meshes; ++i)
+            UploadGPUMesh(&m_model.meshes[i], vertices[i], &m_gpuMeshes[i]);
+    });
+
+    for (auto v : vertices)
+        free(v);
+
+    if (m_gpuMeshes.empty()) {
+        warn("Skinning %s on the CPU\n", filename.c_str());
+        for (unsigned int i = 0; i < m_model.num_meshes; ++i)
+            m_vertices.push_back(
+                AllocSkinnedVertices(m_model.meshes[i].num_verts));
+    }
 
     return true;
 }
 
 bool Md5Object::loadAnimation(const std::string &filename) {
-    if (!ReadMD5Anim(filename.c_str(), &m_animation)) {
+    // only the compressed clip is kept, and it's compiled with the rest.
+    if (!ReadMD5ClipCached(filename.c_str(),
+                           (filename + ".md5cache").c_str(),
+                           MAX_POSITION_ERROR,
+                           MAX_ANGLE_ERROR,
+                           &m_clip)) {
         error("Could not load md5 animation from %s\n", filename.c_str());
-        FreeAnim(&m_animation);
         return false;
     }
+    InitClipCursor(&m_clip, &m_cursor);
+    info("Compressed %s to %u of %u frames, %lu bytes\n",
+         filename.c_str(),
+         m_clip.num_keys,
+         m_clip.num_frames,
+         ClipBytes(&m_clip));
 
     m_anim_info.curr_frame = 0;
     m_anim_info.next_frame = 1;
 
     m_anim_info.last_time = 0;
-    m_anim_info.max_time  = 1.0 / m_animation.frameRate;
+    m_anim_info.max_time  = 1.0 / m_clip.frameRate;
 
     m_skeleton = (struct md5_joint_t *)malloc(sizeof(struct md5_joint_t)
-                                              * m_animation.num_joints);
+                                              * m_clip.num_joints);
     m_animated = true;
 
     return true;
@@ -103,14 +176,86 @@ void Md5Object::update(double t, double dt) {
     // handle updating the skeleton for animation
     if (m_animated) {
         // get current and next frames
-        Animate(&m_animation, &m_anim_info, dt);
+        AnimateClip(&m_clip, &m_anim_info, dt);
+
+        // nothing moves unless the pose does (paused, or drawn faster than
+        // it animates).
+        float interp
+            = as<float>(m_anim_info.last_time * m_clip.frameRate);
+        if (m_anim_info.curr_frame == m_poseFrames[0]
+            && m_anim_info.next_frame == m_poseFrames[1]
+            && interp == m_poseInterp)
+            return;
+        m_poseFrames[0] = m_anim_info.curr_frame;
+        m_poseFrames[1] = m_anim_info.next_frame;
+        m_poseInterp    = interp;
+        ++m_poseGeneration;
 
         // interpolate the two frames' skeletons
-        InterpolateSkeletons(
-            m_animation.skelFrames[m_anim_info.curr_frame],
-            m_animation.skelFrames[m_anim_info.next_frame],
-            m_animation.num_joints,
-            as<float>(m_anim_info.last_time * m_animation.frameRate),
-            m_skeleton);
+        SampleClip(&m_clip,
+                   &m_cursor,
+                   m_anim_info.curr_frame,
+                   m_anim_info.next_frame,
+                   interp,
+                   m_skeleton);
+
+        // once per joint, rather than once per weight when skinning.
+        BuildPalette(m_skeleton,
+                     m_model.inverseBind,
+                     m_model.num_joints,
+                     m_palette.data());
     }
+}
+
+
+void Md5Object::skin() const {
+    if (m_vertices.empty() || m_skinnedGeneration == m_poseGeneration)
+        return;
+
+    ++m_skinMisses;
+    for (unsigned int i = 0; i < m_model.num_meshes; ++i)
+        PrepareMesh(&m_model.meshes[i], m_palette.data(), m_vertices[i]);
+    m_skinnedGeneration = m_poseGeneration;
+}
+
+
+void Md5Object::skinAll(const std::vector<Md5Object *> &objects) {
+    std::vector<std::function<void()>> jobs;
+    for (Md5Object *object : objects) {
+        if (object->m_skinnedGeneration != object->m_poseGeneration
+            && !object->m_vertices.empty())
+            jobs.push_back([object]() { object->skin(); });
+    }
+
+    if (jobs.size() > 1)
+        paone::WorkerPool::shared().run(jobs);
+    else if (!jobs.empty())
+        jobs[0]();
+}
+
+
+int Md5Object::jointIndex(const std::string &name) const {
+    // the names are kept as the file has them, quotes and all.
+    std::string quoted = "\"" + name + "\"";
+    for (unsigned int i = 0; i < m_model.num_joints; ++i) {
+        if (quoted == m_model.baseSkel[i].name)
+            return i;
+    }
+    return -1;
+}
+
+
+Vec Md5Object::jointPos(int joint) const {
+    const float *bind = m_model.baseSkel[joint].pos;
+    return attachedPos(joint, Vec(bind[0], bind[1], bind[2]));
+}
+
+
+Vec Md5Object::attachedPos(int joint, const Vec &bindPoint) const {
+    vec3_t in = {bindPoint.x, bindPoint.y, bindPoint.z}, out;
+    TransformPoint(&m_palette[joint], in, out);
+
+    // as internalDraw() places the model: scaled, turned to stand along Y,
+    // then moved to pos().
+    return pos() + Vec(out[0], out[2], -out[1]) * m_scale;
 }
\ No newline at end of file
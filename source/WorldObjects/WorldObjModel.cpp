@@ -1,11 +1,80 @@
 #include "WorldObjects/WorldObjModel.hpp"
 
+#include <algorithm>
+
+// How many pixels a level of detail may be off by before it's too simple.
+static const float MAX_LOD_PIXEL_ERROR = 1.0f;
+
+float WorldObjModel::s_projectionScale = 1.0f;
 
 WorldObjModel::WorldObjModel() { m_material = Material::WhitePlastic; }
 
 
 bool WorldObjModel::loadObjectFile(const std::string &filename) {
-    return m_obj.loadObjectFile(filename);
+    // The compiled mesh lives next to the model, and is rebuilt whenever the
+    // model or its materials change.
+    if (!m_obj.loadCachedObjectFile(filename, filename + ".meshcache")) {
+        return false;
+    }
+
+    const paone::MeshView &mesh = m_obj.getMesh();
+    if (!mesh.positions.empty()) {
+        Vec lo(mesh.positions[0], mesh.positions[1], mesh.positions[2]);
+        Vec hi = lo;
+        for (size_t i = 0; i < mesh.positions.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                lo.v[k] = std::min(lo.v[k], mesh.positions[i + k]);
+                hi.v[k] = std::max(hi.v[k], mesh.positions[i + k]);
+            }
+        }
+        m_lo = lo;
+        m_hi = hi;
+    }
+    return true;
+}
+
+unsigned int WorldObjModel::levelOfDetail() const {
+    // Only the modelview matrix is asked for: it's the only thing that
+    // changes from one object to the next.
+    GLfloat mv[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+
+    // The camera, in model space. The modelview matrix is a rotation, a
+    // uniform scale and a translation, so its inverse is the transpose over
+    // the scale squared. OpenGL stores its matricies column-major.
+    float scale2 = mv[0] * mv[0] + mv[1] * mv[1] + mv[2] * mv[2];
+    if (scale2 <= 0.0f) {
+        return 0;
+    }
+    Vec eye;
+    for (int k = 0; k < 3; ++k) {
+        eye.v[k] = -(mv[4 * k] * mv[12] + mv[4 * k + 1] * mv[13]
+                     + mv[4 * k + 2] * mv[14])
+                   / scale2;
+    }
+
+    // The nearest the model gets to it. From inside the bounding box (the
+    // level, say), some of the model is as close as it gets.
+    Vec nearest;
+    for (int k = 0; k < 3; ++k) {
+        nearest.v[k] = clamp(eye.v[k], m_lo.v[k], m_hi.v[k]);
+    }
+    float distance = (nearest - eye).norm();
+    if (distance <= 0.0f) {
+        return 0;
+    }
+
+    // How many pixels tall one unit of the model is there. The scale cancels
+    // out: it shrinks the distance as much as it grows the unit.
+    float pixels_per_unit = s_projectionScale / distance;
+
+    unsigned int level = 0;
+    while (level + 1 < m_obj.numLevels()
+           && m_obj.levelError(level + 1) * pixels_per_unit
+                  <= MAX_LOD_PIXEL_ERROR) {
+        ++level;
+    }
+    return level;
 }
 
 void WorldObjModel::internalDraw() const {
@@ -13,6 +82,6 @@ void WorldObjModel::internalDraw() const {
     pushMatrixAnd([&]() {
         glTranslatef(m_pos.x, m_pos.y, m_pos.z);
         glScalef(m_scale, m_scale, m_scale);
-        m_obj.draw();
+        m_obj.draw(levelOfDetail());
     });
 }
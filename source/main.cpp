@@ -2,8 +2,11 @@
 #include "PrettyGLUT.hpp"
 #include "WorldObjects.hpp"
 
+#include "GLTaskQueue.h"
+#include "TextureRegistry.h"
 #include "fmod.hpp"
 
+#include <algorithm>
 #include <fstream>
 
 WorldObjModel level;
@@ -62,20 +65,34 @@ void updateScene(double t, double dt) {
     // we have to update them manually, if we want them updated at all.
     activeCam->update(t, dt);
     if (activeCam == &arcballcam) {
-        link->doWASDControls(10.0f, keyPressed, true);
+        // Link may not have loaded yet.
+        if (link) {
+            link->doWASDControls(10.0f, keyPressed, true);
+        }
     } else {
         activeCam->doWASDControls(4.20f, keyPressed, true);
     }
 
+    std::vector<Md5Object *> characters;
     for (WorldObject *wo : drawn) {
         wo->update(t, dt);
+        if (auto character = dynamic_cast<Md5Object *>(wo)) {
+            characters.push_back(character);
+        }
     }
 
+    // Skin the characters together on the workers, rather than one by one
+    // as they're drawn.
+    Md5Object::skinAll(characters);
+
     // Keep FMOD's internal state up to date.
     updateListenerPosition();
     updateNavisCallPosition();
 
-    kingRed.shader().attachUniform("time", as<float>(t));
+    // He only has a shader once he's loaded.
+    if (kingRed.visible()) {
+        kingRed.shader().attachUniform("time", as<float>(t));
+    }
 
     sys->update();
 
@@ -129,6 +146,30 @@ void hideKingRed(int) {
     glutTimerFunc(30000, hideKingRed, 0);
 }
 
+// What every loaded texture costs on the GPU, biggest first.
+void reportTextures() {
+    auto textures = paone::TextureRegistry::shared().textures();
+    std::sort(textures.begin(),
+              textures.end(),
+              [](const paone::TextureInfo &a, const paone::TextureInfo &b) {
+                  return a.gpuBytes > b.gpuBytes;
+              });
+
+    std::string report;
+    for (const auto &tex : textures) {
+        report += tfm::format("%8.1f KiB %4dx%-4d x%u  %s\n",
+                              tex.gpuBytes / 1024.0,
+                              tex.width,
+                              tex.height,
+                              tex.references,
+                              tex.name);
+    }
+    info("%u textures using %.1f MiB:\n%s",
+         textures.size(),
+         paone::TextureRegistry::shared().gpuBytes() / (1024.0 * 1024.0),
+         report);
+}
+
 void initScene() {
     glChk();
 
@@ -146,47 +187,7 @@ void initScene() {
     drawn.push_back(&sunlight);
     glChk();
 
-    // Loading other maps should be easy, but we've had issues.
-    std::string levelPath = "assets/Env/HyruleField/hyrulefeild.obj";
-    if (!level.loadObjectFile(levelPath)) {
-        glChk();
-        fatal("Error loading object file %s", levelPath);
-    }
-    glChk();
-
-    if (!kingRed.loadObjectFile("assets/KingOfRedLions/boat.obj")) {
-        fatal("Error loading object file %s", "assets/KingOfRedLions/boat.obj");
-    }
-    glChk();
-
-    link = new Md5Object(
-        "assets/FDL/FDL.md5mesh", "assets/FDL/FDL.md5anim", 0.1f);
-    glChk();
-
-    Shader vert;
-    Shader frag;
-    vert.loadFromFile("glsl/wiggly.v.glsl", GL_VERTEX_SHADER);
-    frag.loadFromFile("glsl/pass_through.f.glsl", GL_FRAGMENT_SHADER);
-
-    ShaderProgram wiggly;
-    wiggly.create();
-    wiggly.attach(vert, frag);
-    wiggly.link();
-    glChk();
-
-
-    drawn.push_back(link);
-
     navi = new Navi;
-    if (!navi->loadObjectFile("assets/Navi/Navi.obj")) {
-        error("Unable to load Navi from .obj");
-    } else {
-        drawn.push_back(navi);
-        navi->follow(link);
-    }
-
-    kingRed.shader(wiggly);
-    glutTimerFunc(30000, hideKingRed, 0);
 
     // Camera
     // Hard coded position. Just something other than a weird looking pit.
@@ -194,18 +195,109 @@ void initScene() {
     activeCam->lookInDir(VecPolar(-2.76918, -0.21, 1));
 
     arcballcam.radius(15.0);
-    arcballcam.follow(link);
-
-    // Init render passes
-    renderPasses.push_back(loadRenderPass("inverted"));
 
-    // All three of these approaches came from his blog:
-    // http://www.johndcook.com/blog/2009/08/24/algorithms-convert-color-grayscale/
-    renderPasses.push_back(loadRenderPass("average"));
-    renderPasses.push_back(loadRenderPass("lightness"));
-    renderPasses.push_back(loadRenderPass("luminosity"));
+    // Everything else loads in the background, and the scene starts as soon
+    // as the level is in.
+    // Loading other maps should be easy, but we've had issues.
+    std::string levelPath = "assets/Env/HyruleField/hyrulefeild.obj";
+    assetLoader.add("Hyrule Field",
+                    [=]() { return level.loadObjectFile(levelPath); },
+                    [=](bool ok) {
+                        if (!ok) {
+                            fatal("Error loading object file %s", levelPath);
+                        }
+                    },
+                    {levelPath, "assets/Env/HyruleField/hyrulefeild.mtl"},
+                    true);
+
+    static ShaderProgram wiggly;
+    kingRed.hide();
+    assetLoader.add("King of Red Lions",
+                    []() {
+                        paone::GLTaskQueue::shared().run([]() {
+                            Shader vert;
+                            Shader frag;
+                            vert.loadFromFile("glsl/wiggly.v.glsl",
+                                              GL_VERTEX_SHADER);
+                            frag.loadFromFile("glsl/pass_through.f.glsl",
+                                              GL_FRAGMENT_SHADER);
+
+                            wiggly.create();
+                            wiggly.attach(vert, frag);
+                            wiggly.link();
+                            glChk();
+                        });
+                        return kingRed.loadObjectFile(
+                            "assets/KingOfRedLions/boat.obj");
+                    },
+                    [](bool ok) {
+                        if (!ok) {
+                            error("Error loading object file %s",
+                                  "assets/KingOfRedLions/boat.obj");
+                            return;
+                        }
+                        kingRed.shader(wiggly);
+                        kingRed.show();
+                        glutTimerFunc(30000, hideKingRed, 0);
+                    },
+                    {"assets/KingOfRedLions/boat.obj"});
+
+    static Md5Object *loadedLink = nullptr;
+    assetLoader.add("Link",
+                    []() {
+                        loadedLink = new Md5Object("assets/FDL/FDL.md5mesh",
+                                                   "assets/FDL/FDL.md5anim",
+                                                   0.1f);
+                        return true;
+                    },
+                    [](bool) {
+                        link = loadedLink;
+                        drawn.push_back(link);
+                        arcballcam.follow(link);
+                        if (navi->visible()) {
+                            navi->follow(link);
+                        }
+                    },
+                    {"assets/FDL/FDL.md5mesh", "assets/FDL/FDL.md5anim"});
+
+    // Navi herself is a light, so she's made here. Only her model loads in the
+    // background.
+    navi->hide();
+    assetLoader.add("Navi",
+                    []() { return navi->loadObjectFile("assets/Navi/Navi.obj"); },
+                    [](bool ok) {
+                        if (!ok) {
+                            error("Unable to load Navi from .obj");
+                            return;
+                        }
+                        navi->show();
+                        drawn.push_back(navi);
+                        if (link) {
+                            navi->follow(link);
+                        }
+                    },
+                    {"assets/Navi/Navi.obj"});
 
-    renderPasses.push_back(loadRenderPass("dot-pos"));
+    // Init render passes
+    assetLoader.add("shaders",
+                    []() {
+                        paone::GLTaskQueue::shared().run([]() {
+                            renderPasses.push_back(loadRenderPass("inverted"));
+
+                            // All three of these approaches came from his blog:
+                            // http://www.johndcook.com/blog/2009/08/24/algorithms-convert-color-grayscale/
+                            renderPasses.push_back(loadRenderPass("average"));
+                            renderPasses.push_back(loadRenderPass("lightness"));
+                            renderPasses.push_back(loadRenderPass("luminosity"));
+
+                            renderPasses.push_back(loadRenderPass("dot-pos"));
+                        });
+                        return true;
+                    },
+                    nullptr,
+                    {});
+
+    assetLoader.start([]() { reportTextures(); });
 }
 
 void initFMOD() {
@@ -245,6 +337,14 @@ int main(int argc, char **argv) {
     initOpenGL(&argc, argv);
     printOpenGLInformation();
 
+    // glutInit() has taken its own arguments out by now.
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--single-threaded-load") {
+            info("Loading models on a single thread.");
+            paone::Object::setParallelParsing(false);
+        }
+    }
+
     glutFullScreen();
 
     initScene();
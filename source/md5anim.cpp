@@ -39,6 +39,10 @@
 #include <assert.h>
 
 #include "MD5/md5model.h"
+#include "MD5/md5binary.h"
+#include "MD5/md5lexer.h"
+
+#include "MappedFile.h"
 
 /* Joint info */
 struct joint_info_t {
@@ -246,53 +250,110 @@ static void BuildFrameSkeleton(const struct joint_info_t *jointInfos,
     }
 }
 
+/* What the lines of an md5anim start with */
+enum md5anim_keyword_t
+{
+    MD5ANIM_FRAME,
+    MD5ANIM_VERSION,
+    MD5ANIM_NUM_FRAMES,
+    MD5ANIM_NUM_JOINTS,
+    MD5ANIM_FRAME_RATE,
+    MD5ANIM_NUM_ANIMATED_COMPONENTS,
+    MD5ANIM_HIERARCHY,
+    MD5ANIM_BOUNDS,
+    MD5ANIM_BASEFRAME,
+    MD5ANIM_NUM_KEYWORDS
+};
+static const char *const md5animKeywords[MD5ANIM_NUM_KEYWORDS]
+    = {"frame",
+       "MD5Version",
+       "numFrames",
+       "numJoints",
+       "frameRate",
+       "numAnimatedComponents",
+       "hierarchy",
+       "bounds",
+       "baseframe"};
+
+/**
+ * Read a joint of the hierarchy: "name" parent flags startIndex.
+ */
+static int ReadJointInfo(struct md5_lexer_t *lex,
+                         struct joint_info_t *jointInfo) {
+    struct md5_token_t name;
+    if (!ReadQuoted(lex, &name) || !ReadInt(lex, &jointInfo->parent)
+        || !ReadInt(lex, &jointInfo->flags)
+        || !ReadInt(lex, &jointInfo->startIndex))
+        return 0;
+
+    /* The name keeps its quotes, as it always has */
+    name.start -= 1;
+    name.length += 2;
+    CopyToken(&name, jointInfo->name, sizeof(jointInfo->name));
+    return 1;
+}
+
 /**
  * Load an MD5 animation from file.
  */
 int ReadMD5Anim(const char *filename, struct md5_anim_t *anim) {
-    FILE *fp = NULL;
-    char buff[512];
+    struct md5_lexer_t lex;
+    struct md5_token_t word;
     struct joint_info_t *jointInfos     = NULL;
     struct baseframe_joint_t *baseFrame = NULL;
     float *animFrameData                = NULL;
-    int version;
-    unsigned int numAnimatedComponents;
+    int version, count;
+    unsigned int numAnimatedComponents = 0;
     int frame_index;
     unsigned int i;
+    int ok = 1, reported = 0, seenFrames = 0;
+
+    /* Nothing in anim is trusted, so FreeAnim() is safe whatever fails */
+    memset(anim, 0, sizeof(struct md5_anim_t));
 
     printf("[.md5anim]: about to read %s\n", filename);
 
-    fp = fopen(filename, "rb");
-    if (!fp) {
+    paone::MappedFile file;
+    if (!file.open(filename)) {
         fprintf(stderr, "[.md5anim]: Error: couldn't open \"%s\"!\n", filename);
         return 0;
     }
 
-    while (!feof(fp)) {
-        /* Read whole line */
-        fgets(buff, sizeof(buff), fp);
-
-        if (sscanf(buff, " MD5Version %d", &version) == 1) {
-            if (version != 10) {
+    InitLexer(&lex, file.begin(), file.end());
+    while (ok && NextWord(&lex, &word)) {
+        switch (LookupKeyword(&word, md5animKeywords, MD5ANIM_NUM_KEYWORDS)) {
+        case MD5ANIM_VERSION:
+            ok = ReadInt(&lex, &version);
+            if (ok && version != 10) {
                 /* Bad version */
                 fprintf(stderr, "[.md5anim]: Error: bad animation version\n");
-                fclose(fp);
-                return 0;
+                ok       = 0;
+                reported = 1;
             }
-        } else if (sscanf(buff, " numFrames %d", &anim->num_frames) == 1) {
-            /* Allocate memory for skeleton frames and bounding boxes */
-            if (anim->num_frames > 0) {
-                anim->skelFrames = (struct md5_joint_t **)malloc(
-                    sizeof(struct md5_joint_t *) * anim->num_frames);
-                anim->bboxes = (struct md5_bbox_t *)malloc(
-                    sizeof(struct md5_bbox_t) * anim->num_frames);
+            break;
+        case MD5ANIM_NUM_FRAMES:
+            ok = !seenFrames++ && ReadInt(&lex, &count) && count >= 0;
+            if (ok) {
+                anim->num_frames = count;
+
+                /* Allocate memory for skeleton frames and bounding boxes */
+                if (count > 0) {
+                    anim->skelFrames = (struct md5_joint_t **)calloc(
+                        count, sizeof(struct md5_joint_t *));
+                    anim->bboxes = (struct md5_bbox_t *)malloc(
+                        sizeof(struct md5_bbox_t) * count);
+                }
             }
-        } else if (sscanf(buff, " numJoints %d", &anim->num_joints) == 1) {
-            if (anim->num_joints > 0) {
+            break;
+        case MD5ANIM_NUM_JOINTS:
+            ok = !jointInfos && ReadInt(&lex, &count) && count >= 0;
+            if (ok && count > 0) {
+                anim->num_joints = count;
                 for (i = 0; i < anim->num_frames; ++i) {
-                    /* Allocate memory for joints of each frame */
-                    anim->skelFrames[i] = (struct md5_joint_t *)malloc(
-                        sizeof(struct md5_joint_t) * anim->num_joints);
+                    /* Allocate memory for joints of each frame, zeroed so
+                     * the names pad the same every time (see md5binary.h) */
+                    anim->skelFrames[i] = (struct md5_joint_t *)calloc(
+                        anim->num_joints, sizeof(struct md5_joint_t));
                 }
 
                 /* Allocate temporary memory for building skeleton frames */
@@ -302,79 +363,92 @@ int ReadMD5Anim(const char *filename, struct md5_anim_t *anim) {
                 baseFrame = (struct baseframe_joint_t *)malloc(
                     sizeof(struct baseframe_joint_t) * anim->num_joints);
             }
-        } else if (sscanf(buff, " frameRate %d", &anim->frameRate) == 1) {
+            break;
+        case MD5ANIM_FRAME_RATE:
+            ok = ReadInt(&lex, &anim->frameRate);
+            break;
+        case MD5ANIM_NUM_ANIMATED_COMPONENTS:
+            ok = !animFrameData && ReadInt(&lex, &count) && count >= 0;
+            if (ok && count > 0) {
+                numAnimatedComponents = count;
 
-        } else if (sscanf(buff,
-                          " numAnimatedComponents %d",
-                          &numAnimatedComponents)
-                   == 1) {
-            if (numAnimatedComponents > 0) {
                 /* Allocate memory for animation frame data */
                 animFrameData
                     = (float *)malloc(sizeof(float) * numAnimatedComponents);
             }
-        } else if (strncmp(buff, "hierarchy {", 11) == 0) {
-            for (i = 0; i < anim->num_joints; ++i) {
-                /* Read whole line */
-                fgets(buff, sizeof(buff), fp);
-
-                /* Read joint info */
-                sscanf(buff,
-                       " %s %d %d %d",
-                       jointInfos[i].name,
-                       &jointInfos[i].parent,
-                       &jointInfos[i].flags,
-                       &jointInfos[i].startIndex);
-            }
-        } else if (strncmp(buff, "bounds {", 8) == 0) {
-            for (i = 0; i < anim->num_frames; ++i) {
-                /* Read whole line */
-                fgets(buff, sizeof(buff), fp);
-
-                /* Read bounding box */
-                sscanf(buff,
-                       " ( %f %f %f ) ( %f %f %f )",
-                       &anim->bboxes[i].min[0],
-                       &anim->bboxes[i].min[1],
-                       &anim->bboxes[i].min[2],
-                       &anim->bboxes[i].max[0],
-                       &anim->bboxes[i].max[1],
-                       &anim->bboxes[i].max[2]);
+            break;
+        case MD5ANIM_HIERARCHY:
+            ok = ExpectChar(&lex, '{');
+            for (i = 0; ok && i < anim->num_joints; ++i)
+                ok = ReadJointInfo(&lex, &jointInfos[i]);
+            ok = ok && ExpectChar(&lex, '}');
+            break;
+        case MD5ANIM_BOUNDS:
+            ok = ExpectChar(&lex, '{');
+            for (i = 0; ok && i < anim->num_frames; ++i) {
+                ok = ReadVector(&lex, anim->bboxes[i].min, 3)
+                     && ReadVector(&lex, anim->bboxes[i].max, 3);
             }
-        } else if (strncmp(buff, "baseframe {", 10) == 0) {
-            for (i = 0; i < anim->num_joints; ++i) {
-                /* Read whole line */
-                fgets(buff, sizeof(buff), fp);
-
-                /* Read base frame joint */
-                if (sscanf(buff,
-                           " ( %f %f %f ) ( %f %f %f )",
-                           &baseFrame[i].pos[0],
-                           &baseFrame[i].pos[1],
-                           &baseFrame[i].pos[2],
-                           &baseFrame[i].orient[0],
-                           &baseFrame[i].orient[1],
-                           &baseFrame[i].orient[2])
-                    == 6) {
-                    /* Compute the w component */
+            ok = ok && ExpectChar(&lex, '}');
+            break;
+        case MD5ANIM_BASEFRAME:
+            ok = ExpectChar(&lex, '{');
+            for (i = 0; ok && i < anim->num_joints; ++i) {
+                ok = ReadVector(&lex, baseFrame[i].pos, 3)
+                     && ReadVector(&lex, baseFrame[i].orient, 3);
+
+                /* Compute the w component */
+                if (ok)
                     Quat_computeW(baseFrame[i].orient);
-                }
             }
-        } else if (sscanf(buff, " frame %d", &frame_index) == 1) {
+            ok = ok && ExpectChar(&lex, '}');
+            break;
+        case MD5ANIM_FRAME:
+            ok = ReadInt(&lex, &frame_index) && frame_index >= 0
+                 && (unsigned int)frame_index < anim->num_frames
+                 && ExpectChar(&lex, '{');
+
             /* Read frame data */
-            for (i = 0; i < numAnimatedComponents; ++i)
-                fscanf(fp, "%f", &animFrameData[i]);
+            for (i = 0; ok && i < numAnimatedComponents; ++i)
+                ok = ReadFloat(&lex, &animFrameData[i]);
+            ok = ok && ExpectChar(&lex, '}');
 
             /* Build frame skeleton from the collected data */
-            BuildFrameSkeleton(jointInfos,
-                               baseFrame,
-                               animFrameData,
-                               anim->skelFrames[frame_index],
-                               anim->num_joints);
+            if (ok)
+                BuildFrameSkeleton(jointInfos,
+                                   baseFrame,
+                                   animFrameData,
+                                   anim->skelFrames[frame_index],
+                                   anim->num_joints);
+            break;
+        default:
+            /* commandline, and anything else we don't use */
+            SkipLine(&lex);
+            break;
         }
     }
 
-    fclose(fp);
+    /* Free temporary data allocated */
+    if (animFrameData)
+        free(animFrameData);
+
+    if (baseFrame)
+        free(baseFrame);
+
+    if (jointInfos)
+        free(jointInfos);
+
+    if (!ok) {
+        if (!reported)
+            fprintf(stderr,
+                    "[.md5anim]: Error: \"%s\", line %d: bad %.*s\n",
+                    filename,
+                    lex.line,
+                    word.length,
+                    word.start);
+        FreeAnim(anim);
+        return 0;
+    }
 
     printf("[.md5anim]: finished reading %s\n", filename);
     printf("[.md5anim]: read in %d frames of %d joints with %d animated "
@@ -384,16 +458,28 @@ int ReadMD5Anim(const char *filename, struct md5_anim_t *anim) {
            numAnimatedComponents);
     printf("[.md5anim]: animation's frame rate is %d\n", anim->frameRate);
 
-    /* Free temporary data allocated */
-    if (animFrameData)
-        free(animFrameData);
+    return 1;
+}
 
-    if (baseFrame)
-        free(baseFrame);
+/**
+ * Load an MD5 animation, from cacheFile (see md5binary.h) if it was compiled
+ * from filename as it is now, otherwise from filename, compiling it into
+ * cacheFile for next time.
+ */
+int ReadMD5AnimCached(const char *filename, const char *cacheFile,
+                      struct md5_anim_t *anim) {
+    uint64_t hash;
+    if (!HashMD5Source(filename, &hash))
+        return ReadMD5Anim(filename, anim);
 
-    if (jointInfos)
-        free(jointInfos);
+    if (MapMD5AnimBinary(cacheFile, hash, anim))
+        return 1;
 
+    if (!ReadMD5Anim(filename, anim))
+        return 0;
+
+    if (!WriteMD5AnimBinary(cacheFile, anim, NULL, hash))
+        fprintf(stderr, "[.md5anim]: couldn't write %s\n", cacheFile);
     return 1;
 }
 
@@ -403,10 +489,14 @@ int ReadMD5Anim(const char *filename, struct md5_anim_t *anim) {
 void FreeAnim(struct md5_anim_t *anim) {
     unsigned int i;
 
+    /* A mapped animation's frames are the file's; it goes at the end */
+    int mapped = anim->mapping != NULL;
+
     if (anim->skelFrames) {
         for (i = 0; i < anim->num_frames; ++i) {
             if (anim->skelFrames[i]) {
-                free(anim->skelFrames[i]);
+                if (!mapped)
+                    free(anim->skelFrames[i]);
                 anim->skelFrames[i] = NULL;
             }
         }
@@ -416,9 +506,15 @@ void FreeAnim(struct md5_anim_t *anim) {
     }
 
     if (anim->bboxes) {
-        free(anim->bboxes);
+        if (!mapped)
+            free(anim->bboxes);
         anim->bboxes = NULL;
     }
+
+    if (mapped) {
+        UnmapMD5Binary(anim->mapping);
+        anim->mapping = NULL;
+    }
 }
 
 /**
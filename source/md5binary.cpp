@@ -0,0 +1,482 @@
+/*
+ * md5binary.cpp -- compiled md5 models and animations
+ *
+ * A model file is a header, then, each starting on an ALIGN boundary:
+ *     baseSkel          md5_joint_t[num_joints]
+ *     inverseBind       md5_matrix_t[num_joints]
+ *     meshes            mesh_header_t[num_meshes]
+ * and for each mesh in turn:
+ *     vertices          md5_vertex_t[num_verts]
+ *     triangles         md5_triangle_t[num_tris]
+ *     weights           md5_weight_t[num_weights]
+ *     skin->first_slot  int[num_blocks + 1]
+ *     skin->slots       md5_skin_slot_t[num_slots]
+ *
+ * An animation file is a header, then:
+ *     bboxes            md5_bbox_t[num_frames]
+ *     skelFrames        md5_joint_t[num_frames][num_joints]
+ * and, if num_keys isn't 0, the clip compressed from them (see md5clip.h):
+ *     joints            md5_clip_joint_t[num_joints]
+ *     keyFrames         int[num_keys]
+ *     frameKey          int[num_frames]
+ *     x, y, z           float[num_keys * num_joints], one section each
+ *     orients           md5_packed_quat_t[num_keys * num_joints]
+ */
+
+#include "MD5/md5binary.h"
+#include "MD5/md5clip.h"
+#include "MD5/md5skin.h"
+
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+using namespace std;
+
+static const char MODEL_MAGIC[8] = "GOLMD5M";
+static const char ANIM_MAGIC[8]  = "GOLMD5A";
+
+/* bump this whenever the layout, or what ReadMD5Model(), BuildSkin(),
+ * ReadMD5Anim() or CompressAnim() produce, changes */
+static const uint32_t MD5_BINARY_VERSION = 2;
+
+/* every section starts on a multiple of this, for the vector kernels */
+static const size_t ALIGN = 16;
+
+struct model_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_joints;
+    uint32_t num_meshes;
+    uint32_t unused;
+    uint64_t sourceHash;
+};
+
+struct mesh_header_t
+{
+    char shader[256];
+    int32_t num_verts;
+    int32_t num_tris;
+    int32_t num_weights;
+
+    /* the skin's */
+    int32_t num_joints;
+    int32_t num_blocks;
+    int32_t num_slots;
+    int32_t unused[2];
+};
+
+struct anim_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_frames;
+    uint32_t num_joints;
+    int32_t frameRate;
+    uint64_t sourceHash;
+
+    /* the clip's keys, 0 without one, and the bounds it was compressed
+     * within */
+    uint32_t num_keys;
+    float maxPosError;
+    float maxAngleError;
+    uint32_t unused;
+};
+
+static size_t Padded(size_t size) {
+    return (size + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+/**
+ * Pad a section of size bytes, already written, out to the next one.
+ */
+static bool WritePadding(FILE *fp, size_t size) {
+    static const char zeroes[ALIGN] = {0};
+    size_t padding                  = Padded(size) - size;
+
+    return padding == 0 || fwrite(zeroes, padding, 1, fp) == 1;
+}
+
+/**
+ * Write a section, and pad it out to the next one.
+ */
+static bool WriteSection(FILE *fp, const void *data, size_t size) {
+    return (size == 0 || fwrite(data, size, 1, fp) == 1)
+           && WritePadding(fp, size);
+}
+
+/**
+ * The section of size bytes at *p, moving *p past it.  NULL if the file
+ * ends first.
+ */
+static const void *ReadSection(const char **p, const char *end, size_t size) {
+    const char *section = *p;
+    if ((size_t)(end - section) < Padded(size))
+        return NULL;
+
+    *p += Padded(size);
+    return section;
+}
+
+/**
+ * Write the sections to a file beside filename, and only replace filename
+ * once it's complete.
+ */
+template <typename F>
+static int WriteFile(const char *filename, F write) {
+    string tempFile = string(filename) + ".tmp";
+    FILE *fp        = fopen(tempFile.c_str(), "wb");
+    if (!fp)
+        return 0;
+
+    bool ok = write(fp);
+    ok      = (fclose(fp) == 0) && ok;
+
+    if (ok) {
+        remove(filename);
+        ok = rename(tempFile.c_str(), filename) == 0;
+    }
+    if (!ok)
+        remove(tempFile.c_str());
+
+    return ok;
+}
+
+int HashMD5Source(const char *filename, uint64_t *hash) {
+    paone::MappedFile file;
+    if (!file.open(filename))
+        return 0;
+
+    *hash = paone::hashBytes(file.begin(), file.size());
+    return 1;
+}
+
+int WriteMD5ModelBinary(const char *filename, const struct md5_model_t *mdl,
+                        uint64_t sourceHash) {
+    struct model_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+    header.version    = MD5_BINARY_VERSION;
+    header.num_joints = mdl->num_joints;
+    header.num_meshes = mdl->num_meshes;
+    header.sourceHash = sourceHash;
+
+    struct mesh_header_t *meshes = (struct mesh_header_t *)calloc(
+        mdl->num_meshes + 1, sizeof(struct mesh_header_t));
+    for (unsigned int i = 0; i < mdl->num_meshes; ++i) {
+        const struct md5_mesh_t *mesh = &mdl->meshes[i];
+        memcpy(meshes[i].shader, mesh->shader, sizeof(mesh->shader));
+        meshes[i].num_verts   = mesh->num_verts;
+        meshes[i].num_tris    = mesh->num_tris;
+        meshes[i].num_weights = mesh->num_weights;
+        meshes[i].num_joints  = mesh->skin->num_joints;
+        meshes[i].num_blocks  = mesh->skin->num_blocks;
+        meshes[i].num_slots
+            = mesh->skin->first_slot[mesh->skin->num_blocks];
+    }
+
+    int ok = WriteFile(filename, [&](FILE *fp) {
+        bool ok = WriteSection(fp, &header, sizeof(header))
+                  && WriteSection(fp,
+                                  mdl->baseSkel,
+                                  sizeof(struct md5_joint_t) * mdl->num_joints)
+                  && WriteSection(fp,
+                                  mdl->inverseBind,
+                                  sizeof(struct md5_matrix_t) * mdl->num_joints)
+                  && WriteSection(fp,
+                                  meshes,
+                                  sizeof(struct mesh_header_t)
+                                      * mdl->num_meshes);
+
+        for (unsigned int i = 0; ok && i < mdl->num_meshes; ++i) {
+            const struct md5_mesh_t *mesh = &mdl->meshes[i];
+            ok = WriteSection(fp,
+                              mesh->vertices,
+                              sizeof(struct md5_vertex_t) * mesh->num_verts)
+                 && WriteSection(fp,
+                                 mesh->triangles,
+                                 sizeof(struct md5_triangle_t) * mesh->num_tris)
+                 && WriteSection(fp,
+                                 mesh->weights,
+                                 sizeof(struct md5_weight_t)
+                                     * mesh->num_weights)
+                 && WriteSection(fp,
+                                 mesh->skin->first_slot,
+                                 sizeof(int) * (meshes[i].num_blocks + 1))
+                 && WriteSection(fp,
+                                 mesh->skin->slots,
+                                 sizeof(struct md5_skin_slot_t)
+                                     * meshes[i].num_slots);
+        }
+        return ok;
+    });
+
+    free(meshes);
+    return ok;
+}
+
+int MapMD5ModelBinary(const char *filename, uint64_t sourceHash,
+                      struct md5_model_t *mdl) {
+    paone::MappedFile *file = new paone::MappedFile;
+    if (!file->open(filename)) {
+        delete file;
+        return 0;
+    }
+    const char *p = file->begin(), *end = file->end();
+
+    const struct model_header_t *header
+        = (const struct model_header_t *)ReadSection(
+            &p, end, sizeof(struct model_header_t));
+    if (!header || memcmp(header->magic, MODEL_MAGIC, sizeof(header->magic))
+        || header->version != MD5_BINARY_VERSION
+        || header->sourceHash != sourceHash) {
+        delete file;
+        return 0;
+    }
+
+    /* Point the model into the file, section by section */
+    memset(mdl, 0, sizeof(struct md5_model_t));
+    mdl->num_joints = header->num_joints;
+    mdl->num_meshes = header->num_meshes;
+    mdl->mapping    = file;
+    mdl->baseSkel   = (struct md5_joint_t *)ReadSection(
+        &p, end, sizeof(struct md5_joint_t) * mdl->num_joints);
+    mdl->inverseBind = (struct md5_matrix_t *)ReadSection(
+        &p, end, sizeof(struct md5_matrix_t) * mdl->num_joints);
+    const struct mesh_header_t *meshes
+        = (const struct mesh_header_t *)ReadSection(
+            &p, end, sizeof(struct mesh_header_t) * mdl->num_meshes);
+    int ok = mdl->baseSkel && mdl->inverseBind && meshes;
+
+    mdl->meshes = (struct md5_mesh_t *)calloc(mdl->num_meshes + 1,
+                                              sizeof(struct md5_mesh_t));
+    for (unsigned int i = 0; ok && i < mdl->num_meshes; ++i) {
+        struct md5_mesh_t *mesh = &mdl->meshes[i];
+        memcpy(mesh->shader, meshes[i].shader, sizeof(mesh->shader));
+        mesh->shader[sizeof(mesh->shader) - 1] = '\0';
+        mesh->num_verts   = meshes[i].num_verts;
+        mesh->num_tris    = meshes[i].num_tris;
+        mesh->num_weights = meshes[i].num_weights;
+
+        struct md5_skin_t *skin
+            = (struct md5_skin_t *)calloc(1, sizeof(struct md5_skin_t));
+        skin->num_verts  = meshes[i].num_verts;
+        skin->num_blocks = meshes[i].num_blocks;
+        skin->num_joints = meshes[i].num_joints;
+        skin->mapped     = 1;
+        mesh->skin       = skin;
+
+        ok = mesh->num_verts >= 0 && mesh->num_tris >= 0
+             && mesh->num_weights >= 0 && meshes[i].num_slots >= 0
+             && skin->num_blocks
+                    == (mesh->num_verts + MD5_SKIN_BLOCK - 1) / MD5_SKIN_BLOCK;
+        if (!ok)
+            break;
+
+        mesh->vertices = (struct md5_vertex_t *)ReadSection(
+            &p, end, sizeof(struct md5_vertex_t) * mesh->num_verts);
+        mesh->triangles = (struct md5_triangle_t *)ReadSection(
+            &p, end, sizeof(struct md5_triangle_t) * mesh->num_tris);
+        mesh->weights = (struct md5_weight_t *)ReadSection(
+            &p, end, sizeof(struct md5_weight_t) * mesh->num_weights);
+        skin->first_slot = (int *)ReadSection(
+            &p, end, sizeof(int) * (skin->num_blocks + 1));
+        skin->slots = (struct md5_skin_slot_t *)ReadSection(
+            &p, end, sizeof(struct md5_skin_slot_t) * meshes[i].num_slots);
+        ok = mesh->vertices && mesh->triangles && mesh->weights
+             && skin->first_slot && skin->slots;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "[.md5mesh]: Error: \"%s\" is cut short\n", filename);
+        FreeModel(mdl);
+        memset(mdl, 0, sizeof(struct md5_model_t));
+        return 0;
+    }
+
+    printf("[.md5mesh]: mapped %s: %d meshes, %d joints\n",
+           filename,
+           mdl->num_meshes,
+           mdl->num_joints);
+    return 1;
+}
+
+int WriteMD5AnimBinary(const char *filename, const struct md5_anim_t *anim,
+                       const struct md5_clip_t *clip, uint64_t sourceHash) {
+    struct anim_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ANIM_MAGIC, sizeof(header.magic));
+    header.version    = MD5_BINARY_VERSION;
+    header.num_frames = anim->num_frames;
+    header.num_joints = anim->num_joints;
+    header.frameRate  = anim->frameRate;
+    header.sourceHash = sourceHash;
+    if (clip) {
+        header.num_keys      = clip->num_keys;
+        header.maxPosError   = clip->maxPosError;
+        header.maxAngleError = clip->maxAngleError;
+    }
+
+    return WriteFile(filename, [&](FILE *fp) {
+        bool ok = WriteSection(fp, &header, sizeof(header))
+                  && WriteSection(fp,
+                                  anim->bboxes,
+                                  sizeof(struct md5_bbox_t) * anim->num_frames);
+
+        /* The frames back to back, with the padding after the last */
+        size_t frameSize = sizeof(struct md5_joint_t) * anim->num_joints;
+        for (unsigned int i = 0; ok && i < anim->num_frames; ++i)
+            ok = frameSize == 0
+                 || fwrite(anim->skelFrames[i], frameSize, 1, fp) == 1;
+        ok = ok && WritePadding(fp, frameSize * anim->num_frames);
+        if (!ok || header.num_keys == 0)
+            return ok;
+
+        size_t slots = (size_t)clip->num_keys * clip->num_joints;
+        return WriteSection(fp,
+                            clip->joints,
+                            sizeof(struct md5_clip_joint_t) * clip->num_joints)
+               && WriteSection(
+                   fp, clip->keyFrames, sizeof(int) * clip->num_keys)
+               && WriteSection(
+                   fp, clip->frameKey, sizeof(int) * clip->num_frames)
+               && WriteSection(fp, clip->x, sizeof(float) * slots)
+               && WriteSection(fp, clip->y, sizeof(float) * slots)
+               && WriteSection(fp, clip->z, sizeof(float) * slots)
+               && WriteSection(fp,
+                               clip->orients,
+                               sizeof(struct md5_packed_quat_t) * slots);
+    });
+}
+
+/**
+ * The header of an animation file, if it was compiled from text hashing to
+ * sourceHash, moving *p past it.
+ */
+static const struct anim_header_t *ReadAnimHeader(const char **p,
+                                                  const char *end,
+                                                  uint64_t sourceHash) {
+    const struct anim_header_t *header
+        = (const struct anim_header_t *)ReadSection(
+            p, end, sizeof(struct anim_header_t));
+    if (!header || memcmp(header->magic, ANIM_MAGIC, sizeof(header->magic))
+        || header->version != MD5_BINARY_VERSION
+        || header->sourceHash != sourceHash)
+        return NULL;
+    return header;
+}
+
+int ReadMD5ClipBinary(const char *filename, uint64_t sourceHash,
+                      float maxPosError, float maxAngleError,
+                      struct md5_clip_t *clip) {
+    paone::MappedFile file;
+    if (!file.open(filename))
+        return 0;
+    const char *p = file.begin(), *end = file.end();
+
+    const struct anim_header_t *header = ReadAnimHeader(&p, end, sourceHash);
+    if (!header || header->num_keys == 0 || header->maxPosError != maxPosError
+        || header->maxAngleError != maxAngleError)
+        return 0;
+
+    /* Past the frames */
+    size_t frameSize = sizeof(struct md5_joint_t) * header->num_joints;
+    const void *bboxes = ReadSection(
+        &p, end, sizeof(struct md5_bbox_t) * header->num_frames);
+    const void *frames = ReadSection(&p, end, frameSize * header->num_frames);
+
+    size_t slots = (size_t)header->num_keys * header->num_joints;
+    const void *joints = ReadSection(
+        &p, end, sizeof(struct md5_clip_joint_t) * header->num_joints);
+    const void *keyFrames
+        = ReadSection(&p, end, sizeof(int) * header->num_keys);
+    const void *frameKey
+        = ReadSection(&p, end, sizeof(int) * header->num_frames);
+    const void *x = ReadSection(&p, end, sizeof(float) * slots);
+    const void *y = ReadSection(&p, end, sizeof(float) * slots);
+    const void *z = ReadSection(&p, end, sizeof(float) * slots);
+    const void *orients
+        = ReadSection(&p, end, sizeof(struct md5_packed_quat_t) * slots);
+    if (!bboxes || !frames || !joints || !keyFrames || !frameKey || !x || !y
+        || !z || !orients) {
+        fprintf(stderr, "[.md5anim]: Error: \"%s\" is cut short\n", filename);
+        return 0;
+    }
+
+    /* Copied out, as most of the file is frames the clip has no use for */
+    AllocClip(clip, header->num_frames, header->num_joints, header->num_keys);
+    clip->frameRate     = header->frameRate;
+    clip->num_keys      = header->num_keys;
+    clip->maxPosError   = header->maxPosError;
+    clip->maxAngleError = header->maxAngleError;
+    memcpy(clip->joints,
+           joints,
+           sizeof(struct md5_clip_joint_t) * header->num_joints);
+    memcpy(clip->keyFrames, keyFrames, sizeof(int) * header->num_keys);
+    memcpy(clip->frameKey, frameKey, sizeof(int) * header->num_frames);
+    memcpy(clip->x, x, sizeof(float) * slots);
+    memcpy(clip->y, y, sizeof(float) * slots);
+    memcpy(clip->z, z, sizeof(float) * slots);
+    memcpy(clip->orients, orients, sizeof(struct md5_packed_quat_t) * slots);
+
+    printf("[.md5anim]: read %s: %d of %d frames of %d joints\n",
+           filename,
+           clip->num_keys,
+           clip->num_frames,
+           clip->num_joints);
+    return 1;
+}
+
+int MapMD5AnimBinary(const char *filename, uint64_t sourceHash,
+                     struct md5_anim_t *anim) {
+    paone::MappedFile *file = new paone::MappedFile;
+    if (!file->open(filename)) {
+        delete file;
+        return 0;
+    }
+    const char *p = file->begin(), *end = file->end();
+
+    const struct anim_header_t *header = ReadAnimHeader(&p, end, sourceHash);
+    if (!header) {
+        delete file;
+        return 0;
+    }
+
+    memset(anim, 0, sizeof(struct md5_anim_t));
+    anim->num_frames = header->num_frames;
+    anim->num_joints = header->num_joints;
+    anim->frameRate  = header->frameRate;
+    anim->mapping    = file;
+    anim->bboxes     = (struct md5_bbox_t *)ReadSection(
+        &p, end, sizeof(struct md5_bbox_t) * anim->num_frames);
+
+    size_t frameSize = sizeof(struct md5_joint_t) * anim->num_joints;
+    struct md5_joint_t *frames = (struct md5_joint_t *)ReadSection(
+        &p, end, frameSize * anim->num_frames);
+    if (!anim->bboxes || !frames) {
+        fprintf(stderr, "[.md5anim]: Error: \"%s\" is cut short\n", filename);
+        FreeAnim(anim);
+        memset(anim, 0, sizeof(struct md5_anim_t));
+        return 0;
+    }
+
+    anim->skelFrames = (struct md5_joint_t **)malloc(
+        sizeof(struct md5_joint_t *) * (anim->num_frames + 1));
+    for (unsigned int i = 0; i < anim->num_frames; ++i)
+        anim->skelFrames[i] = frames + (size_t)i * anim->num_joints;
+
+    printf("[.md5anim]: mapped %s: %d frames of %d joints\n",
+           filename,
+           anim->num_frames,
+           anim->num_joints);
+    return 1;
+}
+
+void UnmapMD5Binary(void *mapping) {
+    delete (paone::MappedFile *)mapping;
+}
@@ -0,0 +1,390 @@
+/*
+ * md5clip.cpp -- compressed md5 animations
+ */
+
+#include "MD5/md5clip.h"
+#include "MD5/md5binary.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* what the three components kept span, and the steps they're kept in */
+static const float SMALLEST_MAX = 0.70710678f;
+static const int QUAT_STEPS     = 0x7fff;
+
+void PackQuat(const quat4_t q, struct md5_packed_quat_t *out) {
+    /* Drop the largest component.  q and -q turn the same way, so flip q
+     * to make that positive, and it follows from the other three */
+    int largest = 0;
+    for (int i = 1; i < 4; ++i) {
+        if (fabsf(q[i]) > fabsf(q[largest]))
+            largest = i;
+    }
+    float length = sqrtf(Quat_dotProduct(q, q));
+    float scale  = (q[largest] < 0.0f ? -1.0f : 1.0f) / length;
+
+    for (int i = 0, c = 0; i < 4; ++i) {
+        if (i == largest)
+            continue;
+
+        float unit = (q[i] * scale / SMALLEST_MAX + 1.0f) * 0.5f;
+        long step  = lrintf(unit * QUAT_STEPS);
+        if (step < 0)
+            step = 0;
+        if (step > QUAT_STEPS)
+            step = QUAT_STEPS;
+        out->c[c++] = (unsigned short)step;
+    }
+    out->c[0] |= (largest & 1) << 15;
+    out->c[1] |= (largest >> 1) << 15;
+}
+
+void UnpackQuat(const struct md5_packed_quat_t *packed, quat4_t out) {
+    static const float step = 2.0f * SMALLEST_MAX / QUAT_STEPS;
+
+    float a = (packed->c[0] & QUAT_STEPS) * step - SMALLEST_MAX;
+    float b = (packed->c[1] & QUAT_STEPS) * step - SMALLEST_MAX;
+    float c = (packed->c[2] & QUAT_STEPS) * step - SMALLEST_MAX;
+    float rest    = 1.0f - a * a - b * b - c * c;
+    float largest = rest > 0.0f ? sqrtf(rest) : 0.0f;
+
+    /* Put the dropped component back where it was */
+    switch ((packed->c[0] >> 15) | ((packed->c[1] >> 15) << 1)) {
+    case 0:
+        out[0] = largest, out[1] = a, out[2] = b, out[3] = c;
+        break;
+    case 1:
+        out[0] = a, out[1] = largest, out[2] = b, out[3] = c;
+        break;
+    case 2:
+        out[0] = a, out[1] = b, out[2] = largest, out[3] = c;
+        break;
+    default:
+        out[0] = a, out[1] = b, out[2] = c, out[3] = largest;
+        break;
+    }
+}
+
+/* joint j of key k */
+static void KeyJoint(const struct md5_clip_t *clip, int k, int j, vec3_t pos,
+                     quat4_t orient) {
+    size_t i = (size_t)k * clip->num_joints + j;
+    pos[0]   = clip->x[i];
+    pos[1]   = clip->y[i];
+    pos[2]   = clip->z[i];
+    UnpackQuat(&clip->orients[i], orient);
+}
+
+/* joint j, t of the way from key k to the next */
+static void KeyLerp(const struct md5_clip_t *clip, int k, float t, int j,
+                    vec3_t pos, quat4_t orient) {
+    vec3_t nextPos;
+    quat4_t from, to;
+    KeyJoint(clip, k, j, pos, from);
+    KeyJoint(clip, k + 1, j, nextPos, to);
+
+    for (int c = 0; c < 3; ++c)
+        pos[c] += t * (nextPos[c] - pos[c]);
+    Quat_slerp(from, to, t, orient);
+}
+
+/* the key before frame plus fraction, and how far on from it to the next
+ * that is.  No next key means it's the last */
+static int LocateKey(const struct md5_clip_t *clip, int frame, float fraction,
+                     float *t) {
+    int k = clip->frameKey[frame];
+    if ((unsigned int)k + 1 == clip->num_keys) {
+        *t = 0.0f;
+        return k;
+    }
+
+    *t = (frame - clip->keyFrames[k] + fraction)
+         / (clip->keyFrames[k + 1] - clip->keyFrames[k]);
+    return k;
+}
+
+/* joint j, t of the way on from key k (see LocateKey()) */
+static void ClipJoint(const struct md5_clip_t *clip, int k, float t, int j,
+                      vec3_t pos, quat4_t orient) {
+    if ((unsigned int)k + 1 == clip->num_keys)
+        KeyJoint(clip, k, j, pos, orient);
+    else
+        KeyLerp(clip, k, t, j, pos, orient);
+}
+
+/* the angle, in radians, between two orientations.  In double, as acos()
+ * near 1 is too coarse in float to tell turns this small apart */
+static double AngleBetween(const quat4_t a, const quat4_t b) {
+    double dot = 0.0, lengthA = 0.0, lengthB = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        dot += (double)a[i] * b[i];
+        lengthA += (double)a[i] * a[i];
+        lengthB += (double)b[i] * b[i];
+    }
+    double cosHalf = fabs(dot) / sqrt(lengthA * lengthB);
+    return cosHalf >= 1.0 ? 0.0 : 2.0 * acos(cosHalf);
+}
+
+/**
+ * Whether the frames of anim between first and last can all be dropped,
+ * with clip's last two keys those two.
+ */
+static int SegmentFits(const struct md5_anim_t *anim,
+                       const struct md5_clip_t *clip, int first, int last,
+                       float maxPosError, float maxAngleError) {
+    for (int f = first + 1; f < last; ++f) {
+        float t = (float)(f - first) / (last - first);
+        for (unsigned int j = 0; j < anim->num_joints; ++j) {
+            const struct md5_joint_t *joint = &anim->skelFrames[f][j];
+            vec3_t pos;
+            quat4_t orient;
+            KeyLerp(clip, clip->num_keys - 2, t, j, pos, orient);
+
+            float dx = pos[0] - joint->pos[0], dy = pos[1] - joint->pos[1],
+                  dz = pos[2] - joint->pos[2];
+            if (sqrtf(dx * dx + dy * dy + dz * dz) > maxPosError
+                || AngleBetween(orient, joint->orient) > maxAngleError)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* Append frame f of anim as the clip's next key */
+static void AddKey(const struct md5_anim_t *anim, struct md5_clip_t *clip,
+                   int f) {
+    size_t i = (size_t)clip->num_keys * clip->num_joints;
+    for (unsigned int j = 0; j < anim->num_joints; ++j, ++i) {
+        const struct md5_joint_t *joint = &anim->skelFrames[f][j];
+        clip->x[i]                      = joint->pos[0];
+        clip->y[i]                      = joint->pos[1];
+        clip->z[i]                      = joint->pos[2];
+        PackQuat(joint->orient, &clip->orients[i]);
+    }
+    clip->keyFrames[clip->num_keys++] = f;
+}
+
+void AllocClip(struct md5_clip_t *clip, unsigned int num_frames,
+               unsigned int num_joints, unsigned int num_keys) {
+    size_t slots = (size_t)num_keys * num_joints + 1;
+
+    memset(clip, 0, sizeof(struct md5_clip_t));
+    clip->num_frames = num_frames;
+    clip->num_joints = num_joints;
+
+    clip->joints = (struct md5_clip_joint_t *)calloc(
+        num_joints + 1, sizeof(struct md5_clip_joint_t));
+    clip->keyFrames = (int *)malloc(sizeof(int) * (num_keys + 1));
+    clip->frameKey  = (int *)malloc(sizeof(int) * (num_frames + 1));
+    clip->x         = (float *)malloc(sizeof(float) * slots);
+    clip->y         = (float *)malloc(sizeof(float) * slots);
+    clip->z         = (float *)malloc(sizeof(float) * slots);
+    clip->orients   = (struct md5_packed_quat_t *)malloc(
+        sizeof(struct md5_packed_quat_t) * slots);
+}
+
+void CompressAnim(const struct md5_anim_t *anim, float maxPosError,
+                  float maxAngleError, struct md5_clip_t *clip) {
+    unsigned int num_joints = anim->num_joints;
+    unsigned int num_frames = anim->num_frames;
+
+    /* Room for every frame, until it's known how many are kept */
+    AllocClip(clip, num_frames, num_joints, num_frames);
+    clip->frameRate     = anim->frameRate;
+    clip->maxPosError   = maxPosError;
+    clip->maxAngleError = maxAngleError;
+    if (num_frames == 0)
+        return;
+
+    /* The hierarchy, once */
+    for (unsigned int j = 0; j < num_joints; ++j) {
+        memcpy(clip->joints[j].name,
+               anim->skelFrames[0][j].name,
+               sizeof(clip->joints[j].name));
+        clip->joints[j].parent = anim->skelFrames[0][j].parent;
+    }
+
+    /* Greedily, each key reaches as far on as it can.  A frame is added as
+     * a key to try it, and taken off again */
+    int reduce = maxPosError > 0.0f || maxAngleError > 0.0f;
+    int last   = num_frames - 1;
+    AddKey(anim, clip, 0);
+    for (int first = 0; first < last;) {
+        int end = first + 1;
+        while (reduce && end < last) {
+            AddKey(anim, clip, end + 1);
+            int fits = SegmentFits(
+                anim, clip, first, end + 1, maxPosError, maxAngleError);
+            --clip->num_keys;
+            if (!fits)
+                break;
+            ++end;
+        }
+        AddKey(anim, clip, end);
+        first = end;
+    }
+
+    for (unsigned int k = 0; k < clip->num_keys; ++k) {
+        int next = k + 1 < clip->num_keys ? clip->keyFrames[k + 1] : last + 1;
+        for (int f = clip->keyFrames[k]; f < next; ++f)
+            clip->frameKey[f] = k;
+    }
+
+    /* Give back what wasn't kept */
+    size_t kept = (size_t)clip->num_keys * num_joints + 1;
+    clip->x     = (float *)realloc(clip->x, sizeof(float) * kept);
+    clip->y     = (float *)realloc(clip->y, sizeof(float) * kept);
+    clip->z     = (float *)realloc(clip->z, sizeof(float) * kept);
+    clip->orients = (struct md5_packed_quat_t *)realloc(
+        clip->orients, sizeof(struct md5_packed_quat_t) * kept);
+    clip->keyFrames
+        = (int *)realloc(clip->keyFrames, sizeof(int) * (clip->num_keys + 1));
+}
+
+void FreeClip(struct md5_clip_t *clip) {
+    free(clip->joints);
+    free(clip->keyFrames);
+    free(clip->frameKey);
+    free(clip->x);
+    free(clip->y);
+    free(clip->z);
+    free(clip->orients);
+    memset(clip, 0, sizeof(struct md5_clip_t));
+}
+
+unsigned long ClipBytes(const struct md5_clip_t *clip) {
+    return sizeof(struct md5_clip_t)
+           + sizeof(struct md5_clip_joint_t) * clip->num_joints
+           + sizeof(int) * (clip->num_keys + clip->num_frames)
+           + (sizeof(float) * 3 + sizeof(struct md5_packed_quat_t))
+                 * clip->num_keys * clip->num_joints;
+}
+
+int ReadMD5ClipCached(const char *filename, const char *cacheFile,
+                      float maxPosError, float maxAngleError,
+                      struct md5_clip_t *clip) {
+    struct md5_anim_t anim;
+    memset(&anim, 0, sizeof(anim));
+
+    uint64_t hash;
+    int hashed = HashMD5Source(filename, &hash);
+    if (hashed
+        && ReadMD5ClipBinary(cacheFile, hash, maxPosError, maxAngleError, clip))
+        return 1;
+
+    /* The frames may be compiled already, only without this clip */
+    if (!(hashed && MapMD5AnimBinary(cacheFile, hash, &anim))
+        && !ReadMD5Anim(filename, &anim)) {
+        FreeAnim(&anim);
+        return 0;
+    }
+
+    CompressAnim(&anim, maxPosError, maxAngleError, clip);
+    if (hashed && !WriteMD5AnimBinary(cacheFile, &anim, clip, hash))
+        fprintf(stderr, "[.md5anim]: couldn't write %s\n", cacheFile);
+    FreeAnim(&anim);
+    return 1;
+}
+
+void InitClipCursor(const struct md5_clip_t *clip,
+                    struct md5_clip_cursor_t *cursor) {
+    cursor->key    = -1;
+    cursor->pos    = (vec3_t *)malloc(sizeof(vec3_t) * 2 * clip->num_joints
+                                      + 1);
+    cursor->orient = (quat4_t *)malloc(sizeof(quat4_t) * 2 * clip->num_joints
+                                       + 1);
+}
+
+void FreeClipCursor(struct md5_clip_cursor_t *cursor) {
+    free(cursor->pos);
+    free(cursor->orient);
+    memset(cursor, 0, sizeof(struct md5_clip_cursor_t));
+    cursor->key = -1;
+}
+
+/* Unpack key k and the next into cursor, unless they already are */
+static void MoveCursor(const struct md5_clip_t *clip,
+                       struct md5_clip_cursor_t *cursor, int k) {
+    if (cursor->key == k)
+        return;
+
+    unsigned int n = clip->num_joints;
+    for (unsigned int j = 0; j < n; ++j) {
+        KeyJoint(clip, k, j, cursor->pos[j], cursor->orient[j]);
+        KeyJoint(clip, k + 1, j, cursor->pos[n + j], cursor->orient[n + j]);
+    }
+    cursor->key = k;
+}
+
+void SampleClip(const struct md5_clip_t *clip,
+                struct md5_clip_cursor_t *cursor, int frameA, int frameB,
+                float interp, struct md5_joint_t *out) {
+    if (clip->num_keys == 0)
+        return;
+
+    /* From a frame on to the next, one interpolation does: both are
+     * between the same two keys */
+    if (frameB == frameA + 1) {
+        float t;
+        int k = LocateKey(clip, frameA, interp, &t);
+        if (cursor && (unsigned int)k + 1 < clip->num_keys) {
+            MoveCursor(clip, cursor, k);
+
+            unsigned int n = clip->num_joints;
+            for (unsigned int j = 0; j < n; ++j) {
+                const float *from = cursor->pos[j], *to = cursor->pos[n + j];
+                out[j].parent     = clip->joints[j].parent;
+                for (int c = 0; c < 3; ++c)
+                    out[j].pos[c] = from[c] + t * (to[c] - from[c]);
+                Quat_slerp(cursor->orient[j],
+                           cursor->orient[n + j],
+                           t,
+                           out[j].orient);
+            }
+            return;
+        }
+
+        for (unsigned int j = 0; j < clip->num_joints; ++j) {
+            out[j].parent = clip->joints[j].parent;
+            ClipJoint(clip, k, t, j, out[j].pos, out[j].orient);
+        }
+        return;
+    }
+
+    float tA, tB;
+    int kA = LocateKey(clip, frameA, 0.0f, &tA);
+    int kB = LocateKey(clip, frameB, 0.0f, &tB);
+    for (unsigned int j = 0; j < clip->num_joints; ++j) {
+        vec3_t posA, posB;
+        quat4_t orientA, orientB;
+        ClipJoint(clip, kA, tA, j, posA, orientA);
+        ClipJoint(clip, kB, tB, j, posB, orientB);
+
+        out[j].parent = clip->joints[j].parent;
+        for (int c = 0; c < 3; ++c)
+            out[j].pos[c] = posA[c] + interp * (posB[c] - posA[c]);
+        Quat_slerp(orientA, orientB, interp, out[j].orient);
+    }
+}
+
+void AnimateClip(const struct md5_clip_t *clip, struct anim_info_t *animInfo,
+                 double dt) {
+    int maxFrames = clip->num_frames - 1;
+
+    animInfo->last_time += dt;
+
+    /* move to next frame */
+    if (animInfo->last_time >= animInfo->max_time) {
+        animInfo->curr_frame++;
+        animInfo->next_frame++;
+        animInfo->last_time = 0.0;
+
+        if (animInfo->curr_frame > maxFrames)
+            animInfo->curr_frame = 0;
+
+        if (animInfo->next_frame > maxFrames)
+            animInfo->next_frame = 0;
+    }
+}
@@ -0,0 +1,224 @@
+/*
+ * md5lexer.cpp -- tokens for the md5mesh and md5anim text formats
+ */
+
+#include "MD5/md5lexer.h"
+
+#include <float.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* powers of ten a double holds exactly */
+static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* and mantissas it does */
+static const uint64_t MAX_EXACT_MANTISSA = (uint64_t)1 << 53;
+
+/* the bits of a double's mantissa a float drops, and what they are when it
+ * is exactly halfway between two floats */
+static const uint64_t HALF_FLOAT_MASK = ((uint64_t)1 << 29) - 1;
+static const uint64_t HALF_FLOAT_BIT  = (uint64_t)1 << 28;
+
+static int IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v'
+           || c == '\f';
+}
+
+static int IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Move past whitespace and comments.
+ */
+static void SkipSpace(struct md5_lexer_t *lex) {
+    while (lex->p < lex->end) {
+        if (*lex->p == '\n') {
+            ++lex->line;
+        } else if (*lex->p == '/' && lex->p + 1 < lex->end
+                   && lex->p[1] == '/') {
+            SkipLine(lex);
+            continue;
+        } else if (!IsSpace(*lex->p)) {
+            return;
+        }
+        ++lex->p;
+    }
+}
+
+void InitLexer(struct md5_lexer_t *lex, const char *begin, const char *end) {
+    lex->p    = begin;
+    lex->end  = end;
+    lex->line = 1;
+}
+
+int NextWord(struct md5_lexer_t *lex, struct md5_token_t *word) {
+    SkipSpace(lex);
+    if (lex->p == lex->end)
+        return 0;
+
+    word->start = lex->p;
+    while (lex->p < lex->end && !IsSpace(*lex->p))
+        ++lex->p;
+    word->length = (int)(lex->p - word->start);
+    return 1;
+}
+
+int LookupKeyword(const struct md5_token_t *word, const char *const *keywords,
+                  int num_keywords) {
+    for (int i = 0; i < num_keywords; ++i) {
+        if (strncmp(keywords[i], word->start, word->length) == 0
+            && keywords[i][word->length] == '\0')
+            return i;
+    }
+    return -1;
+}
+
+int ExpectChar(struct md5_lexer_t *lex, char c) {
+    SkipSpace(lex);
+    if (lex->p == lex->end || *lex->p != c)
+        return 0;
+
+    ++lex->p;
+    return 1;
+}
+
+int ReadInt(struct md5_lexer_t *lex, int *out) {
+    SkipSpace(lex);
+    const char *p = lex->p;
+
+    int negative = 0;
+    if (p < lex->end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == lex->end || !IsDigit(*p))
+        return 0;
+
+    unsigned int value = 0;
+    while (p < lex->end && IsDigit(*p))
+        value = value * 10 + (*p++ - '0');
+
+    *out   = negative ? -(int)value : (int)value;
+    lex->p = p;
+    return 1;
+}
+
+/**
+ * Anything ReadFloat() can't do exactly itself: a copy of the number for
+ * strtof(), which needs it null terminated.
+ */
+static int ReadFloatSlowly(struct md5_lexer_t *lex, float *out) {
+    char buff[64];
+    size_t length = lex->end - lex->p;
+    if (length > sizeof(buff) - 1)
+        length = sizeof(buff) - 1;
+    memcpy(buff, lex->p, length);
+    buff[length] = '\0';
+
+    char *end;
+    *out = strtof(buff, &end);
+    if (end == buff)
+        return 0;
+
+    lex->p += end - buff;
+    return 1;
+}
+
+int ReadFloat(struct md5_lexer_t *lex, float *out) {
+    SkipSpace(lex);
+    const char *p = lex->p, *end = lex->end;
+
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    /* The digits, as an integer, and where the point goes */
+    uint64_t mantissa = 0;
+    int exponent = 0, digits = 0, significant = 0;
+    for (; p < end && IsDigit(*p); ++p, ++digits) {
+        mantissa = mantissa * 10 + (*p - '0');
+        significant += mantissa != 0;
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && IsDigit(*p); ++p, ++digits, --exponent) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significant += mantissa != 0;
+        }
+    }
+    if (digits == 0 || significant > 19)
+        return ReadFloatSlowly(lex, out);
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *e = p + 1;
+        int negativeExponent = 0;
+        if (e < end && (*e == '-' || *e == '+'))
+            negativeExponent = *e++ == '-';
+        if (e == end || !IsDigit(*e))
+            return ReadFloatSlowly(lex, out);
+
+        int value = 0;
+        for (; e < end && IsDigit(*e) && value < 10000; ++e)
+            value = value * 10 + (*e - '0');
+        exponent += negativeExponent ? -value : value;
+        p = e;
+    }
+
+    /* Both the mantissa and the power of ten are exact doubles, so one
+     * multiply or divide rounds correctly to double.  Rounding that on to
+     * float can only go wrong if it landed right between two floats. */
+    if (mantissa > MAX_EXACT_MANTISSA || exponent < -22 || exponent > 22)
+        return ReadFloatSlowly(lex, out);
+
+    double value = exponent < 0 ? (double)mantissa / POW10[-exponent]
+                                : (double)mantissa * POW10[exponent];
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & HALF_FLOAT_MASK) == HALF_FLOAT_BIT
+        || (value != 0.0 && value < FLT_MIN) || value > FLT_MAX)
+        return ReadFloatSlowly(lex, out);
+
+    *out   = negative ? -(float)value : (float)value;
+    lex->p = p;
+    return 1;
+}
+
+int ReadQuoted(struct md5_lexer_t *lex, struct md5_token_t *out) {
+    if (!ExpectChar(lex, '"'))
+        return 0;
+
+    const char *close
+        = (const char *)memchr(lex->p, '"', lex->end - lex->p);
+    if (!close)
+        return 0;
+
+    out->start  = lex->p;
+    out->length = (int)(close - lex->p);
+    lex->p      = close + 1;
+    return 1;
+}
+
+int ReadVector(struct md5_lexer_t *lex, float *out, int n) {
+    if (!ExpectChar(lex, '('))
+        return 0;
+
+    for (int i = 0; i < n; ++i) {
+        if (!ReadFloat(lex, &out[i]))
+            return 0;
+    }
+    return ExpectChar(lex, ')');
+}
+
+void CopyToken(const struct md5_token_t *token, char *out, int size) {
+    int length = token->length < size - 1 ? token->length : size - 1;
+    memcpy(out, token->start, length);
+    out[length] = '\0';
+}
+
+void SkipLine(struct md5_lexer_t *lex) {
+    const char *newline
+        = (const char *)memchr(lex->p, '\n', lex->end - lex->p);
+    lex->p = newline ? newline : lex->end;
+}
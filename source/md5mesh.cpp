@@ -34,27 +34,33 @@
 
 #include <SOIL/SOIL.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 using namespace std;
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <math.h>
 
 #include "Shader.hpp"
 #include "MD5/md5model.h"
+#include "MD5/md5binary.h"
+#include "MD5/md5lexer.h"
 #include "MD5/md5mesh.h"
-
-/* vertex array related stuff */
-int max_verts = 0;
-int max_tris  = 0;
-
-vec3_t *vertexArray   = NULL;
-GLuint *vertexIndices = NULL;
-
-vec2_t *texelArray = NULL;
+#include "MD5/md5skin.h"
+#include "GLTaskQueue.h"
+#include "MappedFile.h"
+#include "TextureRegistry.h"
+
+/* Where glsl/md5shader.v.glsl gets joints0..2 and weights0..2, clear of the
+ * built in attributes it uses (gl_Vertex, gl_MultiTexCoord0) */
+enum {
+    MD5_ATTRIB_JOINTS  = 1,
+    MD5_ATTRIB_WEIGHTS = 4
+};
 
 /**
  * Basic quaternion operations.
@@ -122,21 +128,28 @@ void Quat_rotatePoint(const quat4_t q, const vec3_t in, vec3_t out) {
     out[Z] = final[Z];
 }
 
-GLuint loadTexture(string filename) {
-    GLuint textureHandle = SOIL_load_OGL_texture(
-        filename.c_str(),
-        SOIL_LOAD_AUTO,
-        SOIL_CREATE_NEW_ID,
-        SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_NTSC_SAFE_RGB
-            | SOIL_FLAG_COMPRESS_TO_DXT);
+GLuint loadTexture(string filename, unsigned int flags) {
+    // The image is decoded and mipmapped right here; only the upload and the
+    // state below need the GL thread.  Maps that aren't colours keep their
+    // values as they are: no squeezing them into NTSC's range.
+    unsigned int soilFlags
+        = SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_COMPRESS_TO_DXT;
+    if (flags == 0)
+        soilFlags |= SOIL_FLAG_NTSC_SAFE_RGB;
+    GLuint textureHandle = paone::TextureRegistry::shared().loadFile(
+        filename, soilFlags | flags);
+    if (textureHandle != 0) {
+        paone::GLTaskQueue::shared().run([&]() {
+            glBindTexture(GL_TEXTURE_2D, textureHandle);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(
+                GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        });
+    }
     if (textureHandle != 0) {
-        glBindTexture(GL_TEXTURE_2D, textureHandle);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(
-            GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
         printf("[.md5mesh]: %s texture map read in\n", filename.c_str());
     } else {
     }
@@ -158,6 +171,16 @@ GLuint setupMD5Shaders(ShaderProgram &prog, const char *vertexShaderFilename,
 
     prog.create();
     prog.attach(vertexS, fragmentS);
+
+    /* For DrawGPUMesh() */
+    const char *joints[]  = {"joints0", "joints1", "joints2"};
+    const char *weights[] = {"weights0", "weights1", "weights2"};
+    for (int i = 0; i < MD5_GPU_INFLUENCES / 4; ++i) {
+        glBindAttribLocation(prog.handle(), MD5_ATTRIB_JOINTS + i, joints[i]);
+        glBindAttribLocation(
+            prog.handle(), MD5_ATTRIB_WEIGHTS + i, weights[i]);
+    }
+
     prog.link();
 
     prog.use();
@@ -178,16 +201,305 @@ GLuint setupMD5Shaders(ShaderProgram &prog, const char *vertexShaderFilename,
     return prog.handle();
 }
 
+/**
+ * Make a mesh's GL buffers.
+ */
+static void UploadMeshBuffers(struct md5_mesh_t *mesh) {
+    GLuint buffers[3];
+    glGenBuffers(3, buffers);
+    mesh->indexBuffer    = buffers[0];
+    mesh->texelBuffer    = buffers[1];
+    mesh->positionBuffer = buffers[2];
+
+    /* md5_triangle_t is three ints, just as GL wants them */
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 sizeof(struct md5_triangle_t) * mesh->num_tris,
+                 mesh->triangles,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    /* The texels are picked out of the vertices straight into the buffer */
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->texelBuffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 sizeof(vec2_t) * mesh->num_verts,
+                 NULL,
+                 GL_STATIC_DRAW);
+    vec2_t *texels = (vec2_t *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+    if (texels) {
+        for (int i = 0; i < mesh->num_verts; ++i) {
+            texels[i][0] = mesh->vertices[i].st[0];
+            texels[i][1] = mesh->vertices[i].st[1];
+        }
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->positionBuffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 sizeof(vec3_t) * mesh->num_verts,
+                 NULL,
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void FreeMeshBuffers(struct md5_mesh_t *mesh) {
+    if (!mesh->indexBuffer)
+        return;
+
+    GLuint buffers[3]
+        = {mesh->indexBuffer, mesh->texelBuffer, mesh->positionBuffer};
+    paone::GLTaskQueue::shared().run([&]() { glDeleteBuffers(3, buffers); });
+    mesh->indexBuffer = mesh->texelBuffer = mesh->positionBuffer = 0;
+}
+
+/**
+ * Load the maps named by a mesh's shader, with .tga or .png on the end.
+ */
+static void LoadMeshTextures(struct md5_mesh_t *mesh) {
+    string diffuseMapFN         = string(mesh->shader) + ".tga";
+    mesh->textures[0].texHandle = loadTexture(diffuseMapFN);
+    if (mesh->textures[0].texHandle == 0) {
+        diffuseMapFN                = string(mesh->shader) + ".png";
+        mesh->textures[0].texHandle = loadTexture(diffuseMapFN);
+    }
+
+    /* Disabled because it will abort when SOIL can't find the file
+    string specularMapFN        = string(mesh->shader) + "_s.tga";
+    mesh->textures[1].texHandle = loadTexture(specularMapFN);
+    if (mesh->textures[1].texHandle == 0) {
+        specularMapFN               = string(mesh->shader) + "_s.png";
+        mesh->textures[1].texHandle = loadTexture(specularMapFN);
+    }
+    */
+
+    string normalMapFN = string(mesh->shader) + "_local.tga";
+    mesh->textures[2].texHandle
+        = loadTexture(normalMapFN, paone::TEXTURE_FLAG_NORMAL_MAP);
+    if (mesh->textures[2].texHandle == 0) {
+        normalMapFN = string(mesh->shader) + "_local.png";
+        mesh->textures[2].texHandle
+            = loadTexture(normalMapFN, paone::TEXTURE_FLAG_NORMAL_MAP);
+    }
+
+    /* Disabled because it will abort when SOIL can't find the file
+    string heightMapFN = string(mesh->shader) + "_h.tga";
+    mesh->textures[3].texHandle
+        = loadTexture(heightMapFN, paone::TEXTURE_FLAG_LINEAR);
+    if (mesh->textures[3].texHandle == 0) {
+        heightMapFN = string(mesh->shader) + "_h.png";
+        mesh->textures[3].texHandle
+            = loadTexture(heightMapFN, paone::TEXTURE_FLAG_LINEAR);
+    }
+    */
+}
+
+/* What the lines of an md5mesh, and of each mesh in it, start with */
+enum md5mesh_keyword_t
+{
+    MD5MESH_VERSION,
+    MD5MESH_NUM_JOINTS,
+    MD5MESH_NUM_MESHES,
+    MD5MESH_JOINTS,
+    MD5MESH_MESH,
+    MD5MESH_NUM_KEYWORDS
+};
+static const char *const md5meshKeywords[MD5MESH_NUM_KEYWORDS]
+    = {"MD5Version", "numJoints", "numMeshes", "joints", "mesh"};
+
+enum mesh_keyword_t
+{
+    MESH_VERT,
+    MESH_TRI,
+    MESH_WEIGHT,
+    MESH_SHADER,
+    MESH_NUM_VERTS,
+    MESH_NUM_TRIS,
+    MESH_NUM_WEIGHTS,
+    MESH_END,
+    MESH_NUM_KEYWORDS
+};
+static const char *const meshKeywords[MESH_NUM_KEYWORDS] = {"vert",
+                                                            "tri",
+                                                            "weight",
+                                                            "shader",
+                                                            "numverts",
+                                                            "numtris",
+                                                            "numweights",
+                                                            "}"};
+
+/**
+ * Read a joint of the base skeleton: "name" parent ( pos ) ( orient ).
+ */
+static int ReadJoint(struct md5_lexer_t *lex, struct md5_joint_t *joint) {
+    struct md5_token_t name;
+    if (!ReadQuoted(lex, &name) || !ReadInt(lex, &joint->parent)
+        || !ReadVector(lex, joint->pos, 3)
+        || !ReadVector(lex, joint->orient, 3))
+        return 0;
+
+    /* The name keeps its quotes, as it always has */
+    name.start -= 1;
+    name.length += 2;
+    CopyToken(&name, joint->name, sizeof(joint->name));
+
+    /* Compute the w component */
+    Quat_computeW(joint->orient);
+    return 1;
+}
+
+/**
+ * Read the array a "numverts", "numtris" or "numweights" line sizes.
+ */
+template <typename T>
+static int ReadCount(struct md5_lexer_t *lex, int *count, T **array) {
+    if (*array || !ReadInt(lex, count) || *count < 0)
+        return 0;
+
+    /* Zeroed, so any the file leaves out are still checked as something */
+    if (*count > 0)
+        *array = (T *)calloc(*count, sizeof(T));
+    return 1;
+}
+
+/**
+ * Read the index starting a "vert", "tri" or "weight" line.
+ */
+static int ReadIndex(struct md5_lexer_t *lex, int count, int *index) {
+    return ReadInt(lex, index) && *index >= 0 && *index < count;
+}
+
+/**
+ * Whether everything mesh's triangles, vertices and weights refer to is
+ * there, as skinning and drawing it take for granted.
+ */
+static int CheckMesh(const struct md5_mesh_t *mesh, int num_joints) {
+    for (int i = 0; i < mesh->num_tris; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            int index = mesh->triangles[i].index[j];
+            if (index < 0 || index >= mesh->num_verts) {
+                fprintf(stderr,
+                        "[.md5mesh]: Error: tri %d uses vert %d of %d\n",
+                        i,
+                        index,
+                        mesh->num_verts);
+                return 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < mesh->num_verts; ++i) {
+        const struct md5_vertex_t *vert = &mesh->vertices[i];
+        if (vert->start < 0 || vert->count < 0
+            || vert->count > mesh->num_weights - vert->start) {
+            fprintf(stderr,
+                    "[.md5mesh]: Error: vert %d uses weights %d to %d of %d\n",
+                    i,
+                    vert->start,
+                    vert->start + vert->count,
+                    mesh->num_weights);
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < mesh->num_weights; ++i) {
+        int joint = mesh->weights[i].joint;
+        if (joint < 0 || joint >= num_joints) {
+            fprintf(stderr,
+                    "[.md5mesh]: Error: weight %d uses joint %d of %d\n",
+                    i,
+                    joint,
+                    num_joints);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Read a mesh block, from its "{" to its "}", for a model of num_joints.
+ */
+static int ReadMesh(struct md5_lexer_t *lex, struct md5_mesh_t *mesh,
+                    int num_joints) {
+    struct md5_token_t word, shader;
+    int index;
+
+    if (!ExpectChar(lex, '{'))
+        return 0;
+
+    while (NextWord(lex, &word)) {
+        switch (LookupKeyword(&word, meshKeywords, MESH_NUM_KEYWORDS)) {
+        case MESH_VERT: {
+            if (!ReadIndex(lex, mesh->num_verts, &index))
+                return 0;
+
+            struct md5_vertex_t *vert = &mesh->vertices[index];
+            if (!ReadVector(lex, vert->st, 2) || !ReadInt(lex, &vert->start)
+                || !ReadInt(lex, &vert->count))
+                return 0;
+            break;
+        }
+        case MESH_TRI: {
+            if (!ReadIndex(lex, mesh->num_tris, &index))
+                return 0;
+
+            struct md5_triangle_t *tri = &mesh->triangles[index];
+            if (!ReadInt(lex, &tri->index[0]) || !ReadInt(lex, &tri->index[1])
+                || !ReadInt(lex, &tri->index[2]))
+                return 0;
+            break;
+        }
+        case MESH_WEIGHT: {
+            if (!ReadIndex(lex, mesh->num_weights, &index))
+                return 0;
+
+            struct md5_weight_t *weight = &mesh->weights[index];
+            if (!ReadInt(lex, &weight->joint) || !ReadFloat(lex, &weight->bias)
+                || !ReadVector(lex, weight->pos, 3))
+                return 0;
+            break;
+        }
+        case MESH_SHADER:
+            if (!ReadQuoted(lex, &shader))
+                return 0;
+
+            CopyToken(&shader, mesh->shader, sizeof(mesh->shader));
+            if (shader.length > 0)
+                LoadMeshTextures(mesh);
+            break;
+        case MESH_NUM_VERTS:
+            if (!ReadCount(lex, &mesh->num_verts, &mesh->vertices))
+                return 0;
+            break;
+        case MESH_NUM_TRIS:
+            if (!ReadCount(lex, &mesh->num_tris, &mesh->triangles))
+                return 0;
+            break;
+        case MESH_NUM_WEIGHTS:
+            if (!ReadCount(lex, &mesh->num_weights, &mesh->weights))
+                return 0;
+            break;
+        case MESH_END:
+            return CheckMesh(mesh, num_joints);
+        default:
+            SkipLine(lex);
+            break;
+        }
+    }
+
+    /* The file ended first */
+    return 0;
+}
+
 /**
  * Load an MD5 model from file.
  */
 int ReadMD5Model(const char *filename, struct md5_model_t *mdl) {
-
-    FILE *fp;
-    char buff[512];
-    int version;
-    int curr_mesh = 0;
+    struct md5_lexer_t lex;
+    struct md5_token_t word;
+    int version, count;
+    unsigned int curr_mesh = 0;
     unsigned int i;
+    int ok = 1, seenJoints = 0, seenMeshes = 0;
 
     int totVert    = 0;
     int totWeights = 0;
@@ -196,227 +508,109 @@ int ReadMD5Model(const char *filename, struct md5_model_t *mdl) {
     double minX = 999999, minY = 999999, minZ = 999999;
     double maxX = -999999, maxY = -999999, maxZ = -999999;
 
+    /* Nothing in mdl is trusted, so FreeModel() is safe whatever fails */
+    memset(mdl, 0, sizeof(struct md5_model_t));
+
     printf("[.md5mesh]: about to read %s\n", filename);
 
-    fp = fopen(filename, "rb");
-    if (!fp) {
+    paone::MappedFile file;
+    if (!file.open(filename)) {
         fprintf(stderr, "[.md5mesh]: Error: couldn't open \"%s\"!\n", filename);
         return 0;
     }
 
-    while (!feof(fp)) {
-        /* Read whole line */
-        fgets(buff, sizeof(buff), fp);
-
-        if (sscanf(buff, " MD5Version %d", &version) == 1) {
-            if (version != 10) {
+    InitLexer(&lex, file.begin(), file.end());
+    while (ok && NextWord(&lex, &word)) {
+        switch (LookupKeyword(&word, md5meshKeywords, MD5MESH_NUM_KEYWORDS)) {
+        case MD5MESH_VERSION:
+            ok = ReadInt(&lex, &version);
+            if (ok && version != 10) {
                 /* Bad version */
                 fprintf(stderr, "[.md5mesh]: Error: bad model version\n");
-                fclose(fp);
+                FreeModel(mdl);
                 return 0;
             }
-        } else if (sscanf(buff, " numJoints %d", &mdl->num_joints) == 1) {
-            if (mdl->num_joints > 0) {
+            break;
+        case MD5MESH_NUM_JOINTS:
+            ok = !seenJoints++ && ReadInt(&lex, &count) && count >= 0;
+            if (ok) {
+                mdl->num_joints = count;
+
                 /* Allocate memory for base skeleton joints */
-                mdl->baseSkel = (struct md5_joint_t *)calloc(
-                    mdl->num_joints, sizeof(struct md5_joint_t));
+                if (count > 0)
+                    mdl->baseSkel = (struct md5_joint_t *)calloc(
+                        count, sizeof(struct md5_joint_t));
             }
-        } else if (sscanf(buff, " numMeshes %d", &mdl->num_meshes) == 1) {
-            if (mdl->num_meshes > 0) {
+            break;
+        case MD5MESH_NUM_MESHES:
+            ok = !seenMeshes++ && ReadInt(&lex, &count) && count >= 0;
+            if (ok) {
+                mdl->num_meshes = count;
+
                 /* Allocate memory for meshes */
-                mdl->meshes = (struct md5_mesh_t *)calloc(
-                    mdl->num_meshes, sizeof(struct md5_mesh_t));
-            }
-        } else if (strncmp(buff, "joints {", 8) == 0) {
-            /* Read each joint */
-            for (i = 0; i < mdl->num_joints; ++i) {
-                struct md5_joint_t *joint = &mdl->baseSkel[i];
-
-                /* Read whole line */
-                fgets(buff, sizeof(buff), fp);
-
-                if (sscanf(buff,
-                           "%s %d ( %f %f %f ) ( %f %f %f )",
-                           joint->name,
-                           &joint->parent,
-                           &joint->pos[0],
-                           &joint->pos[1],
-                           &joint->pos[2],
-                           &joint->orient[0],
-                           &joint->orient[1],
-                           &joint->orient[2])
-                    == 8) {
-                    /* Compute the w component */
-                    Quat_computeW(joint->orient);
-                }
-            }
-        } else if (strncmp(buff, "mesh {", 6) == 0) {
-            struct md5_mesh_t *mesh = &mdl->meshes[curr_mesh];
-            int vert_index          = 0;
-            int tri_index           = 0;
-            int weight_index        = 0;
-            float fdata[4];
-            int idata[3];
-
-            while ((buff[0] != '}') && !feof(fp)) {
-                /* Read whole line */
-                fgets(buff, sizeof(buff), fp);
-
-                if (strstr(buff, "shader ")) {
-                    int quote = 0, j = 0;
-
-                    /* Copy the shader name whithout the quote marks */
-                    for (i = 0; i < sizeof(buff) && (quote < 2); ++i) {
-                        if (buff[i] == '\"')
-                            quote++;
-
-                        if ((quote == 1) && (buff[i] != '\"')) {
-                            mesh->shader[j] = buff[i];
-                            j++;
-                        }
-                    }
-
-                    /* there was a shader name */
-                    if (j > 0) {
-                        string diffuseMapFN         = string(mesh->shader) + ".tga";
-                        mesh->textures[0].texHandle = loadTexture(diffuseMapFN);
-                        if (mesh->textures[0].texHandle == 0) {
-                            diffuseMapFN = string(mesh->shader) + ".png";
-                            mesh->textures[0].texHandle
-                                = loadTexture(diffuseMapFN);
-                        }
-
-                        /* Disabled because it will abort when SOIL can't find
-                        the file
-                        string specularMapFN = string(mesh->shader) + "_s.tga";
-                        mesh->textures[1].texHandle
-                            = loadTexture(specularMapFN);
-                        if (mesh->textures[1].texHandle == 0) {
-                            specularMapFN = string(mesh->shader) + "_s.png";
-                            mesh->textures[1].texHandle
-                                = loadTexture(specularMapFN);
-                        }
-                        */
-
-                        string normalMapFN
-                            = string(mesh->shader) + "_local.tga";
-                        mesh->textures[2].texHandle = loadTexture(normalMapFN);
-                        if (mesh->textures[2].texHandle == 0) {
-                            normalMapFN = string(mesh->shader) + "_local.png";
-                            mesh->textures[2].texHandle
-                                = loadTexture(normalMapFN);
-                        }
-
-                        /* Disabled because it will abort when SOIL can't find
-                        the file
-                        string heightMapFN          = string(mesh->shader) +
-                        "_h.tga";
-                        mesh->textures[3].texHandle = loadTexture(heightMapFN);
-                        if (mesh->textures[3].texHandle == 0) {
-                            heightMapFN = string(mesh->shader) + "_h.png";
-                            mesh->textures[3].texHandle
-                                = loadTexture(heightMapFN);
-                        }
-                        */
-                    }
-                } else if (sscanf(buff, " numverts %d", &mesh->num_verts)
-                           == 1) {
-                    if (mesh->num_verts > 0) {
-                        /* Allocate memory for vertices */
-                        mesh->vertices = (struct md5_vertex_t *)malloc(
-                            sizeof(struct md5_vertex_t) * mesh->num_verts);
-                    }
-
-                    if (mesh->num_verts > max_verts)
-                        max_verts = mesh->num_verts;
-
-                    totVert += mesh->num_verts;
-                } else if (sscanf(buff, " numtris %d", &mesh->num_tris) == 1) {
-                    if (mesh->num_tris > 0) {
-                        /* Allocate memory for triangles */
-                        mesh->triangles = (struct md5_triangle_t *)malloc(
-                            sizeof(struct md5_triangle_t) * mesh->num_tris);
-                    }
-
-                    if (mesh->num_tris > max_tris)
-                        max_tris = mesh->num_tris;
-
-                    totTris += mesh->num_tris;
-                } else if (sscanf(buff, " numweights %d", &mesh->num_weights)
-                           == 1) {
-                    if (mesh->num_weights > 0) {
-                        /* Allocate memory for vertex weights */
-                        mesh->weights = (struct md5_weight_t *)malloc(
-                            sizeof(struct md5_weight_t) * mesh->num_weights);
-                    }
-
-                    totWeights += mesh->num_weights;
-                } else if (sscanf(buff,
-                                  " vert %d ( %f %f ) %d %d",
-                                  &vert_index,
-                                  &fdata[0],
-                                  &fdata[1],
-                                  &idata[0],
-                                  &idata[1])
-                           == 5) {
-                    /* Copy vertex data */
-                    mesh->vertices[vert_index].st[0] = fdata[0];
-                    mesh->vertices[vert_index].st[1] = fdata[1];
-                    mesh->vertices[vert_index].start = idata[0];
-                    mesh->vertices[vert_index].count = idata[1];
-                } else if (sscanf(buff,
-                                  " tri %d %d %d %d",
-                                  &tri_index,
-                                  &idata[0],
-                                  &idata[1],
-                                  &idata[2])
-                           == 4) {
-                    /* Copy triangle data */
-                    mesh->triangles[tri_index].index[0] = idata[0];
-                    mesh->triangles[tri_index].index[1] = idata[1];
-                    mesh->triangles[tri_index].index[2] = idata[2];
-                } else if (sscanf(buff,
-                                  " weight %d %d %f ( %f %f %f )",
-                                  &weight_index,
-                                  &idata[0],
-                                  &fdata[3],
-                                  &fdata[0],
-                                  &fdata[1],
-                                  &fdata[2])
-                           == 6) {
-                    /* Copy vertex data */
-                    mesh->weights[weight_index].joint  = idata[0];
-                    mesh->weights[weight_index].bias   = fdata[3];
-                    mesh->weights[weight_index].pos[0] = fdata[0];
-                    mesh->weights[weight_index].pos[1] = fdata[1];
-                    mesh->weights[weight_index].pos[2] = fdata[2];
-
-                    if (fdata[0] < minX) {
-                        minX = fdata[0];
-                    }
-                    if (fdata[0] > maxX) {
-                        maxX = fdata[0];
-                    }
-                    if (fdata[1] < minY) {
-                        minY = fdata[1];
-                    }
-                    if (fdata[1] > maxY) {
-                        maxY = fdata[1];
-                    }
-                    if (fdata[2] < minZ) {
-                        minZ = fdata[2];
-                    }
-                    if (fdata[2] > maxZ) {
-                        maxZ = fdata[2];
-                    }
-                }
+                if (count > 0)
+                    mdl->meshes = (struct md5_mesh_t *)calloc(
+                        count, sizeof(struct md5_mesh_t));
             }
+            break;
+        case MD5MESH_JOINTS:
+            ok = ExpectChar(&lex, '{');
+            for (i = 0; ok && i < mdl->num_joints; ++i)
+                ok = ReadJoint(&lex, &mdl->baseSkel[i]);
+            ok = ok && ExpectChar(&lex, '}');
+            break;
+        case MD5MESH_MESH:
+            ok = curr_mesh < mdl->num_meshes
+                 && ReadMesh(
+                     &lex, &mdl->meshes[curr_mesh++], mdl->num_joints);
+            break;
+        default:
+            /* commandline, and anything else we don't use */
+            SkipLine(&lex);
+            break;
+        }
+    }
 
-            curr_mesh++;
+    if (!ok) {
+        fprintf(stderr,
+                "[.md5mesh]: Error: \"%s\", line %d: bad %.*s\n",
+                filename,
+                lex.line,
+                word.length,
+                word.start);
+        FreeModel(mdl);
+        return 0;
+    }
+
+    for (i = 0; i < mdl->num_meshes; ++i) {
+        const struct md5_mesh_t *mesh = &mdl->meshes[i];
+        totVert += mesh->num_verts;
+        totTris += mesh->num_tris;
+        totWeights += mesh->num_weights;
+
+        for (int w = 0; w < mesh->num_weights; ++w) {
+            const float *pos = mesh->weights[w].pos;
+            minX             = min(minX, (double)pos[0]);
+            maxX             = max(maxX, (double)pos[0]);
+            minY             = min(minY, (double)pos[1]);
+            maxY             = max(maxY, (double)pos[1]);
+            minZ             = min(minZ, (double)pos[2]);
+            maxZ             = max(maxZ, (double)pos[2]);
         }
     }
 
-    fclose(fp);
+    /* Set up for skinning */
+    mdl->inverseBind = (struct md5_matrix_t *)malloc(
+        sizeof(struct md5_matrix_t) * (mdl->num_joints + 1));
+    InverseBindMatrices(mdl->baseSkel, mdl->num_joints, mdl->inverseBind);
+    for (i = 0; i < mdl->num_meshes; ++i)
+        mdl->meshes[i].skin = BuildSkin(&mdl->meshes[i], mdl->baseSkel);
+
+    /* Everything but the positions goes to GL once, now */
+    paone::GLTaskQueue::shared().run([mdl]() {
+        for (unsigned int m = 0; m < mdl->num_meshes; ++m)
+            UploadMeshBuffers(&mdl->meshes[m]);
+    });
 
     printf("[.md5mesh]: finished reading %s\n", filename);
     printf("[.md5mesh]: read in %d meshes, %d joints, %d vertices, %d weights, "
@@ -436,89 +630,117 @@ int ReadMD5Model(const char *filename, struct md5_model_t *mdl) {
     return 1;
 }
 
+/**
+ * Load an MD5 model, from cacheFile (see md5binary.h) if it was compiled
+ * from filename as it is now, otherwise from filename, compiling it into
+ * cacheFile for next time.
+ */
+int ReadMD5ModelCached(const char *filename, const char *cacheFile,
+                       struct md5_model_t *mdl) {
+    uint64_t hash;
+    if (!HashMD5Source(filename, &hash))
+        return ReadMD5Model(filename, mdl);
+
+    if (!MapMD5ModelBinary(cacheFile, hash, mdl)) {
+        if (!ReadMD5Model(filename, mdl))
+            return 0;
+
+        if (!WriteMD5ModelBinary(cacheFile, mdl, hash))
+            fprintf(stderr, "[.md5mesh]: couldn't write %s\n", cacheFile);
+        return 1;
+    }
+
+    /* All that's left is what the text loader does for GL */
+    for (unsigned int m = 0; m < mdl->num_meshes; ++m) {
+        if (mdl->meshes[m].shader[0])
+            LoadMeshTextures(&mdl->meshes[m]);
+    }
+    paone::GLTaskQueue::shared().run([mdl]() {
+        for (unsigned int m = 0; m < mdl->num_meshes; ++m)
+            UploadMeshBuffers(&mdl->meshes[m]);
+    });
+
+    return 1;
+}
+
 /**
  * Free resources allocated for the model.
  */
 void FreeModel(struct md5_model_t *mdl) {
     unsigned int i;
 
+    /* A mapped model's arrays are the file's; it goes at the end */
+    int mapped = mdl->mapping != NULL;
+
     if (mdl->baseSkel) {
-        free(mdl->baseSkel);
+        if (!mapped)
+            free(mdl->baseSkel);
         mdl->baseSkel = NULL;
     }
 
+    if (mdl->inverseBind) {
+        if (!mapped)
+            free(mdl->inverseBind);
+        mdl->inverseBind = NULL;
+    }
+
     if (mdl->meshes) {
         /* Free mesh data */
         for (i = 0; i < mdl->num_meshes; ++i) {
             if (mdl->meshes[i].vertices) {
-                free(mdl->meshes[i].vertices);
+                if (!mapped)
+                    free(mdl->meshes[i].vertices);
                 mdl->meshes[i].vertices = NULL;
             }
 
             if (mdl->meshes[i].triangles) {
-                free(mdl->meshes[i].triangles);
+                if (!mapped)
+                    free(mdl->meshes[i].triangles);
                 mdl->meshes[i].triangles = NULL;
             }
 
             if (mdl->meshes[i].weights) {
-                free(mdl->meshes[i].weights);
+                if (!mapped)
+                    free(mdl->meshes[i].weights);
                 mdl->meshes[i].weights = NULL;
             }
+
+            FreeSkin(mdl->meshes[i].skin);
+            mdl->meshes[i].skin = NULL;
+
+            FreeMeshBuffers(&mdl->meshes[i]);
+
+            /* Textures are shared with anything else that uses them */
+            for (int j = 0; j < 4; ++j) {
+                if (mdl->meshes[i].textures[j].texHandle) {
+                    paone::TextureRegistry::shared().release(
+                        mdl->meshes[i].textures[j].texHandle);
+                    mdl->meshes[i].textures[j].texHandle = 0;
+                }
+            }
         }
 
         free(mdl->meshes);
         mdl->meshes = NULL;
     }
+
+    if (mapped) {
+        UnmapMD5Binary(mdl->mapping);
+        mdl->mapping = NULL;
+    }
 }
 
 /**
  * Prepare a mesh for drawing.  Compute mesh's final vertex positions
- * given a skeleton.  Put the vertices in vertex arrays.
+ * given a skeleton's palette, into vertices (see AllocSkinnedVertices()).
  */
 void PrepareMesh(const struct md5_mesh_t *mesh,
-                 const struct md5_joint_t *skeleton)
-
-{
-    int i, j, k;
-
-    /* Setup vertex indices */
-    for (k = 0, i = 0; i < mesh->num_tris; ++i) {
-        for (j = 0; j < 3; ++j, ++k)
-            vertexIndices[k] = mesh->triangles[i].index[j];
-    }
-
-    /* Setup vertices */
-    for (i = 0; i < mesh->num_verts; ++i) {
-        vec3_t finalVertex = {0.0f, 0.0f, 0.0f};
-
-        /* Calculate final vertex to draw with weights */
-        for (j = 0; j < mesh->vertices[i].count; ++j) {
-            const struct md5_weight_t *weight
-                = &mesh->weights[mesh->vertices[i].start + j];
-            const struct md5_joint_t *joint = &skeleton[weight->joint];
-
-            /* Calculate transformed vertex for this weight */
-            vec3_t wv;
-            Quat_rotatePoint(joint->orient, weight->pos, wv);
-
-            /* The sum of all weight->bias should be 1.0 */
-            finalVertex[0] += (joint->pos[0] + wv[0]) * weight->bias;
-            finalVertex[1] += (joint->pos[1] + wv[1]) * weight->bias;
-            finalVertex[2] += (joint->pos[2] + wv[2]) * weight->bias;
-        }
-
-        // TODO #1: Place final vertices into our vertex array
-        vertexArray[i][0] = finalVertex[0];
-        vertexArray[i][1] = finalVertex[1];
-        vertexArray[i][2] = finalVertex[2];
-
-        // TODO #5: Place texture coordinate into texel array
-        texelArray[i][0] = mesh->vertices[i].st[0];
-        texelArray[i][1] = mesh->vertices[i].st[1];
-    }
+                 const struct md5_matrix_t *palette, vec3_t *vertices) {
+    SkinVertices(mesh->skin, palette, vertices);
 }
 
-void DrawMesh(const struct md5_mesh_t *mesh) {
+/* Bind a mesh's textures, and undo it */
+static void BindTextures(const struct md5_mesh_t *mesh) {
     glEnable(GL_TEXTURE_2D);
 
     /* Bind Diffuse Map */
@@ -536,59 +758,160 @@ void DrawMesh(const struct md5_mesh_t *mesh) {
     /* Bind Height Map */
     glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, mesh->textures[3].texHandle);
+}
+
+static void UnbindTextures() {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // do this last so 0 is active again by default
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+}
+
+void DrawMesh(const struct md5_mesh_t *mesh, const vec3_t *vertices) {
+    BindTextures(mesh);
 
     // TODO #2: Enable our vertex array
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
     // TODO #3: pass our vertex pointer and draw everything!
-    glVertexPointer(3, GL_FLOAT, 0, vertexArray);
-    glTexCoordPointer(2, GL_FLOAT, 0, texelArray);
+    // Only the positions change; the buffer is orphaned first so GL doesn't
+    // wait on the last frame's draw to finish with it.
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->positionBuffer);
+    if (vertices) {
+        glBufferData(GL_ARRAY_BUFFER,
+                     sizeof(vec3_t) * mesh->num_verts,
+                     NULL,
+                     GL_STREAM_DRAW);
+        glBufferSubData(
+            GL_ARRAY_BUFFER, 0, sizeof(vec3_t) * mesh->num_verts, vertices);
+    }
+    glVertexPointer(3, GL_FLOAT, 0, BUFFER_OFFSET(0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->texelBuffer);
+    glTexCoordPointer(2, GL_FLOAT, 0, BUFFER_OFFSET(0));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
     glDrawElements(
-        GL_TRIANGLES, mesh->num_tris * 3, GL_UNSIGNED_INT, vertexIndices);
+        GL_TRIANGLES, mesh->num_tris * 3, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     // TODO #4: Disable the vertex array
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    UnbindTextures();
+}
 
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, 0);
+int MaxGPUSkinningJoints(const ShaderProgram &prog) {
+    GLint uniforms = 0;
+    glGetProgramiv(prog.handle(), GL_ACTIVE_UNIFORMS, &uniforms);
+
+    /* The palette is 3 rows a joint */
+    for (GLint i = 0; i < uniforms; ++i) {
+        char name[64];
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(
+            prog.handle(), i, sizeof(name), NULL, &size, &type, name);
+        if (type == GL_FLOAT_VEC4 && (!strcmp(name, "palette")
+                                      || !strcmp(name, "palette[0]")))
+            return size / 3;
+    }
 
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    return 0;
+}
 
-    // do this last so 0 is active again by default
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glDisable(GL_TEXTURE_2D);
+void UploadGPUMesh(const struct md5_mesh_t *mesh,
+                   const struct md5_gpu_vertex_t *vertices,
+                   struct md5_gpu_mesh_t *gpu) {
+    glGenBuffers(1, &gpu->vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu->vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER,
+                 sizeof(struct md5_gpu_vertex_t) * mesh->num_verts,
+                 vertices,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void AllocVertexArrays() {
-    vertexArray   = (vec3_t *)malloc(sizeof(vec3_t) * max_verts);
-    vertexIndices = (GLuint *)malloc(sizeof(GLuint) * max_tris * 3);
+void FreeGPUMesh(struct md5_gpu_mesh_t *gpu) {
+    glDeleteBuffers(1, &gpu->vertexBuffer);
+    memset(gpu, 0, sizeof(struct md5_gpu_mesh_t));
+}
 
-    texelArray = (vec2_t *)malloc(sizeof(vec2_t) * max_verts);
+void SetSkinningPalette(const ShaderProgram &prog,
+                        const struct md5_matrix_t *palette, int num_joints) {
+    glUniform1i(prog.getUniformLocation("skinned"), palette != NULL);
+    if (palette)
+        glUniform4fv(prog.getUniformLocation("palette"),
+                     3 * num_joints,
+                     &palette[0].m[0][0]);
 }
 
-void FreeVertexArrays() {
-    if (vertexArray) {
-        free(vertexArray);
-        vertexArray = NULL;
-    }
+void DrawGPUMesh(const struct md5_mesh_t *mesh,
+                 const struct md5_gpu_mesh_t *gpu) {
+    const GLsizei stride = sizeof(struct md5_gpu_vertex_t);
+    int i;
+
+    BindTextures(mesh);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gpu->vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
 
-    if (vertexIndices) {
-        free(vertexIndices);
-        vertexIndices = NULL;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(
+        3, GL_FLOAT, stride, BUFFER_OFFSET(offsetof(md5_gpu_vertex_t, pos)));
+    glTexCoordPointer(
+        2, GL_FLOAT, stride, BUFFER_OFFSET(offsetof(md5_gpu_vertex_t, st)));
+
+    /* Four joints and weights to an attribute */
+    for (i = 0; i < MD5_GPU_INFLUENCES / 4; ++i) {
+        glEnableVertexAttribArray(MD5_ATTRIB_JOINTS + i);
+        glVertexAttribPointer(
+            MD5_ATTRIB_JOINTS + i,
+            4,
+            GL_UNSIGNED_BYTE,
+            GL_FALSE,
+            stride,
+            BUFFER_OFFSET(offsetof(md5_gpu_vertex_t, joint) + 4 * i));
+
+        glEnableVertexAttribArray(MD5_ATTRIB_WEIGHTS + i);
+        glVertexAttribPointer(
+            MD5_ATTRIB_WEIGHTS + i,
+            4,
+            GL_FLOAT,
+            GL_FALSE,
+            stride,
+            BUFFER_OFFSET(offsetof(md5_gpu_vertex_t, weight)
+                          + 4 * sizeof(float) * i));
     }
 
-    if (texelArray) {
-        free(texelArray);
-        texelArray = NULL;
+    glDrawElements(
+        GL_TRIANGLES, mesh->num_tris * 3, GL_UNSIGNED_INT, BUFFER_OFFSET(0));
+
+    for (i = 0; i < MD5_GPU_INFLUENCES / 4; ++i) {
+        glDisableVertexAttribArray(MD5_ATTRIB_JOINTS + i);
+        glDisableVertexAttribArray(MD5_ATTRIB_WEIGHTS + i);
     }
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    UnbindTextures();
 }
 
 /**
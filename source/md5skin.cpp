@@ -0,0 +1,543 @@
+/*
+ * md5skin.cpp -- vectorized skinning for md5 meshes
+ *
+ * Every level adds up, for each influence, the joint's palette matrix times
+ * the influence's (bias scaled) bind pose position, plus bias times the
+ * matrix's translation.  The vector levels load each lane's matrix whole and
+ * transpose them into a register per element, which is quicker than
+ * gathering the elements one by one.
+ */
+
+#include "MD5/md5skin.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+// the vector kernels are compiled for their instruction sets function by
+// function, so nothing else needs special flags and the CPU is asked before
+// any of them run.
+#if (defined(__GNUC__) || defined(__clang__))                                  \
+    && (defined(__x86_64__) || defined(__i386__))
+#define MD5_X86_KERNELS 1
+#include <immintrin.h>
+#define MD5_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MD5_X86_KERNELS 0
+#endif
+
+// the kernels read a matrix as 12 floats in a row.
+static_assert(sizeof(struct md5_matrix_t) == 12 * sizeof(float),
+              "md5_matrix_t must be 12 packed floats");
+
+static enum md5_skin_level_t detectSkinLevel() {
+#if MD5_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return MD5_SKIN_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return MD5_SKIN_SSE2;
+#endif
+    return MD5_SKIN_SCALAR;
+}
+
+static atomic<int> skinLimit(MD5_SKIN_AVX2);
+
+enum md5_skin_level_t SupportedSkinLevel() {
+    static const enum md5_skin_level_t supported = detectSkinLevel();
+    return supported;
+}
+
+enum md5_skin_level_t SkinLevel() {
+    int limit = skinLimit;
+    return SupportedSkinLevel() < limit ? SupportedSkinLevel()
+                                        : (enum md5_skin_level_t)limit;
+}
+
+void LimitSkinLevel(enum md5_skin_level_t level) { skinLimit = level; }
+
+
+void JointMatrix(const struct md5_joint_t *joint, struct md5_matrix_t *out) {
+    const float *q = joint->orient;
+    float mag
+        = sqrt((q[X] * q[X]) + (q[Y] * q[Y]) + (q[Z] * q[Z]) + (q[W] * q[W]));
+
+    /* The rotation of the normalized orient, scaled by its length: the same
+     * as q * v * normalize(conjugate(q)) */
+    float s = mag > 0.0f ? 2.0f / mag : 0.0f;
+    float x = q[X], y = q[Y], z = q[Z], w = q[W];
+
+    out->m[0][0] = mag - s * (y * y + z * z);
+    out->m[0][1] = s * (x * y - z * w);
+    out->m[0][2] = s * (x * z + y * w);
+    out->m[1][0] = s * (x * y + z * w);
+    out->m[1][1] = mag - s * (x * x + z * z);
+    out->m[1][2] = s * (y * z - x * w);
+    out->m[2][0] = s * (x * z - y * w);
+    out->m[2][1] = s * (y * z + x * w);
+    out->m[2][2] = mag - s * (x * x + y * y);
+
+    out->m[0][3] = joint->pos[0];
+    out->m[1][3] = joint->pos[1];
+    out->m[2][3] = joint->pos[2];
+}
+
+void InverseBindMatrices(const struct md5_joint_t *bindSkel, int num_joints,
+                         struct md5_matrix_t *out) {
+    for (int i = 0; i < num_joints; ++i) {
+        struct md5_matrix_t bind;
+        JointMatrix(&bindSkel[i], &bind);
+
+        /* A rotation scaled by s: its transpose over s squared undoes it */
+        float s2 = bind.m[0][0] * bind.m[0][0] + bind.m[1][0] * bind.m[1][0]
+                   + bind.m[2][0] * bind.m[2][0];
+        float oneOverS2 = s2 > 0.0f ? 1.0f / s2 : 0.0f;
+
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 3; ++c)
+                out[i].m[r][c] = bind.m[c][r] * oneOverS2;
+            out[i].m[r][3] = -(out[i].m[r][0] * bind.m[0][3]
+                               + out[i].m[r][1] * bind.m[1][3]
+                               + out[i].m[r][2] * bind.m[2][3]);
+        }
+    }
+}
+
+void BuildPalette(const struct md5_joint_t *skeleton,
+                  const struct md5_matrix_t *inverseBind, int num_joints,
+                  struct md5_matrix_t *palette) {
+    for (int i = 0; i < num_joints; ++i) {
+        struct md5_matrix_t pose;
+        JointMatrix(&skeleton[i], &pose);
+
+        const struct md5_matrix_t *inv = &inverseBind[i];
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                palette[i].m[r][c] = pose.m[r][0] * inv->m[0][c]
+                                     + pose.m[r][1] * inv->m[1][c]
+                                     + pose.m[r][2] * inv->m[2][c];
+            }
+            palette[i].m[r][3] += pose.m[r][3];
+        }
+    }
+}
+
+void TransformPoint(const struct md5_matrix_t *matrix, const vec3_t point,
+                    vec3_t out) {
+    for (int r = 0; r < 3; ++r) {
+        out[r] = matrix->m[r][0] * point[0] + matrix->m[r][1] * point[1]
+                 + matrix->m[r][2] * point[2] + matrix->m[r][3];
+    }
+}
+
+/**
+ * Repack a mesh's weights.
+ */
+struct md5_skin_t *BuildSkin(const struct md5_mesh_t *mesh,
+                             const struct md5_joint_t *bindSkel) {
+    struct md5_skin_t *skin
+        = (struct md5_skin_t *)calloc(1, sizeof(struct md5_skin_t));
+    skin->num_verts  = mesh->num_verts;
+    skin->num_blocks = (mesh->num_verts + MD5_SKIN_BLOCK - 1) / MD5_SKIN_BLOCK;
+
+    /* Each vertex's weights, one per joint */
+    struct influence {
+        int joint;
+        float bias;
+        vec3_t pos;
+    };
+    vector<influence> influences;
+    influences.reserve(mesh->num_weights);
+    vector<int> first(mesh->num_verts + 1, 0);
+    for (int i = 0; i < mesh->num_verts; ++i) {
+        const struct md5_vertex_t *vertex = &mesh->vertices[i];
+        first[i] = (int)influences.size();
+
+        for (int j = 0; j < vertex->count; ++j) {
+            if (vertex->start + j < 0
+                || vertex->start + j >= mesh->num_weights)
+                continue;
+            const struct md5_weight_t *weight
+                = &mesh->weights[vertex->start + j];
+
+            size_t k = first[i];
+            while (k < influences.size()
+                   && influences[k].joint != weight->joint)
+                ++k;
+            if (k == influences.size()) {
+                influence added = {weight->joint, 0.0f, {0.0f, 0.0f, 0.0f}};
+                influences.push_back(added);
+            }
+
+            /* Where the weight is in the bind pose */
+            struct md5_matrix_t bind;
+            vec3_t pos;
+            JointMatrix(&bindSkel[weight->joint], &bind);
+            TransformPoint(&bind, weight->pos, pos);
+
+            influences[k].bias += weight->bias;
+            influences[k].pos[0] += pos[0] * weight->bias;
+            influences[k].pos[1] += pos[1] * weight->bias;
+            influences[k].pos[2] += pos[2] * weight->bias;
+            skin->num_joints = max(skin->num_joints, weight->joint + 1);
+        }
+    }
+    first[mesh->num_verts] = (int)influences.size();
+
+    /* Each block gets as many slots as its busiest vertex */
+    skin->first_slot = (int *)malloc(sizeof(int) * (skin->num_blocks + 1));
+    int num_slots    = 0;
+    for (int b = 0; b < skin->num_blocks; ++b) {
+        skin->first_slot[b] = num_slots;
+
+        int slots = 0;
+        for (int l = 0; l < MD5_SKIN_BLOCK; ++l) {
+            int i = b * MD5_SKIN_BLOCK + l;
+            if (i < mesh->num_verts)
+                slots = max(slots, first[i + 1] - first[i]);
+        }
+        num_slots += slots;
+    }
+    skin->first_slot[skin->num_blocks] = num_slots;
+
+    /* Padding is all zeroes: joint 0, with no bias */
+    skin->slots = (struct md5_skin_slot_t *)calloc(
+        max(num_slots, 1), sizeof(struct md5_skin_slot_t));
+    for (int i = 0; i < mesh->num_verts; ++i) {
+        struct md5_skin_slot_t *slot
+            = &skin->slots[skin->first_slot[i / MD5_SKIN_BLOCK]];
+        int l = i % MD5_SKIN_BLOCK;
+
+        for (int k = first[i]; k < first[i + 1]; ++k, ++slot) {
+            slot->joint[l] = influences[k].joint;
+            slot->bias[l]  = influences[k].bias;
+            slot->x[l]     = influences[k].pos[0];
+            slot->y[l]     = influences[k].pos[1];
+            slot->z[l]     = influences[k].pos[2];
+        }
+    }
+
+    return skin;
+}
+
+/**
+ * A mesh's vertices for the GPU.  Where a vertex is in the bind pose is the
+ * sum of its (bias scaled) slots; the GPU blends its joints' matrices by
+ * bias and moves that, rather than moving each slot, which is the same as
+ * long as the weights agree on where the vertex is.
+ */
+struct md5_gpu_vertex_t *BuildGPUVertices(const struct md5_mesh_t *mesh) {
+    const struct md5_skin_t *skin = mesh->skin;
+    struct md5_gpu_vertex_t *vertices = (struct md5_gpu_vertex_t *)calloc(
+        max(skin->num_verts, 1), sizeof(struct md5_gpu_vertex_t));
+
+    for (int i = 0; i < skin->num_verts; ++i) {
+        struct md5_gpu_vertex_t *vertex = &vertices[i];
+        vertex->st[0] = mesh->vertices[i].st[0];
+        vertex->st[1] = mesh->vertices[i].st[1];
+
+        int b = i / MD5_SKIN_BLOCK, l = i % MD5_SKIN_BLOCK, n = 0;
+        for (int k = skin->first_slot[b]; k < skin->first_slot[b + 1]; ++k) {
+            const struct md5_skin_slot_t *slot = &skin->slots[k];
+            if (slot->bias[l] == 0.0f)
+                continue;
+            if (n == MD5_GPU_INFLUENCES || slot->joint[l] > 255) {
+                free(vertices);
+                return NULL;
+            }
+
+            vertex->joint[n]  = (unsigned char)slot->joint[l];
+            vertex->weight[n] = slot->bias[l];
+            vertex->pos[0] += slot->x[l];
+            vertex->pos[1] += slot->y[l];
+            vertex->pos[2] += slot->z[l];
+            ++n;
+        }
+    }
+
+    return vertices;
+}
+
+void FreeSkin(struct md5_skin_t *skin) {
+    if (!skin)
+        return;
+
+    if (!skin->mapped) {
+        free(skin->first_slot);
+        free(skin->slots);
+    }
+    free(skin);
+}
+
+/* the skinned block, SoA, into (up to) count vertices of out */
+static void storeBlock(const float *x, const float *y, const float *z,
+                       int count, vec3_t *out) {
+    for (int l = 0; l < count; ++l) {
+        out[l][0] = x[l];
+        out[l][1] = y[l];
+        out[l][2] = z[l];
+    }
+}
+
+//
+// Scalar
+//
+
+static void skinBlockScalar(const struct md5_skin_slot_t *slot,
+                            const struct md5_skin_slot_t *end,
+                            const struct md5_matrix_t *palette, float *x,
+                            float *y, float *z) {
+    for (int l = 0; l < MD5_SKIN_BLOCK; ++l)
+        x[l] = y[l] = z[l] = 0.0f;
+
+    for (; slot < end; ++slot) {
+        for (int l = 0; l < MD5_SKIN_BLOCK; ++l) {
+            const float(*m)[4] = palette[slot->joint[l]].m;
+            float vx = slot->x[l], vy = slot->y[l], vz = slot->z[l];
+            float bias = slot->bias[l];
+
+            x[l] += m[0][0] * vx + m[0][1] * vy + m[0][2] * vz
+                    + m[0][3] * bias;
+            y[l] += m[1][0] * vx + m[1][1] * vy + m[1][2] * vz
+                    + m[1][3] * bias;
+            z[l] += m[2][0] * vx + m[2][1] * vy + m[2][2] * vz
+                    + m[2][3] * bias;
+        }
+    }
+}
+
+#if MD5_X86_KERNELS
+
+//
+// SSE2
+//
+// Half a block at a time: each row of the four lanes' matrices, transposed.
+//
+
+MD5_TARGET("sse2")
+static void skinBlockSSE2(const struct md5_skin_slot_t *slot,
+                          const struct md5_skin_slot_t *end,
+                          const struct md5_matrix_t *palette, float *x,
+                          float *y, float *z) {
+    for (int h = 0; h < MD5_SKIN_BLOCK; h += 4) {
+        __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps(),
+               sz = _mm_setzero_ps();
+
+        for (const struct md5_skin_slot_t *s = slot; s < end; ++s) {
+            const float *p0 = &palette[s->joint[h + 0]].m[0][0];
+            const float *p1 = &palette[s->joint[h + 1]].m[0][0];
+            const float *p2 = &palette[s->joint[h + 2]].m[0][0];
+            const float *p3 = &palette[s->joint[h + 3]].m[0][0];
+
+            __m128 vx = _mm_loadu_ps(s->x + h), vy = _mm_loadu_ps(s->y + h),
+                   vz   = _mm_loadu_ps(s->z + h);
+            __m128 bias = _mm_loadu_ps(s->bias + h);
+
+            __m128 *sums[3] = {&sx, &sy, &sz};
+            for (int r = 0; r < 3; ++r) {
+                __m128 m0 = _mm_loadu_ps(p0 + 4 * r),
+                       m1 = _mm_loadu_ps(p1 + 4 * r),
+                       m2 = _mm_loadu_ps(p2 + 4 * r),
+                       m3 = _mm_loadu_ps(p3 + 4 * r);
+                _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+
+                *sums[r] = _mm_add_ps(
+                    *sums[r],
+                    _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(m0, vx), _mm_mul_ps(m1, vy)),
+                        _mm_add_ps(_mm_mul_ps(m2, vz), _mm_mul_ps(m3, bias))));
+            }
+        }
+
+        _mm_storeu_ps(x + h, sx);
+        _mm_storeu_ps(y + h, sy);
+        _mm_storeu_ps(z + h, sz);
+    }
+}
+
+//
+// AVX2
+//
+// A whole block at a time.  The first two rows of each lane's matrix are one
+// 32 byte load, and an 8x8 transpose of those gives their 8 elements; the
+// third rows are paired up lane l with lane l + 4 and transposed 4x4 within
+// each 128 bit half.
+//
+
+MD5_TARGET("avx2")
+static void skinBlockAVX2(const struct md5_skin_slot_t *slot,
+                          const struct md5_skin_slot_t *end,
+                          const struct md5_matrix_t *palette, float *x,
+                          float *y, float *z) {
+    __m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps(),
+           sz = _mm256_setzero_ps();
+
+    for (; slot < end; ++slot) {
+        const float *p[8];
+        __m256 r[8];
+        for (int l = 0; l < 8; ++l) {
+            p[l] = &palette[slot->joint[l]].m[0][0];
+            r[l] = _mm256_loadu_ps(p[l]);
+        }
+
+        __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+        __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+        __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+        __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+        __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+        __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+        __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+        __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+        __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+        __m256 m00 = _mm256_permute2f128_ps(u0, u4, 0x20);
+        __m256 m01 = _mm256_permute2f128_ps(u1, u5, 0x20);
+        __m256 m02 = _mm256_permute2f128_ps(u2, u6, 0x20);
+        __m256 m03 = _mm256_permute2f128_ps(u3, u7, 0x20);
+        __m256 m10 = _mm256_permute2f128_ps(u0, u4, 0x31);
+        __m256 m11 = _mm256_permute2f128_ps(u1, u5, 0x31);
+        __m256 m12 = _mm256_permute2f128_ps(u2, u6, 0x31);
+        __m256 m13 = _mm256_permute2f128_ps(u3, u7, 0x31);
+
+        __m256 d[4];
+        for (int l = 0; l < 4; ++l)
+            d[l] = _mm256_insertf128_ps(
+                _mm256_castps128_ps256(_mm_loadu_ps(p[l] + 8)),
+                _mm_loadu_ps(p[l + 4] + 8),
+                1);
+        t0 = _mm256_unpacklo_ps(d[0], d[1]);
+        t1 = _mm256_unpackhi_ps(d[0], d[1]);
+        t2 = _mm256_unpacklo_ps(d[2], d[3]);
+        t3 = _mm256_unpackhi_ps(d[2], d[3]);
+        __m256 m20 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 m21 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 m22 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 m23 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+        __m256 vx = _mm256_loadu_ps(slot->x), vy = _mm256_loadu_ps(slot->y),
+               vz   = _mm256_loadu_ps(slot->z);
+        __m256 bias = _mm256_loadu_ps(slot->bias);
+
+        sx = _mm256_add_ps(
+            sx,
+            _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(m00, vx), _mm256_mul_ps(m01, vy)),
+                _mm256_add_ps(_mm256_mul_ps(m02, vz),
+                              _mm256_mul_ps(m03, bias))));
+        sy = _mm256_add_ps(
+            sy,
+            _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(m10, vx), _mm256_mul_ps(m11, vy)),
+                _mm256_add_ps(_mm256_mul_ps(m12, vz),
+                              _mm256_mul_ps(m13, bias))));
+        sz = _mm256_add_ps(
+            sz,
+            _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(m20, vx), _mm256_mul_ps(m21, vy)),
+                _mm256_add_ps(_mm256_mul_ps(m22, vz),
+                              _mm256_mul_ps(m23, bias))));
+    }
+
+    _mm256_storeu_ps(x, sx);
+    _mm256_storeu_ps(y, sy);
+    _mm256_storeu_ps(z, sz);
+}
+
+#endif
+
+void SkinVertices(const struct md5_skin_t *skin,
+                  const struct md5_matrix_t *palette, vec3_t *out) {
+    typedef void (*skin_block_t)(const struct md5_skin_slot_t *,
+                                 const struct md5_skin_slot_t *,
+                                 const struct md5_matrix_t *, float *, float *,
+                                 float *);
+    skin_block_t skinBlock = skinBlockScalar;
+#if MD5_X86_KERNELS
+    switch (SkinLevel()) {
+    case MD5_SKIN_AVX2:
+        skinBlock = skinBlockAVX2;
+        break;
+    case MD5_SKIN_SSE2:
+        skinBlock = skinBlockSSE2;
+        break;
+    default:
+        break;
+    }
+#endif
+
+    float x[MD5_SKIN_BLOCK], y[MD5_SKIN_BLOCK], z[MD5_SKIN_BLOCK];
+    for (int b = 0; b < skin->num_blocks; ++b) {
+        skinBlock(&skin->slots[skin->first_slot[b]],
+                  &skin->slots[skin->first_slot[b + 1]],
+                  palette,
+                  x,
+                  y,
+                  z);
+        storeBlock(x,
+                   y,
+                   z,
+                   min(MD5_SKIN_BLOCK, skin->num_verts - b * MD5_SKIN_BLOCK),
+                   out + b * MD5_SKIN_BLOCK);
+    }
+}
+
+/* arrays given back, kept for reuse: at most this many of each size */
+static const size_t MAX_POOLED = 64;
+
+struct skinned_pool {
+    mutex lock;
+    map<int, vector<vec3_t *> > free;
+};
+
+static skinned_pool &skinnedPool() {
+    // never destroyed, so arrays freed while exiting have somewhere to go.
+    static skinned_pool *pool = new skinned_pool;
+    return *pool;
+}
+
+vec3_t *AllocSkinnedVertices(int num_verts) {
+    skinned_pool &pool = skinnedPool();
+    {
+        lock_guard<mutex> hold(pool.lock);
+        vector<vec3_t *> &sized = pool.free[num_verts];
+        if (!sized.empty()) {
+            vec3_t *vertices = sized.back();
+            sized.pop_back();
+            return vertices;
+        }
+    }
+
+    return (vec3_t *)malloc(sizeof(vec3_t) * max(num_verts, 1));
+}
+
+void FreeSkinnedVertices(vec3_t *vertices, int num_verts) {
+    if (!vertices)
+        return;
+
+    skinned_pool &pool = skinnedPool();
+    {
+        lock_guard<mutex> hold(pool.lock);
+        vector<vec3_t *> &sized = pool.free[num_verts];
+        if (sized.size() < MAX_POOLED) {
+            sized.push_back(vertices);
+            return;
+        }
+    }
+
+    free(vertices);
+}